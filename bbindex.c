@@ -0,0 +1,419 @@
+/*--------------------------------------------------------------*/
+/* bbindex.c --							*/
+/*								*/
+/* Uniform grid bin index over net bounding boxes.		*/
+/*								*/
+/* Bbox collision queries used to run check_single_bbox_	*/
+/* collision() against every net in flight, or against every	*/
+/* net of the design, and that check walks the edges of both	*/
+/* polygons grid point by grid point.  Two bboxes can only	*/
+/* collide if their trunk extents (the rectangles enclosing	*/
+/* their edges) overlap, so the index files each net under the	*/
+/* bins of a coarse grid over the die that its extent covers.	*/
+/* A query returns the keys of only those nets sharing a bin	*/
+/* with the query net and having an overlapping extent;  the	*/
+/* caller then runs the exact test on those few.		*/
+/*								*/
+/* Nets without a usable extent (no bbox, or no edges) collide	*/
+/* with everything under check_single_bbox_collision(), so they	*/
+/* are kept aside and returned by every query.  A query for	*/
+/* such a net returns every net in the index.			*/
+/*								*/
+/* Keys are given on insertion and returned in ascending order,	*/
+/* so that callers see the nets in the same order as a linear	*/
+/* scan over the keys would produce.  The index is not locked;  callers	*/
+/* serialize access to it.					*/
+/*--------------------------------------------------------------*/
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "qrouter.h"
+#include "qconfig.h"
+#include "node.h"
+#include "bbindex.h"
+
+typedef struct bbentry_ BBENTRY;
+
+struct bbentry_ {
+    NET net;			// NULL if the entry is free
+    int key;			// Sort key of query results
+    int nextfree;		// Next free entry, if free
+    int x1, y1, x2, y2;		// Trunk extent, if "bounded"
+    BOOL bounded;
+    u_int stamp;		// Last query that returned this entry
+};
+
+typedef struct bbbin_ {
+    int *entry;			// Indices into entries[]
+    int count;
+    int max;
+} BBBIN;
+
+struct bbindex_ {
+    BBENTRY *entries;
+    int numentries;		// Entries ever used
+    int maxentries;
+    int freelist;		// First free entry, or -1
+    int binsize;		// Bin side in grid positions
+    int nbx, nby;		// Bins in X and Y
+    BBBIN *bins;
+    BBBIN unbounded;		// Nets returned by every query
+    u_int stamp;
+    BBENTRY **hit;		// Entries found by a query
+    int *result;		// Keys found by a query
+    int maxresult;
+    int count;			// Nets in the index
+};
+
+/*--------------------------------------------------------------*/
+/* Grow an integer list to hold at least one more element	*/
+/*--------------------------------------------------------------*/
+
+static void
+bin_add(BBBIN *bin, int e)
+{
+    if (bin->count == bin->max) {
+	bin->max = (bin->max == 0) ? 4 : (bin->max << 1);
+	bin->entry = (int *)realloc(bin->entry, bin->max * sizeof(int));
+	if (bin->entry == NULL) {
+	    printf("%s: memory leak. dying!\n",__FUNCTION__);
+	    exit(0);
+	}
+    }
+    bin->entry[bin->count++] = e;
+}
+
+static void
+bin_delete(BBBIN *bin, int e)
+{
+    int i;
+
+    for (i = 0; i < bin->count; i++)
+	if (bin->entry[i] == e) {
+	    bin->entry[i] = bin->entry[--bin->count];
+	    return;
+	}
+}
+
+/*--------------------------------------------------------------*/
+/* Size the bin grid to the current die.  Any nets already in	*/
+/* the index are dropped.					*/
+/*--------------------------------------------------------------*/
+
+static void
+bbindex_setup(BBINDEX idx)
+{
+    int i, side;
+
+    for (i = 0; i < idx->nbx * idx->nby; i++) free(idx->bins[i].entry);
+    free(idx->bins);
+    free(idx->unbounded.entry);
+
+    side = MAX(NumChannelsX[0], NumChannelsY[0]);
+    idx->binsize = MAX((side + BBINDEX_BINS - 1) / BBINDEX_BINS, BBINDEX_MIN_BIN);
+    idx->nbx = MAX((NumChannelsX[0] + idx->binsize - 1) / idx->binsize, 1);
+    idx->nby = MAX((NumChannelsY[0] + idx->binsize - 1) / idx->binsize, 1);
+    idx->bins = (BBBIN *)calloc(idx->nbx * idx->nby, sizeof(BBBIN));
+    if (idx->bins == NULL) {
+	printf("%s: memory leak. dying!\n",__FUNCTION__);
+	exit(0);
+    }
+    idx->unbounded.entry = NULL;
+    idx->unbounded.count = idx->unbounded.max = 0;
+    idx->numentries = 0;
+    idx->freelist = -1;
+    idx->count = 0;
+}
+
+/* Bin range covered by an entry, clipped to the grid */
+
+static void
+bin_range(BBINDEX idx, BBENTRY *be, int *bx1, int *by1, int *bx2, int *by2)
+{
+    *bx1 = MIN(MAX(be->x1 / idx->binsize, 0), idx->nbx - 1);
+    *by1 = MIN(MAX(be->y1 / idx->binsize, 0), idx->nby - 1);
+    *bx2 = MIN(MAX(be->x2 / idx->binsize, 0), idx->nbx - 1);
+    *by2 = MIN(MAX(be->y2 / idx->binsize, 0), idx->nby - 1);
+}
+
+/*--------------------------------------------------------------*/
+/* bbindex_new --						*/
+/*								*/
+/* Create an empty index over the current die.			*/
+/*--------------------------------------------------------------*/
+
+BBINDEX
+bbindex_new(void)
+{
+    BBINDEX idx;
+
+    idx = (BBINDEX)calloc(1, sizeof(struct bbindex_));
+    if (idx == NULL) {
+	printf("%s: memory leak. dying!\n",__FUNCTION__);
+	exit(0);
+    }
+    bbindex_setup(idx);
+    return idx;
+}
+
+void
+bbindex_free(BBINDEX idx)
+{
+    int i;
+
+    if (idx == NULL) return;
+    for (i = 0; i < idx->nbx * idx->nby; i++) free(idx->bins[i].entry);
+    free(idx->bins);
+    free(idx->unbounded.entry);
+    free(idx->entries);
+    free(idx->hit);
+    free(idx->result);
+    free(idx);
+}
+
+/*--------------------------------------------------------------*/
+/* bbindex_clear --						*/
+/*								*/
+/* Remove all nets from the index, and resize the bin grid if	*/
+/* the die has changed since the index was set up.		*/
+/*--------------------------------------------------------------*/
+
+void
+bbindex_clear(BBINDEX idx)
+{
+    int i, side, binsize;
+
+    side = MAX(NumChannelsX[0], NumChannelsY[0]);
+    binsize = MAX((side + BBINDEX_BINS - 1) / BBINDEX_BINS, BBINDEX_MIN_BIN);
+    if ((binsize != idx->binsize) ||
+		(idx->nbx != MAX((NumChannelsX[0] + binsize - 1) / binsize, 1)) ||
+		(idx->nby != MAX((NumChannelsY[0] + binsize - 1) / binsize, 1))) {
+	bbindex_setup(idx);
+	return;
+    }
+    for (i = 0; i < idx->nbx * idx->nby; i++) idx->bins[i].count = 0;
+    idx->unbounded.count = 0;
+    idx->numentries = 0;
+    idx->freelist = -1;
+    idx->count = 0;
+}
+
+/*--------------------------------------------------------------*/
+/* bbindex_insert --						*/
+/*								*/
+/* Add "net" to the index under its current bbox.  "key" orders	*/
+/* the net in query results.  The index does not notice later	*/
+/* changes to the bbox;  remove and insert the net again, or	*/
+/* clear and rebuild the index.					*/
+/*--------------------------------------------------------------*/
+
+void
+bbindex_insert(BBINDEX idx, NET net, int key)
+{
+    BBENTRY *be;
+    int e, bx, by, bx1, by1, bx2, by2;
+
+    // Reuse a free entry, if there is one
+    if (idx->freelist >= 0) {
+	e = idx->freelist;
+	idx->freelist = idx->entries[e].nextfree;
+    }
+    else {
+	if (idx->numentries == idx->maxentries) {
+	    idx->maxentries = (idx->maxentries == 0) ? 64 : (idx->maxentries << 1);
+	    idx->entries = (BBENTRY *)realloc(idx->entries,
+			idx->maxentries * sizeof(BBENTRY));
+	    if (idx->entries == NULL) {
+		printf("%s: memory leak. dying!\n",__FUNCTION__);
+		exit(0);
+	    }
+	}
+	e = idx->numentries++;
+    }
+
+    be = &idx->entries[e];
+    be->net = net;
+    be->key = key;
+    be->stamp = idx->stamp;
+    be->bounded = get_bbox_extent(net->bbox, &be->x1, &be->y1, &be->x2, &be->y2);
+    idx->count++;
+
+    if (!be->bounded) {
+	bin_add(&idx->unbounded, e);
+	return;
+    }
+    bin_range(idx, be, &bx1, &by1, &bx2, &by2);
+    for (by = by1; by <= by2; by++)
+	for (bx = bx1; bx <= bx2; bx++)
+	    bin_add(&idx->bins[by * idx->nbx + bx], e);
+}
+
+/*--------------------------------------------------------------*/
+/* bbindex_remove --						*/
+/*								*/
+/* Remove "net" from the index.  The bins are found from the	*/
+/* extent recorded on insertion.				*/
+/*--------------------------------------------------------------*/
+
+void
+bbindex_remove(BBINDEX idx, NET net)
+{
+    BBENTRY *be;
+    int e, bx, by, bx1, by1, bx2, by2;
+
+    for (e = 0; e < idx->numentries; e++)
+	if (idx->entries[e].net == net) break;
+    if (e == idx->numentries) return;
+
+    be = &idx->entries[e];
+    if (!be->bounded)
+	bin_delete(&idx->unbounded, e);
+    else {
+	bin_range(idx, be, &bx1, &by1, &bx2, &by2);
+	for (by = by1; by <= by2; by++)
+	    for (bx = bx1; bx <= bx2; bx++)
+		bin_delete(&idx->bins[by * idx->nbx + bx], e);
+    }
+    be->net = NULL;
+    be->nextfree = idx->freelist;
+    idx->freelist = e;
+    idx->count--;
+}
+
+int
+bbindex_count(BBINDEX idx)
+{
+    return idx->count;
+}
+
+/* Add entry "e" to the query result, unless it is already there */
+
+static void
+result_add(BBINDEX idx, int e, int *count)
+{
+    BBENTRY *be = &idx->entries[e];
+
+    if (be->stamp == idx->stamp) return;
+    be->stamp = idx->stamp;
+    if (*count == idx->maxresult) {
+	idx->maxresult = (idx->maxresult == 0) ? 64 : (idx->maxresult << 1);
+	idx->hit = (BBENTRY **)realloc(idx->hit, idx->maxresult * sizeof(BBENTRY *));
+	idx->result = (int *)realloc(idx->result, idx->maxresult * sizeof(int));
+	if ((idx->hit == NULL) || (idx->result == NULL)) {
+	    printf("%s: memory leak. dying!\n",__FUNCTION__);
+	    exit(0);
+	}
+    }
+    idx->hit[(*count)++] = be;
+}
+
+static int
+compare_keys(const void *a, const void *b)
+{
+    int ka = (*(BBENTRY **)a)->key;
+    int kb = (*(BBENTRY **)b)->key;
+
+    return (ka < kb) ? -1 : (ka > kb) ? 1 : 0;
+}
+
+/* Collect all nets in the index */
+
+static int
+query_all(BBINDEX idx)
+{
+    int e, n;
+
+    n = 0;
+    idx->stamp++;
+    for (e = 0; e < idx->numentries; e++)
+	if (idx->entries[e].net != NULL)
+	    result_add(idx, e, &n);
+    return n;
+}
+
+/* Collect the nets whose extent overlaps the given rectangle,	*/
+/* and the nets without an extent.				*/
+
+static int
+query_rect(BBINDEX idx, int x1, int y1, int x2, int y2)
+{
+    BBENTRY *be;
+    BBBIN *bin;
+    int i, n, bx, by, bx1, by1, bx2, by2;
+
+    n = 0;
+    idx->stamp++;
+    for (i = 0; i < idx->unbounded.count; i++)
+	result_add(idx, idx->unbounded.entry[i], &n);
+
+    bx1 = MIN(MAX(x1 / idx->binsize, 0), idx->nbx - 1);
+    by1 = MIN(MAX(y1 / idx->binsize, 0), idx->nby - 1);
+    bx2 = MIN(MAX(x2 / idx->binsize, 0), idx->nbx - 1);
+    by2 = MIN(MAX(y2 / idx->binsize, 0), idx->nby - 1);
+    for (by = by1; by <= by2; by++)
+	for (bx = bx1; bx <= bx2; bx++) {
+	    bin = &idx->bins[by * idx->nbx + bx];
+	    for (i = 0; i < bin->count; i++) {
+		be = &idx->entries[bin->entry[i]];
+		if ((be->x1 > x2) || (be->x2 < x1) || (be->y1 > y2) ||
+			    (be->y2 < y1))
+		    continue;
+		result_add(idx, bin->entry[i], &n);
+	    }
+	}
+    return n;
+}
+
+/* Return the keys of the "n" nets found, in ascending order */
+
+static int *
+query_result(BBINDEX idx, int n, int *count)
+{
+    int i;
+
+    qsort(idx->hit, n, sizeof(BBENTRY *), compare_keys);
+    for (i = 0; i < n; i++)
+	idx->result[i] = idx->hit[i]->key;
+
+    *count = n;
+    return idx->result;
+}
+
+/*--------------------------------------------------------------*/
+/* bbindex_query --						*/
+/*								*/
+/* Return the keys of the nets in the index that may collide	*/
+/* with "net", in ascending order, and set *count to their	*/
+/* number.  The key of "net" itself is returned if it is in the	*/
+/* index.  The array belongs to the index and is valid until	*/
+/* the next query.						*/
+/*--------------------------------------------------------------*/
+
+int *
+bbindex_query(BBINDEX idx, NET net, int *count)
+{
+    int n, x1, y1, x2, y2;
+
+    if (!get_bbox_extent(net->bbox, &x1, &y1, &x2, &y2))
+	n = query_all(idx);
+    else
+	n = query_rect(idx, x1, y1, x2, y2);
+    return query_result(idx, n, count);
+}
+
+/*--------------------------------------------------------------*/
+/* bbindex_query_rect --					*/
+/*								*/
+/* Like bbindex_query(), for the nets whose extent overlaps	*/
+/* the rectangle from (x1, y1) to (x2, y2), and the nets	*/
+/* without an extent.						*/
+/*--------------------------------------------------------------*/
+
+int *
+bbindex_query_rect(BBINDEX idx, int x1, int y1, int x2, int y2, int *count)
+{
+    return query_result(idx, query_rect(idx, x1, y1, x2, y2), count);
+}
+
+/* end of bbindex.c */
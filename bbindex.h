@@ -0,0 +1,30 @@
+/*--------------------------------------------------------------*/
+/* bbindex.h --							*/
+/*								*/
+/* Uniform grid bin index over net bounding boxes (header file)	*/
+/*--------------------------------------------------------------*/
+
+#ifndef BBINDEX_H
+
+/* Aim for about this many bins along the longer side of the	*/
+/* die, but never make a bin smaller than BBINDEX_MIN_BIN grid	*/
+/* positions on a side.						*/
+#define BBINDEX_BINS		64
+#define BBINDEX_MIN_BIN		8
+
+typedef struct bbindex_ *BBINDEX;
+
+BBINDEX bbindex_new(void);
+void    bbindex_free(BBINDEX idx);
+void    bbindex_clear(BBINDEX idx);
+void    bbindex_insert(BBINDEX idx, NET net, int key);
+void    bbindex_remove(BBINDEX idx, NET net);
+int    *bbindex_query(BBINDEX idx, NET net, int *count);
+int    *bbindex_query_rect(BBINDEX idx, int x1, int y1, int x2, int y2,
+		int *count);
+int     bbindex_count(BBINDEX idx);
+
+#define BBINDEX_H
+#endif
+
+/* end of bbindex.h */
@@ -0,0 +1,232 @@
+/*--------------------------------------------------------------*/
+/* congest.c --							*/
+/*								*/
+/* Negotiated congestion costs for the second stage.		*/
+/*								*/
+/* When negotiating, the nets taking part are not written to	*/
+/* Obs[] but are counted on every grid position they cover in	*/
+/* "Usage".  Each net is routed against the others as a soft	*/
+/* cost instead of ripping them up:  eval_pt() adds the number	*/
+/* of other nets on a position times "PresentFactor", plus the	*/
+/* number of passes the position has been overused times	*/
+/* "HistoryFactor".  The present cost is raised on each pass,	*/
+/* so that the nets settle on positions where they don't have	*/
+/* to share, and positions that have been wanted by several	*/
+/* nets for long are left to the nets that have no other way.	*/
+/*								*/
+/* The counts are only changed by the main thread, between	*/
+/* routes, so that they may be read by the router threads	*/
+/* without locking.						*/
+/*--------------------------------------------------------------*/
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "qrouter.h"
+#include "qconfig.h"
+#include "congest.h"
+
+u_char Negotiating = FALSE;
+int    PresentFactor = 1;
+int    HistoryFactor = 1;
+
+static u_short *Usage[MAX_LAYERS];	// Nets on each position
+static u_short *History[MAX_LAYERS];	// Passes each position was overused
+
+static u_long *cells = NULL;		// Positions of one net, see net_cells()
+static int maxcells = 0;
+
+/*--------------------------------------------------------------*/
+/* congest_init --						*/
+/*								*/
+/* Allocate the usage and history counts for the current grid,	*/
+/* all zero.							*/
+/*--------------------------------------------------------------*/
+
+void
+congest_init(void)
+{
+    int l;
+
+    congest_free();
+    for (l = 0; l < Num_layers; l++) {
+	Usage[l] = (u_short *)calloc(NumChannelsX[l] * NumChannelsY[l],
+		sizeof(u_short));
+	History[l] = (u_short *)calloc(NumChannelsX[l] * NumChannelsY[l],
+		sizeof(u_short));
+	if ((Usage[l] == NULL) || (History[l] == NULL)) {
+	    printf("%s: memory leak. dying!\n",__FUNCTION__);
+	    exit(0);
+	}
+    }
+}
+
+void
+congest_free(void)
+{
+    int l;
+
+    for (l = 0; l < MAX_LAYERS; l++) {
+	free(Usage[l]);
+	free(History[l]);
+	Usage[l] = History[l] = NULL;
+    }
+    free(cells);
+    cells = NULL;
+    maxcells = 0;
+}
+
+static int
+compare_cells(const void *a, const void *b)
+{
+    u_long ca = *(const u_long *)a;
+    u_long cb = *(const u_long *)b;
+
+    return (ca < cb) ? -1 : (ca > cb) ? 1 : 0;
+}
+
+static void
+add_cell(int *n, int x, int y, int lay)
+{
+    if (*n == maxcells) {
+	maxcells = (maxcells == 0) ? 256 : (maxcells << 1);
+	cells = (u_long *)realloc(cells, maxcells * sizeof(u_long));
+	if (cells == NULL) {
+	    printf("%s: memory leak. dying!\n",__FUNCTION__);
+	    exit(0);
+	}
+    }
+    cells[(*n)++] = (u_long)OGRID(x, y, lay) * MAX_LAYERS + lay;
+}
+
+/*--------------------------------------------------------------*/
+/* List the grid positions covered by the routes of net "net"	*/
+/* in "cells", each one once, and return how many there are.	*/
+/* Routes of a net meet at their ends, and a net must only be	*/
+/* counted once on a position it covers more than once.		*/
+/*--------------------------------------------------------------*/
+
+static int
+net_cells(NET net)
+{
+    ROUTE rt;
+    SEG seg;
+    int n, i, k, x, y;
+
+    n = 0;
+    for (rt = net->routes; rt; rt = rt->next) {
+	for (seg = rt->segments; seg; seg = seg->next) {
+	    x = seg->x1;
+	    y = seg->y1;
+	    while (1) {
+		add_cell(&n, x, y, seg->layer);
+		if ((seg->segtype & ST_VIA) && (seg->layer + 1 < Num_layers))
+		    add_cell(&n, x, y, seg->layer + 1);
+
+		if ((x == seg->x2) && (y == seg->y2)) break;
+
+		if (x < seg->x2) x++;
+		else if (x > seg->x2) x--;
+		if (y < seg->y2) y++;
+		else if (y > seg->y2) y--;
+	    }
+	}
+    }
+    if (n == 0) return 0;
+
+    qsort(cells, n, sizeof(u_long), compare_cells);
+    for (i = k = 1; i < n; i++)
+	if (cells[i] != cells[k - 1])
+	    cells[k++] = cells[i];
+    return k;
+}
+
+/*--------------------------------------------------------------*/
+/* congest_add_net --						*/
+/*								*/
+/* Add "delta" (1 or -1) to the usage of every position covered	*/
+/* by the routes of net "net".					*/
+/*--------------------------------------------------------------*/
+
+void
+congest_add_net(NET net, int delta)
+{
+    int i, n, lay;
+    u_short *u;
+
+    n = net_cells(net);
+    for (i = 0; i < n; i++) {
+	lay = (int)(cells[i] % MAX_LAYERS);
+	u = &Usage[lay][cells[i] / MAX_LAYERS];
+	if ((delta > 0) || (*u > 0)) *u += delta;
+    }
+}
+
+/*--------------------------------------------------------------*/
+/* congest_overuse --						*/
+/*								*/
+/* Return the number of positions covered by the routes of net	*/
+/* "net" that are also used by another net.  The net itself	*/
+/* must have been added to the usage counts.			*/
+/*--------------------------------------------------------------*/
+
+int
+congest_overuse(NET net)
+{
+    int i, n, lay, over;
+
+    over = 0;
+    n = net_cells(net);
+    for (i = 0; i < n; i++) {
+	lay = (int)(cells[i] % MAX_LAYERS);
+	if (Usage[lay][cells[i] / MAX_LAYERS] > 1) over++;
+    }
+    return over;
+}
+
+/*--------------------------------------------------------------*/
+/* congest_update_history --					*/
+/*								*/
+/* Raise the history count of every overused position.  To be	*/
+/* called once at the end of each pass.  Returns the number of	*/
+/* overused positions.						*/
+/*--------------------------------------------------------------*/
+
+int
+congest_update_history(void)
+{
+    int l, i, size, over;
+
+    over = 0;
+    for (l = 0; l < Num_layers; l++) {
+	size = NumChannelsX[l] * NumChannelsY[l];
+	for (i = 0; i < size; i++) {
+	    if (Usage[l][i] > 1) {
+		over++;
+		if (History[l][i] < 0xffff) History[l][i]++;
+	    }
+	}
+    }
+    return over;
+}
+
+/*--------------------------------------------------------------*/
+/* congest_cost --						*/
+/*								*/
+/* Cost added by eval_pt() for a route step onto position	*/
+/* (x, y) on layer "lay".  The net being routed is not in the	*/
+/* usage counts while it is routed, so any usage is by other	*/
+/* nets.							*/
+/*--------------------------------------------------------------*/
+
+int
+congest_cost(int x, int y, int lay)
+{
+    int cost;
+
+    cost = History[lay][OGRID(x, y, lay)] * HistoryFactor +
+		Usage[lay][OGRID(x, y, lay)] * PresentFactor;
+    return MIN(cost, CONGEST_MAX_FACTOR * ConflictCost);
+}
+
+/* end of congest.c */
@@ -0,0 +1,32 @@
+/*--------------------------------------------------------------*/
+/* congest.h --							*/
+/*								*/
+/* Negotiated congestion costs for the second stage (header	*/
+/* file)							*/
+/*--------------------------------------------------------------*/
+
+#ifndef CONGEST_H
+
+/* Number of negotiation passes made before giving up and	*/
+/* leaving the nets still in conflict to the rip-up stage.	*/
+#define NEGOTIATE_PASSES	16
+
+/* The sharing cost of a grid position is never made larger	*/
+/* than this many times the conflict cost.			*/
+#define CONGEST_MAX_FACTOR	4
+
+extern u_char Negotiating;	// Set while eval_pt() adds sharing costs
+extern int    PresentFactor;	// Cost per other net on a position
+extern int    HistoryFactor;	// Cost per pass a position was overused
+
+void    congest_init(void);
+void    congest_free(void);
+void    congest_add_net(NET net, int delta);
+int     congest_overuse(NET net);
+int     congest_update_history(void);
+int     congest_cost(int x, int y, int lay);
+
+#define CONGEST_H
+#endif
+
+/* end of congest.h */
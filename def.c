@@ -25,79 +25,45 @@
 #include <stdarg.h>
 #include <math.h>		/* for roundf() function, if std=c99 */
 
+#include <tcl.h>
+
 #include "qrouter.h"
+#include "point.h"
 #include "node.h"
 #include "qconfig.h"
 #include "maze.h"
 #include "lef.h"
 #include "def.h"
+#include "hash.h"
+#include "snapshot.h"
 
 int numSpecial = 0;		/* Tracks number of specialnets */
-
-#ifndef TCL_QROUTER
-
-/* Find an instance in the instance list.  If qrouter	*/
-/* is compiled with Tcl support, then this routine is	*/
-/* found in tclqrouter.c and uses hash tables, greatly	*/
-/* speeding up the read-in of large DEF files.		*/
-
-static GATE
-DefFindInstance(char *name)
-{
-    GATE ginst;
-
-    for (ginst = Nlgates; ginst; ginst = ginst->next) {
-	if (!strcasecmp(ginst->gatename, name))
-	    return ginst;
-    }
-    return NULL;
-}
-
-/* For the non-Tcl version, these are empty placeholders */
-
-static void
-DefHashInit(void)
-{
-}
-
-static void
-DefHashInstance(GATE gateginfo)
-{
-}
-
-#else /* The versions using TCL hash tables */
-
-#include <tk.h>
+u_char DefParallel = FALSE;	/* Parse COMPONENTS and NETS on threads */
 
 /* This hash table speeds up DEF file reading */
 
-static Tcl_HashTable InstanceTable;
+static HASHTABLE InstanceTable = {HASH_STRING};
 
 /*--------------------------------------------------------------*/
-/* Cell macro lookup based on the hash table			*/
+/* Instance lookup based on the hash table			*/
 /*--------------------------------------------------------------*/
 
 static void
 DefHashInit(void)
 {
-   /* Initialize the macro hash table */
+   /* Empty the instance hash table */
 
-   Tcl_InitHashTable(&InstanceTable, TCL_STRING_KEYS);
+   HashKill(&InstanceTable);
 }
 
 static GATE
 DefFindInstance(char *name)
 {
-    GATE ginst;
-    Tcl_HashEntry *entry;
-
-    entry = Tcl_FindHashEntry(&InstanceTable, name);
-    ginst = (entry) ? (GATE)Tcl_GetHashValue(entry) : NULL;
-    return ginst;
+    return (GATE)HashFind(&InstanceTable, name);
 }
 
 /*--------------------------------------------------------------*/
-/* Cell macro hash table generation				*/
+/* Instance hash table generation				*/
 /* Given an instance record, create an entry in the hash table	*/
 /* for the instance name, with the record entry pointing to the	*/
 /* instance record.						*/
@@ -106,17 +72,9 @@ DefFindInstance(char *name)
 static void
 DefHashInstance(GATE gateginfo)
 {
-    int new;
-    Tcl_HashEntry *entry;
-
-    entry = Tcl_CreateHashEntry(&InstanceTable,
-		gateginfo->gatename, &new);
-    if (entry != NULL)
-	Tcl_SetHashValue(entry, (ClientData)gateginfo);
+    HashAdd(&InstanceTable, gateginfo->gatename, (void *)gateginfo);
 }
 
-#endif	/* TCL_QROUTER */
-
 /*
  *------------------------------------------------------------
  *
@@ -183,7 +141,7 @@ DefAddRoutes(FILE *f, float oscale, NET net, char special)
 	    {
 		/* SPECIALNETS has the additional width */
 		token = LefNextToken(f, TRUE);
-		if (sscanf(token, "%lg", &w) != 1)
+		if (!LefParseDouble(token, &w))
 		{
 		    LefError("Bad width in special net\n");
 		    continue;
@@ -199,7 +157,7 @@ DefAddRoutes(FILE *f, float oscale, NET net, char special)
 	    // Create a new route record, add to the 1st node
 
 	    if (special == (char)0) {
-	       routednet = (ROUTE)malloc(sizeof(struct route_));
+	       routednet = allocROUTE();
 	       routednet->next = net->routes;
 	       net->routes = routednet;
 	       routednet->netnum = net->netnum;
@@ -263,7 +221,7 @@ DefAddRoutes(FILE *f, float oscale, NET net, char special)
 		}
 		if ((special == (char)0) && (paintLayer >= 0)) {
 
-		    newRoute = (SEG)malloc(sizeof(struct seg_));
+		    newRoute = allocSEG();
 		    newRoute->segtype = ST_VIA;
 		    newRoute->x1 = refp.x;
 		    newRoute->x2 = refp.x;
@@ -272,7 +230,7 @@ DefAddRoutes(FILE *f, float oscale, NET net, char special)
 		    newRoute->layer = paintLayer;
 
 		    if (routednet == NULL) {
-			routednet = (ROUTE)malloc(sizeof(struct route_));
+			routednet = allocROUTE();
 			routednet->next = net->routes;
 			net->routes = routednet;
 
@@ -312,7 +270,7 @@ DefAddRoutes(FILE *f, float oscale, NET net, char special)
 		    goto endCoord;
 		}
 	    }
-	    else if (sscanf(token, "%lg", &x) == 1)
+	    else if (LefParseDouble(token, &x))
 	    {
 		x /= oscale;		// In microns
 		refp.x = (int)((x - Xlowerbound + EPS) / PitchX[paintLayer]);
@@ -329,13 +287,13 @@ DefAddRoutes(FILE *f, float oscale, NET net, char special)
 		{
 		    LefError("No reference point for \"*\" wildcard\n"); 
 		    if (newRoute != NULL) {
-			free(newRoute);
+			freeSEG(newRoute);
 			newRoute = NULL;
 		    }
 		    goto endCoord;
 		}
 	    }
-	    else if (sscanf(token, "%lg", &y) == 1)
+	    else if (LefParseDouble(token, &y))
 	    {
 		y /= oscale;		// In microns
 		refp.y = (int)((y - Ylowerbound + EPS) / PitchY[paintLayer]);
@@ -404,7 +362,7 @@ DefAddRoutes(FILE *f, float oscale, NET net, char special)
 		   }
 		}
 		else if (paintLayer >= 0) {
-		   newRoute = (SEG)malloc(sizeof(struct seg_));
+		   newRoute = allocSEG();
 		   newRoute->segtype = ST_WIRE;
 		   newRoute->x1 = locarea.x1;
 		   newRoute->x2 = locarea.x2;
@@ -413,7 +371,7 @@ DefAddRoutes(FILE *f, float oscale, NET net, char special)
 		   newRoute->layer = paintLayer;
 
 		   if (routednet == NULL) {
-			routednet = (ROUTE)malloc(sizeof(struct route_));
+			routednet = allocROUTE();
 			routednet->next = net->routes;
 			net->routes = routednet;
 
@@ -448,19 +406,27 @@ endCoord:
 /*
  *------------------------------------------------------------
  *
- * DefReadGatePin ---
+ * DefFindGatePin ---
  *
  *	Given a gate name and a pin name in a net from the
  *	DEF file NETS section, find the position of the
  *	gate, then the position of the pin within the gate,
- *	and add pin and obstruction information to the grid
- *	network.
+ *	and record the routing grid points of the pin in
+ *	"node".  The gate is returned in "gp".
+ *
+ * Results:
+ *	Index of the pin in the gate, or -1 if not found.
+ *
+ * Side Effects:
+ *	None outside of "node", so that this may be run
+ *	from a worker thread.
  *
  *------------------------------------------------------------
  */
 
-static void
-DefReadGatePin(NET net, NODE node, char *instname, char *pinname, double *home)
+static int
+DefFindGatePin(NET net, NODE node, char *instname, char *pinname,
+		double *home, GATE *gp)
 {
     int i;
     GATE gateginfo;
@@ -471,6 +437,7 @@ DefReadGatePin(NET net, NODE node, char *instname, char *pinname, double *home)
     DPOINT dp;
 
     g = DefFindInstance(instname);
+    *gp = g;
     if (g) {
 
 	gateginfo = g->gatetype;
@@ -478,7 +445,7 @@ DefReadGatePin(NET net, NODE node, char *instname, char *pinname, double *home)
 	if (!gateginfo) {
 	    LefError("Endpoint %s/%s of net %s not found\n",
 				instname, pinname, net->netname);
-	    return;
+	    return -1;
 	}
 	for (i = 0; i < gateginfo->nodes; i++) {
 	    if (!strcasecmp(gateginfo->node[i], pinname)) {
@@ -544,19 +511,621 @@ DefReadGatePin(NET net, NODE node, char *instname, char *pinname, double *home)
 			gridx++;
 		    }
 		}
-		node->netnum = net->netnum;
-		g->netnum[i] = net->netnum;
-		g->noderec[i] = node;
-		node->netname = net->netname;
-		node->next = net->netnodes;
-		net->netnodes = node;
+		return i;
+	    }
+	}
+    }
+    return -1;
+}
+
+/*
+ *------------------------------------------------------------
+ *
+ * DefLinkGatePin ---
+ *
+ *	Connect "node", found by DefFindGatePin() as pin "i"
+ *	of gate "g", to the net.
+ *
+ *------------------------------------------------------------
+ */
+
+static void
+DefLinkGatePin(NET net, NODE node, GATE g, int i)
+{
+    node->netnum = net->netnum;
+    g->netnum[i] = net->netnum;
+    g->noderec[i] = node;
+    node->netname = net->netname;
+    node->next = net->netnodes;
+    net->netnodes = node;
+}
+
+/*
+ *------------------------------------------------------------
+ *
+ * Parallel section reading --
+ *
+ *	With DefParallel set, the records of a COMPONENTS or
+ *	NETS section are first scanned for their boundaries,
+ *	without copying anything, and split into chunks of
+ *	whole records.  Worker threads parse the chunks, each
+ *	with its own reader over its part of the file (see
+ *	LefBeginSpan()).  The GATE and NET records they make
+ *	are then merged in file order by the main thread, which
+ *	also does everything touching shared state:  hashing
+ *	instances, numbering nets and connecting pins to nets.
+ *	The result is the same as reading the section serially,
+ *	including the order of any error messages.
+ *
+ *	Sections with routes (ROUTED, FIXED or COVER nets) paint
+ *	into Obs[] and are always read serially.
+ *
+ *------------------------------------------------------------
+ */
+
+/* A pin connection found by a worker, made by the merge */
+
+struct deflink_ {
+    NET  net;
+    NODE node;
+    GATE gate;
+    int  pin;
+};
+
+typedef struct defchunk_ *DEFCHUNK;
+
+struct defchunk_ {
+    char *start;		/* First record of the chunk */
+    char *end;			/* Start of the next chunk */
+    int   lineno;		/* Lines before "start" */
+    int   numrecs;		/* Records in the chunk */
+    void **rec;			/* GATE or NET made from each record */
+    struct deflink_ *link;	/* Pin connections, in file order */
+    int   numlinks;
+    int   maxlinks;
+    u_char bad;			/* Records did not parse as scanned */
+    LEFERROR errors;		/* Errors, to be reported by the merge */
+};
+
+struct defsection_ {
+    FILE  *f;
+    float  oscale;
+    char   special;
+    double *home;
+    u_char nets;		/* NETS (TRUE) or COMPONENTS (FALSE) */
+    DEFCHUNK chunk;
+    int    numchunks;
+    int    next;		/* Next chunk to parse */
+};
+
+TCL_DECLARE_MUTEX(defChunkMutex)
+
+static GATE DefReadComponent(FILE *f, float oscale);
+static NET  DefReadNet(FILE *f, float oscale, char special, double *home,
+		int *netidx, DEFCHUNK chunk);
+
+/* Keywords starting or ending a COMPONENTS or NETS record */
+
+enum def_record_keys {DEF_RECORD_START = 0, DEF_RECORD_END};
+
+static char *record_keys[] = {
+    "-",
+    "END",
+    NULL
+};
+
+enum def_netprop_keys {
+	DEF_NETPROP_USE = 0, DEF_NETPROP_ROUTED, DEF_NETPROP_FIXED,
+	DEF_NETPROP_COVER, DEF_NETPROP_SHAPE, DEF_NETPROP_SOURCE,
+	DEF_NETPROP_WEIGHT, DEF_NETPROP_PROPERTY};
+
+static char *net_property_keys[] = {
+    "USE",
+    "ROUTED",
+    "FIXED",
+    "COVER",
+    "SHAPE",
+    "SOURCE",
+    "WEIGHT",
+    "PROPERTY",
+    NULL
+};
+
+/* Look up a token slice in a keyword table */
+
+static int
+DefLookupSlice(char *token, int len, char **table)
+{
+    char key[32];
+
+    if (len >= (int)sizeof(key)) return -1;
+    memcpy(key, token, len);
+    key[len] = '\0';
+    return Lookup(key, table);
+}
+
+/*--------------------------------------------------------------*/
+/* Find the records of the section being read from file "f"	*/
+/* and split them into chunks for "numthreads" workers.		*/
+/* Returns the number of chunks, leaving the file at the END	*/
+/* statement, or zero (with the file unmoved) if the section	*/
+/* should be read serially.					*/
+/*--------------------------------------------------------------*/
+
+static int
+DefScanSection(FILE *f, struct defsection_ *sec, int numthreads)
+{
+    LEFREADER r = LefGetReader(f);
+    char *token, *pos, *start, **recpos = NULL;
+    int *recline = NULL;
+    int len, line, startline, numrecs = 0, maxrecs = 0;
+    int c, k, numchunks, key;
+    u_char atstart = TRUE, property = FALSE;
+
+    start = LefTell(f, &startline);
+    while (1) {
+	pos = LefTell(f, &line);
+	token = LefNextSlice(r, TRUE, &len);
+	if (token == NULL) goto serial;
+
+	if (atstart) {
+	    key = DefLookupSlice(token, len, record_keys);
+	    if (key == DEF_RECORD_END) break;
+	    if (key != DEF_RECORD_START) goto serial;
+	    if (numrecs == maxrecs) {
+		maxrecs = (maxrecs == 0) ? 1024 : 2 * maxrecs;
+		recpos = (char **)realloc(recpos, maxrecs * sizeof(char *));
+		recline = (int *)realloc(recline, maxrecs * sizeof(int));
+		if ((recpos == NULL) || (recline == NULL)) {
+		    printf("%s: memory leak. dying!\n",__FUNCTION__);
+		    exit(0);
+		}
+	    }
+	    recpos[numrecs] = pos;
+	    recline[numrecs] = line;
+	    numrecs++;
+	    atstart = FALSE;
+	    property = FALSE;
+	}
+	else if (*token == ';')
+	    atstart = TRUE;
+	else if (property && sec->nets) {
+	    key = DefLookupSlice(token, len, net_property_keys);
+	    if ((key == DEF_NETPROP_ROUTED) || (key == DEF_NETPROP_FIXED) ||
+			(key == DEF_NETPROP_COVER))
+		goto serial;
+	    property = FALSE;
+	}
+	else
+	    property = (*token == '+');
+    }
+
+    if (numrecs < numthreads) goto serial;
+
+    numchunks = numthreads * DEF_CHUNKS_PER_THREAD;
+    if (numchunks > numrecs) numchunks = numrecs;
+    sec->chunk = (DEFCHUNK)calloc(numchunks, sizeof(struct defchunk_));
+    if (sec->chunk == NULL) {
+	printf("%s: memory leak. dying!\n",__FUNCTION__);
+	exit(0);
+    }
+    for (c = 0; c < numchunks; c++) {
+	k = (int)(((long)c * numrecs) / numchunks);
+	sec->chunk[c].start = recpos[k];
+	sec->chunk[c].lineno = recline[k];
+	k = (int)(((long)(c + 1) * numrecs) / numchunks);
+	sec->chunk[c].numrecs = k - (int)(((long)c * numrecs) / numchunks);
+	sec->chunk[c].end = (k < numrecs) ? recpos[k] : pos;
+	sec->chunk[c].rec = (void **)malloc(sec->chunk[c].numrecs *
+			sizeof(void *));
+	if (sec->chunk[c].rec == NULL) {
+	    printf("%s: memory leak. dying!\n",__FUNCTION__);
+	    exit(0);
+	}
+    }
+    sec->numchunks = numchunks;
+    sec->next = 0;
+    free(recpos);
+    free(recline);
+
+    /* Leave the END statement to the caller */
+    LefSeek(f, pos, line);
+    return numchunks;
+
+serial:
+    free(recpos);
+    free(recline);
+    LefSeek(f, start, startline);
+    return 0;
+}
+
+/*--------------------------------------------------------------*/
+/* Record a pin connection to be made by the merge.		*/
+/*--------------------------------------------------------------*/
+
+static void
+DefAddLink(DEFCHUNK c, NET net, NODE node, GATE g, int pin)
+{
+    if (c->numlinks == c->maxlinks) {
+	c->maxlinks = (c->maxlinks == 0) ? 256 : 2 * c->maxlinks;
+	c->link = (struct deflink_ *)realloc(c->link,
+			c->maxlinks * sizeof(struct deflink_));
+	if (c->link == NULL) {
+	    printf("%s: memory leak. dying!\n",__FUNCTION__);
+	    exit(0);
+	}
+    }
+    c->link[c->numlinks].net = net;
+    c->link[c->numlinks].node = node;
+    c->link[c->numlinks].gate = g;
+    c->link[c->numlinks].pin = pin;
+    c->numlinks++;
+}
+
+/*--------------------------------------------------------------*/
+/* Worker thread:  parse chunks until none are left.		*/
+/*--------------------------------------------------------------*/
+
+static Tcl_ThreadCreateType
+DefReadThread(ClientData parm)
+{
+    struct defsection_ *sec = (struct defsection_ *)parm;
+    DEFCHUNK c;
+    char *token;
+    int k;
+
+    while (1) {
+	Tcl_MutexLock(&defChunkMutex);
+	c = (sec->next < sec->numchunks) ? &sec->chunk[sec->next++] : NULL;
+	Tcl_MutexUnlock(&defChunkMutex);
+	if (c == NULL) break;
+
+	LefBeginSpan(sec->f, c->start, c->end, c->lineno);
+	LefDeferErrors();
+	for (k = 0; k < c->numrecs; k++) {
+	    token = LefNextToken(sec->f, TRUE);
+	    if ((token == NULL) || (Lookup(token, record_keys) !=
+			DEF_RECORD_START)) {
+		c->bad = TRUE;
 		break;
 	    }
+	    if (sec->nets)
+		c->rec[k] = DefReadNet(sec->f, sec->oscale, sec->special,
+			sec->home, NULL, c);
+	    else
+		c->rec[k] = DefReadComponent(sec->f, sec->oscale);
+	}
+	c->numrecs = k;
+
+	/* The records must have used up the chunk exactly */
+	if (LefNextToken(sec->f, TRUE) != NULL) c->bad = TRUE;
+
+	c->errors = LefTakeErrors();
+	LefEndSpan();
+    }
+    TCL_THREAD_CREATE_RETURN;
+}
+
+/*--------------------------------------------------------------*/
+/* Free what the workers made from chunk "c".  Used only if	*/
+/* the section has to be read again serially.			*/
+/*--------------------------------------------------------------*/
+
+static void
+DefFreeChunk(DEFCHUNK c, u_char nets)
+{
+    GATE gate;
+    NET net;
+    NODE node;
+    DSEG drect;
+    DPOINT dp;
+    int k, i;
+
+    for (k = 0; k < c->numlinks; k++) {
+	node = c->link[k].node;
+	while (node->taps) {
+	    dp = node->taps;
+	    node->taps = dp->next;
+	    free(dp);
+	}
+	while (node->extend) {
+	    dp = node->extend;
+	    node->extend = dp->next;
+	    free(dp);
+	}
+	free(node);
+    }
+    for (k = 0; k < c->numrecs; k++) {
+	if (c->rec[k] == NULL) continue;
+	if (nets) {
+	    net = (NET)c->rec[k];
+	    free(net);
+	}
+	else {
+	    gate = (GATE)c->rec[k];
+	    for (i = 0; i < gate->nodes; i++) {
+		while (gate->taps[i]) {
+		    drect = gate->taps[i];
+		    gate->taps[i] = drect->next;
+		    free(drect);
+		}
+		if (gate->netnum[i] != 0) free(gate->noderec[i]);
+	    }
+	    while (gate->obs) {
+		drect = gate->obs;
+		gate->obs = drect->next;
+		free(drect);
+	    }
+	    free(gate->taps);
+	    free(gate->noderec);
+	    free(gate->direction);
+	    free(gate->netnum);
+	    free(gate->node);
+	    free(gate);
 	}
-	if (i < gateginfo->nodes) return;
+    }
+    LefFreeErrors(c->errors);
+    c->errors = NULL;
+}
+
+/*--------------------------------------------------------------*/
+/* Free the chunk list of a section.				*/
+/*--------------------------------------------------------------*/
+
+static void
+DefFreeSection(struct defsection_ *sec)
+{
+    int c;
+
+    for (c = 0; c < sec->numchunks; c++) {
+	free(sec->chunk[c].rec);
+	free(sec->chunk[c].link);
+    }
+    free(sec->chunk);
+    sec->chunk = NULL;
+    sec->numchunks = 0;
+}
+
+/*--------------------------------------------------------------*/
+/* Parse the records of the current section of "f" on worker	*/
+/* threads.  Returns TRUE with the chunks in "sec" ready to be	*/
+/* merged, or FALSE (with the file unmoved) if the section must	*/
+/* be read serially.						*/
+/*--------------------------------------------------------------*/
+
+static u_char
+DefReadSection(FILE *f, struct defsection_ *sec)
+{
+    Tcl_ThreadId *ids;
+    char *start;
+    int startline, numthreads, i, c;
+    u_char bad = FALSE;
+
+    if (NumThreads == 0) set_num_threads(0);
+    numthreads = NumThreads;
+    if (numthreads < 2) return FALSE;
+
+    start = LefTell(f, &startline);
+    if (DefScanSection(f, sec, numthreads) == 0) return FALSE;
+    if (numthreads > sec->numchunks) numthreads = sec->numchunks;
+
+    ids = (Tcl_ThreadId *)malloc(numthreads * sizeof(Tcl_ThreadId));
+    if (ids == NULL) {
+	printf("%s: memory leak. dying!\n",__FUNCTION__);
+	exit(0);
+    }
+    for (i = 0; i < numthreads; i++) {
+	if (Tcl_CreateThread(&ids[i], DefReadThread, (ClientData)sec,
+		TCL_THREAD_STACK_DEFAULT, TCL_THREAD_JOINABLE) != TCL_OK)
+	    exit(0);
+    }
+    for (i = 0; i < numthreads; i++) Tcl_JoinThread(ids[i], NULL);
+    free(ids);
+
+    for (c = 0; c < sec->numchunks; c++)
+	if (sec->chunk[c].bad) bad = TRUE;
+
+    if (bad) {
+	/* Some record was not where the scan put it:  start over */
+	for (c = 0; c < sec->numchunks; c++)
+	    DefFreeChunk(&sec->chunk[c], sec->nets);
+	DefFreeSection(sec);
+	LefSeek(f, start, startline);
+	return FALSE;
+    }
+    return TRUE;
+}
+
+/*--------------------------------------------------------------*/
+/* Create the record for a net named "name".			*/
+/*--------------------------------------------------------------*/
+
+static NET
+DefNewNet(char *name)
+{
+    NET net;
+
+    net = (NET)malloc(sizeof(struct net_));
+    net->netorder = 0;
+    net->numnodes = 0;
+    net->flags = 0;
+    net->netname = StrIntern(&DesignNames, name);
+    net->netnodes = (NODE)NULL;
+    net->noripup = (NETLIST)NULL;
+    net->routes = (ROUTE)NULL;
+    net->bbox = (BBOX)NULL;
+    net->locked = FALSE;
+    net->active = FALSE;
+    net->routed = FALSE;
+    net->expanded = 0;
+    net->guide = NULL;
+    net->numguide = 0;
+    net->bbox_color = 0;
+    net->netnum = UNDEF_NET;
+    return net;
+}
+
+/*--------------------------------------------------------------*/
+/* Give a net its number.  Nets must be numbered in file order.	*/
+/*--------------------------------------------------------------*/
+
+static void
+DefNumberNet(NET net, int *netidx)
+{
+    // Net numbers start at MIN_NET_NUMBER for regular nets,
+    // use VDD_NET and GND_NET for power and ground, and 0
+    // is not a valid net number.
+
+    net->netnum = UNDEF_NET;
+    if(vddnet) {
+	    if(!strcmp(net->netname, vddnet)) {
+		    net->netnum = VDD_NET;
+		    vddnets=postpone_net(vddnets,net);
+	    }
+    }
+    if(gndnet) {
+	    if(!strcmp(net->netname, gndnet)) {
+		    net->netnum = GND_NET;
+		    gndnets=postpone_net(gndnets,net);
+	    }
+    }
+    if(clknet) {
+	    if(!strcmp(net->netname, clknet)) {
+		    net->netnum = CLK_NET;
+		    clknets=postpone_net(clknets,net);
+	    }
+    }
+    if(net->netnum==UNDEF_NET) {
+       net->netnum = (*netidx)++;
     }
 }
 
+/*
+ *------------------------------------------------------------
+ *
+ * DefReadNet --
+ *
+ *	Read one record of a NETS or SPECIALNETS section,
+ *	following the "-" keyword.
+ *
+ *	With "chunk" NULL, the net is added to Nlnets and
+ *	numbered from "netidx", and its pins are connected.
+ *	Otherwise (on a worker thread) all of that is left
+ *	to the merge, and the pin connections are recorded
+ *	in the chunk.
+ *
+ * Results:
+ *	The new net.
+ *
+ *------------------------------------------------------------
+ */
+
+static NET
+DefReadNet(FILE *f, float oscale, char special, double *home,
+		int *netidx, DEFCHUNK chunk)
+{
+    char *token;
+    int subkey, pin;
+    int nodeidx;
+    char instname[MAX_NAME_LEN], pinname[MAX_NAME_LEN];
+    NET net;
+    NODE node;
+    GATE g;
+
+    /* Get net name */
+    token = LefNextToken(f, TRUE);
+
+    net = DefNewNet(token);
+    if (chunk == NULL) {
+	Nlnets[Numnets++] = net;
+	DefNumberNet(net, netidx);
+	hash_net(net);
+    }
+
+    nodeidx = 0;
+
+    /* Get next token;  will be '(' if this is a netlist	*/
+    token = LefNextToken(f, TRUE);
+
+    /* Process all properties */
+    while (token && (*token != ';'))
+    {
+	/* Find connections for the net */
+	if (*token == '(')
+	{
+	    token = LefNextToken(f, TRUE);  /* get pin or gate */
+	    strcpy(instname, token);
+	    token = LefNextToken(f, TRUE);	/* get node name */
+
+	    if (!strcasecmp(instname, "pin")) {
+		strcpy(instname, token);
+		strcpy(pinname, "pin");
+	    }
+	    else
+		strcpy(pinname, token);
+
+	    node = (NODE)calloc(1, sizeof(struct node_));
+	    node->nodenum = nodeidx++;
+	    pin = DefFindGatePin(net, node, instname, pinname, home, &g);
+	    if (pin >= 0) {
+		if (chunk == NULL)
+		    DefLinkGatePin(net, node, g, pin);
+		else
+		    DefAddLink(chunk, net, node, g, pin);
+	    }
+
+	    token = LefNextToken(f, TRUE);	/* should be ')' */
+
+	    continue;
+	}
+	else if (*token != '+')
+	{
+	    token = LefNextToken(f, TRUE);	/* Not a property */
+	    continue;	/* Ignore it, whatever it is */
+	}
+	else
+	    token = LefNextToken(f, TRUE);
+
+	subkey = Lookup(token, net_property_keys);
+	if (subkey < 0)
+	{
+	    LefError("Unknown net property \"%s\" in "
+			"NET definition; ignoring.\n", token);
+	    continue;
+	}
+	switch (subkey)
+	{
+	    case DEF_NETPROP_USE:
+		/* Presently, we ignore this */
+		break;
+	    case DEF_NETPROP_SHAPE:
+		/* Ignore this too, along with the next keyword */
+		token = LefNextToken(f, TRUE);
+		break;
+	    case DEF_NETPROP_ROUTED:
+		// Read in the route;  qrouter now takes
+		// responsibility for this route.
+		while (token && (*token != ';'))
+		    token = DefAddRoutes(f, oscale, net, special);
+		break;
+	    case DEF_NETPROP_FIXED:
+	    case DEF_NETPROP_COVER:
+		// Treat fixed nets like specialnets:  read them
+		// in as obstructions, and write them out as-is.
+		// Use special = 2 so it is treated like a
+		// specialnet but does not expect the specialnet
+		// syntax (unless it is, in fact, a specialnet
+		// entry).
+		
+		while (token && (*token != ';'))
+		    token = DefAddRoutes(f, oscale, net,
+				(special == (char)0) ? (char)2 : special);
+		break;
+	}
+    }
+    return net;
+}
+
 /*
  *------------------------------------------------------------
  *
@@ -574,43 +1143,19 @@ DefReadGatePin(NET net, NODE node, char *instname, char *pinname, double *home)
  *------------------------------------------------------------
  */
 
-enum def_net_keys {DEF_NET_START = 0, DEF_NET_END};
-enum def_netprop_keys {
-	DEF_NETPROP_USE = 0, DEF_NETPROP_ROUTED, DEF_NETPROP_FIXED,
-	DEF_NETPROP_COVER, DEF_NETPROP_SHAPE, DEF_NETPROP_SOURCE,
-	DEF_NETPROP_WEIGHT, DEF_NETPROP_PROPERTY};
-
 static void
 DefReadNets(FILE *f, char *sname, float oscale, char special, int total)
 {
     char *token;
-    int keyword, subkey;
-    int i, processed = 0;
-    int nodeidx;
-    char instname[MAX_NAME_LEN], pinname[MAX_NAME_LEN];
+    int keyword;
+    int i, j, k, c, processed = 0;
 
     NET net;
     int netidx;
     NODE node;
+    DEFCHUNK chunk;
     double home[MAX_LAYERS];
-
-    static char *net_keys[] = {
-	"-",
-	"END",
-	NULL
-    };
-
-    static char *net_property_keys[] = {
-	"USE",
-	"ROUTED",
-	"FIXED",
-	"COVER",
-	"SHAPE",
-	"SOURCE",
-	"WEIGHT",
-	"PROPERTY",
-	NULL
-    };
+    struct defsection_ sec;
 
     if (Numnets == 0)
     {
@@ -631,9 +1176,35 @@ DefReadNets(FILE *f, char *sname, float oscale, char special, int total)
 	for (i = Numnets; i < (Numnets + total); i++) Nlnets[i] = NULL;
     }
 
+    sec.f = f;
+    sec.oscale = oscale;
+    sec.special = special;
+    sec.home = home;
+    sec.nets = TRUE;
+    if (DefParallel && DefReadSection(f, &sec)) {
+
+	/* Merge the nets read by the workers, in file order */
+
+	for (c = 0; c < sec.numchunks; c++) {
+	    chunk = &sec.chunk[c];
+	    LefReplayErrors(chunk->errors);
+	    for (k = 0, j = 0; k < chunk->numrecs; k++) {
+		net = (NET)chunk->rec[k];
+		Nlnets[Numnets++] = net;
+		DefNumberNet(net, &netidx);
+		hash_net(net);
+		processed++;
+		for (; (j < chunk->numlinks) && (chunk->link[j].net == net); j++)
+		    DefLinkGatePin(net, chunk->link[j].node, chunk->link[j].gate,
+				chunk->link[j].pin);
+	    }
+	}
+	DefFreeSection(&sec);
+    }
+
     while ((token = LefNextToken(f, TRUE)) != NULL)
     {
-	keyword = Lookup(token, net_keys);
+	keyword = Lookup(token, record_keys);
 	if (keyword < 0)
 	{
 	    LefError("Unknown keyword \"%s\" in NET "
@@ -644,136 +1215,17 @@ DefReadNets(FILE *f, char *sname, float oscale, char special, int total)
 
 	switch (keyword)
 	{
-	    case DEF_NET_START:
+	    case DEF_RECORD_START:
 
-		/* Get net name */
-		token = LefNextToken(f, TRUE);
-
-		net = (NET)malloc(sizeof(struct net_));
-		Nlnets[Numnets++] = net;
-		net->netorder = 0;
-		net->numnodes = 0;
-		net->flags = 0;
-		net->netname = strdup(token);
-		net->netnodes = (NODE)NULL;
-		net->noripup = (NETLIST)NULL;
-		net->routes = (ROUTE)NULL;
-		net->bbox = (BBOX)NULL;
-		net->locked = FALSE;
-		net->active = FALSE;
-		net->routed = FALSE;
-		net->bbox_color = 0;
-
-		// Net numbers start at MIN_NET_NUMBER for regular nets,
-		// use VDD_NET and GND_NET for power and ground, and 0
-		// is not a valid net number.
-
-		net->netnum = UNDEF_NET;
-		if(vddnet) {
-			if(!strcmp(token, vddnet)) {
-				net->netnum = VDD_NET;
-				vddnets=postpone_net(vddnets,net);
-			}
-		}
-		if(gndnet) {
-			if(!strcmp(token, gndnet)) {
-				net->netnum = GND_NET;
-				gndnets=postpone_net(gndnets,net);
-			}
-		}
-		if(clknet) {
-			if(!strcmp(token, clknet)) {
-				net->netnum = CLK_NET;
-				clknets=postpone_net(clknets,net);
-			}
-		}
-		if(net->netnum==UNDEF_NET) {
-		   net->netnum = netidx++;
-		}
-
-		nodeidx = 0;
+		DefReadNet(f, oscale, special, home, &netidx, NULL);
 
 		/* Update the record of the number of nets processed	*/
 		/* and spit out a message for every 5% finished.	*/
 
 		processed++;
-
-		/* Get next token;  will be '(' if this is a netlist	*/
-		token = LefNextToken(f, TRUE);
-
-		/* Process all properties */
-		while (token && (*token != ';'))
-		{
-		    /* Find connections for the net */
-		    if (*token == '(')
-		    {
-			token = LefNextToken(f, TRUE);  /* get pin or gate */
-			strcpy(instname, token);
-			token = LefNextToken(f, TRUE);	/* get node name */
-
-			if (!strcasecmp(instname, "pin")) {
-			    strcpy(instname, token);
-			    strcpy(pinname, "pin");
-			}
-			else
-			    strcpy(pinname, token);
-
-			node = (NODE)calloc(1, sizeof(struct node_));
-			node->nodenum = nodeidx++;
-			DefReadGatePin(net, node, instname, pinname, home);
-
-			token = LefNextToken(f, TRUE);	/* should be ')' */
-
-			continue;
-		    }
-		    else if (*token != '+')
-		    {
-			token = LefNextToken(f, TRUE);	/* Not a property */
-			continue;	/* Ignore it, whatever it is */
-		    }
-		    else
-			token = LefNextToken(f, TRUE);
-
-		    subkey = Lookup(token, net_property_keys);
-		    if (subkey < 0)
-		    {
-			LefError("Unknown net property \"%s\" in "
-				"NET definition; ignoring.\n", token);
-			continue;
-		    }
-		    switch (subkey)
-		    {
-			case DEF_NETPROP_USE:
-			    /* Presently, we ignore this */
-			    break;
-			case DEF_NETPROP_SHAPE:
-			    /* Ignore this too, along with the next keyword */
-			    token = LefNextToken(f, TRUE);
-			    break;
-			case DEF_NETPROP_ROUTED:
-			    // Read in the route;  qrouter now takes
-			    // responsibility for this route.
-			    while (token && (*token != ';'))
-			        token = DefAddRoutes(f, oscale, net, special);
-			    break;
-			case DEF_NETPROP_FIXED:
-			case DEF_NETPROP_COVER:
-			    // Treat fixed nets like specialnets:  read them
-			    // in as obstructions, and write them out as-is.
-			    // Use special = 2 so it is treated like a
-			    // specialnet but does not expect the specialnet
-			    // syntax (unless it is, in fact, a specialnet
-			    // entry).
-			    
-			    while (token && (*token != ';'))
-			        token = DefAddRoutes(f, oscale, net,
-					(special == (char)0) ? (char)2 : special);
-			    break;
-		    }
-		}
 		break;
 
-	    case DEF_NET_END:
+	    case DEF_RECORD_END:
 		if (!LefParseEndStatement(f, sname))
 		{
 		    LefError("Net END statement missing.\n");
@@ -781,7 +1233,7 @@ DefReadNets(FILE *f, char *sname, float oscale, char special, int total)
 		}
 		break;
 	}
-	if (keyword == DEF_NET_END) break;
+	if (keyword == DEF_RECORD_END) break;
     }
 
     // Set the number of nodes per net for each node on the net
@@ -959,9 +1411,9 @@ DefReadLocation(gate, f, oscale)
     token = LefNextToken(f, TRUE);
     if (*token != '(') goto parse_error;
     token = LefNextToken(f, TRUE);
-    if (sscanf(token, "%f", &x) != 1) goto parse_error;
+    if (!LefParseFloat(token, &x)) goto parse_error;
     token = LefNextToken(f, TRUE);
-    if (sscanf(token, "%f", &y) != 1) goto parse_error;
+    if (!LefParseFloat(token, &y)) goto parse_error;
     token = LefNextToken(f, TRUE);
     if (*token != ')') goto parse_error;
     token = LefNextToken(f, TRUE);
@@ -1133,8 +1585,8 @@ DefReadPins(FILE *f, char *sname, float oscale, int total)
 			case DEF_PINS_PROP_NET:
 			    /* Get the net name */
 			    token = LefNextToken(f, TRUE);
-			    gate->gatename = strdup(token);
-			    gate->node[0] = strdup(token);
+			    gate->gatename = StrIntern(&DesignNames, token);
+			    gate->node[0] = gate->gatename;
 			    break;
 			case DEF_PINS_PROP_DIR:
 			    token = LefNextToken(f, TRUE);
@@ -1170,7 +1622,7 @@ DefReadPins(FILE *f, char *sname, float oscale, int total)
 
 		    /* If no NET was declared for pin, use pinname */
 		    if (gate->gatename == NULL)
-			gate->gatename = strdup(pinname);
+			gate->gatename = StrIntern(&DesignNames, pinname);
 
 		    /* Make sure pin is at least the size of the route layer */
 		    drect = (DSEG)malloc(sizeof(struct dseg_));
@@ -1340,6 +1792,7 @@ DefReadVias(f, sname, oscale, total)
 
                     lefl->next = LefInfo;
                     LefInfo = lefl;
+                    LefLayerChanged();
 		}
 		else
 		{
@@ -1488,24 +1941,6 @@ DefReadBlockages(FILE *f, char *sname, float oscale, int total)
 		"the number declared (%d).\n", processed, total);
 }
 
-/*
- *------------------------------------------------------------
- *
- * DefReadComponents --
- *
- *	Read a COMPONENTS section from a DEF file.
- *
- * Results:
- *	None.
- *
- * Side Effects:
- *	Many.  Cell instances are created and added to
- *	the database.
- *
- *------------------------------------------------------------
- */
-
-enum def_comp_keys {DEF_COMP_START = 0, DEF_COMP_END};
 enum def_prop_keys {
 	DEF_PROP_FIXED = 0, DEF_PROP_COVER,
 	DEF_PROP_PLACED, DEF_PROP_UNPLACED,
@@ -1513,25 +1948,25 @@ enum def_prop_keys {
 	DEF_PROP_REGION, DEF_PROP_GENERATE, DEF_PROP_PROPERTY,
 	DEF_PROP_EEQMASTER};
 
-static void
-DefReadComponents(FILE *f, char *sname, float oscale, int total)
+/*--------------------------------------------------------------*/
+/* Read one record of a COMPONENTS section, following the "-"	*/
+/* keyword.  Returns the new gate (not yet added to Nlgates or	*/
+/* the instance hash table), or NULL if no gate was made.	*/
+/* Touches nothing shared, and may be run from a worker thread.	*/
+/*--------------------------------------------------------------*/
+
+static GATE
+DefReadComponent(FILE *f, float oscale)
 {
     GATE gateginfo;
     GATE gate = NULL;
     char *token;
     char usename[512];
-    int keyword, subkey, i;
-    int processed = 0;
-    char OK;
+    char *vddpin, *gndpin;
+    int subkey, i;
     DSEG drect, newrect;
     double tmp;
 
-    static char *component_keys[] = {
-	"-",
-	"END",
-	NULL
-    };
-
     static char *property_keys[] = {
 	"FIXED",
 	"COVER",
@@ -1547,194 +1982,241 @@ DefReadComponents(FILE *f, char *sname, float oscale, int total)
 	NULL
     };
 
+    /* Get use and macro names */
+    token = LefNextToken(f, TRUE);
+    if (sscanf(token, "%511s", usename) != 1)
+    {
+	LefError("Bad component statement:  Need use and macro names\n");
+	LefEndStatement(f);
+	return NULL;
+    }
+    token = LefNextToken(f, TRUE);
+
+    /* Find the corresponding macro */
+    gateginfo = lefFindCell(token);
+    if (gateginfo == NULL) {
+	LefError("Could not find a macro definition for \"%s\"\n",
+			token);
+	gate = NULL;
+    }
+    else {
+	gate = (GATE)malloc(sizeof(struct gate_));
+	gate->gatename = StrIntern(&DesignNames, usename);
+	gate->gatetype = gateginfo;
+    }
+	
+    /* Now do a search through the line for "+" entries	*/
+    /* And process each.					*/
+
     while ((token = LefNextToken(f, TRUE)) != NULL)
     {
-	keyword = Lookup(token, component_keys);
+	if (*token == ';') break;
+	if (*token != '+') continue;
 
-	if (keyword < 0)
+	token = LefNextToken(f, TRUE);
+	subkey = Lookup(token, property_keys);
+	if (subkey < 0)
 	{
-	    LefError("Unknown keyword \"%s\" in COMPONENT "
-			"definition; ignoring.\n", token);
-	    LefEndStatement(f);
+	    LefError("Unknown component property \"%s\" in "
+			"COMPONENT definition; ignoring.\n", token);
 	    continue;
 	}
-	switch (keyword)
+	switch (subkey)
 	{
-	    case DEF_COMP_START:		/* "-" keyword */
+	    case DEF_PROP_PLACED:
+	    case DEF_PROP_UNPLACED:
+	    case DEF_PROP_FIXED:
+	    case DEF_PROP_COVER:
+		DefReadLocation(gate, f, oscale);
+		break;
+	    case DEF_PROP_SOURCE:
+	    case DEF_PROP_WEIGHT:
+	    case DEF_PROP_FOREIGN:
+	    case DEF_PROP_REGION:
+	    case DEF_PROP_GENERATE:
+	    case DEF_PROP_PROPERTY:
+	    case DEF_PROP_EEQMASTER:
+		token = LefNextToken(f, TRUE);
+		break;
+	}
+    }
 
-		/* Update the record of the number of components	*/
-		/* processed and spit out a message for every 5% done.	*/
- 
-		processed++;
+    if (gate != NULL)
+    {
+	/* Process the gate */
+	gate->width = gateginfo->width;
+	gate->height = gateginfo->height;   
+	gate->nodes = gateginfo->nodes;   
+	gate->obs = (DSEG)NULL;
+
+	gate->taps = (DSEG *)malloc(gate->nodes * sizeof(DSEG));
+	gate->noderec = (NODE *)malloc(gate->nodes * sizeof(NODE));
+	gate->direction = (u_char *)malloc(gate->nodes * sizeof(u_char));
+	gate->netnum = (int *)malloc(gate->nodes * sizeof(int));
+	gate->node = (char **)malloc(gate->nodes * sizeof(char *));
+
+	/* Pin names are interned, so a pin named after the power	*/
+	/* or ground net has the same name pointer as the table's.	*/
+	vddpin = StrFind(&CellNames, vddnet);
+	gndpin = StrFind(&CellNames, gndnet);
+
+	for (i = 0; i < gate->nodes; i++) {
+	    /* Let the node names point to the master cell;	*/
+	    /* this is just diagnostic;  allows us, for	*/
+	    /* instance, to identify vdd and gnd nodes, so	*/
+	    /* we don't complain about them being		*/
+	    /* disconnected.				*/
+
+	    gate->node[i] = gateginfo->node[i];  /* copy pointer */
+	    gate->direction[i] = gateginfo->direction[i];  /* copy */
+	    gate->taps[i] = (DSEG)NULL;
+
+	    /* Global power/ground bus check */
+	    if (vddpin && (gate->node[i] == vddpin)) {
+	       /* Create a placeholder node with no taps */
+	       gate->netnum[i] = VDD_NET;
+	       gate->noderec[i] = (NODE)calloc(1, sizeof(struct node_));
+	       gate->noderec[i]->netnum = VDD_NET;
+	    }
+	    else if (gndpin && (gate->node[i] == gndpin)) {
+	       /* Create a placeholder node with no taps */
+	       gate->netnum[i] = GND_NET;
+	       gate->noderec[i] = (NODE)calloc(1, sizeof(struct node_));
+	       gate->noderec[i]->netnum = GND_NET;
+	    }
+	    else {
+	       gate->netnum[i] = 0;		/* Until we read NETS */
+	       gate->noderec[i] = NULL;
+	    }
 
-		/* Get use and macro names */
-		token = LefNextToken(f, TRUE);
-		if (sscanf(token, "%511s", usename) != 1)
-		{
-		    LefError("Bad component statement:  Need use and macro names\n");
-		    LefEndStatement(f);
-		    break;
-		}
-		token = LefNextToken(f, TRUE);
+	    /* Make a copy of the gate nodes and adjust for	*/
+	    /* instance position				*/
 
-		/* Find the corresponding macro */
-		OK = 0;
-		for (gateginfo = GateInfo; gateginfo; gateginfo = gateginfo->next) {
-		    if (!strcasecmp(gateginfo->gatename, token)) {
-			OK = 1;
-			break;
-		    }
-		}
-		if (!OK) {
-		    LefError("Could not find a macro definition for \"%s\"\n",
-				token);
-		    gate = NULL;
-		}
-		else {
-		    gate = (GATE)malloc(sizeof(struct gate_));
-		    gate->gatename = strdup(usename);
-		    gate->gatetype = gateginfo;
-		}
-		
-		/* Now do a search through the line for "+" entries	*/
-		/* And process each.					*/
+	    for (drect = gateginfo->taps[i]; drect; drect = drect->next) {
+		newrect = (DSEG)malloc(sizeof(struct dseg_));
+		*newrect = *drect;
+		newrect->next = gate->taps[i];
+		gate->taps[i] = newrect;
+	    }
 
-		while ((token = LefNextToken(f, TRUE)) != NULL)
-		{
-		    if (*token == ';') break;
-		    if (*token != '+') continue;
+	    for (drect = gate->taps[i]; drect; drect = drect->next) {
+		    rotate_object(drect, gateginfo, gate);
+		    //printf("%s drect->x1 %f drect->y1 %f drect->x2 %f drect->y2 %f\n",__FUNCTION__,drect->x1,drect->y1,drect->x2,drect->y2);
+	    }
+	}
 
-		    token = LefNextToken(f, TRUE);
-		    subkey = Lookup(token, property_keys);
-		    if (subkey < 0)
-		    {
-			LefError("Unknown component property \"%s\" in "
-				"COMPONENT definition; ignoring.\n", token);
-			continue;
-		    }
-		    switch (subkey)
-		    {
-			case DEF_PROP_PLACED:
-			case DEF_PROP_UNPLACED:
-			case DEF_PROP_FIXED:
-			case DEF_PROP_COVER:
-			    DefReadLocation(gate, f, oscale);
-			    break;
-			case DEF_PROP_SOURCE:
-			case DEF_PROP_WEIGHT:
-			case DEF_PROP_FOREIGN:
-			case DEF_PROP_REGION:
-			case DEF_PROP_GENERATE:
-			case DEF_PROP_PROPERTY:
-			case DEF_PROP_EEQMASTER:
-			    token = LefNextToken(f, TRUE);
-			    break;
-		    }
-		}
+	/* Make a copy of the gate obstructions and adjust	*/
+	/* for instance position				*/
+	for (drect = gateginfo->obs; drect; drect = drect->next) {
+	    newrect = (DSEG)malloc(sizeof(struct dseg_));
+	    *newrect = *drect;
+	    newrect->next = gate->obs;
+	    gate->obs = newrect;
+	}
 
-		if (gate != NULL)
-		{
-		    /* Process the gate */
-		    gate->width = gateginfo->width;
-		    gate->height = gateginfo->height;   
-		    gate->nodes = gateginfo->nodes;   
-		    gate->obs = (DSEG)NULL;
+	for (drect = gate->obs; drect; drect = drect->next) {
+		rotate_object(drect, gateginfo, gate);
+		//printf("%s drect->x1 %f drect->y1 %f drect->x2 %f drect->y2 %f\n",__FUNCTION__,drect->x1,drect->y1,drect->x2,drect->y2);
+	}
 
-                    gate->taps = (DSEG *)malloc(gate->nodes * sizeof(DSEG));
-                    gate->noderec = (NODE *)malloc(gate->nodes * sizeof(NODE));
-                    gate->direction = (u_char *)malloc(gate->nodes * sizeof(u_char));
-                    gate->netnum = (int *)malloc(gate->nodes * sizeof(int));
-                    gate->node = (char **)malloc(gate->nodes * sizeof(char *));
-
-		    for (i = 0; i < gate->nodes; i++) {
-			/* Let the node names point to the master cell;	*/
-			/* this is just diagnostic;  allows us, for	*/
-			/* instance, to identify vdd and gnd nodes, so	*/
-			/* we don't complain about them being		*/
-			/* disconnected.				*/
-
-			gate->node[i] = gateginfo->node[i];  /* copy pointer */
-			gate->direction[i] = gateginfo->direction[i];  /* copy */
-			gate->taps[i] = (DSEG)NULL;
-
-			/* Global power/ground bus check */
-			if (vddnet && !strcmp(gate->node[i], vddnet)) {
-			   /* Create a placeholder node with no taps */
-			   gate->netnum[i] = VDD_NET;
-			   gate->noderec[i] = (NODE)calloc(1, sizeof(struct node_));
-			   gate->noderec[i]->netnum = VDD_NET;
-			}
-			else if (gndnet && !strcmp(gate->node[i], gndnet)) {
-			   /* Create a placeholder node with no taps */
-			   gate->netnum[i] = GND_NET;
-			   gate->noderec[i] = (NODE)calloc(1, sizeof(struct node_));
-			   gate->noderec[i]->netnum = GND_NET;
-			}
-			else {
-			   gate->netnum[i] = 0;		/* Until we read NETS */
-			   gate->noderec[i] = NULL;
-			}
+	if((gate->orient==DEF_WEST)||(gate->orient==DEF_EAST)||(gate->orient==DEF_FLIPPED_WEST)||(gate->orient==DEF_FLIPPED_EAST)) {
+		tmp = gate->width;
+		gate->width = gate->height;
+		gate->height = tmp;
+	}
+    }
+    return gate;
+}
 
-			/* Make a copy of the gate nodes and adjust for	*/
-			/* instance position				*/
+/*
+ *------------------------------------------------------------
+ *
+ * DefReadComponents --
+ *
+ *	Read a COMPONENTS section from a DEF file.
+ *
+ * Results:
+ *	None.
+ *
+ * Side Effects:
+ *	Many.  Cell instances are created and added to
+ *	the database.
+ *
+ *------------------------------------------------------------
+ */
 
-			for (drect = gateginfo->taps[i]; drect; drect = drect->next) {
-			    newrect = (DSEG)malloc(sizeof(struct dseg_));
-			    *newrect = *drect;
-			    newrect->next = gate->taps[i];
-			    gate->taps[i] = newrect;
-			}
+static void
+DefReadComponents(FILE *f, char *sname, float oscale, int total)
+{
+    GATE gate;
+    char *token;
+    int keyword, c, k;
+    int processed = 0;
+    struct defsection_ sec;
 
-			for (drect = gate->taps[i]; drect; drect = drect->next) {
-				rotate_object(drect, gateginfo, gate);
-				//printf("%s drect->x1 %f drect->y1 %f drect->x2 %f drect->y2 %f\n",__FUNCTION__,drect->x1,drect->y1,drect->x2,drect->y2);
-			}
-		}
+    sec.f = f;
+    sec.oscale = oscale;
+    sec.special = FALSE;
+    sec.home = NULL;
+    sec.nets = FALSE;
+    if (DefParallel && DefReadSection(f, &sec)) {
 
-		    /* Make a copy of the gate obstructions and adjust	*/
-		    /* for instance position				*/
-		    for (drect = gateginfo->obs; drect; drect = drect->next) {
-			newrect = (DSEG)malloc(sizeof(struct dseg_));
-			*newrect = *drect;
-			newrect->next = gate->obs;
-			gate->obs = newrect;
-		    }
+	/* Merge the gates read by the workers, in file order */
 
-			for (drect = gate->obs; drect; drect = drect->next) {
-				rotate_object(drect, gateginfo, gate);
-				//printf("%s drect->x1 %f drect->y1 %f drect->x2 %f drect->y2 %f\n",__FUNCTION__,drect->x1,drect->y1,drect->x2,drect->y2);
-			}
+	for (c = 0; c < sec.numchunks; c++) {
+	    LefReplayErrors(sec.chunk[c].errors);
+	    for (k = 0; k < sec.chunk[c].numrecs; k++) {
+		gate = (GATE)sec.chunk[c].rec[k];
+		processed++;
+		if (gate == NULL) continue;
+		gate->next = Nlgates;
+		Nlgates = gate;
+		DefHashInstance(gate);
+	    }
+	}
+	DefFreeSection(&sec);
+    }
 
-			if((gate->orient==DEF_WEST)||(gate->orient==DEF_EAST)||(gate->orient==DEF_FLIPPED_WEST)||(gate->orient==DEF_FLIPPED_EAST)) {
-				tmp = gate->width;
-				gate->width = gate->height;
-				gate->height = tmp;
-			}
+    while ((token = LefNextToken(f, TRUE)) != NULL)
+    {
+	keyword = Lookup(token, record_keys);
+
+	if (keyword < 0)
+	{
+	    LefError("Unknown keyword \"%s\" in COMPONENT "
+			"definition; ignoring.\n", token);
+	    LefEndStatement(f);
+	    continue;
+	}
+	switch (keyword)
+	{
+	    case DEF_RECORD_START:		/* "-" keyword */
 
-			gate->next = Nlgates;
-			Nlgates = gate;
+		/* Update the record of the number of components	*/
+		/* processed and spit out a message for every 5% done.	*/
+ 
+		processed++;
+
+		gate = DefReadComponent(f, oscale);
+		if (gate != NULL)
+		{
+		    gate->next = Nlgates;
+		    Nlgates = gate;
 
 		    // Used by Tcl version of qrouter
 		    DefHashInstance(gate);
 		}
 		break;
 
-	    case DEF_COMP_END:
+	    case DEF_RECORD_END:
 		if (!LefParseEndStatement(f, sname))
 		{
 		    LefError("Component END statement missing.\n");
 		    keyword = -1;
 		}
-
-		/* Finish final call by placing the cell use */
-		if ((total > 0) && (gate != NULL))
-		{
-		    // Nothing to do. . . gate has already been placed in list.
-		    gate = NULL;
-		}
 		break;
 	}
-	if (keyword == DEF_COMP_END) break;
+	if (keyword == DEF_RECORD_END) break;
     }
 
     if (processed == total) {
@@ -1781,7 +2263,8 @@ DefRead(char *inName)
 {
     FILE *f;
     char filename[256];
-    char *token;
+    char *token, *text;
+    size_t textlen;
     int keyword, dscale, total;
     int curlayer = -1, channels;
     int v, h, i;
@@ -1948,7 +2431,7 @@ DefRead(char *inName)
 		}
 		corient = tolower(token[0]);	// X or Y
 		token = LefNextToken(f, TRUE);
-		if (sscanf(token, "%lg", &start) != 1) {
+		if (!LefParseDouble(token, &start)) {
 		    LefError("Problem parsing track start position.\n");
 		}
 		token = LefNextToken(f, TRUE);
@@ -1964,7 +2447,7 @@ DefRead(char *inName)
 		    LefError("TRACKS missing STEP size.\n");
 		}
 		token = LefNextToken(f, TRUE);
-		if (sscanf(token, "%lg", &step) != 1) {
+		if (!LefParseDouble(token, &step)) {
 		    LefError("Problem parsing track step size.\n");
 		}
 		token = LefNextToken(f, TRUE);
@@ -2103,6 +2586,10 @@ DefRead(char *inName)
 
     /* Cleanup */
 
-    if (f != NULL) fclose(f);
+    if (f != NULL) {
+	text = LefFileText(f, &textlen);
+	snapshot_input(SNAP_DEF, text, textlen);
+	LefCloseFile(f);
+    }
     return oscale;
 }
@@ -8,7 +8,12 @@
 #ifndef _DEFINT_H
 #define _DEFINT_H
 
+/* With DefParallel set, a section is split into about this	*/
+/* many chunks per thread, for the threads to share out.	*/
+#define DEF_CHUNKS_PER_THREAD	4
+
 extern int numSpecial;
+extern u_char DefParallel;
 extern float  DefRead(char *inName);
 
 #endif /* _DEFINT_H */
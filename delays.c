@@ -477,10 +477,9 @@ int write_delays(char *filename)
 	lefrcvalues[i].capx = (PitchX[i] * width) * areacap + (PitchX[i] * edgecap);
 	lefrcvalues[i].capy = (PitchY[i] * width) * areacap + (PitchY[i] * edgecap);
 
-	if (i < (Num_layers - 1))
-	    LefGetViaResistance(i, &(lefrcvalues[i].viares));
-	else
-	    lefrcvalues[i].viares = 0.0;	/* Not used */
+	if ((i >= (Num_layers - 1)) ||
+		(LefGetViaResistance(i, &(lefrcvalues[i].viares)) != 0))
+	    lefrcvalues[i].viares = 0.0;	/* Not used, or not given */
     }
 
     /* Each net is output independently.  Loop through all nets. */
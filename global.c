@@ -0,0 +1,600 @@
+/*--------------------------------------------------------------*/
+/* global.c --							*/
+/*								*/
+/* Coarse global routing ahead of the first stage.		*/
+/*								*/
+/* The search mask made by createMask() guesses a trunk-and-	*/
+/* branch route for each net on its own, with no idea of where	*/
+/* the other nets want to go.  Here the die is divided into	*/
+/* GCells of GCELL_SIZE x GCELL_SIZE tracks, and each edge	*/
+/* between neighboring GCells gets a capacity:  the number of	*/
+/* tracks that cross it free of obstructions on the layers	*/
+/* routed in that direction.  Layers with a pitch coarser than	*/
+/* the route grid have their off-pitch tracks blocked in Obs[]	*/
+/* already, so they add only the tracks they have.		*/
+/*								*/
+/* Every net is then routed over the GCells, growing a tree	*/
+/* from one pin to the nearest pin not yet connected, with a	*/
+/* search whose edge costs rise as the edges fill up.  Nets	*/
+/* crossing edges that overflow are ripped up and routed again	*/
+/* for a few passes, with the cost of those edges raised each	*/
+/* time.  The GCells used by the route of each net are kept in	*/
+/* the net record and become the search mask of the detailed	*/
+/* router (see createGuideMask()).  Where the global route	*/
+/* leaves the net bbox, the bbox is grown to take it in.	*/
+/*--------------------------------------------------------------*/
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "qrouter.h"
+#include "qconfig.h"
+#include "node.h"
+#include "global.h"
+
+int GCellsX = 0;
+int GCellsY = 0;
+
+/* Edge c joins GCell c to GCell c + 1 in the horizontal	*/
+/* arrays, and to GCell c + GCellsX in the vertical arrays.	*/
+
+static int *capH = NULL, *capV = NULL;	// Free tracks across each edge
+static int *useH = NULL, *useV = NULL;	// Nets across each edge
+static int *histH = NULL, *histV = NULL;	// Passes each edge overflowed
+
+/* Edges used by the global route of one net, coded as 2 * c	*/
+/* for horizontal edge c and 2 * c + 1 for vertical edge c.	*/
+
+typedef struct gpath_ {
+    int *edge;
+    int numedges;
+    int maxedges;
+} GPATH;
+
+/* Search state, one entry per GCell */
+
+static int *dist = NULL;
+static int *from = NULL;		// Edge by which the GCell was reached
+static u_int *seen = NULL;		// Search for which "dist" is set
+static u_int *intree = NULL;		// Net whose route tree holds the GCell
+static u_int *ispin = NULL;		// Net with a pin in the GCell
+static u_int searchstamp = 0;
+static u_int netstamp = 0;
+
+static int *tree = NULL;		// GCells of the route tree
+static int numtree = 0;
+static int *pins = NULL;		// GCells of the net pins
+static int maxpins = 0;
+
+typedef struct gheap_ {
+    int cost;
+    int cell;
+} GHEAP;
+
+static GHEAP *heap = NULL;
+static int heapsize = 0;
+static int maxheap = 0;
+
+static void *
+galloc(size_t n, size_t size)
+{
+    void *p;
+
+    p = calloc((n > 0) ? n : 1, size);
+    if (p == NULL) {
+	printf("%s: memory leak. dying!\n",__FUNCTION__);
+	exit(0);
+    }
+    return p;
+}
+
+static void
+heap_push(int cell, int cost)
+{
+    int i, p;
+
+    if (heapsize == maxheap) {
+	maxheap = (maxheap == 0) ? 256 : (maxheap << 1);
+	heap = (GHEAP *)realloc(heap, maxheap * sizeof(GHEAP));
+	if (heap == NULL) {
+	    printf("%s: memory leak. dying!\n",__FUNCTION__);
+	    exit(0);
+	}
+    }
+    for (i = heapsize++; i > 0; i = p) {
+	p = (i - 1) >> 1;
+	if (heap[p].cost <= cost) break;
+	heap[i] = heap[p];
+    }
+    heap[i].cost = cost;
+    heap[i].cell = cell;
+}
+
+static BOOL
+heap_pop(int *cell, int *cost)
+{
+    GHEAP last;
+    int i, c;
+
+    if (heapsize == 0) return FALSE;
+    *cell = heap[0].cell;
+    *cost = heap[0].cost;
+    last = heap[--heapsize];
+    for (i = 0; (c = 2 * i + 1) < heapsize; i = c) {
+	if ((c + 1 < heapsize) && (heap[c + 1].cost < heap[c].cost)) c++;
+	if (last.cost <= heap[c].cost) break;
+	heap[i] = heap[c];
+    }
+    heap[i] = last;
+    return TRUE;
+}
+
+/*--------------------------------------------------------------*/
+/* A track crossing a GCell edge is free if neither position	*/
+/* on either side of the edge is obstructed or routed.		*/
+/*--------------------------------------------------------------*/
+
+static BOOL
+track_free(int x, int y, int lay)
+{
+    if ((x >= NumChannelsX[lay]) || (y >= NumChannelsY[lay])) return FALSE;
+    return ((OBSVAL(x, y, lay) & (NO_NET | ROUTED_NET)) == 0) ? TRUE : FALSE;
+}
+
+/*--------------------------------------------------------------*/
+/* Size the GCell grid to the die and find the edge capacities	*/
+/*--------------------------------------------------------------*/
+
+static void
+global_setup(void)
+{
+    int gx, gy, c, l, x, y, xb, yb, numcells;
+
+    GCellsX = (NumChannelsX[0] + GCELL_SIZE - 1) / GCELL_SIZE;
+    GCellsY = (NumChannelsY[0] + GCELL_SIZE - 1) / GCELL_SIZE;
+    numcells = GCellsX * GCellsY;
+
+    capH = (int *)galloc(numcells, sizeof(int));
+    capV = (int *)galloc(numcells, sizeof(int));
+    useH = (int *)galloc(numcells, sizeof(int));
+    useV = (int *)galloc(numcells, sizeof(int));
+    histH = (int *)galloc(numcells, sizeof(int));
+    histV = (int *)galloc(numcells, sizeof(int));
+    dist = (int *)galloc(numcells, sizeof(int));
+    from = (int *)galloc(numcells, sizeof(int));
+    seen = (u_int *)galloc(numcells, sizeof(u_int));
+    intree = (u_int *)galloc(numcells, sizeof(u_int));
+    ispin = (u_int *)galloc(numcells, sizeof(u_int));
+    tree = (int *)galloc(numcells, sizeof(int));
+    searchstamp = netstamp = 0;
+
+    // A single layer is routed in both directions
+
+    for (gy = 0; gy < GCellsY; gy++) {
+	for (gx = 0; gx < GCellsX; gx++) {
+	    c = gy * GCellsX + gx;
+	    if (gx < GCellsX - 1) {
+		xb = (gx + 1) * GCELL_SIZE - 1;
+		for (l = 0; l < Num_layers; l++) {
+		    if ((Num_layers > 1) && Vert[l]) continue;
+		    for (y = gy * GCELL_SIZE; (y < (gy + 1) * GCELL_SIZE) &&
+				(y < NumChannelsY[0]); y++)
+			if (track_free(xb, y, l) && track_free(xb + 1, y, l))
+			    capH[c]++;
+		}
+	    }
+	    if (gy < GCellsY - 1) {
+		yb = (gy + 1) * GCELL_SIZE - 1;
+		for (l = 0; l < Num_layers; l++) {
+		    if ((Num_layers > 1) && !Vert[l]) continue;
+		    for (x = gx * GCELL_SIZE; (x < (gx + 1) * GCELL_SIZE) &&
+				(x < NumChannelsX[0]); x++)
+			if (track_free(x, yb, l) && track_free(x, yb + 1, l))
+			    capV[c]++;
+		}
+	    }
+	}
+    }
+}
+
+static void
+global_cleanup(void)
+{
+    free(capH);
+    free(capV);
+    free(useH);
+    free(useV);
+    free(histH);
+    free(histV);
+    free(dist);
+    free(from);
+    free(seen);
+    free(intree);
+    free(ispin);
+    free(tree);
+    free(pins);
+    free(heap);
+    capH = capV = useH = useV = histH = histV = NULL;
+    dist = from = tree = pins = NULL;
+    seen = intree = ispin = NULL;
+    heap = NULL;
+    maxpins = maxheap = heapsize = 0;
+}
+
+/*--------------------------------------------------------------*/
+/* Cost of a route across an edge.  Every edge costs one GCell	*/
+/* of wire, raised for each pass it has overflowed.  An edge	*/
+/* costs more as it fills up, and much more past capacity.	*/
+/*--------------------------------------------------------------*/
+
+static int
+edge_cost(int e)
+{
+    int c, cap, use, hist, cost;
+
+    c = e >> 1;
+    if (e & 1) {
+	cap = capV[c];
+	use = useV[c];
+	hist = histV[c];
+    }
+    else {
+	cap = capH[c];
+	use = useH[c];
+	hist = histH[c];
+    }
+    cost = GCELL_SIZE * (1 + hist);
+    if (use >= cap)
+	cost += 4 * GCELL_SIZE * (use - cap + 1);
+    else
+	cost += (GCELL_SIZE * use) / cap;
+    return cost;
+}
+
+static void
+path_usage(GPATH *gp, int delta)
+{
+    int i, e;
+
+    for (i = 0; i < gp->numedges; i++) {
+	e = gp->edge[i];
+	if (e & 1)
+	    useV[e >> 1] += delta;
+	else
+	    useH[e >> 1] += delta;
+    }
+}
+
+static BOOL
+path_overflows(GPATH *gp)
+{
+    int i, e;
+
+    for (i = 0; i < gp->numedges; i++) {
+	e = gp->edge[i];
+	if ((e & 1) ? (useV[e >> 1] > capV[e >> 1]) :
+			(useH[e >> 1] > capH[e >> 1]))
+	    return TRUE;
+    }
+    return FALSE;
+}
+
+static void
+add_edge(GPATH *gp, int e)
+{
+    if (gp->numedges == gp->maxedges) {
+	gp->maxedges = (gp->maxedges == 0) ? 16 : (gp->maxedges << 1);
+	gp->edge = (int *)realloc(gp->edge, gp->maxedges * sizeof(int));
+	if (gp->edge == NULL) {
+	    printf("%s: memory leak. dying!\n",__FUNCTION__);
+	    exit(0);
+	}
+    }
+    gp->edge[gp->numedges++] = e;
+}
+
+/*--------------------------------------------------------------*/
+/* List the GCells of the pins of net "net" in "pins", each	*/
+/* one once, and mark them in "ispin".  The first tap of each	*/
+/* node stands for the node, as in find_bounding_box().		*/
+/*--------------------------------------------------------------*/
+
+static int
+net_pins(NET net)
+{
+    NODE node;
+    DPOINT dtap;
+    int n, c, x, y;
+
+    netstamp++;
+    n = 0;
+    for (node = net->netnodes; node; node = node->next) {
+	dtap = (node->taps == NULL) ? node->extend : node->taps;
+	if (dtap == NULL) continue;
+	x = MIN(MAX(dtap->gridx, 0), NumChannelsX[0] - 1);
+	y = MIN(MAX(dtap->gridy, 0), NumChannelsY[0] - 1);
+	c = (y / GCELL_SIZE) * GCellsX + x / GCELL_SIZE;
+	if (ispin[c] == netstamp) continue;
+	ispin[c] = netstamp;
+	if (n == maxpins) {
+	    maxpins = (maxpins == 0) ? 16 : (maxpins << 1);
+	    pins = (int *)realloc(pins, maxpins * sizeof(int));
+	    if (pins == NULL) {
+		printf("%s: memory leak. dying!\n",__FUNCTION__);
+		exit(0);
+	    }
+	}
+	pins[n++] = c;
+    }
+    return n;
+}
+
+static void
+relax(int n, int e, int d)
+{
+    d += edge_cost(e);
+    if ((seen[n] == searchstamp) && (dist[n] <= d)) return;
+    seen[n] = searchstamp;
+    dist[n] = d;
+    from[n] = e;
+    heap_push(n, d);
+}
+
+/*--------------------------------------------------------------*/
+/* Route net "net" over the GCells, recording the edges used	*/
+/* in "gp" and adding them to the edge usage.			*/
+/*--------------------------------------------------------------*/
+
+static void
+route_net(NET net, GPATH *gp)
+{
+    int npins, remaining, i, c, c0, e, d, x, y, found;
+    int sx1, sy1, sx2, sy2;
+
+    gp->numedges = 0;
+    npins = net_pins(net);
+    if (npins < 2) return;
+
+    // The search is held to the GCells around the pins
+
+    sx1 = sx2 = pins[0] % GCellsX;
+    sy1 = sy2 = pins[0] / GCellsX;
+    for (i = 1; i < npins; i++) {
+	x = pins[i] % GCellsX;
+	y = pins[i] / GCellsX;
+	sx1 = MIN(sx1, x);
+	sx2 = MAX(sx2, x);
+	sy1 = MIN(sy1, y);
+	sy2 = MAX(sy2, y);
+    }
+    sx1 = MAX(sx1 - GLOBAL_MARGIN, 0);
+    sy1 = MAX(sy1 - GLOBAL_MARGIN, 0);
+    sx2 = MIN(sx2 + GLOBAL_MARGIN, GCellsX - 1);
+    sy2 = MIN(sy2 + GLOBAL_MARGIN, GCellsY - 1);
+
+    numtree = 0;
+    intree[pins[0]] = netstamp;
+    tree[numtree++] = pins[0];
+    remaining = npins - 1;
+
+    while (remaining > 0) {
+
+	// Search out from the whole tree for the nearest pin not
+	// yet connected to it.
+
+	searchstamp++;
+	heapsize = 0;
+	for (i = 0; i < numtree; i++) {
+	    c = tree[i];
+	    seen[c] = searchstamp;
+	    dist[c] = 0;
+	    from[c] = -1;
+	    heap_push(c, 0);
+	}
+	found = -1;
+	while (heap_pop(&c, &d)) {
+	    if (d > dist[c]) continue;
+	    if ((ispin[c] == netstamp) && (intree[c] != netstamp)) {
+		found = c;
+		break;
+	    }
+	    x = c % GCellsX;
+	    y = c / GCellsX;
+	    if (x < sx2) relax(c + 1, 2 * c, d);
+	    if (x > sx1) relax(c - 1, 2 * (c - 1), d);
+	    if (y < sy2) relax(c + GCellsX, 2 * c + 1, d);
+	    if (y > sy1) relax(c - GCellsX, 2 * (c - GCellsX) + 1, d);
+	}
+	if (found < 0) break;
+
+	// Add the path found to the tree
+
+	for (c = found; intree[c] != netstamp; ) {
+	    intree[c] = netstamp;
+	    tree[numtree++] = c;
+	    if (ispin[c] == netstamp) remaining--;
+
+	    e = from[c];
+	    add_edge(gp, e);
+	    c0 = e >> 1;
+	    if (e & 1) {
+		useV[c0]++;
+		c = (c == c0) ? c0 + GCellsX : c0;
+	    }
+	    else {
+		useH[c0]++;
+		c = (c == c0) ? c0 + 1 : c0;
+	    }
+	}
+    }
+}
+
+static int
+compare_cells(const void *a, const void *b)
+{
+    return *(const int *)a - *(const int *)b;
+}
+
+/*--------------------------------------------------------------*/
+/* Keep the GCells of the global route of net "net" as its	*/
+/* guide, and grow the net bbox to take in any part of the	*/
+/* route outside of the GCells of the pins.			*/
+/*--------------------------------------------------------------*/
+
+static void
+set_guide(NET net, GPATH *gp)
+{
+    int npins, i, n, c, e;
+    int px1, py1, px2, py2, gx1, gy1, gx2, gy2;
+    int x1, y1, x2, y2;
+
+    npins = net_pins(net);
+    if (npins == 0) return;
+
+    net->guide = (int *)galloc(npins + 2 * gp->numedges, sizeof(int));
+    n = 0;
+    for (i = 0; i < npins; i++) net->guide[n++] = pins[i];
+    for (i = 0; i < gp->numedges; i++) {
+	e = gp->edge[i];
+	c = e >> 1;
+	net->guide[n++] = c;
+	net->guide[n++] = (e & 1) ? c + GCellsX : c + 1;
+    }
+    qsort(net->guide, n, sizeof(int), compare_cells);
+    for (i = net->numguide = 1; i < n; i++)
+	if (net->guide[i] != net->guide[net->numguide - 1])
+	    net->guide[net->numguide++] = net->guide[i];
+
+    px1 = px2 = pins[0] % GCellsX;
+    py1 = py2 = pins[0] / GCellsX;
+    for (i = 1; i < npins; i++) {
+	px1 = MIN(px1, pins[i] % GCellsX);
+	px2 = MAX(px2, pins[i] % GCellsX);
+	py1 = MIN(py1, pins[i] / GCellsX);
+	py2 = MAX(py2, pins[i] / GCellsX);
+    }
+    gx1 = gx2 = net->guide[0] % GCellsX;
+    gy1 = gy2 = net->guide[0] / GCellsX;
+    for (i = 1; i < net->numguide; i++) {
+	gx1 = MIN(gx1, net->guide[i] % GCellsX);
+	gx2 = MAX(gx2, net->guide[i] % GCellsX);
+	gy1 = MIN(gy1, net->guide[i] / GCellsX);
+	gy2 = MAX(gy2, net->guide[i] / GCellsX);
+    }
+    if ((gx1 == px1) && (gy1 == py1) && (gx2 == px2) && (gy2 == py2))
+	return;
+    if (!get_bbox_extent(net->bbox, &x1, &y1, &x2, &y2)) return;
+
+    if (gx1 < px1) x1 = MIN(x1, gx1 * GCELL_SIZE);
+    if (gy1 < py1) y1 = MIN(y1, gy1 * GCELL_SIZE);
+    if (gx2 > px2) x2 = MAX(x2, MIN((gx2 + 1) * GCELL_SIZE, NumChannelsX[0]) - 1);
+    if (gy2 > py2) y2 = MAX(y2, MIN((gy2 + 1) * GCELL_SIZE, NumChannelsY[0]) - 1);
+    set_bbox_rect(net->bbox, x1, y1, x2, y2);
+}
+
+/* Nets routed by the global router */
+
+static BOOL
+global_net(NET net)
+{
+    if (net->numnodes < 2) return FALSE;
+    if ((net->netnum == VDD_NET) || (net->netnum == GND_NET)) return FALSE;
+    if (net->flags & NET_IGNORED) return FALSE;
+    return (net->bbox != NULL) ? TRUE : FALSE;
+}
+
+/*--------------------------------------------------------------*/
+/* global_route --						*/
+/*								*/
+/* Route all nets over the GCell grid, and keep the result in	*/
+/* each net as its guide.  To be called after the DEF file has	*/
+/* been read and before the first stage.  Any guides from an	*/
+/* earlier call are replaced.					*/
+/*								*/
+/* Return value:  The total overflow of the GCell edges, that	*/
+/* is, the number of nets across them in excess of capacity.	*/
+/*--------------------------------------------------------------*/
+
+int
+global_route(void)
+{
+    GPATH *paths;
+    NET net;
+    int i, c, pass, rerouted, overflow, numcells;
+
+    global_clear();
+    if ((Numnets == 0) || (Obs[0] == NULL)) return 0;
+
+    global_setup();
+    numcells = GCellsX * GCellsY;
+    paths = (GPATH *)galloc(Numnets, sizeof(GPATH));
+
+    overflow = 0;
+    for (pass = 0; pass < GLOBAL_PASSES; pass++) {
+	rerouted = 0;
+	for (i = 0; i < Numnets; i++) {
+	    net = Nlnets[i];
+	    if (!global_net(net)) continue;
+	    if (pass > 0) {
+		if (!path_overflows(&paths[i])) continue;
+		path_usage(&paths[i], -1);
+	    }
+	    route_net(net, &paths[i]);
+	    rerouted++;
+	}
+
+	// Raise the cost of every edge that overflows
+
+	overflow = 0;
+	for (c = 0; c < numcells; c++) {
+	    if (useH[c] > capH[c]) {
+		overflow += useH[c] - capH[c];
+		histH[c]++;
+	    }
+	    if (useV[c] > capV[c]) {
+		overflow += useV[c] - capV[c];
+		histV[c]++;
+	    }
+	}
+	if (Verbose > 0)
+	    Fprintf(stdout, "Global route pass %d: %d nets routed, "
+			"overflow %d\n", pass + 1, rerouted, overflow);
+	if (overflow == 0) break;
+    }
+
+    for (i = 0; i < Numnets; i++) {
+	net = Nlnets[i];
+	if (global_net(net)) set_guide(net, &paths[i]);
+	free(paths[i].edge);
+    }
+    free(paths);
+    global_cleanup();
+
+    if (Verbose > 0)
+	Fprintf(stdout, "Global route on %d x %d GCells:  overflow %d\n",
+		GCellsX, GCellsY, overflow);
+
+    return overflow;
+}
+
+/*--------------------------------------------------------------*/
+/* global_clear --						*/
+/*								*/
+/* Drop the guides of all nets, so that the detailed router	*/
+/* goes back to its own estimate of the best route.  Net bboxes	*/
+/* grown by global_route() are left as they are.		*/
+/*--------------------------------------------------------------*/
+
+void
+global_clear(void)
+{
+    int i;
+
+    for (i = 0; i < Numnets; i++) {
+	free(Nlnets[i]->guide);
+	Nlnets[i]->guide = NULL;
+	Nlnets[i]->numguide = 0;
+    }
+}
+
+/* end of global.c */
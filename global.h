@@ -0,0 +1,29 @@
+/*--------------------------------------------------------------*/
+/* global.h --							*/
+/*								*/
+/* Coarse global routing ahead of the first stage (header	*/
+/* file)							*/
+/*--------------------------------------------------------------*/
+
+#ifndef GLOBAL_H
+
+/* Side of a global routing cell (GCell), in route tracks.	*/
+#define GCELL_SIZE		10
+
+/* Passes of rip-up and reroute of the nets crossing GCell	*/
+/* edges used by more nets than they have tracks for.		*/
+#define GLOBAL_PASSES		4
+
+/* Routes of a net are searched for within this many GCells	*/
+/* around the GCells of its pins.				*/
+#define GLOBAL_MARGIN		2
+
+extern int GCellsX, GCellsY;	// GCell grid of the last global route
+
+int     global_route(void);
+void    global_clear(void);
+
+#define GLOBAL_H
+#endif
+
+/* end of global.h */
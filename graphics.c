@@ -18,6 +18,7 @@
 #include "qconfig.h"
 #include "node.h"
 #include "maze.h"
+#include "pqueue.h"
 #include "mask.h"
 #include "lef.h"
 
@@ -61,7 +62,7 @@ void highlight(int x, int y) {
     int i, xspc, yspc, hspc;
     PROUTE *Pr;
 
-    // If Obs2[] at x, y is a source or dest, don't highlight
+    // If the search window at x, y is a source or dest, don't highlight
     // Do this only for layer 0;  it doesn't have to be rigorous. 
     for (i = 0; i < Num_layers; i++) {
 	Pr = &OBS2VAL(x, y, i);
@@ -87,22 +88,15 @@ void highlight(int x, int y) {
 /*--------------------------------------*/
 void highlight_source(NET net) {
     POINT vpnt = create_point(0,0,0);
-    POINT pmax = get_right_upper_trunk_point(net->bbox);
-    POINT pmin = get_left_lower_trunk_point(net->bbox);
     int xmax, ymax;
     int xmin, ymin;
-    xmin = pmin->x;
-    ymin = pmin->y;
-    xmax = pmax->x;
-    ymax = pmax->y;
-    free(pmin);
-    free(pmax);
+    get_bbox_extent(net->bbox, &xmin, &ymin, &xmax, &ymax);
 
     int xspc, yspc, hspc;
     int i;
     PROUTE *Pr;
 
-    if (Obs2[0] == NULL) return;
+    if (SearchWin == NULL) return;
 
     // Determine the number of routes per width and height, if
     // it has not yet been computed
@@ -138,21 +132,14 @@ void highlight_source(NET net) {
 /*--------------------------------------*/
 void highlight_dest(NET net) {
     POINT vpnt = create_point(0,0,0);
-    POINT pmax = get_right_upper_trunk_point(net->bbox);
-    POINT pmin = get_left_lower_trunk_point(net->bbox);
     int xmax, ymax;
     int xmin, ymin;
-    xmin = pmin->x;
-    ymin = pmin->y;
-    xmax = pmax->x;
-    ymax = pmax->y;
-    free(pmin);
-    free(pmax);
+    get_bbox_extent(net->bbox, &xmin, &ymin, &xmax, &ymax);
 
     int xspc, yspc, hspc, dspc;
     PROUTE *Pr;
 
-    if (Obs2[0] == NULL) return;
+    if (SearchWin == NULL) return;
 
     // Determine the number of routes per width and height, if
     // it has not yet been computed
@@ -185,9 +172,10 @@ void highlight_dest(NET net) {
 /*----------------------------------------------*/
 /* Highlight all the search starting points	*/
 /*----------------------------------------------*/
-void highlight_starts(POINT glist) {
+void highlight_starts(PQUEUE pq) {
     int xspc, yspc, hspc;
-    POINT gpoint;
+    int b, e;
+    PQENTRY *pe;
 
     // Determine the number of routes per width and height, if
     // it has not yet been computed
@@ -195,10 +183,13 @@ void highlight_starts(POINT glist) {
     hspc = spacing >> 1;
 
     XSetForeground(dpy, gc, greenyellowpix);
-    for (gpoint = glist; gpoint; gpoint = gpoint->next) {
-	xspc = (gpoint->x + 1) * spacing - hspc;
-	yspc = height - (gpoint->y + 1) * spacing - hspc;
-	XFillRectangle(dpy, win, gc, xspc, yspc, spacing, spacing);
+    for (b = pq->minbucket; b <= pq->maxbucket; b++) {
+	for (e = pq->bucket[b]; e != PQ_NONE; e = pe->next) {
+	    pe = &pq->entries[e];
+	    xspc = (pe->x + 1) * spacing - hspc;
+	    yspc = height - (pe->y + 1) * spacing - hspc;
+	    XFillRectangle(dpy, win, gc, xspc, yspc, spacing, spacing);
+	}
     }
 }
 
@@ -211,22 +202,15 @@ void highlight_mask(NET net) {
     if(!gc) return;
     if(!win) return;
     if(!net->bbox) return;
-    if(net->bbox->num_edges<4) return;
+    if(net->bbox->num_vertices<4) return;
 
     int xspc, yspc, hspc;
     POINT vpnt = create_point(0,0,0);
-    POINT pmax = get_right_upper_trunk_point(net->bbox);
-    POINT pmin = get_left_lower_trunk_point(net->bbox);
     int xmax, ymax;
     int xmin, ymin;
-    xmin = pmin->x;
-    ymin = pmin->y;
-    xmax = pmax->x;
-    ymax = pmax->y;
-    free(pmin);
-    free(pmax);
+    get_bbox_extent(net->bbox, &xmin, &ymin, &xmax, &ymax);
 
-    if (RMask == NULL) return;
+    if (SearchWin == NULL) return;
 
     // Determine the number of routes per width and height, if
     // it has not yet been computed
@@ -360,7 +344,7 @@ map_estimate()
     int xspc, yspc, hspc;
     int i, x, y, nwidth, nheight, area, length, value;
     float density, *Congestion, norm, maxval;
-    POINT pt1, pt2;
+    int x1, y1, x2, y2;
 
     hspc = spacing >> 1;
 
@@ -374,10 +358,9 @@ map_estimate()
 	length = net_absolute_distance(net);
 	density = (float)length / (float)area;
 
-	pt1 = get_left_lower_trunk_point(net->bbox);
-	pt2 = get_right_upper_trunk_point(net->bbox);
-	for (x = pt1->x; x < pt2->x; x++)
-	    for (y = pt1->y; y < pt2->y; y++)
+	if (!get_bbox_extent(net->bbox, &x1, &y1, &x2, &y2)) continue;
+	for (x = x1; x < x2; x++)
+	    for (y = y1; y < y2; y++)
 		CONGEST(x, y) += density;
     }
 
@@ -402,8 +385,6 @@ map_estimate()
     }
 
     // Cleanup
-    free(pt1);
-    free(pt2);
     free(Congestion);
 }
 
@@ -478,7 +459,7 @@ draw_net_bbox(NET net) {
 	if (dpy == NULL) return;
 	if (net == NULL) return;
 	if (net->bbox == NULL) return;
-	if(net->bbox->num_edges<4) return;
+	if(net->bbox->num_vertices<4) return;
 
 	if(net->bbox_color) {
 		if(!strcmp(net->bbox_color,"green"))
@@ -492,46 +473,32 @@ draw_net_bbox(NET net) {
 	} else {
 		XSetForeground(dpy, gc, blackpix); // set box colour to black
 	}
-	if(net->bbox->edges) {
-		tx = net->bbox->edges->pt1->x;
-		ty = net->bbox->edges->pt1->y;
-	}
+	tx = net->bbox->x1;
+	ty = net->bbox->y1;
 	for(int shr=0;shr<SHRINK_NUMS;shr++) {
 		tb=shrink_bbox(net->bbox,shr);
 		if(!tb) continue;
-		for(BBOX_LINE line=tb->edges;line;line=line->next) {
-			if(!line) continue;
-			x1=line->pt1->x;
-			y1=line->pt1->y;
-			x2=line->pt2->x;
-			y2=line->pt2->y;
-			if(shr==0) {
-				if(x1<tx) tx=x1;
-				if(x2<tx) tx=x2;
-				if(y1<ty) ty=y1;
-				if(y2<ty) ty=y2;
-			}
+		for(int i=0;i<tb->num_vertices;i++) {
+			x1=tb->vertex[i].x;
+			y1=tb->vertex[i].y;
+			x2=tb->vertex[(i+1)%tb->num_vertices].x;
+			y2=tb->vertex[(i+1)%tb->num_vertices].y;
 			XDrawLine(dpy,buffer,gc,spacing*x1,height-spacing*y1,spacing*x2,height-spacing*y2);
 		}
-		free(tb);
+		free_bbox(tb);
 	}
 	if(net) if(net->netname)
 		XDrawString(dpy, buffer, gc, spacing*tx,height-spacing*ty,net->netname,strlen(net->netname));
 
 	// trunk box
-	POINT p1, p2;
 	int x0, y0, dx, dy;
 	if(drawTrunk) {
-	p1 = get_left_lower_trunk_point(net->bbox);
-	p2 = get_right_upper_trunk_point(net->bbox);
-	x0 = (p1->x)*spacing;
-	y0 = height-(p2->y)*spacing;
-	dx = (p2->x-p1->x)*spacing;
-	dy = (p2->y-p1->y)*spacing;
+	x0 = (net->bbox->x1)*spacing;
+	y0 = height-(net->bbox->y2)*spacing;
+	dx = (net->bbox->x2-net->bbox->x1)*spacing;
+	dy = (net->bbox->y2-net->bbox->y1)*spacing;
 	XSetForeground(dpy, gc, goldpix);
 	XDrawRectangle(dpy, buffer, gc, x0, y0, dx, dy);
-	free(p1);
-	free(p2);
 	}
 }
 
@@ -12,7 +12,7 @@
 void   highlight(int, int);
 void   highlight_source(NET net);
 void   highlight_dest(NET net);
-void   highlight_starts(POINT glist);
+void   highlight_starts(PQUEUE pq);
 void   highlight_mask(NET net);
 
 void   draw_net(NET net, u_char single, int *lastlayer);
@@ -0,0 +1,356 @@
+/*--------------------------------------------------------------*/
+/* hash.c --							*/
+/*								*/
+/* Open-addressing hash tables for name and number lookups.	*/
+/*								*/
+/* Instances, cell macros, layers and nets used to be found by	*/
+/* walking their lists and comparing every name (or number)	*/
+/* along the way, which made reading a large DEF file and the	*/
+/* collision checks of the router quadratic in the size of the	*/
+/* design.  These tables index the records instead, and they	*/
+/* do so the same way whether or not qrouter is compiled with	*/
+/* Tcl.								*/
+/*								*/
+/* Slots are probed linearly from the home slot of the hash.	*/
+/* The table doubles in size whenever it becomes half full, so	*/
+/* probe sequences stay short.  Names are not copied:  the key	*/
+/* of an entry is the name string of the record it points to,	*/
+/* which must stay put while the entry is in the table.		*/
+/*								*/
+/* Lookups do not modify the table, so any number of threads	*/
+/* may search a table at once as long as nobody is adding to	*/
+/* it.  Callers serialize additions.				*/
+/*								*/
+/* String tables are built on the same tables and intern the	*/
+/* names shared by many records.  They lock, as DEF records are	*/
+/* read on several threads at once.				*/
+/*--------------------------------------------------------------*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+
+#include <tcl.h>
+
+#include "qrouter.h"
+#include "hash.h"
+
+/* One block of a string table arena */
+
+struct strblock_ {
+    STRBLOCK next;
+    int size;			// Bytes of text[]
+    int used;			// Bytes of text[] handed out
+    char text[];
+};
+
+STRTABLE CellNames = {{HASH_STRING}};
+STRTABLE DesignNames = {{HASH_STRING}};
+
+TCL_DECLARE_MUTEX(strTableMutex)
+
+/*--------------------------------------------------------------*/
+/* Hash a name (FNV-1a), folding case for HASH_NOCASE tables.	*/
+/*--------------------------------------------------------------*/
+
+static u_int
+HashName(HASHTABLE *table, char *name)
+{
+    u_int hash = 2166136261U;
+    u_char *s;
+
+    if (table->keytype == HASH_NOCASE) {
+	for (s = (u_char *)name; *s; s++)
+	    hash = (hash ^ (u_int)tolower(*s)) * 16777619U;
+    }
+    else {
+	for (s = (u_char *)name; *s; s++)
+	    hash = (hash ^ (u_int)*s) * 16777619U;
+    }
+    return hash;
+}
+
+/*--------------------------------------------------------------*/
+/* Hash a number.  Net numbers are mostly consecutive;  the	*/
+/* multiply spreads them over the high bits and the shift	*/
+/* brings those back down to where the slot mask looks.		*/
+/*--------------------------------------------------------------*/
+
+static u_int
+HashNum(int num)
+{
+    u_int hash = (u_int)num * 2654435761U;
+
+    return hash ^ (hash >> 16);
+}
+
+/*--------------------------------------------------------------*/
+/* Compare the key of an entry with a name.			*/
+/*--------------------------------------------------------------*/
+
+static int
+HashSameName(HASHTABLE *table, HASHENTRY *he, u_int hash, char *name)
+{
+    if (he->hash != hash) return 0;
+    if (table->keytype == HASH_NOCASE)
+	return !strcasecmp(he->name, name);
+    else
+	return !strcmp(he->name, name);
+}
+
+/*--------------------------------------------------------------*/
+/* Double the number of slots (or make the first ones) and	*/
+/* put all entries back in their new home slots.		*/
+/*--------------------------------------------------------------*/
+
+static void
+HashGrow(HASHTABLE *table)
+{
+    HASHENTRY *old, *he;
+    int oldsize, newsize, i, s;
+
+    old = table->entry;
+    oldsize = table->size;
+    newsize = (oldsize == 0) ? HASH_MIN_SIZE : (oldsize << 1);
+
+    table->entry = (HASHENTRY *)calloc(newsize, sizeof(HASHENTRY));
+    if (table->entry == NULL) {
+	printf("%s: memory leak. dying!\n", __FUNCTION__);
+	exit(0);
+    }
+    table->size = newsize;
+
+    for (i = 0; i < oldsize; i++) {
+	he = &old[i];
+	if (he->value == NULL) continue;
+	s = he->hash & (newsize - 1);
+	while (table->entry[s].value != NULL)
+	    s = (s + 1) & (newsize - 1);
+	table->entry[s] = *he;
+    }
+    free(old);
+}
+
+/*--------------------------------------------------------------*/
+/* Return the record filed under "name", or NULL.		*/
+/*--------------------------------------------------------------*/
+
+void *
+HashFind(HASHTABLE *table, char *name)
+{
+    HASHENTRY *he;
+    u_int hash;
+    int s;
+
+    if ((table->count == 0) || (name == NULL)) return NULL;
+
+    hash = HashName(table, name);
+    s = hash & (table->size - 1);
+    for (he = &table->entry[s]; he->value != NULL; he = &table->entry[s]) {
+	if (HashSameName(table, he, hash, name))
+	    return he->value;
+	s = (s + 1) & (table->size - 1);
+    }
+    return NULL;
+}
+
+/*--------------------------------------------------------------*/
+/* File record "value" under "name", replacing any record	*/
+/* already filed under the same name.  "name" is kept by	*/
+/* reference and must not be freed while in the table.		*/
+/*--------------------------------------------------------------*/
+
+void
+HashAdd(HASHTABLE *table, char *name, void *value)
+{
+    HASHENTRY *he;
+    u_int hash;
+    int s;
+
+    if (2 * (table->count + 1) > table->size) HashGrow(table);
+
+    hash = HashName(table, name);
+    s = hash & (table->size - 1);
+    for (he = &table->entry[s]; he->value != NULL; he = &table->entry[s]) {
+	if (HashSameName(table, he, hash, name)) {
+	    he->name = name;
+	    he->value = value;
+	    return;
+	}
+	s = (s + 1) & (table->size - 1);
+    }
+    he->hash = hash;
+    he->name = name;
+    he->value = value;
+    table->count++;
+}
+
+/*--------------------------------------------------------------*/
+/* Return the record filed under number "num", or NULL.		*/
+/*--------------------------------------------------------------*/
+
+void *
+HashIntFind(HASHTABLE *table, int num)
+{
+    HASHENTRY *he;
+    u_int hash;
+    int s;
+
+    if (table->count == 0) return NULL;
+
+    hash = HashNum(num);
+    s = hash & (table->size - 1);
+    for (he = &table->entry[s]; he->value != NULL; he = &table->entry[s]) {
+	if (he->num == num)
+	    return he->value;
+	s = (s + 1) & (table->size - 1);
+    }
+    return NULL;
+}
+
+/*--------------------------------------------------------------*/
+/* File record "value" under number "num", replacing any	*/
+/* record already filed under the same number.			*/
+/*--------------------------------------------------------------*/
+
+void
+HashIntAdd(HASHTABLE *table, int num, void *value)
+{
+    HASHENTRY *he;
+    u_int hash;
+    int s;
+
+    if (2 * (table->count + 1) > table->size) HashGrow(table);
+
+    hash = HashNum(num);
+    s = hash & (table->size - 1);
+    for (he = &table->entry[s]; he->value != NULL; he = &table->entry[s]) {
+	if (he->num == num) {
+	    he->value = value;
+	    return;
+	}
+	s = (s + 1) & (table->size - 1);
+    }
+    he->hash = hash;
+    he->num = num;
+    he->value = value;
+    table->count++;
+}
+
+/*--------------------------------------------------------------*/
+/* Remove all entries and free the slots.  The table keeps its	*/
+/* key type and may be filled again.				*/
+/*--------------------------------------------------------------*/
+
+void
+HashKill(HASHTABLE *table)
+{
+    free(table->entry);
+    table->entry = NULL;
+    table->size = 0;
+    table->count = 0;
+}
+
+/*--------------------------------------------------------------*/
+/* Copy "name" into the arena of a string table.  A string too	*/
+/* long to share a block gets a block of its own behind the	*/
+/* current one, which stays open for the strings that follow.	*/
+/*--------------------------------------------------------------*/
+
+static char *
+StrStore(STRTABLE *table, char *name)
+{
+    STRBLOCK sb, nb;
+    int len, size;
+    char *s;
+
+    len = strlen(name) + 1;
+    sb = table->block;
+    if ((sb == NULL) || (sb->used + len > sb->size)) {
+	size = (len > STR_BLOCK_SIZE / 4) ? len : STR_BLOCK_SIZE;
+	nb = (STRBLOCK)malloc(sizeof(struct strblock_) + size);
+	if (nb == NULL) {
+	    printf("%s: memory leak. dying!\n", __FUNCTION__);
+	    exit(0);
+	}
+	nb->size = size;
+	nb->used = 0;
+	if ((sb != NULL) && (size == len)) {
+	    nb->next = sb->next;
+	    sb->next = nb;
+	}
+	else {
+	    nb->next = sb;
+	    table->block = nb;
+	}
+	sb = nb;
+    }
+    s = sb->text + sb->used;
+    memcpy(s, name, len);
+    sb->used += len;
+    return s;
+}
+
+/*--------------------------------------------------------------*/
+/* Return the copy of "name" kept by the string table, adding	*/
+/* it if it is not there yet.					*/
+/*--------------------------------------------------------------*/
+
+char *
+StrIntern(STRTABLE *table, char *name)
+{
+    char *s;
+
+    if (name == NULL) return NULL;
+
+    Tcl_MutexLock(&strTableMutex);
+    s = (char *)HashFind(&table->index, name);
+    if (s == NULL) {
+	s = StrStore(table, name);
+	HashAdd(&table->index, s, (void *)s);
+    }
+    Tcl_MutexUnlock(&strTableMutex);
+    return s;
+}
+
+/*--------------------------------------------------------------*/
+/* Return the copy of "name" kept by the string table, or NULL	*/
+/* if it has none.  Any string from the table that is equal to	*/
+/* "name" is this very pointer.					*/
+/*--------------------------------------------------------------*/
+
+char *
+StrFind(STRTABLE *table, char *name)
+{
+    char *s;
+
+    if (name == NULL) return NULL;
+
+    Tcl_MutexLock(&strTableMutex);
+    s = (char *)HashFind(&table->index, name);
+    Tcl_MutexUnlock(&strTableMutex);
+    return s;
+}
+
+/*--------------------------------------------------------------*/
+/* Free all strings of a string table.  Every pointer handed	*/
+/* out by the table becomes invalid.				*/
+/*--------------------------------------------------------------*/
+
+void
+StrKill(STRTABLE *table)
+{
+    STRBLOCK sb;
+
+    Tcl_MutexLock(&strTableMutex);
+    HashKill(&table->index);
+    while (table->block) {
+	sb = table->block;
+	table->block = sb->next;
+	free(sb);
+    }
+    Tcl_MutexUnlock(&strTableMutex);
+}
+
+/* end of hash.c */
@@ -0,0 +1,76 @@
+/*--------------------------------------------------------------*/
+/* hash.h --							*/
+/*								*/
+/* Open-addressing hash tables for name and number lookups	*/
+/* (header file)						*/
+/*--------------------------------------------------------------*/
+
+#ifndef HASH_H
+
+/* Key types.  A table holds keys of one type only.		*/
+#define HASH_STRING	0	/* Case-sensitive names		*/
+#define HASH_NOCASE	1	/* Case-insensitive names	*/
+#define HASH_INT	2	/* Integer numbers		*/
+
+/* Number of slots allocated on the first insertion.  Must be	*/
+/* a power of two.						*/
+#define HASH_MIN_SIZE	16
+
+typedef struct hashentry_ HASHENTRY;
+
+struct hashentry_ {
+    u_int hash;			// Full hash value of the key
+    int num;			// Key of HASH_INT tables
+    char *name;			// Key of name tables (not copied)
+    void *value;		// NULL if the slot is free
+};
+
+/* A table is declared with its key type as the only	*/
+/* initializer, e.g. "static HASHTABLE t = {HASH_STRING};"	*/
+
+typedef struct hashtable_ HASHTABLE;
+
+struct hashtable_ {
+    u_char keytype;
+    int size;			// Number of slots, zero or a power of 2
+    int count;			// Number of slots in use
+    HASHENTRY *entry;
+};
+
+/* A string table keeps one copy of each distinct string in	*/
+/* an arena, so that records can share names and equal names	*/
+/* compare equal by pointer.  The strings are only freed all at	*/
+/* once, by StrKill().  Declare as "STRTABLE t = {{HASH_STRING}};"	*/
+
+/* Arena blocks are this large, unless one string needs more	*/
+#define STR_BLOCK_SIZE	16384
+
+typedef struct strblock_ *STRBLOCK;
+
+typedef struct strtable_ STRTABLE;
+
+struct strtable_ {
+    HASHTABLE index;		// The strings, keyed by themselves
+    STRBLOCK block;		// Arena blocks, current one first
+};
+
+/* Names of cell macro pins, read from LEF or the config file	*/
+extern STRTABLE CellNames;
+
+/* Names of instances and nets of the design read from DEF,	*/
+/* freed by reinitialize()					*/
+extern STRTABLE DesignNames;
+
+void *HashFind(HASHTABLE *table, char *name);
+void  HashAdd(HASHTABLE *table, char *name, void *value);
+void *HashIntFind(HASHTABLE *table, int num);
+void  HashIntAdd(HASHTABLE *table, int num, void *value);
+void  HashKill(HASHTABLE *table);
+char *StrIntern(STRTABLE *table, char *name);
+char *StrFind(STRTABLE *table, char *name);
+void  StrKill(STRTABLE *table);
+
+#define HASH_H
+#endif
+
+/* end of hash.h */
@@ -27,21 +27,54 @@
 #include <stdarg.h>
 #include <sys/time.h>
 #include <math.h>
+#include <unistd.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/mman.h>
+
+#include <tcl.h>
 
 #include "qrouter.h"
 #include "node.h"
 #include "qconfig.h"
 #include "maze.h"
 #include "lef.h"
+#include "hash.h"
+#include "snapshot.h"
 
 /* ---------------------------------------------------------------------*/
 
-/* Current line number for reading */
-int lefCurrentLine;
+/* Current line number for reading (of the file read by this thread) */
+__thread int lefCurrentLine;
 
 /* Information about routing layers */
 LefList LefInfo;
 
+/* Hash tables indexing LefInfo by name and by layer number.	*/
+/* They are regenerated by the first lookup after a change.	*/
+static HASHTABLE LayerTable = {HASH_STRING};
+static HASHTABLE LayerNumTable = {HASH_INT};
+static volatile int lefLayerGen = 0;
+static volatile int lefLayerHashed = -1;
+TCL_DECLARE_MUTEX(lefLayerMutex)
+
+/* Cell macros in GateInfo, indexed by name */
+static HASHTABLE MacroTable = {HASH_NOCASE};
+
+/* Number of errors reported by LefError() */
+static int lefErrors = 0;
+
+/* Errors kept back by a worker thread (see LefDeferErrors()) */
+struct leferror_ {
+    LEFERROR next;
+    int line;
+    char msg[1];
+};
+
+static __thread u_char lefDeferring = FALSE;
+static __thread LEFERROR lefDeferred = NULL;
+static __thread LEFERROR *lefDeferTail = NULL;
+
 /* Gate information is in the linked list GateInfo, imported */
 
 /*---------------------------------------------------------
@@ -173,6 +206,500 @@ LookupFull(name, table)
 }
 
 
+/*
+ *------------------------------------------------------------
+ *
+ * Token readers --
+ *
+ *	Each input file is read through a LEFREADER holding the
+ *	whole file contents, either mapped with mmap() or, for
+ *	streams that cannot be mapped, read into memory.  Tokens
+ *	are returned as slices (pointer and length) into that
+ *	memory, so that nothing is copied until a caller needs a
+ *	NUL-terminated string.  All tokenizer state is kept in the
+ *	reader, so that more than one file may be read at a time.
+ *
+ *	Readers are found from the FILE pointer passed to
+ *	LefNextToken(), and created on first use.  A file read
+ *	with LefNextToken() must be closed with LefCloseFile().
+ *
+ *------------------------------------------------------------
+ */
+
+struct lefreader_ {
+    LEFREADER next;
+    FILE  *file;
+    char  *map;		/* Mapped or allocated file contents */
+    size_t mapsize;
+    u_char mapped;	/* TRUE if "map" came from mmap() */
+    char  *end;		/* End of the file contents */
+    char  *pos;		/* Start of the next unread line */
+    char  *line;	/* Start of the current line */
+    char  *eol;		/* End of the current line */
+    char  *nexttoken;	/* Next token on the line, or NULL */
+    int    lineno;	/* Number of lines read */
+    char  *copy;	/* NUL-terminated copy of the current line */
+    size_t copysize;
+};
+
+static LEFREADER LefReaders = NULL;
+static int lefReaderEpoch = 0;	/* Bumped whenever a reader is freed */
+TCL_DECLARE_MUTEX(lefReaderMutex)
+
+/* Last reader used by this thread, valid while the epoch matches */
+static __thread LEFREADER lefLastReader = NULL;
+static __thread int lefLastEpoch = -1;
+
+/* Part of a file being read by this thread (see LefBeginSpan()) */
+static __thread LEFREADER lefSpanReader = NULL;
+
+static char lefEolToken[] = "\n";
+
+/*--------------------------------------------------------------*/
+/* Create a reader for the open file "f", starting at the	*/
+/* current file position.					*/
+/*--------------------------------------------------------------*/
+
+static LEFREADER
+LefNewReader(FILE *f)
+{
+    LEFREADER r;
+    struct stat st;
+    long offset;
+    size_t len, n;
+    char *map = MAP_FAILED;
+
+    r = (LEFREADER)calloc(1, sizeof(struct lefreader_));
+    if (r == NULL) {
+	printf("%s: memory leak. dying!\n",__FUNCTION__);
+	exit(0);
+    }
+    r->file = f;
+
+    offset = ftell(f);
+    if ((offset >= 0) && (fstat(fileno(f), &st) == 0) && S_ISREG(st.st_mode)
+		&& (st.st_size > offset)) {
+	map = mmap(NULL, (size_t)st.st_size, PROT_READ, MAP_PRIVATE,
+		fileno(f), 0);
+	if (map != MAP_FAILED) {
+#ifdef MADV_SEQUENTIAL
+	    madvise(map, (size_t)st.st_size, MADV_SEQUENTIAL);
+#endif
+	    r->map = map;
+	    r->mapsize = (size_t)st.st_size;
+	    r->mapped = TRUE;
+	    r->pos = map + offset;
+	    r->end = map + st.st_size;
+	}
+    }
+
+    if (map == MAP_FAILED) {
+	/* Pipes and the like:  read the rest of the stream */
+	len = 0;
+	r->mapsize = 65536;
+	r->map = malloc(r->mapsize);
+	while (r->map != NULL) {
+	    n = fread(r->map + len, 1, r->mapsize - len, f);
+	    len += n;
+	    if (len < r->mapsize) break;
+	    r->mapsize *= 2;
+	    r->map = realloc(r->map, r->mapsize);
+	}
+	if (r->map == NULL) {
+	    printf("%s: memory leak. dying!\n",__FUNCTION__);
+	    exit(0);
+	}
+	r->pos = r->map;
+	r->end = r->map + len;
+    }
+    return r;
+}
+
+/*--------------------------------------------------------------*/
+/* Find the reader for file "f", creating it if needed.		*/
+/*--------------------------------------------------------------*/
+
+LEFREADER
+LefGetReader(FILE *f)
+{
+    LEFREADER r;
+
+    if ((lefSpanReader != NULL) && (lefSpanReader->file == f))
+	return lefSpanReader;
+
+    if ((lefLastReader != NULL) && (lefLastEpoch == lefReaderEpoch) &&
+		(lefLastReader->file == f))
+	return lefLastReader;
+
+    Tcl_MutexLock(&lefReaderMutex);
+    for (r = LefReaders; r; r = r->next)
+	if (r->file == f) break;
+    if (r == NULL) {
+	r = LefNewReader(f);
+	r->next = LefReaders;
+	LefReaders = r;
+    }
+    lefLastEpoch = lefReaderEpoch;
+    Tcl_MutexUnlock(&lefReaderMutex);
+
+    lefLastReader = r;
+    return r;
+}
+
+/*--------------------------------------------------------------*/
+/* Release the reader for file "f" (if any) and close the file.	*/
+/*--------------------------------------------------------------*/
+
+void
+LefCloseFile(FILE *f)
+{
+    LEFREADER r, *rp;
+
+    Tcl_MutexLock(&lefReaderMutex);
+    for (rp = &LefReaders; (r = *rp) != NULL; rp = &r->next)
+	if (r->file == f) break;
+    if (r != NULL) {
+	*rp = r->next;
+	lefReaderEpoch++;
+    }
+    Tcl_MutexUnlock(&lefReaderMutex);
+
+    if (r != NULL) {
+	if (r->mapped)
+	    munmap(r->map, r->mapsize);
+	else
+	    free(r->map);
+	free(r->copy);
+	free(r);
+    }
+    lefLastReader = NULL;
+    fclose(f);
+}
+
+/*--------------------------------------------------------------*/
+/* Return the whole text of file "f" as held by its reader,	*/
+/* and its length in "len".					*/
+/*--------------------------------------------------------------*/
+
+char *
+LefFileText(FILE *f, size_t *len)
+{
+    LEFREADER r;
+
+    r = LefGetReader(f);
+    *len = (size_t)(r->end - r->map);
+    return r->map;
+}
+
+/*--------------------------------------------------------------*/
+/* Return the position of the next unread token of file "f",	*/
+/* and in "lineno" the number of lines before it.  Either may	*/
+/* be passed to LefSeek() or LefBeginSpan().			*/
+/*--------------------------------------------------------------*/
+
+char *
+LefTell(FILE *f, int *lineno)
+{
+    LEFREADER r = LefGetReader(f);
+
+    if (r->nexttoken != NULL) {
+	*lineno = r->lineno - 1;
+	return r->nexttoken;
+    }
+    *lineno = r->lineno;
+    return r->pos;
+}
+
+/*--------------------------------------------------------------*/
+/* Continue reading file "f" at a position from LefTell().	*/
+/*--------------------------------------------------------------*/
+
+void
+LefSeek(FILE *f, char *pos, int lineno)
+{
+    LEFREADER r = LefGetReader(f);
+
+    r->pos = pos;
+    r->nexttoken = NULL;
+    r->lineno = lineno;
+    lefCurrentLine = lineno;
+}
+
+/*--------------------------------------------------------------*/
+/* Make this thread read file "f" from "start" up to "end",	*/
+/* positions found with LefTell(), until LefEndSpan() is	*/
+/* called.  Other threads may read other parts of the file at	*/
+/* the same time.  The file contents are shared, not copied.	*/
+/*--------------------------------------------------------------*/
+
+void
+LefBeginSpan(FILE *f, char *start, char *end, int lineno)
+{
+    LEFREADER r;
+
+    r = (LEFREADER)calloc(1, sizeof(struct lefreader_));
+    if (r == NULL) {
+	printf("%s: memory leak. dying!\n",__FUNCTION__);
+	exit(0);
+    }
+    r->file = f;
+    r->pos = start;
+    r->end = end;
+    r->lineno = lineno;
+    lefCurrentLine = lineno;
+    lefSpanReader = r;
+}
+
+void
+LefEndSpan(void)
+{
+    LEFREADER r = lefSpanReader;
+
+    if (r == NULL) return;
+    lefSpanReader = NULL;
+    free(r->copy);
+    free(r);
+}
+
+/*--------------------------------------------------------------*/
+/* Move to the next line holding a token.  Blank lines and	*/
+/* lines starting with a comment are skipped.  Returns FALSE at	*/
+/* the end of the file.						*/
+/*--------------------------------------------------------------*/
+
+static u_char
+lefNextLine(LEFREADER r)
+{
+    char *p, *nl, *eol;
+
+    while (r->pos < r->end) {
+	nl = memchr(r->pos, '\n', (size_t)(r->end - r->pos));
+	eol = (nl) ? nl : r->end;
+	r->lineno++;
+	r->line = p = r->pos;
+	r->pos = (nl) ? nl + 1 : r->end;
+
+	while ((p < eol) && isspace(*p)) p++;	/* skip leading whitespace */
+	if ((p < eol) && (*p != '#') && (*p != '\0')) {
+	    r->eol = eol;
+	    r->nexttoken = p;
+	    return TRUE;
+	}
+    }
+    return FALSE;
+}
+
+/*
+ *------------------------------------------------------------
+ *
+ * LefNextSlice --
+ *
+ *	Move to the next token read by "r".  This works like
+ *	LefNextToken() but does not copy the token.  Its length
+ *	is returned in "len".
+ *
+ * Results:
+ *	Pointer to the start of the next token in the file
+ *	contents (not NUL-terminated), or NULL at end of file.
+ *	End-of-line is returned as the string "\n".
+ *
+ * Side Effects:
+ *	May move the reader to a new line.
+ *
+ *------------------------------------------------------------
+ */
+
+char *
+LefNextSlice(LEFREADER r, u_char ignore_eol, int *len)
+{
+    char *curtoken, *p, *nl;
+
+    if (r->nexttoken == NULL) {
+	if (!lefNextLine(r)) return NULL;
+	if (!ignore_eol) {
+	    *len = 1;
+	    return lefEolToken;
+	}
+    }
+    curtoken = p = r->nexttoken;
+
+    /* Treat quoted material as a single token, which may span lines */
+
+    if (*p == '\"') {
+	p++;
+	while ((p < r->end) && ((*p != '\"') || (*(p - 1) == '\\')) &&
+		(*p != '\0')) {
+	    if (*p == '\n') r->lineno++;
+	    p++;
+	}
+	if ((p < r->end) && (*p == '\"'))
+	    p++;
+	if (p > r->eol) {
+	    nl = memchr(p, '\n', (size_t)(r->end - p));
+	    r->eol = (nl) ? nl : r->end;
+	    r->pos = (nl) ? nl + 1 : r->end;
+	}
+    }
+    else {
+	while ((p < r->eol) && !isspace(*p) && (*p != '\0'))
+	    p++;
+    }
+    *len = (int)(p - curtoken);
+
+    while ((p < r->eol) && isspace(*p))
+	p++;		/* skip any whitespace */
+
+    if ((p >= r->eol) || (*p == '#') || (*p == '\0'))
+	r->nexttoken = NULL;
+    else
+	r->nexttoken = p;
+
+    return curtoken;
+}
+
+/*--------------------------------------------------------------*/
+/* Fast number parsing.  Decimal numbers whose digits and	*/
+/* exponent fit in an exactly representable value are		*/
+/* converted with a single rounding (and so give the same	*/
+/* result as strtod());  anything else is passed on to		*/
+/* strtod().  As with sscanf(), a number followed by other	*/
+/* characters is accepted.  Returns TRUE if a number was read;	*/
+/* otherwise the value is left unchanged.			*/
+/*--------------------------------------------------------------*/
+
+static const double lefPow10[] = {
+    1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11,
+    1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22
+};
+
+static const float lefPow10f[] = {
+    1e0f, 1e1f, 1e2f, 1e3f, 1e4f, 1e5f, 1e6f, 1e7f, 1e8f, 1e9f, 1e10f
+};
+
+/* Split a decimal number into mantissa and power of ten.	*/
+/* Returns FALSE if the number needs the general conversion.	*/
+
+static u_char
+lefScanDecimal(const char *s, int len, u_char *neg, unsigned long long *mant,
+		int *exp10)
+{
+    const char *p = s, *end = s + len;
+    unsigned long long m = 0;
+    int ndigits = 0, e = 0, x = 0;
+    u_char xneg = FALSE;
+
+    *neg = FALSE;
+    if ((p < end) && ((*p == '-') || (*p == '+'))) {
+	*neg = (*p == '-');
+	p++;
+    }
+    for (; (p < end) && isdigit(*p); p++, ndigits++) {
+	if (m >= 100000000000000000ULL) return FALSE;
+	m = m * 10 + (*p - '0');
+    }
+    if ((p < end) && (*p == '.')) {
+	for (p++; (p < end) && isdigit(*p); p++, ndigits++, e--) {
+	    if (m >= 100000000000000000ULL) return FALSE;
+	    m = m * 10 + (*p - '0');
+	}
+    }
+    if (ndigits == 0) return FALSE;
+
+    if ((p < end) && ((*p == 'e') || (*p == 'E'))) {
+	p++;
+	if ((p < end) && ((*p == '-') || (*p == '+'))) {
+	    xneg = (*p == '-');
+	    p++;
+	}
+	if ((p >= end) || !isdigit(*p)) return FALSE;
+	for (; (p < end) && isdigit(*p); p++) {
+	    if (x > 1000) return FALSE;
+	    x = x * 10 + (*p - '0');
+	}
+	e += (xneg) ? -x : x;
+    }
+
+    /* Trailing material (hex digits, "inf", etc.) goes to strtod() */
+    if ((p < end) && isalnum(*p)) return FALSE;
+
+    *mant = m;
+    *exp10 = e;
+    return TRUE;
+}
+
+/* General conversion:  strtod() wants a NUL-terminated string */
+
+static u_char
+lefStrtod(const char *s, int len, double *dval)
+{
+    char buf[64], *endp;
+    double d;
+
+    if (len >= (int)sizeof(buf)) len = sizeof(buf) - 1;
+    memcpy(buf, s, len);
+    buf[len] = '\0';
+    d = strtod(buf, &endp);
+    if (endp == buf) return FALSE;
+    *dval = d;
+    return TRUE;
+}
+
+u_char
+LefSliceDouble(const char *s, int len, double *dval)
+{
+    unsigned long long m;
+    int e;
+    u_char neg;
+    double d;
+
+    if (lefScanDecimal(s, len, &neg, &m, &e) && (m < (1ULL << 53))
+		&& (e >= -22) && (e <= 22)) {
+	d = (double)m;
+	d = (e < 0) ? d / lefPow10[-e] : d * lefPow10[e];
+	*dval = (neg) ? -d : d;
+	return TRUE;
+    }
+    return lefStrtod(s, len, dval);
+}
+
+u_char
+LefSliceFloat(const char *s, int len, float *fval)
+{
+    unsigned long long m;
+    int e;
+    u_char neg;
+    float f;
+    char buf[64], *endp;
+
+    if (lefScanDecimal(s, len, &neg, &m, &e) && (m < (1ULL << 24))
+		&& (e >= -10) && (e <= 10)) {
+	f = (float)m;
+	f = (e < 0) ? f / lefPow10f[-e] : f * lefPow10f[e];
+	*fval = (neg) ? -f : f;
+	return TRUE;
+    }
+
+    if (len >= (int)sizeof(buf)) len = sizeof(buf) - 1;
+    memcpy(buf, s, len);
+    buf[len] = '\0';
+    f = strtof(buf, &endp);
+    if (endp == buf) return FALSE;
+    *fval = f;
+    return TRUE;
+}
+
+u_char
+LefParseDouble(char *token, double *dval)
+{
+    return LefSliceDouble(token, strlen(token), dval);
+}
+
+u_char
+LefParseFloat(char *token, float *fval)
+{
+    return LefSliceFloat(token, strlen(token), fval);
+}
+
 /*
  *------------------------------------------------------------
  *
@@ -200,67 +727,30 @@ LookupFull(name, table)
 char *
 LefNextToken(FILE *f, u_char ignore_eol)
 {
-    static char line[LEF_LINE_MAX + 2];	/* input buffer */
-    static char *nexttoken = NULL;	/* pointer to next token */
-    static char *curtoken;		/* pointer to current token */
-    static char eol_token='\n';
-
-    /* Read a new line if necessary */
-
-    if (nexttoken == NULL)
-    {
-	for(;;)
-	{
-	    if (fgets(line, LEF_LINE_MAX + 1, f) == NULL) return NULL;
-	    lefCurrentLine++;
-	    curtoken = line;
-	    while (isspace(*curtoken) && (*curtoken != '\n') && (*curtoken != '\0'))
-		curtoken++;		/* skip leading whitespace */
-
-	    if ((*curtoken != '#') && (*curtoken != '\n') && (*curtoken != '\0'))
-	    {
-		nexttoken = curtoken;
-		break;
-	    }
-	}
-	if (!ignore_eol)
-	    return &eol_token;
-    }
-    else
-	curtoken = nexttoken;
-
-    /* Find the next token; set to NULL if none (end-of-line). */
-    /* Treat quoted material as a single token */
-
-    if (*nexttoken == '\"') {
-	nexttoken++;
-	while (((*nexttoken != '\"') || (*(nexttoken - 1) == '\\')) &&
-		(*nexttoken != '\0')) {
-	    if (*nexttoken == '\n') { 	
-		if (fgets(nexttoken + 1, LEF_LINE_MAX -
-				(size_t)(nexttoken - line), f) == NULL)
-		    return NULL;
-	    }
-	    nexttoken++;	/* skip all in quotes (move past current token) */
+    LEFREADER r = LefGetReader(f);
+    char *token;
+    int len;
+    size_t offset;
+
+    token = LefNextSlice(r, ignore_eol, &len);
+    lefCurrentLine = r->lineno;
+    if ((token == NULL) || (token == lefEolToken)) return token;
+
+    /* Tokens are copied to the same offset in a copy of the line,	*/
+    /* so that earlier tokens from the line remain valid.		*/
+
+    offset = (size_t)(token - r->line);
+    if ((size_t)(r->eol - r->line) + 1 > r->copysize) {
+	r->copysize = (size_t)(r->eol - r->line) + 1;
+	r->copy = realloc(r->copy, r->copysize);
+	if (r->copy == NULL) {
+	    printf("%s: memory leak. dying!\n",__FUNCTION__);
+	    exit(0);
 	}
-	if (*nexttoken == '\"')
-	    nexttoken++;
     }
-    else {
-	while (!isspace(*nexttoken) && (*nexttoken != '\0') && (*nexttoken != '\n'))
-	    nexttoken++;	/* skip non-whitespace (move past current token) */
-    }
-
-    /* Terminate the current token */
-    if (*nexttoken != '\0') *nexttoken++ = '\0';
-
-    while (isspace(*nexttoken) && (*nexttoken != '\0') && (*nexttoken != '\n'))
-	nexttoken++;	/* skip any whitespace */
-
-    if ((*nexttoken == '#') || (*nexttoken == '\n') || (*nexttoken == '\0'))
-	nexttoken = NULL;
-
-    return curtoken;
+    memcpy(r->copy + offset, token, len);
+    r->copy[offset + len] = '\0';
+    return r->copy + offset;
 }
 
 /*
@@ -283,23 +773,45 @@ LefNextToken(FILE *f, u_char ignore_eol)
 void
 LefError(char *fmt, ...)
 {  
-    static int errors = 0;
     va_list args;
+    LEFERROR e;
+    int len;
 
     if (Verbose == 0) return;
 
     if (fmt == NULL)  /* Special case:  report any errors and reset */
     {
-	if (errors)
+	if (lefErrors)
 	{
 	    Fprintf(stdout, "LEF Read: encountered %d error%s total.\n",
-			errors, (errors == 1) ? "" : "s");
-	    errors = 0;
+			lefErrors, (lefErrors == 1) ? "" : "s");
+	    lefErrors = 0;
 	}
 	return;
     }
 
-    if (errors < LEF_MAX_ERRORS)
+    if (lefDeferring)
+    {
+	/* Keep the message for LefReplayErrors() */
+	va_start(args, fmt);
+	len = vsnprintf(NULL, 0, fmt, args);
+	va_end(args);
+	e = (LEFERROR)malloc(sizeof(struct leferror_) + len);
+	if (e == NULL) {
+	    printf("%s: memory leak. dying!\n",__FUNCTION__);
+	    exit(0);
+	}
+	e->next = NULL;
+	e->line = lefCurrentLine;
+	va_start(args, fmt);
+	vsnprintf(e->msg, len + 1, fmt, args);
+	va_end(args);
+	*lefDeferTail = e;
+	lefDeferTail = &e->next;
+	return;
+    }
+
+    if (lefErrors < LEF_MAX_ERRORS)
     {
 	Fprintf(stderr, "LEF Read, Line %d: ", lefCurrentLine);
 	va_start(args, fmt);
@@ -307,10 +819,73 @@ LefError(char *fmt, ...)
 	va_end(args);
 	Flush(stderr);
     }
-    else if (errors == LEF_MAX_ERRORS)
+    else if (lefErrors == LEF_MAX_ERRORS)
 	Fprintf(stderr, "LEF Read:  Further errors will not be reported.\n");
 
-    errors++;
+    lefErrors++;
+}
+
+/*
+ *------------------------------------------------------------
+ *
+ * LefDeferErrors, LefTakeErrors, LefReplayErrors --
+ *
+ *	Worker threads reading part of a file cannot print.
+ *	Between LefDeferErrors() and LefTakeErrors(), errors
+ *	found by this thread are kept instead, and returned in
+ *	order by LefTakeErrors().  LefReplayErrors() reports
+ *	them (from the main thread) as LefError() would have,
+ *	and frees them;  LefFreeErrors() just frees them.
+ *
+ *------------------------------------------------------------
+ */
+
+void
+LefDeferErrors(void)
+{
+    lefDeferred = NULL;
+    lefDeferTail = &lefDeferred;
+    lefDeferring = TRUE;
+}
+
+LEFERROR
+LefTakeErrors(void)
+{
+    LEFERROR e = lefDeferred;
+
+    lefDeferred = NULL;
+    lefDeferring = FALSE;
+    return e;
+}
+
+void
+LefFreeErrors(LEFERROR e)
+{
+    LEFERROR next;
+
+    for (; e; e = next) {
+	next = e->next;
+	free(e);
+    }
+}
+
+void
+LefReplayErrors(LEFERROR e)
+{
+    LEFERROR next;
+
+    for (; e; e = next) {
+	next = e->next;
+	if (lefErrors < LEF_MAX_ERRORS)
+	{
+	    Fprintf(stderr, "LEF Read, Line %d: %s", e->line, e->msg);
+	    Flush(stderr);
+	}
+	else if (lefErrors == LEF_MAX_ERRORS)
+	    Fprintf(stderr, "LEF Read:  Further errors will not be reported.\n");
+	lefErrors++;
+	free(e);
+    }
 }
 
 /*
@@ -428,14 +1003,50 @@ LefSkipSection(FILE *f, char *section)
 
 GATE
 lefFindCell(char *name)
+{
+    return (GATE)HashFind(&MacroTable, name);
+}
+
+/*
+ *------------------------------------------------------------
+ *
+ * LefHashCell --
+ *
+ *	Enter a cell just prepended to the GateInfo list into
+ *	the macro hash table.  The table is case-insensitive
+ *	and, like a search of the list, finds the most recently
+ *	added of several cells whose names differ only in case.
+ *
+ *------------------------------------------------------------
+ */
+
+void
+LefHashCell(GATE gateginfo)
+{
+    HashAdd(&MacroTable, gateginfo->gatename, (void *)gateginfo);
+}
+
+/*
+ *------------------------------------------------------------
+ *
+ * LefHashCells --
+ *
+ *	Regenerate the macro hash table from the GateInfo list.
+ *	Called after cells have been renamed, or after the list
+ *	has been reset.
+ *
+ *------------------------------------------------------------
+ */
+
+void
+LefHashCells(void)
 {
     GATE gateginfo;
 
-    for (gateginfo = GateInfo; gateginfo; gateginfo = gateginfo->next) { 
-	if (!strcasecmp(gateginfo->gatename, name))
-	    return gateginfo;
-    }
-    return (GATE)NULL;
+    HashKill(&MacroTable);
+    for (gateginfo = GateInfo; gateginfo; gateginfo = gateginfo->next)
+	if (HashFind(&MacroTable, gateginfo->gatename) == NULL)
+	    HashAdd(&MacroTable, gateginfo->gatename, (void *)gateginfo);
 }
 
 /*
@@ -540,10 +1151,54 @@ LefRedefined(LefList lefl, char *redefname)
     newlefl->info.via.area.layer = -1;
     newlefl->info.via.cell = (GATE)NULL;
     newlefl->info.via.lr = (DSEG)NULL;
+    LefLayerChanged();
 
     return newlefl;
 }
 
+/*
+ *------------------------------------------------------------
+ * Note that a layer record has been added to LefInfo, or
+ * that its name or layer number has changed.  The layer
+ * hash tables are regenerated on the next lookup.
+ *------------------------------------------------------------
+ */
+
+void
+LefLayerChanged(void)
+{
+    lefLayerGen++;
+}
+
+/*
+ *------------------------------------------------------------
+ * Regenerate the layer hash tables from LefInfo if it has
+ * changed.  Where several records share a name or a layer
+ * number, the first one in the list is entered, which is
+ * the one that a search of the list would find.
+ *------------------------------------------------------------
+ */
+
+static void
+LefHashLayers(void)
+{
+    LefList lefl;
+
+    Tcl_MutexLock(&lefLayerMutex);
+    if (lefLayerHashed != lefLayerGen) {
+	HashKill(&LayerTable);
+	HashKill(&LayerNumTable);
+	for (lefl = LefInfo; lefl; lefl = lefl->next) {
+	    if (HashFind(&LayerTable, lefl->lefName) == NULL)
+		HashAdd(&LayerTable, lefl->lefName, (void *)lefl);
+	    if (HashIntFind(&LayerNumTable, lefl->type) == NULL)
+		HashIntAdd(&LayerNumTable, lefl->type, (void *)lefl);
+	}
+	lefLayerHashed = lefLayerGen;
+    }
+    Tcl_MutexUnlock(&lefLayerMutex);
+}
+
 /*
  *------------------------------------------------------------
  * Find a layer record in the list of layers
@@ -553,17 +1208,9 @@ LefRedefined(LefList lefl, char *redefname)
 LefList
 LefFindLayer(char *token)
 {
-    LefList lefl, rlefl;
-   
     if (token == NULL) return NULL;
-    rlefl = (LefList)NULL;
-    for (lefl = LefInfo; lefl; lefl = lefl->next) {
-	if (!strcmp(lefl->lefName, token)) {
-	   rlefl = lefl;
-	   break;
-	}
-    }
-    return rlefl;
+    if (lefLayerHashed != lefLayerGen) LefHashLayers();
+    return (LefList)HashFind(&LayerTable, token);
 }
 	
 /*
@@ -575,16 +1222,8 @@ LefFindLayer(char *token)
 LefList
 LefFindLayerByNum(int layer)
 {
-    LefList lefl, rlefl;
-   
-    rlefl = (LefList)NULL;
-    for (lefl = LefInfo; lefl; lefl = lefl->next) {
-	if (lefl->type == layer) {
-	   rlefl = lefl;
-	   break;
-	}
-    }
-    return rlefl;
+    if (lefLayerHashed != lefLayerGen) LefHashLayers();
+    return (LefList)HashIntFind(&LayerNumTable, layer);
 }
 	
 /*
@@ -1076,9 +1715,9 @@ LefReadRect(FILE *f, int curlayer, float oscale)
 	token = LefNextToken(f, TRUE);
 	needMatch = TRUE;
     }
-    if (!token || sscanf(token, "%f", &llx) != 1) goto parse_error;
+    if (!token || !LefParseFloat(token, &llx)) goto parse_error;
     token = LefNextToken(f, TRUE);
-    if (!token || sscanf(token, "%f", &lly) != 1) goto parse_error;
+    if (!token || !LefParseFloat(token, &lly)) goto parse_error;
     token = LefNextToken(f, TRUE);
     if (needMatch)
     {
@@ -1091,9 +1730,9 @@ LefReadRect(FILE *f, int curlayer, float oscale)
 	token = LefNextToken(f, TRUE);
 	needMatch = TRUE;
     }
-    if (!token || sscanf(token, "%f", &urx) != 1) goto parse_error;
+    if (!token || !LefParseFloat(token, &urx)) goto parse_error;
     token = LefNextToken(f, TRUE);
-    if (!token || sscanf(token, "%f", &ury) != 1) goto parse_error;
+    if (!token || !LefParseFloat(token, &ury)) goto parse_error;
     if (needMatch)
     {
 	token = LefNextToken(f, TRUE);
@@ -1411,7 +2050,7 @@ LefReadPolygon(FILE *f, int curlayer, float oscale)
     {
 	token = LefNextToken(f, TRUE);
 	if (token == NULL || *token == ';') break;
-	if (sscanf(token, "%lg", &px) != 1)
+	if (!LefParseDouble(token, &px))
 	{
 	    LefError("Bad X value in polygon.\n");
 	    LefEndStatement(f);
@@ -1424,7 +2063,7 @@ LefReadPolygon(FILE *f, int curlayer, float oscale)
 	    LefError("Missing Y value in polygon point!\n");
 	    break;
 	}
-	if (sscanf(token, "%lg", &py) != 1)
+	if (!LefParseDouble(token, &py))
 	{
 	    LefError("Bad Y value in polygon.\n");
 	    LefEndStatement(f);
@@ -1594,7 +2233,7 @@ LefReadPort(lefMacro, f, pinName, pinNum, pinDir, pinUse, oscale)
 	lefMacro->direction[pinNum] = pinDir;
 	lefMacro->netnum[pinNum] = -1;
         if (pinName != NULL)
-            lefMacro->node[pinNum] = strdup(pinName);
+            lefMacro->node[pinNum] = StrIntern(&CellNames, pinName);
         else
 	    lefMacro->node[pinNum] = NULL;
     }
@@ -1834,6 +2473,7 @@ LefReadMacro(f, mname, oscale)
 		"Renaming original cell \"%s\"\n", mname, newname);
 
 	lefMacro->gatename = strdup(newname);
+	LefHashCells();
 	lefMacro = lefFindCell(mname);
     }
 
@@ -1861,6 +2501,7 @@ LefReadMacro(f, mname, oscale)
     lefMacro->node[0] = NULL;
     lefMacro->netnum[0] = -1;
     GateInfo = lefMacro;
+    LefHashCell(lefMacro);
 
 
     /* Initial values */
@@ -1889,11 +2530,11 @@ LefReadMacro(f, mname, oscale)
 		break;
 	    case LEF_SIZE:
 		token = LefNextToken(f, TRUE);
-		if (!token || sscanf(token, "%f", &x) != 1) goto size_error;
+		if (!token || !LefParseFloat(token, &x)) goto size_error;
 		token = LefNextToken(f, TRUE);		/* skip keyword "BY" */
 		if (!token) goto size_error;
 		token = LefNextToken(f, TRUE);
-		if (!token || sscanf(token, "%f", &y) != 1) goto size_error;
+		if (!token || !LefParseFloat(token, &y)) goto size_error;
 
 		lefBBox.x2 = x + lefBBox.x1;
 		lefBBox.y2 = y + lefBBox.y1;
@@ -1906,9 +2547,9 @@ size_error:
 		break;
 	    case LEF_ORIGIN:
 		token = LefNextToken(f, TRUE);
-		if (!token || sscanf(token, "%f", &x) != 1) goto origin_error;
+		if (!token || !LefParseFloat(token, &x)) goto origin_error;
 		token = LefNextToken(f, TRUE);
-		if (!token || sscanf(token, "%f", &y) != 1) goto origin_error;
+		if (!token || !LefParseFloat(token, &y)) goto origin_error;
 
 		lefBBox.x1 = -x;
 		lefBBox.y1 = -y;
@@ -2161,6 +2802,9 @@ LefReadLayerSection(f, lname, mode, lefl)
 			// been specified and needs to be set to default.
 			lefl->info.route.offset = -1.0;
 			lefl->info.route.hdirection = (u_char)0;
+			lefl->info.route.respersq = 0.0;
+			lefl->info.route.areacap = 0.0;
+			lefl->info.route.edgecap = 0.0;
 
 			/* A routing type has been declared.  Assume	*/
 			/* this takes the name "metal1", "M1", or some	*/
@@ -2188,6 +2832,7 @@ LefReadLayerSection(f, lname, mode, lefl)
 			if (lefl->type < 0) {
 			    lefl->type = LefGetMaxLayer();
 			}
+			LefLayerChanged();
 		    }
 		    else if (typekey == CLASS_VIA) {
 			lefl->info.via.area.x1 = 0.0;
@@ -2197,6 +2842,7 @@ LefReadLayerSection(f, lname, mode, lefl)
 			lefl->info.via.area.layer = -1;
 			lefl->info.via.cell = (GATE)NULL;
 			lefl->info.via.lr = (DSEG)NULL;
+			lefl->info.via.respervia = 0.0;
 		    }
 		}
 		else if (lefl->lefClass != typekey) {
@@ -2208,13 +2854,13 @@ LefReadLayerSection(f, lname, mode, lefl)
 		break;
 	    case LEF_LAYER_WIDTH:
 		token = LefNextToken(f, TRUE);
-		sscanf(token, "%lg", &dvalue);
+		LefParseDouble(token, &dvalue);
 		lefl->info.route.width = dvalue / (double)oscale;
 		LefEndStatement(f);
 		break;
 	    case LEF_LAYER_SPACING:
 		token = LefNextToken(f, TRUE);
-		sscanf(token, "%lg", &dvalue);
+		LefParseDouble(token, &dvalue);
 		token = LefNextToken(f, TRUE);
 		typekey = Lookup(token, spacing_keys);
 
@@ -2232,7 +2878,7 @@ LefReadLayerSection(f, lname, mode, lefl)
 		    // the spacing order.
 		    newrule->spacing = dvalue / (double)oscale;
 		    token = LefNextToken(f, TRUE);
-		    sscanf(token, "%lg", &dvalue);
+		    LefParseDouble(token, &dvalue);
 		    newrule->width = dvalue / (double)oscale;
 		    for (testrule = lefl->info.route.spacing; testrule;
 				testrule = testrule->next)
@@ -2271,13 +2917,13 @@ LefReadLayerSection(f, lname, mode, lefl)
 
 		while (*token != ';') {
 		    token = LefNextToken(f, TRUE);	// Minimum width value
-		    sscanf(token, "%lg", &dvalue);
+		    LefParseDouble(token, &dvalue);
 		    newrule->width = dvalue / (double)oscale;
 
 		    for (i = 0; i < entries; i++) {
 			token = LefNextToken(f, TRUE);	// Spacing value
 		    }
-		    sscanf(token, "%lg", &dvalue);
+		    LefParseDouble(token, &dvalue);
 		    newrule->spacing = dvalue / (double)oscale;
 		    token = LefNextToken(f, TRUE);
 
@@ -2301,7 +2947,7 @@ LefReadLayerSection(f, lname, mode, lefl)
 		break;
 	    case LEF_LAYER_PITCH:
 		token = LefNextToken(f, TRUE);
-		sscanf(token, "%lg", &dvalue);
+		LefParseDouble(token, &dvalue);
 		lefl->info.route.pitch = dvalue / (double)oscale;
 
 		/* Offset default is 1/2 the pitch.  Offset is		*/
@@ -2319,7 +2965,7 @@ LefReadLayerSection(f, lname, mode, lefl)
 		break;
 	    case LEF_LAYER_OFFSET:
 		token = LefNextToken(f, TRUE);
-		sscanf(token, "%lg", &dvalue);
+		LefParseDouble(token, &dvalue);
 		lefl->info.route.offset = dvalue / (double)oscale;
 		LefEndStatement(f);
 		break;
@@ -2328,13 +2974,13 @@ LefReadLayerSection(f, lname, mode, lefl)
 		if (lefl->lefClass == CLASS_ROUTE) {
 		    if (!strcmp(token, "RPERSQ")) {
 			token = LefNextToken(f, TRUE);
-			sscanf(token, "%lg", &dvalue);
+			LefParseDouble(token, &dvalue);
 			// Units are ohms per square
 			lefl->info.route.respersq = dvalue;
 		    }
 		}
 		else if (lefl->lefClass == CLASS_VIA) {
-		    sscanf(token, "%lg", &dvalue);
+		    LefParseDouble(token, &dvalue);
 		    lefl->info.via.respervia = dvalue;	// Units ohms
 		}
 		LefEndStatement(f);
@@ -2344,7 +2990,7 @@ LefReadLayerSection(f, lname, mode, lefl)
 		if (lefl->lefClass == CLASS_ROUTE) {
 		    if (!strcmp(token, "CPERSQDIST")) {
 			token = LefNextToken(f, TRUE);
-			sscanf(token, "%lg", &dvalue);
+			LefParseDouble(token, &dvalue);
 			// Units are pF per squared unit length
 			lefl->info.route.areacap = dvalue / 
 				((double)oscale * (double)oscale);
@@ -2355,7 +3001,7 @@ LefReadLayerSection(f, lname, mode, lefl)
 	    case LEF_LAYER_EDGECAP:
 		token = LefNextToken(f, TRUE);
 		if (lefl->lefClass == CLASS_ROUTE) {
-		    sscanf(token, "%lg", &dvalue);
+		    LefParseDouble(token, &dvalue);
 		    // Units are pF per unit length
 		    lefl->info.route.edgecap = dvalue / (double)oscale;
 		}
@@ -2421,8 +3067,9 @@ LefRead(inName)
 {
     FILE *f;
     char filename[256];
-    char *token;
+    char *token, *text;
     char tsave[128];
+    size_t textlen;
     int keyword, layer;
     int oprecis = 100;	// = 1 / manufacturing grid (microns)
     float oscale;
@@ -2500,7 +3147,7 @@ LefRead(inName)
 		break;
 	    case LEF_MANUFACTURINGGRID:
 		token = LefNextToken(f, TRUE);
-		if (sscanf(token, "%lg", &ogrid) == 1)
+		if (LefParseDouble(token, &ogrid))
 		    oprecis = (int)((1.0 / ogrid) + 0.5);
 		LefEndStatement(f);
 		break;
@@ -2533,6 +3180,7 @@ LefRead(inName)
 
 		    lefl->next = LefInfo;
 		    LefInfo = lefl;
+		    LefLayerChanged();
 
 		    LefReadLayerSection(f, tsave, keyword, lefl);
 		}
@@ -2564,6 +3212,7 @@ LefRead(inName)
 		    lefl->lefName = strdup(token);
 		    lefl->next = LefInfo;
 		    LefInfo = lefl;
+		    LefLayerChanged();
 		}
 		else
 		{
@@ -2633,14 +3282,15 @@ LefRead(inName)
     }
 
     /* Cleanup */
-    if (f != NULL) fclose(f);
+    if (f != NULL) {
+	text = LefFileText(f, &textlen);
+	snapshot_input(SNAP_LEF, text, textlen);
+	LefCloseFile(f);
+    }
 
     /* Make sure that the gate list has one entry called "pin" */
 
-    for (gateginfo = GateInfo; gateginfo; gateginfo = gateginfo->next)
-	if (!strcasecmp(gateginfo->gatename, "pin"))
-	    break;
-
+    gateginfo = lefFindCell("pin");
     if (!gateginfo) {
 	/* Add a new GateInfo entry for pseudo-gate "pin" */
 	gateginfo = (GATE)malloc(sizeof(struct gate_));
@@ -2668,8 +3318,9 @@ LefRead(inName)
 	gateginfo->taps[0] = grect;
         gateginfo->noderec[0] = NULL;
         gateginfo->netnum[0] = -1;
-	gateginfo->node[0] = strdup("pin");
+	gateginfo->node[0] = StrIntern(&CellNames, "pin");
 	GateInfo = gateginfo;
+	LefHashCell(gateginfo);
     }
     PinMacro = gateginfo;
 
@@ -106,8 +106,14 @@ typedef struct _lefLayer {
     } info;
 } lefLayer;
 
+/* Tokenizer state for one input file (see lef.c) */
+typedef struct lefreader_ *LEFREADER;
+
+/* Error messages kept back by a worker thread (see lef.c) */
+typedef struct leferror_ *LEFERROR;
+
 /* External declaration of global variables */
-extern int lefCurrentLine;
+extern __thread int lefCurrentLine;
 extern LefList LefInfo;
 
 /* Forward declarations */
@@ -118,7 +124,25 @@ u_char LefParseEndStatement(FILE *f, char *match);
 void  LefSkipSection(FILE *f, char *match);
 void  LefEndStatement(FILE *f);
 GATE  lefFindCell(char *name);
+void  LefHashCell(GATE gateginfo);
+void  LefHashCells(void);
 char *LefNextToken(FILE *f, u_char ignore_eol);
+LEFREADER LefGetReader(FILE *f);
+char *LefNextSlice(LEFREADER r, u_char ignore_eol, int *len);
+void  LefCloseFile(FILE *f);
+char *LefFileText(FILE *f, size_t *len);
+char *LefTell(FILE *f, int *lineno);
+void  LefSeek(FILE *f, char *pos, int lineno);
+void  LefBeginSpan(FILE *f, char *start, char *end, int lineno);
+void  LefEndSpan(void);
+void  LefDeferErrors(void);
+LEFERROR LefTakeErrors(void);
+void  LefReplayErrors(LEFERROR e);
+void  LefFreeErrors(LEFERROR e);
+u_char LefSliceDouble(const char *s, int len, double *dval);
+u_char LefSliceFloat(const char *s, int len, float *fval);
+u_char LefParseDouble(char *token, double *dval);
+u_char LefParseFloat(char *token, float *fval);
 char *LefLower(char *token);
 DSEG  LefReadGeometry(GATE lefMacro, FILE *f, float oscale);
 LefList LefRedefined(LefList lefl, char *redefname);
@@ -127,6 +151,7 @@ DSEG LefReadRect(FILE *f, int curlayer, float oscale);
 int  LefReadLayer(FILE *f, u_char obstruct);
 LefList LefFindLayer(char *token);
 LefList LefFindLayerByNum(int layer);
+void  LefLayerChanged(void);
 int    LefFindLayerNum(char *token);
 double LefGetRouteKeepout(int layer);
 double LefGetRouteWidth(int layer);
@@ -48,7 +48,7 @@ highlight_dest(void) {
 }
 
 void
-highlight_starts(POINT glist) {
+highlight_starts(PQUEUE pq) {
 }
 
 void
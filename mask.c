@@ -13,6 +13,8 @@
 #include <string.h>
 #include <unistd.h>
 
+#include <tcl.h>
+
 #ifdef TCL_QROUTER
 #include <tk.h>
 #endif
@@ -27,8 +29,7 @@
 #include "lef.h"
 #include "def.h"
 #include "graphics.h"
-
-u_char   *RMask;    	        // mask out best area to route
+#include "global.h"
 
 /*--------------------------------------------------------------*/
 /* Comparison routine used for qsort.  Sort nets by number of	*/
@@ -78,7 +79,6 @@ int altCompNets(NET *a, NET *b)
    int pwidth, qwidth, pheight, qheight, pdim, qdim;
    int pxmin, pxmax, pymin, pymax;
    int qxmin, qxmax, qymin, qymax;
-   POINT pnt;
 
    // Any NULL nets get shoved up front
    if (p == NULL) return ((q == NULL) ? 0 : -1);
@@ -94,25 +94,8 @@ int altCompNets(NET *a, NET *b)
    }
 
    // Otherwise sort as described above.
-   pnt = get_left_lower_trunk_point((*a)->bbox);
-   pxmin = pnt->x;
-   pymin = pnt->y;
-   free(pnt);
-
-   pnt = get_right_upper_trunk_point((*a)->bbox);
-   pxmax = pnt->x;
-   pymax = pnt->y;
-   free(pnt);
-
-   pnt = get_left_lower_trunk_point((*b)->bbox);
-   qxmin = pnt->x;
-   qymin = pnt->y;
-   free(pnt);
-
-   pnt = get_right_upper_trunk_point((*b)->bbox);
-   qxmax = pnt->x;
-   qymax = pnt->y;
-   free(pnt);
+   get_bbox_extent((*a)->bbox, &pxmin, &pymin, &pxmax, &pymax);
+   get_bbox_extent((*b)->bbox, &qxmin, &qymin, &qxmax, &qymax);
 
    pwidth = pxmax - pxmin;
    pheight = pymax - pymin;
@@ -183,6 +166,7 @@ void create_netorder(u_char method)
 			(__compar_fn_t)altCompNets);
 	 break;
   }
+  bump_bbox_generation();	// net order keys the bbox collision index
 
   for (i = 0; i < Numnets; i++) {
      net = Nlnets[i];
@@ -192,18 +176,6 @@ void create_netorder(u_char method)
 } /* create_netorder() */
 
 
-BBOX add_line_to_bbox_ints(BBOX bbox, int x1, int y1, int x2, int y2)
-{
-	BBOX_LINE line = NULL; // line to add
-	BBOX b = (bbox==NULL)?new_bbox():bbox;
-	line = new_line(); // creating requested line
-	line->pt1 = create_point(x1,y1,0);
-	line->pt2 = create_point(x2,y2,0);
-	b->num_edges++; // incrementing line count
-	b->edges=add_line_to_edge(b->edges, line);
-	return b;
-}
-
 /*--------------------------------------------------------------*/
 /* Measure and record the bounding box of a net.		*/
 /* This is preparatory to generating a mask for the net.	*/
@@ -277,10 +249,7 @@ void find_bounding_box(NET net)
       x2+=BOX_ROOM_X;
       y2+=BOX_ROOM_Y;
 
-      net->bbox = add_line_to_bbox_ints(net->bbox, x1, y1, x1, y2); // left lower point -> left upper point
-      net->bbox = add_line_to_bbox_ints(net->bbox, x1, y1, x2, y1); // left lower point -> right lower point
-      net->bbox = add_line_to_bbox_ints(net->bbox, x2, y2, x2, y1); // right upper point -> right lower point
-      net->bbox = add_line_to_bbox_ints(net->bbox, x2, y2, x1, y2); // right upper point -> left upper point
+      set_bbox_rect(net->bbox, x1, y1, x2, y2);
 }
 
 /*--------------------------------------------------------------*/
@@ -306,20 +275,11 @@ void defineRouteTree(NET net)
     NODE n1;
     DPOINT dtap;
     int xcent, ycent, xmin, ymin, xmax, ymax;
-    POINT pnt;
 
     // This is called after create_bounding_box(), so bounds have
     // been calculated.
 
-    pnt = get_left_lower_trunk_point(net->bbox);
-    xmin = pnt->x;
-    ymin = pnt->y;
-    free(pnt);
-
-    pnt = get_right_upper_trunk_point(net->bbox);
-    xmax = pnt->x;
-    ymax = pnt->y;
-    free(pnt);
+    get_bbox_extent(net->bbox, &xmin, &ymin, &xmax, &ymax);
 
     if (net->numnodes == 2) {
 
@@ -371,20 +331,6 @@ void defineRouteTree(NET net)
     }
 }
 
-/*--------------------------------------------------------------*/
-/* initMask() ---						*/
-/*--------------------------------------------------------------*/
-
-void initMask(void)
-{
-   RMask = (u_char *)calloc(NumChannelsX[0] * NumChannelsY[0],
-			sizeof(u_char));
-   if (!RMask) {
-      fprintf(stderr, "Out of memory 3.\n");
-      exit(3);
-   }
-}
-
 /*--------------------------------------------------------------*/
 /* Fill mask around the area of a vertical line			*/
 /*--------------------------------------------------------------*/
@@ -397,14 +343,7 @@ void create_vbranch_mask(NET net, int x, int y1, int y2, u_char slack, u_char ha
    u_char m;
    POINT pt;
    BBOX tb;
-   pt = get_left_lower_trunk_point(net->bbox);
-   xmin = pt->x;
-   ymin = pt->y;
-   free(pt);
-   pt = get_right_upper_trunk_point(net->bbox);
-   xmax = pt->x;
-   ymax = pt->y;
-   free(pt);
+   get_bbox_extent(net->bbox, &xmin, &ymin, &xmax, &ymax);
 
    pt = create_point(0,0,0);
    gx1 = x - slack;
@@ -468,14 +407,7 @@ void create_hbranch_mask(NET net, int y, int x1, int x2, u_char slack, u_char ha
    int xmin, xmax, ymin, ymax;
    u_char m;
    POINT pt;
-   pt = get_left_lower_trunk_point(net->bbox);
-   xmin = pt->x;
-   ymin = pt->y;
-   free(pt);
-   pt = get_right_upper_trunk_point(net->bbox);
-   xmax = pt->x;
-   ymax = pt->y;
-   free(pt);
+   get_bbox_extent(net->bbox, &xmin, &ymin, &xmax, &ymax);
 
    pt=create_point(0,0,0);
    gy1 = y - slack;
@@ -526,49 +458,41 @@ void create_hbranch_mask(NET net, int y, int x1, int x2, u_char slack, u_char ha
 }
 
 /*--------------------------------------------------------------*/
-/* setBboxCurrent() ---						*/
+/* getBboxCurrent() ---						*/
 /*								*/
-/* Alter the net's bounding box information to include the	*/
-/* existing bounding box around all net route segments.  This	*/
-/* allows stage 3 routing to minimize the search area.		*/
+/* Find the trunk extent of the net's bounding box, grown to	*/
+/* include the existing bounding box around all net route	*/
+/* segments.  Stage 3 rips up and reroutes the net inside this	*/
+/* area.  Returns FALSE if the net has no usable bounding box.	*/
 /*								*/
 /*--------------------------------------------------------------*/
 
-void setBboxCurrent(NET net)
+BOOL getBboxCurrent(NET net, int *xmin, int *ymin, int *xmax, int *ymax)
 {
     ROUTE rt;
     SEG seg;
-    POINT pnt;
-    int xmin, ymin, xmax, ymax;
+
+    if (!get_bbox_extent(net->bbox, xmin, ymin, xmax, ymax)) return FALSE;
 
     // If net is routed, increase the bounding box to
     // include the current route solution.
 
-    pnt = get_left_lower_trunk_point(net->bbox);
-    xmin = pnt->x;
-    ymin = pnt->y;
-    free(pnt);
-
-    pnt = get_right_upper_trunk_point(net->bbox);
-    xmax = pnt->x;
-    ymax = pnt->y;
-    free(pnt);
-
     for (rt = net->routes; rt; rt = rt->next)
 	for (seg = rt->segments; seg; seg = seg->next)
 	{
-	    if (seg->x1 < xmin) xmin = seg->x1;
-	    else if (seg->x1 > xmax) xmax = seg->x1;
+	    if (seg->x1 < *xmin) *xmin = seg->x1;
+	    else if (seg->x1 > *xmax) *xmax = seg->x1;
 
-	    if (seg->x2 < xmin) xmin = seg->x2;
-	    else if (seg->x2 > xmax) xmax = seg->x2;
+	    if (seg->x2 < *xmin) *xmin = seg->x2;
+	    else if (seg->x2 > *xmax) *xmax = seg->x2;
 
-	    if (seg->y1 < ymin) ymin = seg->y1;
-	    else if (seg->y1 > ymax) ymax = seg->y1;
+	    if (seg->y1 < *ymin) *ymin = seg->y1;
+	    else if (seg->y1 > *ymax) *ymax = seg->y1;
 
-	    if (seg->y2 < ymin) ymin = seg->y2;
-	    else if (seg->y2 > ymax) ymax = seg->y2;
+	    if (seg->y2 < *ymin) *ymin = seg->y2;
+	    else if (seg->y2 > *ymax) *ymax = seg->y2;
 	}
+    return TRUE;
 }
 
 /*--------------------------------------------------------------*/
@@ -586,19 +510,10 @@ void createBboxMask(NET net, u_char halo)
 {
     int xmin, ymin, xmax, ymax;
     int i, j, gx1, gy1, gx2, gy2;
-    POINT pnt;
 
     fillMask(net, (u_char)halo);
 
-    pnt = get_left_lower_trunk_point(net->bbox);
-    xmin = pnt->x;
-    ymin = pnt->y;
-    free(pnt);
-
-    pnt = get_right_upper_trunk_point(net->bbox);
-    xmax = pnt->x;
-    ymax = pnt->y;
-    free(pnt);
+    get_bbox_extent(net->bbox, &xmin, &ymin, &xmax, &ymax);
 
     for (gx1 = xmin; gx1 <= xmax; gx1++)
 	for (gy1 = ymin; gy1 <= ymax; gy1++)
@@ -631,6 +546,215 @@ void createBboxMask(NET net, u_char halo)
      }
 }
 
+/*--------------------------------------------------------------*/
+/* createGuideMask() ---					*/
+/*								*/
+/* Create mask limiting the area to search for routing to the	*/
+/* GCells of the net's global route (see global.c).		*/
+/*								*/
+/* Values are 0 inside the GCells of the route, and increase	*/
+/* by one for each route track away from them, out to "halo".	*/
+/*--------------------------------------------------------------*/
+
+void createGuideMask(NET net, u_char halo)
+{
+    int xmin, ymin, xmax, ymax, w, h;
+    int i, x, y, gx, gy, v;
+    u_char *m;
+    NODE n1;
+    DPOINT dtap;
+
+    if (!get_bbox_extent(net->bbox, &xmin, &ymin, &xmax, &ymax)) return;
+    xmin = MAX(xmin, 0);
+    ymin = MAX(ymin, 0);
+    xmax = MIN(xmax, NumChannelsX[0] - 1);
+    ymax = MIN(ymax, NumChannelsY[0] - 1);
+    if ((xmax < xmin) || (ymax < ymin)) return;
+    w = xmax - xmin + 1;
+    h = ymax - ymin + 1;
+
+    m = (u_char *)malloc(w * h);
+    if (m == NULL) {
+	printf("%s: memory leak. dying!\n",__FUNCTION__);
+	exit(0);
+    }
+    memset(m, halo, w * h);
+
+    for (i = 0; i < net->numguide; i++) {
+	gx = (net->guide[i] % GCellsX) * GCELL_SIZE;
+	gy = (net->guide[i] / GCellsX) * GCELL_SIZE;
+	for (y = MAX(gy, ymin); (y < gy + GCELL_SIZE) && (y <= ymax); y++)
+	    for (x = MAX(gx, xmin); (x < gx + GCELL_SIZE) && (x <= xmax); x++)
+		m[(y - ymin) * w + x - xmin] = (u_char)0;
+    }
+
+    // Two passes give each position its distance in tracks,
+    // counting diagonal steps as one, to the nearest GCell.
+
+    for (y = 0; y < h; y++)
+	for (x = 0; x < w; x++) {
+	    v = m[y * w + x];
+	    if (x > 0) v = MIN(v, m[y * w + x - 1] + 1);
+	    if (y > 0) {
+		v = MIN(v, m[(y - 1) * w + x] + 1);
+		if (x > 0) v = MIN(v, m[(y - 1) * w + x - 1] + 1);
+		if (x < w - 1) v = MIN(v, m[(y - 1) * w + x + 1] + 1);
+	    }
+	    m[y * w + x] = (u_char)v;
+	}
+    for (y = h - 1; y >= 0; y--)
+	for (x = w - 1; x >= 0; x--) {
+	    v = m[y * w + x];
+	    if (x < w - 1) v = MIN(v, m[y * w + x + 1] + 1);
+	    if (y < h - 1) {
+		v = MIN(v, m[(y + 1) * w + x] + 1);
+		if (x < w - 1) v = MIN(v, m[(y + 1) * w + x + 1] + 1);
+		if (x > 0) v = MIN(v, m[(y + 1) * w + x - 1] + 1);
+	    }
+	    m[y * w + x] = (u_char)v;
+	}
+
+    for (y = 0; y < h; y++)
+	for (x = 0; x < w; x++)
+	    RMASK(x + xmin, y + ymin) = m[y * w + x];
+    free(m);
+
+    // Allow routes at all tap and extension points
+    for (n1 = net->netnodes; n1 != NULL; n1 = n1->next) {
+	for (dtap = n1->taps; dtap != NULL; dtap = dtap->next)
+	    RMASK(dtap->gridx, dtap->gridy) = (u_char)0;
+	for (dtap = n1->extend; dtap != NULL; dtap = dtap->next)
+	    RMASK(dtap->gridx, dtap->gridy) = (u_char)0;
+    }
+}
+
+/*--------------------------------------------------------------*/
+/* Occupancy of the route grid, for analyzeCongestion().	*/
+/*								*/
+/* Each position (x, y) counts, over all layers, the bits of	*/
+/* Obs[] that make it congested:  ROUTED_NET, NO_NET, and any	*/
+/* of PINOBSTRUCTMASK.  Each row keeps the prefix sums of its	*/
+/* positions, so that the occupancy of any run of a row is a	*/
+/* difference of two sums.  The counts are built from Obs[]	*/
+/* on first use, and then kept current by the code writing	*/
+/* routes to Obs[] and ripping them out, which calls		*/
+/* occupancy_update() on the area it changed.  A row whose	*/
+/* counts changed has its sums rebuilt when next read.		*/
+/*--------------------------------------------------------------*/
+
+static u_char *OccCell = NULL;		// Occupancy of each position
+static int *OccSum = NULL;		// Prefix sums of each row
+static u_char *OccDirty = NULL;		// Row sums to be rebuilt
+static int OccWidth = 0, OccHeight = 0;
+
+TCL_DECLARE_MUTEX(occupancyMutex)
+
+static u_char occupancy_value(int x, int y)
+{
+    int l;
+    u_int n;
+    u_char v = 0;
+
+    for (l = 0; l < Num_layers; l++) {
+	if ((x >= NumChannelsX[l]) || (y >= NumChannelsY[l])) continue;
+	n = OBSVAL(x, y, l);
+	if (n & ROUTED_NET) v++;
+	if (n & NO_NET) v++;
+	if (n & PINOBSTRUCTMASK) v++;
+    }
+    return v;
+}
+
+/* Build the counts from Obs[].  Caller holds occupancyMutex. */
+
+static void occupancy_build(void)
+{
+    int x, y;
+
+    OccWidth = NumChannelsX[0];
+    OccHeight = NumChannelsY[0];
+    OccCell = (u_char *)malloc(OccWidth * OccHeight);
+    OccSum = (int *)malloc((OccWidth + 1) * OccHeight * sizeof(int));
+    OccDirty = (u_char *)malloc(OccHeight);
+    if ((OccCell == NULL) || (OccSum == NULL) || (OccDirty == NULL)) {
+	printf("%s: memory leak. dying!\n",__FUNCTION__);
+	exit(0);
+    }
+    for (y = 0; y < OccHeight; y++) {
+	for (x = 0; x < OccWidth; x++)
+	    OccCell[y * OccWidth + x] = occupancy_value(x, y);
+	OccDirty[y] = TRUE;
+    }
+}
+
+/*--------------------------------------------------------------*/
+/* occupancy_update() ---					*/
+/*								*/
+/* Recount the occupancy of the positions from (x1, y1) to	*/
+/* (x2, y2) after Obs[] was changed there.			*/
+/*--------------------------------------------------------------*/
+
+void occupancy_update(int x1, int y1, int x2, int y2)
+{
+    int x, y;
+    u_char v;
+
+    Tcl_MutexLock(&occupancyMutex);
+    if (OccCell != NULL) {
+	x1 = MAX(x1, 0);
+	y1 = MAX(y1, 0);
+	x2 = MIN(x2, OccWidth - 1);
+	y2 = MIN(y2, OccHeight - 1);
+	for (y = y1; y <= y2; y++)
+	    for (x = x1; x <= x2; x++) {
+		v = occupancy_value(x, y);
+		if (OccCell[y * OccWidth + x] != v) {
+		    OccCell[y * OccWidth + x] = v;
+		    OccDirty[y] = TRUE;
+		}
+	    }
+    }
+    Tcl_MutexUnlock(&occupancyMutex);
+}
+
+/*--------------------------------------------------------------*/
+/* occupancy_clear() ---					*/
+/*								*/
+/* Drop the counts, to be built again from Obs[] when next	*/
+/* needed.  To be called whenever Obs[] is reallocated.		*/
+/*--------------------------------------------------------------*/
+
+void occupancy_clear(void)
+{
+    Tcl_MutexLock(&occupancyMutex);
+    free(OccCell);
+    free(OccSum);
+    free(OccDirty);
+    OccCell = NULL;
+    OccSum = NULL;
+    OccDirty = NULL;
+    OccWidth = OccHeight = 0;
+    Tcl_MutexUnlock(&occupancyMutex);
+}
+
+/* Occupancy of row y from x1 to x2.  Caller holds occupancyMutex. */
+
+static int occupancy_run(int y, int x1, int x2)
+{
+    int x, *sum;
+    u_char *cell;
+
+    sum = OccSum + y * (OccWidth + 1);
+    if (OccDirty[y]) {
+	cell = OccCell + y * OccWidth;
+	sum[0] = 0;
+	for (x = 0; x < OccWidth; x++)
+	    sum[x + 1] = sum[x] + cell[x];
+	OccDirty[y] = FALSE;
+    }
+    return sum[x2 + 1] - sum[x1];
+}
+
 /*--------------------------------------------------------------*/
 /* analyzeCongestion() ---					*/
 /*								*/
@@ -642,36 +766,33 @@ void createBboxMask(NET net, u_char halo)
 
 int analyzeCongestion(NET net, int ycent, int ymin, int ymax, int xmin, int xmax)
 {
-    int i, minidx = -1, sidx, n;
-    int *score, minscore;
-    POINT vpnt = create_point(0,0,0);
-
-    score = (int *)malloc((ymax - ymin + 1) * sizeof(int));
-
-    for (vpnt->y = ymin; vpnt->y <= ymax; vpnt->y++) {
-	sidx = vpnt->y - ymin;
-	score[sidx] = ABSDIFF(ycent, vpnt->y) * Num_layers;
-	for (vpnt->x = xmin; vpnt->x <= xmax; vpnt->x++) {
-	    for (vpnt->layer = 0; vpnt->layer < Num_layers; vpnt->layer++) {
-		if(check_point_area(net->bbox,vpnt,FALSE,WIRE_ROOM)) {
-			n = OBSVAL(vpnt->x, vpnt->y, vpnt->layer);
-			if (n & ROUTED_NET) score[sidx]++;
-			if (n & NO_NET) score[sidx]++;
-			if (n & PINOBSTRUCTMASK) score[sidx]++;
-		}
+    int x, y, x0, minidx = -1;
+    int score, minscore;
+
+    minscore = MAXRT;
+    for (y = ymin; y <= ymax; y++) {
+	score = ABSDIFF(ycent, y) * Num_layers;
+
+	// Add up the occupancy of each run of positions inside
+	// the net bbox along the row.
+
+	Tcl_MutexLock(&occupancyMutex);
+	if (OccCell == NULL) occupancy_build();
+	if ((y >= 0) && (y < OccHeight)) {
+	    for (x = MAX(xmin, 0); x <= MIN(xmax, OccWidth - 1); x++) {
+		if (!check_xy_area(net->bbox, x, y, FALSE, WIRE_ROOM)) continue;
+		for (x0 = x; (x < MIN(xmax, OccWidth - 1)) &&
+			check_xy_area(net->bbox, x + 1, y, FALSE, WIRE_ROOM); x++);
+		score += occupancy_run(y, x0, x);
 	    }
 	}
-    }
-    minscore = MAXRT;
-    for (i = 0; i < (ymax - ymin + 1); i++) {
-	if (score[i] < minscore) {
-	    minscore = score[i];
-	    minidx = i + ymin;
+	Tcl_MutexUnlock(&occupancyMutex);
+
+	if (score < minscore) {
+	    minscore = score;
+	    minidx = y;
 	}
     }
-
-    free(vpnt);
-    free(score);
     return minidx;
 }
 
@@ -706,22 +827,13 @@ void createMask(NET net, u_char slack, u_char halo)
 {
   NODE n1, n2;
   DPOINT dtap;
-  POINT pnt;
   int i, j, orient;
   int dx, dy, gx1, gx2, gy1, gy2;
   int xcent, ycent, xmin, ymin, xmax, ymax;
 
   fillMask(net, (u_char)halo);
 
-  pnt = get_left_lower_trunk_point(net->bbox);
-  xmin = pnt->x;
-  ymin = pnt->y;
-  free(pnt);
-
-  pnt = get_right_upper_trunk_point(net->bbox);
-  xmax = pnt->x;
-  ymax = pnt->y;
-  free(pnt);
+  get_bbox_extent(net->bbox, &xmin, &ymin, &xmax, &ymax);
 
   xcent = xmin;
   ycent = ymin;
@@ -895,18 +1007,16 @@ void createMask(NET net, u_char slack, u_char halo)
 
 void fillMask(NET net, u_char value) {
 	if(!net) return;
-	POINT p1, p2, vpnt;
-	p1 = get_left_lower_trunk_point(net->bbox);
-	p2 = get_right_upper_trunk_point(net->bbox);
+	POINT vpnt;
+	int x1, y1, x2, y2;
+	if(!get_bbox_extent(net->bbox, &x1, &y1, &x2, &y2)) return;
 	vpnt = create_point(0,0,0);
-	for(vpnt->x=p1->x;vpnt->x<p2->x;vpnt->x++) {
-		for(vpnt->y=p1->y;vpnt->y<p2->y;vpnt->y++) {
+	for(vpnt->x=x1;vpnt->x<x2;vpnt->x++) {
+		for(vpnt->y=y1;vpnt->y<y2;vpnt->y++) {
 			if(check_point_area(net->bbox,vpnt,FALSE,WIRE_ROOM)) RMASK(vpnt->x, vpnt->y) = value;
 		}
 	}
 	free(vpnt);
-	free(p1);
-	free(p2);
 }
 
 /* end of mask.c */
@@ -23,7 +23,10 @@
 #include "point.h"
 #include "node.h"
 #include "maze.h"
+#include "pqueue.h"
 #include "lef.h"
+#include "mask.h"
+#include "congest.h"
 
 extern int TotalRoutes;
 
@@ -182,12 +185,11 @@ int set_powerbus_to_net(int netnum)
 /* back on the stack for visiting on the next round.		*/
 /*--------------------------------------------------------------*/
 
-void clear_non_source_targets(NET net, POINT *pushlist)
+void clear_non_source_targets(NET net, PQUEUE pushlist)
 {
    NODE node;
    DPOINT ntap;
    PROUTE *Pr;
-   POINT gpoint;
    int lay, x, y;
 
    for (node = net->netnodes; node; node = node->next) {
@@ -199,16 +201,10 @@ void clear_non_source_targets(NET net, POINT *pushlist)
 	 if (Pr->flags & PR_TARGET) {
 	    if (Pr->flags & PR_PROCESSED) {
 	       Pr->flags &= ~PR_PROCESSED;
-	       if (~(Pr->flags & PR_ON_STACK)) {
-			gpoint = create_point(x,y,lay);
-			if(check_point_area(net->bbox,gpoint,FALSE,WIRE_ROOM)) {
-				Pr->flags |= PR_ON_STACK;
-				gpoint->next = *pushlist;
-				*pushlist = gpoint;
-			} else {
-				free(gpoint);
-			}
-		}
+	       if(check_xy_area(net->bbox,x,y,FALSE,WIRE_ROOM)) {
+		  Pr->flags |= PR_ON_STACK;
+		  pq_push(pushlist, x, y, lay, PQ_KEY(Pr));
+	       }
 	    }
 	 }
       }
@@ -222,15 +218,9 @@ void clear_non_source_targets(NET net, POINT *pushlist)
 	    if (Pr->flags & PR_TARGET) {
 		if (Pr->flags & PR_PROCESSED) {
 			Pr->flags &= ~PR_PROCESSED;
-			if (~(Pr->flags & PR_ON_STACK)) {
-				gpoint = create_point(x,y,lay);
-				if(check_point_area(net->bbox,gpoint,FALSE,WIRE_ROOM)) {
-					Pr->flags |= PR_ON_STACK;
-					gpoint->next = *pushlist;
-					*pushlist = gpoint;
-				} else {
-					free(gpoint);
-				}
+			if(check_xy_area(net->bbox,x,y,FALSE,WIRE_ROOM)) {
+				Pr->flags |= PR_ON_STACK;
+				pq_push(pushlist, x, y, lay, PQ_KEY(Pr));
 			}
 		}
          }
@@ -361,13 +351,12 @@ count_targets(NET net)
 /* will be no way to route the net.				*/
 /*--------------------------------------------------------------*/
 
-int set_node_to_net(NODE node, int newflags, POINT* pushlist, BBOX bbox, u_char stage)
+int set_node_to_net(NODE node, int newflags, PQUEUE pushlist, BBOX bbox, u_char stage)
 {
     int x, y, lay, obsnet = 0;
     int result = 0;
     u_char found_one = FALSE;
     NODEINFO lnode;
-    POINT gpoint;
     DPOINT ntap;
     PROUTE *Pr;
 
@@ -425,18 +414,12 @@ int set_node_to_net(NODE node, int newflags, POINT* pushlist, BBOX bbox, u_char
 
 	  Pr->prdata.cost = (newflags == PR_SOURCE) ? 0 : MAXRT;
 
-	  // push this point on the stack to process
+	  // push this point on the queue to process
 
 	  if (pushlist != NULL) {
-	     if (~(Pr->flags & PR_ON_STACK)) {
-	        gpoint = create_point(x,y,lay);
-		if(check_point_area(bbox,gpoint,FALSE,WIRE_ROOM)) {
-			Pr->flags |= PR_ON_STACK;
-			gpoint->next = *pushlist;
-			*pushlist = gpoint;
-		} else {
-		     free(gpoint);
-		}
+	     if(check_xy_area(bbox,x,y,FALSE,WIRE_ROOM)) {
+		Pr->flags |= PR_ON_STACK;
+		pq_push(pushlist, x, y, lay, PQ_KEY(Pr));
 	     }
 	  }
 	  found_one = TRUE;
@@ -483,23 +466,12 @@ int set_node_to_net(NODE node, int newflags, POINT* pushlist, BBOX bbox, u_char
 	  Pr->flags |= (newflags == PR_SOURCE) ? newflags : (newflags | PR_COST);
 	  Pr->prdata.cost = (newflags == PR_SOURCE) ? 0 : MAXRT;
 
-	  // push this point on the stack to process
+	  // push this point on the queue to process
 
 	  if (pushlist != NULL) {
-	     if (~(Pr->flags & PR_ON_STACK)) {
-		
-	        gpoint = create_point(x,y,lay);
-		if(check_point_area(bbox,gpoint,FALSE,WIRE_ROOM)) {
-			Pr->flags |= PR_ON_STACK;
-		if (found_one) {
-	            gpoint->next = pushlist[1];
-		    pushlist[1] = gpoint;
-		} else {
-	            gpoint->next = *pushlist;
-		    *pushlist = gpoint;
-		}} else {
-		     free(gpoint);
-	     }
+	     if(check_xy_area(bbox,x,y,FALSE,WIRE_ROOM)) {
+		Pr->flags |= PR_ON_STACK;
+		pq_push(pushlist, x, y, lay, PQ_KEY(Pr));
 	     }
 	  }
 	  found_one = TRUE;
@@ -589,12 +561,11 @@ int disable_node_nets(NODE node)
 /* source nodes) is routable by definition. . .			*/
 /*--------------------------------------------------------------*/
 
-int set_route_to_net(NET net, ROUTE rt, int newflags, POINT *pushlist, u_char stage)
+int set_route_to_net(NET net, ROUTE rt, int newflags, PQUEUE pushlist, u_char stage)
 {
     int x, y, lay;
     int result = 0;
     NODEINFO lnode;
-    POINT gpoint;
     SEG seg;
     NODE n2;
     PROUTE *Pr;
@@ -611,18 +582,12 @@ int set_route_to_net(NET net, ROUTE rt, int newflags, POINT *pushlist, u_char st
 		// if (Pr->prdata.net != node->netnum) Pr->flags |= PR_CONFLICT;
 		Pr->prdata.cost = (newflags == PR_SOURCE) ? 0 : MAXRT;
 
-		// push this point on the stack to process
+		// push this point on the queue to process
 
 		if (pushlist != NULL) {
-		   if (~(Pr->flags & PR_ON_STACK)) {
-	  	      gpoint = create_point(x,y,lay);
-		      if(check_point_area(net->bbox,gpoint,FALSE,WIRE_ROOM)) {
-			Pr->flags |= PR_ON_STACK;
-			gpoint->next = *pushlist;
-			*pushlist = gpoint;
-		      } else {
-				free(gpoint);
-			}
+		   if(check_xy_area(net->bbox,x,y,FALSE,WIRE_ROOM)) {
+		      Pr->flags |= PR_ON_STACK;
+		      pq_push(pushlist, x, y, lay, PQ_KEY(Pr));
 		   }
 		}
 
@@ -664,7 +629,7 @@ int set_route_to_net(NET net, ROUTE rt, int newflags, POINT *pushlist, u_char st
 /* connect do the nodes.					*/
 /*--------------------------------------------------------------*/
 
-int set_route_to_net_recursive(NET net, ROUTE rt, int newflags, POINT *pushlist, u_char stage)
+int set_route_to_net_recursive(NET net, ROUTE rt, int newflags, PQUEUE pushlist, u_char stage)
 {
     ROUTE route;
     int result;
@@ -721,7 +686,7 @@ int set_route_to_net_recursive(NET net, ROUTE rt, int newflags, POINT *pushlist,
 /* "newflags" (PR_SOURCE or PR_DEST) in Obs2[].			*/
 /*--------------------------------------------------------------*/
 
-int set_routes_to_net(NODE node, NET net, int newflags, POINT* pushlist, int stage)
+int set_routes_to_net(NODE node, NET net, int newflags, PQUEUE pushlist, int stage)
 {
     ROUTE rt;
     int result = 0;
@@ -755,7 +720,6 @@ addcollidingnet(NETLIST *nlptr, int netnum, int x, int y, int lay)
     NETLIST cnl;
     NET fnet;
     SEG seg;
-    int i;
     int sx, sy;
     u_char found;
 
@@ -763,53 +727,50 @@ addcollidingnet(NETLIST *nlptr, int netnum, int x, int y, int lay)
 	if (cnl->net->netnum == netnum)
 	    return 0;
 
-    for (i = 0; i < Numnets; i++) {
-	fnet = Nlnets[i];
-	if (fnet->netnum == netnum) {
-	    cnl = (NETLIST)malloc(sizeof(struct netlist_));
-	    cnl->net = fnet;
-	    cnl->next = *nlptr;
-	    *nlptr = cnl;
+    fnet = getnetbynum(netnum);
+    if (fnet == NULL) return 0;
 
-	    /* If there are no routes then we're done. */
+    cnl = (NETLIST)malloc(sizeof(struct netlist_));
+    cnl->net = fnet;
+    cnl->next = *nlptr;
+    *nlptr = cnl;
 
-	    if (fnet->routes == NULL) return 0;
+    /* If there are no routes then we're done. */
 
-	    /* If there is only one route then there is no need */
-	    /* to search or shuffle.				*/
+    if (fnet->routes == NULL) return 0;
 
-	    if (fnet->routes->next == NULL) {
-		fnet->routes->flags |= RT_RIP;
-		return 1;
-	    }
+    /* If there is only one route then there is no need */
+    /* to search or shuffle.				*/
 
-	    for (rt = fnet->routes; rt; rt = rt->next) {
-		found = 0;
-		for (seg = rt->segments; seg; seg = seg->next) {
-		    if ((seg->layer == lay) || ((seg->segtype & ST_VIA) &&
-				((seg->layer + 1) == lay))) {
-			sx = seg->x1;
-			sy = seg->y1;
-			while (1) {
-			    if ((sx == x) && (sy == y)) {
-				found = 1;
-				break;
-			    }
-			    if ((sx == seg->x2) && (sy == seg->y2)) break;
-			    if (sx < seg->x2) sx++;
-			    else if (sx > seg->x2) sx--;
-			    if (sy < seg->y2) sy++;
-			    else if (sy > seg->y2) sy--;
-			}
-			if (found) break;
+    if (fnet->routes->next == NULL) {
+	fnet->routes->flags |= RT_RIP;
+	return 1;
+    }
+
+    for (rt = fnet->routes; rt; rt = rt->next) {
+	found = 0;
+	for (seg = rt->segments; seg; seg = seg->next) {
+	    if ((seg->layer == lay) || ((seg->segtype & ST_VIA) &&
+			((seg->layer + 1) == lay))) {
+		sx = seg->x1;
+		sy = seg->y1;
+		while (1) {
+		    if ((sx == x) && (sy == y)) {
+			found = 1;
+			break;
 		    }
+		    if ((sx == seg->x2) && (sy == seg->y2)) break;
+		    if (sx < seg->x2) sx++;
+		    else if (sx > seg->x2) sx--;
+		    if (sy < seg->y2) sy++;
+		    else if (sy > seg->y2) sy--;
 		}
-		if (found) rt->flags |= RT_RIP;
+		if (found) break;
 	    }
-	    return 1;
 	}
+	if (found) rt->flags |= RT_RIP;
     }
-    return 0;
+    return 1;
 }
 
 /*--------------------------------------------------------------*/
@@ -968,7 +929,7 @@ void ripup_dependent(NET net)
 void analyze_route_overwrite(int x, int y, int lay, int netnum)
 {
     u_char is_valid = FALSE;
-    int i, sx, sy, l;
+    int sx, sy, l;
     NET fnet;
     ROUTE rt;
     SEG seg;
@@ -994,44 +955,174 @@ void analyze_route_overwrite(int x, int y, int lay, int netnum)
 	return; 	/* No action, just overwrite */
     }
 
-    for (i = 0; i < Numnets; i++) {
-	fnet = Nlnets[i];
-	if (fnet->netnum == netnum) {
-	    for (rt = fnet->routes; rt; rt = rt->next) {
-		for (seg = rt->segments; seg; seg = seg->next) {
-		    sx = seg->x1;
-		    sy = seg->y1;
-		    l = seg->layer;
-		    while (1) {
-			if ((sx == x) && (sy == y) && (l == lay)) {
-			    Fprintf(stderr, "Net position %d %d %d appears to "
-					"belong to a valid network route.\n",
-					x, y, lay);
-			    /* Found the route containing this position, */
-			    /* so rip up the net now.			 */
-			    Fprintf(stderr, "Taking evasive action against net "
-					"%d\n", netnum);
-			    ripup_net(fnet, TRUE, FALSE);
-			    return;
-			}
-			if ((sx == seg->x2) && (sy == seg->y2)) {
-			    if ((seg->segtype == ST_WIRE) || (l == (lay + 1))) break;
-			    else l++;
-			}
-			else {
-			    if (seg->x2 > seg->x1) sx++;
-			    else if (seg->x2 < seg->x1) sx--;
-			    if (seg->y2 > seg->y1) sy++;
-			    else if (seg->y2 < seg->y1) sy--;
-			}
-		    }
+    fnet = getnetbynum(netnum);
+    if (fnet == NULL) return;
+
+    for (rt = fnet->routes; rt; rt = rt->next) {
+	for (seg = rt->segments; seg; seg = seg->next) {
+	    sx = seg->x1;
+	    sy = seg->y1;
+	    l = seg->layer;
+	    while (1) {
+		if ((sx == x) && (sy == y) && (l == lay)) {
+		    Fprintf(stderr, "Net position %d %d %d appears to "
+				"belong to a valid network route.\n",
+				x, y, lay);
+		    /* Found the route containing this position, */
+		    /* so rip up the net now.			 */
+		    Fprintf(stderr, "Taking evasive action against net "
+				"%d\n", netnum);
+		    ripup_net(fnet, TRUE, FALSE);
+		    return;
+		}
+		if ((sx == seg->x2) && (sy == seg->y2)) {
+		    if ((seg->segtype == ST_WIRE) || (l == (lay + 1))) break;
+		    else l++;
+		}
+		else {
+		    if (seg->x2 > seg->x1) sx++;
+		    else if (seg->x2 < seg->x1) sx--;
+		    if (seg->y2 > seg->y1) sy++;
+		    else if (seg->y2 < seg->y1) sy--;
 		}
 	    }
-	    break;
 	}
     }
 }
 
+/*--------------------------------------------------------------*/
+/* Recount the occupancy (see mask.c) of the positions around	*/
+/* segment "seg", after it was written to or removed from	*/
+/* Obs[].							*/
+/*--------------------------------------------------------------*/
+
+static void
+seg_occupancy_update(SEG seg)
+{
+   occupancy_update(MIN(seg->x1, seg->x2) - 1, MIN(seg->y1, seg->y2) - 1,
+		MAX(seg->x1, seg->x2) + 1, MAX(seg->y1, seg->y2) + 1);
+}
+
+/*--------------------------------------------------------------*/
+/* Remove route "rt" of net "thisnet" from the Obs[] array.	*/
+/*--------------------------------------------------------------*/
+
+static void
+ripup_route_obs(ROUTE rt, int thisnet)
+{
+   int oldnet, x, y, lay, dir;
+   NODEINFO lnode;
+   SEG seg;
+
+   for (seg = rt->segments; seg; seg = seg->next) {
+      lay = seg->layer;
+      x = seg->x1;
+      y = seg->y1;
+      while (1) {
+	 oldnet = OBSVAL(x, y, lay) & NETNUM_MASK;
+	 if ((oldnet > 0) && (oldnet < MAXNETNUM)) {
+	    if (oldnet != thisnet) {
+	       Fprintf(stderr, "Error: position %d %d layer %d has net "
+			  "%d not %d!\n", x, y, lay, oldnet, thisnet);
+	       // Stop-gap:  Need to analyze the root of this problem.
+	       // However, a reasonable action is to try to find the
+	       // net and route associated with the incorrect net.
+	       analyze_route_overwrite(x, y, lay, oldnet);
+
+	       // return FALSE;	// Something went wrong
+	    }
+
+	    // Reset the net number to zero along this route for
+	    // every point that is not a node tap.  Points that
+	    // were routed over obstructions to reach off-grid
+	    // taps are returned to obstructions.
+
+	    if ((lay >= Pinlayers) || ((lnode = NODEIPTR(x, y, lay)) == NULL)
+			  || (lnode->nodesav == NULL)) {
+	       dir = OBSVAL(x, y, lay) & PINOBSTRUCTMASK;
+	       if (dir == 0)
+		  OBSVAL(x, y, lay) = OBSVAL(x, y, lay) & BLOCKED_MASK;
+	       else
+		  OBSVAL(x, y, lay) = NO_NET | dir;
+	    }
+	    else {
+	       // Clear routed mask bit
+	       OBSVAL(x, y, lay) &= ~ROUTED_NET;
+	    }
+
+	    // Routes which had blockages added on the sides due
+	    // to spacing constraints have DRC_BLOCKAGE set;
+	    // these flags should be removed.
+
+	    if (needblock[lay] & (ROUTEBLOCKX | VIABLOCKX)) {
+	       if ((x > 0) && ((OBSVAL(x - 1, y, lay) &
+			  DRC_BLOCKAGE) == DRC_BLOCKAGE))
+		  OBSVAL(x - 1, y, lay) &= ~DRC_BLOCKAGE;
+	       else if ((x < NumChannelsX[lay] - 1) &&
+			  ((OBSVAL(x + 1, y, lay) &
+			  DRC_BLOCKAGE) == DRC_BLOCKAGE))
+		  OBSVAL(x + 1, y, lay) &= ~DRC_BLOCKAGE;
+	    }
+	    if (needblock[lay] & (ROUTEBLOCKY | VIABLOCKY)) {
+	       if ((y > 0) && ((OBSVAL(x, y - 1, lay) &
+			  DRC_BLOCKAGE) == DRC_BLOCKAGE))
+		  OBSVAL(x, y - 1, lay) &= ~DRC_BLOCKAGE;
+	       else if ((y < NumChannelsY[lay] - 1) &&
+			  ((OBSVAL(x, y + 1, lay) &
+			  DRC_BLOCKAGE) == DRC_BLOCKAGE))
+		  OBSVAL(x, y + 1, lay) &= ~DRC_BLOCKAGE;
+	    }
+	 }
+
+	 // Check for and handle via end on last route segment.
+
+	 if ((x == seg->x2) && (y == seg->y2)) {
+	    if (seg->segtype & ST_VIA) {
+		if (lay == seg->layer)
+		   lay++;
+		else
+		   break;
+	    }
+	    else
+	       break;
+	 }
+
+	 if (x < seg->x2) x++;
+	 else if (x > seg->x2) x--;
+	 if (y < seg->y2) y++;
+	 else if (y > seg->y2) y--;
+      }
+      seg_occupancy_update(seg);
+   }
+}
+
+/*--------------------------------------------------------------*/
+/* For each node tap of net "net", restore the node pointer on	*/
+/* Nodeinfo->nodeloc so that crossover costs are again applied	*/
+/* to routes over this node tap.				*/
+/*--------------------------------------------------------------*/
+
+static void
+restore_nodelocs(NET net)
+{
+   NODEINFO lnode;
+   NODE node;
+   DPOINT ntap;
+   int x, y, lay;
+
+   for (node = net->netnodes; node; node = node->next) {
+      for (ntap = node->taps; ntap; ntap = ntap->next) {
+	 lay = ntap->layer;
+	 x = ntap->gridx;
+	 y = ntap->gridy;
+	 if (lay < Pinlayers) {
+	    lnode = NODEIPTR(x, y, lay);
+	    if (lnode) lnode->nodeloc = lnode->nodesav;
+	 }
+      }
+   }
+}
+
 /*--------------------------------------------------------------*/
 /* ripup_net ---						*/
 /*								*/
@@ -1047,12 +1138,10 @@ void analyze_route_overwrite(int x, int y, int lay, int netnum)
 
 u_char ripup_net(NET net, u_char restore, u_char flagged)
 {
-   int thisnet, oldnet, x, y, lay, dir;
+   int thisnet, x, y, lay;
    NODEINFO lnode;
-   NODE node;
    ROUTE rt, rsave, rlast;
    SEG seg;
-   DPOINT ntap;
 
    if (flagged) ripup_dependent(net);
 
@@ -1060,87 +1149,7 @@ u_char ripup_net(NET net, u_char restore, u_char flagged)
 
    for (rt = net->routes; rt; rt = rt->next) {
       if (flagged && !(rt->flags & RT_RIP)) continue;
-      if (rt->segments) {
-	 for (seg = rt->segments; seg; seg = seg->next) {
-	    lay = seg->layer;
-	    x = seg->x1;
-	    y = seg->y1;
-	    while (1) {
-	       oldnet = OBSVAL(x, y, lay) & NETNUM_MASK;
-	       if ((oldnet > 0) && (oldnet < MAXNETNUM)) {
-	          if (oldnet != thisnet) {
-		     Fprintf(stderr, "Error: position %d %d layer %d has net "
-				"%d not %d!\n", x, y, lay, oldnet, thisnet);
-		     // Stop-gap:  Need to analyze the root of this problem.
-		     // However, a reasonable action is to try to find the
-		     // net and route associated with the incorrect net.
-		     analyze_route_overwrite(x, y, lay, oldnet);
-
-		     // return FALSE;	// Something went wrong
-	          }
-
-	          // Reset the net number to zero along this route for
-	          // every point that is not a node tap.  Points that
-		  // were routed over obstructions to reach off-grid
-		  // taps are returned to obstructions.
-
-	          if ((lay >= Pinlayers) || ((lnode = NODEIPTR(x, y, lay)) == NULL)
-				|| (lnode->nodesav == NULL)) {
-		     dir = OBSVAL(x, y, lay) & PINOBSTRUCTMASK;
-		     if (dir == 0)
-		        OBSVAL(x, y, lay) = OBSVAL(x, y, lay) & BLOCKED_MASK;
-		     else
-		        OBSVAL(x, y, lay) = NO_NET | dir;
-		  }
-	          else {
-		     // Clear routed mask bit
-		     OBSVAL(x, y, lay) &= ~ROUTED_NET;
-		  }
-
-		  // Routes which had blockages added on the sides due
-		  // to spacing constraints have DRC_BLOCKAGE set;
-		  // these flags should be removed.
-
-		  if (needblock[lay] & (ROUTEBLOCKX | VIABLOCKX)) {
-		     if ((x > 0) && ((OBSVAL(x - 1, y, lay) &
-				DRC_BLOCKAGE) == DRC_BLOCKAGE))
-			OBSVAL(x - 1, y, lay) &= ~DRC_BLOCKAGE;
-		     else if ((x < NumChannelsX[lay] - 1) &&
-				((OBSVAL(x + 1, y, lay) &
-				DRC_BLOCKAGE) == DRC_BLOCKAGE))
-			OBSVAL(x + 1, y, lay) &= ~DRC_BLOCKAGE;
-		  }
-		  if (needblock[lay] & (ROUTEBLOCKY | VIABLOCKY)) {
-		     if ((y > 0) && ((OBSVAL(x, y - 1, lay) &
-				DRC_BLOCKAGE) == DRC_BLOCKAGE))
-			OBSVAL(x, y - 1, lay) &= ~DRC_BLOCKAGE;
-		     else if ((y < NumChannelsY[lay] - 1) &&
-				((OBSVAL(x, y + 1, lay) &
-				DRC_BLOCKAGE) == DRC_BLOCKAGE))
-			OBSVAL(x, y + 1, lay) &= ~DRC_BLOCKAGE;
-		  }
-	       }
-
-	       // Check for and handle via end on last route segment.
-
-	       if ((x == seg->x2) && (y == seg->y2)) {
-		  if (seg->segtype & ST_VIA) {
-		      if (lay == seg->layer)
-			 lay++;
-		      else
-		         break;
-		  }
-		  else
-		     break;
-	       }
-
-	       if (x < seg->x2) x++;
-	       else if (x > seg->x2) x--;
-	       if (y < seg->y2) y++;
-	       else if (y > seg->y2) y--;
-	    }
-	 }
-      }
+      if (rt->segments) ripup_route_obs(rt, thisnet);
    }
 
    // For each net node tap, restore the node pointer on Nodeinfo->nodeloc
@@ -1162,19 +1171,8 @@ u_char ripup_net(NET net, u_char restore, u_char flagged)
 	    }
 	 }
       }
-      else {
-         for (node = net->netnodes; node; node = node->next) {
-	    for (ntap = node->taps; ntap; ntap = ntap->next) {
-	       lay = ntap->layer;
-	       x = ntap->gridx;
-	       y = ntap->gridy;
-	       if (lay < Pinlayers) {
-		   lnode = NODEIPTR(x, y, lay);
-		   if (lnode) lnode->nodeloc = lnode->nodesav;
-	       }
-	    }
-	 }
-      }
+      else
+	 restore_nodelocs(net);
    }
 
    /* Remove all flagged routing information from this net	*/
@@ -1194,10 +1192,10 @@ u_char ripup_net(NET net, u_char restore, u_char flagged)
 	    rsave = rsave->next;
 	    while (rt->segments) {
 	       seg = rt->segments->next;
-	       free(rt->segments);
+	       freeSEG(rt->segments);
 	       rt->segments = seg;
 	    }
-	    free(rt);
+	    freeROUTE(rt);
 	 }
 	 else {
 	    rlast = rsave;
@@ -1211,10 +1209,10 @@ u_char ripup_net(NET net, u_char restore, u_char flagged)
          net->routes = rt->next;
          while (rt->segments) {
 	    seg = rt->segments->next;
-	    free(rt->segments);
+	    freeSEG(rt->segments);
 	    rt->segments = seg;
          }
-         free(rt);
+         freeROUTE(rt);
       }
    }
 
@@ -1228,6 +1226,31 @@ u_char ripup_net(NET net, u_char restore, u_char flagged)
    return (net->numnodes == 0) ? FALSE : TRUE;
 }
 
+/*--------------------------------------------------------------*/
+/* lift_net ---							*/
+/*								*/
+/*  Remove all routes of net "net" from the Obs[] array and	*/
+/*  restore its node taps, as ripup_net() does with "restore"	*/
+/*  set, but keep the routes in the net record.  The caller	*/
+/*  is expected to either write the routes back or free them.	*/
+/*								*/
+/*  Return value: FALSE for special nets, whose routes are	*/
+/*  fixed obstructions and are left in place.  TRUE otherwise.	*/
+/*--------------------------------------------------------------*/
+
+u_char lift_net(NET net)
+{
+   ROUTE rt;
+
+   if (net->numnodes == 0) return FALSE;
+
+   for (rt = net->routes; rt; rt = rt->next)
+      if (rt->segments) ripup_route_obs(rt, net->netnum);
+
+   restore_nodelocs(net);
+   return TRUE;
+}
+
 /*--------------------------------------------------------------*/
 /* eval_pt - evaluate cost to get from given point to		*/
 /*	current point.  Current point is passed in "ept", and	*/
@@ -1244,14 +1267,13 @@ u_char ripup_net(NET net, u_char restore, u_char flagged)
 /*	those nets, add them to the "failed" stack, and re-	*/
 /*	route this one.						*/
 /*								*/
-/*  ARGS: none							*/
-/*  RETURNS: pointer to a new POINT record to put on the stack	*/
-/*	if the node needs to be (re)processed and isn't	already	*/
-/*	on the stack, NULL otherwise.				*/
+/*  ARGS: "pq" is the queue of positions pending evaluation	*/
+/*  RETURNS: 1 if the node needs to be (re)processed and has	*/
+/*	been placed on the queue, 0 otherwise.			*/
 /*  SIDE EFFECTS: none (get this right or else)			*/
 /*--------------------------------------------------------------*/
 
-POINT eval_pt(NET net, GRIDP* ept, u_char flags, u_char stage)
+int eval_pt(NET net, GRIDP* ept, u_char flags, u_char stage, PQUEUE pq)
 {
     int thiscost = 0;
     int netnum;
@@ -1260,7 +1282,6 @@ POINT eval_pt(NET net, GRIDP* ept, u_char flags, u_char stage)
     NETLIST nl;
     PROUTE *Pr, *Pt;
     GRIDP newpt;
-    POINT ptret = NULL;
 
     newpt = *ept;
 
@@ -1294,7 +1315,7 @@ POINT eval_pt(NET net, GRIDP* ept, u_char flags, u_char stage)
 	  break;
     }
 
-    if(!check_grid_point_area(net->bbox, newpt, FALSE, WIRE_ROOM)) return NULL;
+    if(!check_grid_point_area(net->bbox, newpt, FALSE, WIRE_ROOM)) return 0;
 
     Pr = &OBS2VAL(newpt.x, newpt.y, newpt.lay);
     nodeptr = (newpt.lay < Pinlayers) ? NODEIPTR(newpt.x, newpt.y, newpt.lay) : NULL;
@@ -1304,13 +1325,13 @@ POINT eval_pt(NET net, GRIDP* ept, u_char flags, u_char stage)
        netnum = Pr->prdata.net;
        if (stage && (netnum < MAXNETNUM)) {
 	  if ((newpt.lay < Pinlayers) && nodeptr && (nodeptr->nodesav != NULL))
-	     return NULL;		// But cannot route over terminals!
+	     return 0;		// But cannot route over terminals!
 
 	  // Is net k in the "noripup" list?  If so, don't route it */
 
 	  for (nl = net->noripup; nl; nl = nl->next) {
 	     if (nl->net->netnum == netnum)
-		return NULL;
+		return 0;
 	  }
 
 	  // In case of a collision, we change the grid point to be routable
@@ -1324,7 +1345,7 @@ POINT eval_pt(NET net, GRIDP* ept, u_char flags, u_char stage)
        }
        else if (stage && (netnum == DRC_BLOCKAGE)) {
 	  if ((newpt.lay < Pinlayers) && nodeptr && (nodeptr->nodesav != NULL))
-	     return NULL;		// But cannot route over terminals!
+	     return 0;		// But cannot route over terminals!
 
 	  // Position does not contain the net number, so we have to
 	  // go looking for it.  Fortunately this is a fairly rare
@@ -1341,7 +1362,7 @@ POINT eval_pt(NET net, GRIDP* ept, u_char flags, u_char stage)
 	              // Is net k in the "noripup" list?  If so, don't route it */
 	              for (nl = net->noripup; nl; nl = nl->next)
 	                 if (nl->net->netnum == netnum)
-		            return NULL;
+		            return 0;
 		}
 	     }
 
@@ -1353,7 +1374,7 @@ POINT eval_pt(NET net, GRIDP* ept, u_char flags, u_char stage)
 	              // Is net k in the "noripup" list?  If so, don't route it */
 	              for (nl = net->noripup; nl; nl = nl->next)
 	                 if (nl->net->netnum == netnum)
-		            return NULL;
+		            return 0;
 		}
 	     }
 	  } 
@@ -1366,7 +1387,7 @@ POINT eval_pt(NET net, GRIDP* ept, u_char flags, u_char stage)
 	              // Is net k in the "noripup" list?  If so, don't route it */
 	              for (nl = net->noripup; nl; nl = nl->next)
 	                 if (nl->net->netnum == netnum)
-		            return NULL;
+		            return 0;
 		}
 	     }
 
@@ -1378,7 +1399,7 @@ POINT eval_pt(NET net, GRIDP* ept, u_char flags, u_char stage)
 	              // Is net k in the "noripup" list?  If so, don't route it */
 	              for (nl = net->noripup; nl; nl = nl->next)
 	                 if (nl->net->netnum == netnum)
-		            return NULL;
+		            return 0;
 		}
 	     }
 	  }
@@ -1393,7 +1414,7 @@ POINT eval_pt(NET net, GRIDP* ept, u_char flags, u_char stage)
 	  thiscost += ConflictCost;
        }
        else
-          return NULL;		// Position is not routeable
+          return 0;		// Position is not routeable
     }
 
     // Compute the cost to step from the current point to the new point.
@@ -1454,6 +1475,9 @@ POINT eval_pt(NET net, GRIDP* ept, u_char flags, u_char stage)
     if (Pr->flags & PR_CONFLICT)
        thiscost += ConflictCost;	// For 2nd stage routes
 
+    if (Negotiating)
+       thiscost += congest_cost(newpt.x, newpt.y, newpt.lay);
+
     if (thiscost < Pr->prdata.cost) {
        Pr->flags &= ~PR_PRED_DMASK;
        Pr->flags |= flags;
@@ -1464,20 +1488,57 @@ POINT eval_pt(NET net, GRIDP* ept, u_char flags, u_char stage)
 	  Fprintf(stdout, "New cost %d at (%d %d %d)\n", thiscost,
 		newpt.x, newpt.y, newpt.lay);
        }
-       if (~(Pr->flags & PR_ON_STACK)) {
-	 ptret = create_point(newpt.x,newpt.y,newpt.lay);
-	 if(check_point_area(net->bbox,ptret,FALSE,WIRE_ROOM))
-		Pr->flags |= PR_ON_STACK;
-		ptret->next = NULL;
-		return ptret;
-         } else {
-		 free(ptret);
-	 }
+       // The position is queued again even if it is already on the
+       // queue;  the entry with the old, higher cost is discarded
+       // when it is popped.
+
+       if(check_xy_area(net->bbox,newpt.x,newpt.y,FALSE,WIRE_ROOM)) {
+	  Pr->flags |= PR_ON_STACK;
+	  pq_push(pq, newpt.x, newpt.y, newpt.lay, thiscost);
+	  return 1;
        }
-    return NULL;	// New position did not get a lower cost
+    }
+    return 0;	// New position did not get a lower cost
 
 } /* eval_pt() */
 
+/*------------------------------------------------------*/
+/* Routes are searched in the private window of each	*/
+/* router thread, but committed to the shared Obs[]	*/
+/* array.  Writing a segment also updates neighboring	*/
+/* positions, so all commits to Obs[] are made while	*/
+/* holding obsCommitMutex:  writeback_route() holds it	*/
+/* for a whole route, commit_proute() for each segment.	*/
+/* Rip-up is done by the main thread while no router	*/
+/* threads are running, except in stage 3, where each	*/
+/* thread rips up its own net with ripup_net_locked().	*/
+/* Rip-up and commit both write the positions next to	*/
+/* a route, so the thread pool keeps the areas of the	*/
+/* nets in flight at least two positions apart, and no	*/
+/* position is written for two nets at once.		*/
+/*------------------------------------------------------*/
+
+TCL_DECLARE_MUTEX(obsCommitMutex)
+
+/*--------------------------------------------------------------*/
+/* ripup_net_locked ---						*/
+/*								*/
+/*  Rip up all routes of net "net" as ripup_net() does, from a	*/
+/*  router thread while other threads may commit routes.  The	*/
+/*  rip-up clears DRC_BLOCKAGE next to each route, where a	*/
+/*  commit sets it, so obsCommitMutex is held throughout.	*/
+/*--------------------------------------------------------------*/
+
+u_char ripup_net_locked(NET net, u_char restore)
+{
+   u_char result;
+
+   Tcl_MutexLock(&obsCommitMutex);
+   result = ripup_net(net, restore, FALSE);
+   Tcl_MutexUnlock(&obsCommitMutex);
+   return result;
+}
+
 /*------------------------------------------------------*/
 /* writeback_segment() ---				*/
 /*							*/
@@ -1502,6 +1563,8 @@ POINT eval_pt(NET net, GRIDP* ept, u_char flags, u_char stage)
 /* segment is on a tap offset, mark the position in	*/
 /* front as unroutable.  If the segment neighbors an	*/
 /* offset tap, then mark the tap unroutable.		*/
+/*							*/
+/* The caller must hold obsCommitMutex.			*/
 /*------------------------------------------------------*/
 
 void writeback_segment(SEG seg, int netnum)
@@ -1780,6 +1843,22 @@ route_set_connections(net, route)
    }
 }
 
+/*--------------------------------------------------------------*/
+/* route_point - allocate a position of the indexed route	*/
+/*		from the calling thread's point store		*/
+/*--------------------------------------------------------------*/
+
+static POINT route_point(int x, int y, int layer)
+{
+   POINT lr = allocPOINT();
+
+   lr->x = x;
+   lr->y = y;
+   lr->layer = layer;
+   lr->next = NULL;
+   return lr;
+}
+
 /*--------------------------------------------------------------*/
 /* commit_proute - turn the potential route into an actual	*/
 /*		route by generating the route segments		*/
@@ -1828,15 +1907,18 @@ int commit_proute(NET net, ROUTE rt, GRIDP *ept, u_char stage) // TODO: fix this
    // Generate an indexed route, recording the series of predecessors and their
    // positions.
 
-   lrtop = create_point(ept->x,ept->y,ept->lay);
+   lrtop = route_point(ept->x, ept->y, ept->lay);
    lrend = lrtop;
 
    while (1) {
-      newlr = clone_point(lrend);
+      newlr = route_point(lrend->x, lrend->y, lrend->layer);
       Pr = &OBS2VAL(newlr->x, newlr->y, newlr->layer);
       dmask = Pr->flags & PR_PRED_DMASK;
 
-      if (dmask == PR_PRED_NONE) break;
+      if (dmask == PR_PRED_NONE) {
+	 freePOINT(newlr);
+	 break;
+      }
 
       switch (dmask) {
          case PR_PRED_N:
@@ -2057,9 +2139,9 @@ int commit_proute(NET net, ROUTE rt, GRIDP *ept, u_char stage) // TODO: fix this
 
 	       if (mincost < MAXRT) {
 	          pri = &OBS2VAL(minx, miny, cl);
-		  newlr =  create_point(minx,miny,cl);
+		  newlr = route_point(minx, miny, cl);
 	          pri2 = &OBS2VAL(minx, miny, dl);
-		  newlr2 = create_point(minx,miny,dl);
+		  newlr2 = route_point(minx, miny, dl);
 
 		  lrprev->next = newlr;
 		  newlr->next = newlr2;
@@ -2071,8 +2153,8 @@ int commit_proute(NET net, ROUTE rt, GRIDP *ept, u_char stage) // TODO: fix this
 		     if (lrnext->x == minx && lrnext->y == miny &&
 				lrnext->layer == dl) {
 			newlr->next = lrnext;
-			free(lrppre);
-			free(newlr2);
+			freePOINT(lrppre);
+			freePOINT(newlr2);
 			lrppre = lrnext;	// ?
 		     }
 		     else
@@ -2187,8 +2269,8 @@ int commit_proute(NET net, ROUTE rt, GRIDP *ept, u_char stage) // TODO: fix this
 	          }
 
 		  if (mincost < MAXRT) {
-		     newlr = create_point(minx,miny,cl);
-		     newlr2 = create_point(minx,miny,dl);
+		     newlr = route_point(minx, miny, cl);
+		     newlr2 = route_point(minx, miny, dl);
 
 		     // If newlr is a source or target, then make it
 		     // the endpoint, because we have just moved the
@@ -2203,7 +2285,7 @@ int commit_proute(NET net, ROUTE rt, GRIDP *ept, u_char stage) // TODO: fix this
 			) {
 			lrtop = newlr;
 			lrend = newlr;
-			free(lrcur);
+			freePOINT(lrcur);
 			lrcur = newlr;
 		     }
 		     else
@@ -2217,8 +2299,8 @@ int commit_proute(NET net, ROUTE rt, GRIDP *ept, u_char stage) // TODO: fix this
 		     if (lrppre->x == minx && lrppre->y == miny &&
 				lrppre->layer == dl) {
 			newlr->next = lrppre;
-			free(lrprev);
-			free(newlr2);
+			freePOINT(lrprev);
+			freePOINT(newlr2);
 			lrprev = lrcur;
 		     }
 		     else
@@ -2274,7 +2356,7 @@ int commit_proute(NET net, ROUTE rt, GRIDP *ept, u_char stage) // TODO: fix this
    while (1) {
       // if((!lrcur)||(!lrprev))
       // 	      break;
-      seg = (SEG)malloc(sizeof(struct seg_));
+      seg = allocSEG();
       if(!seg)
 	      exit(0);
 
@@ -2338,6 +2420,7 @@ int commit_proute(NET net, ROUTE rt, GRIDP *ept, u_char stage) // TODO: fix this
 
       lay2 = (seg->segtype & ST_VIA) ? seg->layer + 1 : seg->layer;
 
+      Tcl_MutexLock(&obsCommitMutex);
       netobs1 = OBSVAL(seg->x1, seg->y1, seg->layer);
       netobs2 = OBSVAL(seg->x2, seg->y2, lay2);
 
@@ -2382,6 +2465,8 @@ int commit_proute(NET net, ROUTE rt, GRIDP *ept, u_char stage) // TODO: fix this
 
       OBSVAL(seg->x1, seg->y1, seg->layer) |= dir1;
       OBSVAL(seg->x2, seg->y2, lay2) |= dir2;
+      seg_occupancy_update(seg);
+      Tcl_MutexUnlock(&obsCommitMutex);
 
       // An offset route end on the previous segment, if it is a via, needs
       // to carry over to this one, if it is a wire route.
@@ -2430,6 +2515,7 @@ int commit_proute(NET net, ROUTE rt, GRIDP *ept, u_char stage) // TODO: fix this
 
       if (lrprev == NULL) {
 
+	 Tcl_MutexLock(&obsCommitMutex);
          if (dir2 && (stage == (u_char)0)) {
 	    OBSVAL(seg->x2, seg->y2, lay2) |= dir2;
          }
@@ -2437,6 +2523,8 @@ int commit_proute(NET net, ROUTE rt, GRIDP *ept, u_char stage) // TODO: fix this
 	    // This also applies to vias at the end of a route
 	    OBSVAL(seg->x1, seg->y1, seg->layer) |= dir1;
 	 }
+	 seg_occupancy_update(seg);
+	 Tcl_MutexUnlock(&obsCommitMutex);
 
 	 // Before returning, set *ept to the endpoint
 	 // position.  This is for diagnostic purposes only.
@@ -2447,7 +2535,7 @@ int commit_proute(NET net, ROUTE rt, GRIDP *ept, u_char stage) // TODO: fix this
 	 // Clean up allocated memory for the route. . .
 	 while (lrtop != NULL) {
 	    lrnext = lrtop->next;
-	    free(lrtop);
+	    freePOINT(lrtop);
 	    lrtop = lrnext;
 	 }
 	 return rval;	// Success
@@ -2459,7 +2547,7 @@ cleanup:
 
    while (lrtop != NULL) {
       lrnext = lrtop->next;
-      free(lrtop);
+      freePOINT(lrtop);
       lrtop = lrnext;
    }
    return 0;
@@ -2486,6 +2574,7 @@ int writeback_route(ROUTE rt)
    u_char first = (u_char)1;
 
    netnum = rt->netnum | ROUTED_NET;
+   Tcl_MutexLock(&obsCommitMutex);
    for (seg = rt->segments; seg; seg = seg->next) {
 
       /* Save stub route information at segment ends. 		*/
@@ -2512,7 +2601,9 @@ int writeback_route(ROUTE rt)
 	 else if (dir2)
 	    OBSVAL(seg->x2, seg->y2, lay2) |= dir2;
       }
+      seg_occupancy_update(seg);
    }
+   Tcl_MutexUnlock(&obsCommitMutex);
    return TRUE;
 }
 
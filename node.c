@@ -12,6 +12,7 @@
 #include <math.h>
 #include <stdlib.h>
 #include <string.h>
+#include <limits.h>
 
 #include <tcl.h>
 
@@ -21,80 +22,151 @@
 #include "lef.h"
 #include "mask.h"
 #include "output.h"
+#include "bbindex.h"
 
-POINT get_left_lower_trunk_point(BBOX bbox)
-{
-	if(!bbox) return NULL;
-	if(!bbox->edges) return NULL;
-	POINT pt1, pt2;
-	pt1 = bbox->edges->pt1;
-	pt2 = bbox->edges->pt2;
-	if(!pt1) return NULL;
-	if(!pt2) return NULL;
-	POINT retpt = create_point(pt1->x,pt1->y, 0); // creating requested point;
-	for(BBOX_LINE l = bbox->edges; l; l=l->next) {
-		if(!l) continue;
-		pt1 = l->pt1;
-		pt2 = l->pt2;
-		if(!pt1) continue;
-		if(!pt2) continue;
-		if(pt1->x<retpt->x) retpt->x = pt1->x;
-		if(pt1->y<retpt->y) retpt->y = pt1->y;
-		if(pt2->x<retpt->x) retpt->x = pt2->x;
-		if(pt2->y<retpt->y) retpt->y = pt2->y;
+/*--------------------------------------------------------------*/
+/* Net bboxes.							*/
+/*								*/
+/* A bbox is a rectilinear polygon, kept as a vertex array in	*/
+/* canonical order (see qrouter.h).  Every change of the	*/
+/* vertices goes through set_bbox_vertices(), which puts them	*/
+/* in that order, derives the extent and the horizontal and	*/
+/* vertical edges, and compiles the membership tests below	*/
+/* from the new shape.						*/
+/*--------------------------------------------------------------*/
+
+static void compile_bbox(BBOX bbox);
+
+static long long bbox_vertex_area2(BBOX_VERTEX *v, int n)
+{
+	long long a = 0;
+	for(int i = 0; i < n; i++)
+		a += (long long)v[i].x * v[(i + 1) % n].y - (long long)v[(i + 1) % n].x * v[i].y;
+	return a;
+}
+
+// set the vertices of a bbox, in either direction and starting
+// anywhere.  repeated vertices, and vertices in the middle of a
+// straight run, are dropped.  a bbox with fewer than four vertices
+// left is empty.
+void set_bbox_vertices(BBOX bbox, BBOX_VERTEX *v, int n)
+{
+	BBOX_VERTEX *nv, p, c, q;
+	BOOL changed;
+	int i, k, first;
+
+	invalidate_bbox_raster(bbox);
+	nv = malloc((n > 0 ? n : 1) * sizeof(BBOX_VERTEX));
+	if(!nv) {
+		printf("%s: memory leak. dying!\n",__FUNCTION__);
+		exit(0);
 	}
-	return retpt;
-}
-
-POINT get_right_upper_trunk_point(BBOX bbox)
-{
-	if(!bbox) return NULL;
-	if(!bbox->edges) return NULL;
-	POINT pt1, pt2;
-	pt1 = bbox->edges->pt1;
-	pt2 = bbox->edges->pt2;
-	if(!pt1) return NULL;
-	if(!pt2) return NULL;
-
-	POINT retpt =  create_point(pt1->x,pt1->y,0); // creating requested point;
-	for(BBOX_LINE l = bbox->edges; l; l=l->next) {
-		if(!l) continue;
-		pt1 = l->pt1;
-		pt2 = l->pt2;
-		if(!pt1) continue;
-		if(!pt2) continue;
-		if(pt1->x>retpt->x) retpt->x = pt1->x;
-		if(pt1->y>retpt->y) retpt->y = pt1->y;
-		if(pt2->x>retpt->x) retpt->x = pt2->x;
-		if(pt2->y>retpt->y) retpt->y = pt2->y;
+	memcpy(nv, v, n * sizeof(BBOX_VERTEX));
+
+	do {
+		changed = FALSE;
+		for(i = 0; (i < n) && (n >= 3);) {
+			p = nv[(i + n - 1) % n];
+			c = nv[i];
+			q = nv[(i + 1) % n];
+			if(((c.x == q.x) && (c.y == q.y)) ||
+					((p.x == c.x) && (c.x == q.x)) ||
+					((p.y == c.y) && (c.y == q.y))) {
+				memmove(nv + i, nv + i + 1, (n - i - 1) * sizeof(BBOX_VERTEX));
+				n--;
+				changed = TRUE;
+			} else
+				i++;
+		}
+	} while(changed);
+	if(n < 4) n = 0;
+
+	// counter-clockwise, from the lowest of the leftmost vertices
+	if(bbox_vertex_area2(nv, n) < 0)
+		for(i = 0; i < n / 2; i++) {
+			p = nv[i];
+			nv[i] = nv[n - 1 - i];
+			nv[n - 1 - i] = p;
+		}
+	first = 0;
+	for(i = 1; i < n; i++)
+		if((nv[i].x < nv[first].x) || ((nv[i].x == nv[first].x) && (nv[i].y < nv[first].y)))
+			first = i;
+
+	free(bbox->vertex);
+	free(bbox->hedge);
+	free(bbox->vedge);
+	bbox->vertex = malloc((n > 0 ? n : 1) * sizeof(BBOX_VERTEX));
+	bbox->hedge = malloc((n > 0 ? n : 1) * sizeof(BBOX_EDGE));
+	bbox->vedge = malloc((n > 0 ? n : 1) * sizeof(BBOX_EDGE));
+	if(!bbox->vertex || !bbox->hedge || !bbox->vedge) {
+		printf("%s: memory leak. dying!\n",__FUNCTION__);
+		exit(0);
+	}
+	for(i = 0; i < n; i++) bbox->vertex[i] = nv[(first + i) % n];
+	free(nv);
+	bbox->num_vertices = n;
+	bbox->num_hedges = bbox->num_vedges = 0;
+	bbox->x1 = bbox->y1 = bbox->x2 = bbox->y2 = 0;
+
+	for(i = 0; i < n; i++) {
+		c = bbox->vertex[i];
+		q = bbox->vertex[(i + 1) % n];
+		if((i == 0) || (c.x < bbox->x1)) bbox->x1 = c.x;
+		if((i == 0) || (c.y < bbox->y1)) bbox->y1 = c.y;
+		if((i == 0) || (c.x > bbox->x2)) bbox->x2 = c.x;
+		if((i == 0) || (c.y > bbox->y2)) bbox->y2 = c.y;
+		if(c.y == q.y) {
+			k = bbox->num_hedges++;
+			bbox->hedge[k].c = c.y;
+			bbox->hedge[k].lo = MIN(c.x, q.x);
+			bbox->hedge[k].hi = MAX(c.x, q.x);
+		} else if(c.x == q.x) {
+			k = bbox->num_vedges++;
+			bbox->vedge[k].c = c.x;
+			bbox->vedge[k].lo = MIN(c.y, q.y);
+			bbox->vedge[k].hi = MAX(c.y, q.y);
+		}
 	}
-	return retpt;
+
+	compile_bbox(bbox);
+}
+
+// make a bbox the rectangle with corners x1,y1 and x2,y2
+void set_bbox_rect(BBOX bbox, int x1, int y1, int x2, int y2)
+{
+	BBOX_VERTEX v[4];
+	v[0].x = x1; v[0].y = y1;
+	v[1].x = x2; v[1].y = y1;
+	v[2].x = x2; v[2].y = y2;
+	v[3].x = x1; v[3].y = y2;
+	set_bbox_vertices(bbox, v, 4);
+}
+
+// trunk extent of a bbox, the rectangle enclosing all its edges.
+// returns FALSE if there is no bbox or it is empty.
+BOOL get_bbox_extent(BBOX bbox, int *x1, int *y1, int *x2, int *y2)
+{
+	if(!bbox) return FALSE;
+	if(bbox->num_vertices == 0) return FALSE;
+	*x1 = bbox->x1;
+	*y1 = bbox->y1;
+	*x2 = bbox->x2;
+	*y2 = bbox->y2;
+	return TRUE;
 }
 
 int get_bbox_area(NET net)
 {
-	int ret = 0;
-	int xmin;
-	POINT p = get_left_lower_trunk_point(net->bbox);
-	BBOX_LINE hlines1 = get_horizontal_lines(net->bbox->edges);
-	BBOX_LINE hlines2 = get_horizontal_lines(net->bbox->edges);
-	xmin = hlines1->pt1->x;
-	for(BBOX_LINE l1=hlines1;l1;l1=l1->next) if(l1->pt1->x<xmin) xmin = l1->pt1->x;
-	for(BBOX_LINE l1=hlines1;l1;l1=l1->next) {
-		for(BBOX_LINE l2=hlines2;l2;l2=l2->next) {
-		}
-	}
-	return ret;
-} // TODO: fix this!
+	if(!net->bbox) return 0;
+	return (int)(bbox_vertex_area2(net->bbox->vertex, net->bbox->num_vertices) / 2);
+}
 
 int net_absolute_distance(NET net)
 {
-	POINT pt1, pt2;
 	int distance, x, y;
-	pt1 = get_right_upper_trunk_point(net->bbox);
-	pt2 = get_left_lower_trunk_point(net->bbox);
-	x = pt1->x - pt2->x;
-	y = pt1->y - pt2->y;
+	x = net->bbox->x2 - net->bbox->x1;
+	y = net->bbox->y2 - net->bbox->y1;
 	distance = sqrt((x*x)+(y*y));
 	return distance;
 }
@@ -126,100 +198,50 @@ BBOX new_bbox()
 		printf("%s: memory leak. dying!\n",__FUNCTION__);
 		exit(0);
 	}
-	pt->edges = NULL;
-	pt->num_edges = 0;
+	pt->vertex = NULL;
+	pt->num_vertices = 0;
+	pt->x1 = pt->y1 = pt->x2 = pt->y2 = 0;
+	pt->hedge = NULL;
+	pt->vedge = NULL;
+	pt->num_hedges = 0;
+	pt->num_vedges = 0;
 	pt->x1_exception = FALSE;
 	pt->x2_exception = FALSE;
 	pt->y1_exception = FALSE;
 	pt->y2_exception = FALSE;
+	pt->raster = NULL;
+	pt->area = NULL;
 	return pt;
 }
 
-BBOX_LINE clone_line(BBOX_LINE orig)
-{
-	if(!orig) return NULL;
-	if(!orig->pt1) return NULL;
-	if(!orig->pt2) return NULL;
-	BBOX_LINE r = new_line();
-	r->pt1=clone_point(orig->pt1);
-	r->pt2=clone_point(orig->pt2);
-	r->next = NULL;
-	return r;
-}
-
-BBOX_LINE new_line()
+BBOX shrink_bbox(BBOX orig, int num_pixels)
 {
-	BBOX_LINE r = malloc(sizeof(struct bbox_line_));
-	if(!r) {
+	int x, y, n = orig->num_vertices;
+	BBOX ret;
+	BBOX_VERTEX *v = malloc((n > 0 ? n : 1) * sizeof(BBOX_VERTEX));
+	if(!v) {
 		printf("%s: memory leak. dying!\n",__FUNCTION__);
 		exit(0);
 	}
-	r->next = NULL;
-	r->pt1 = NULL;
-	r->pt2 = NULL;
-	return r;
-}
-
-BBOX_LINE clone_line_list(BBOX_LINE orig)
-{
-	if(!orig) return NULL;
-	BBOX_LINE nl = NULL;
-	BBOX_LINE head = NULL;
-	BBOX_LINE current = NULL;
-
-	head = clone_line(orig);
-	current = head;
-	for(BBOX_LINE t = orig->next; t; t=t->next) {
-		nl = clone_line(t);
-		current->next = nl;
-		current = current->next;
-	}
-
-	current->next = NULL;
-
-	return head;
-}
-
-BBOX shrink_bbox(BBOX orig, int num_pixels)
-{
-	int x, y;
-	POINT pt;
-	BBOX ret = clone_bbox(orig);
-	pt = get_left_lower_trunk_point(orig);
-	int xmin0 = pt->x;
-	int ymin0 = pt->y;
-	free(pt);
 
-	for(BBOX_LINE l=ret->edges;l;l=l->next) {
-		x=(l->pt1->x>xmin0)?l->pt1->x-xmin0:0;  // setting p0 as 0 point
+	for(int i = 0; i < n; i++) {
+		x=(orig->vertex[i].x>orig->x1)?orig->vertex[i].x-orig->x1:0;  // setting p0 as 0 point
 		x=(x>(num_pixels*2))?(x-(num_pixels*2)):0; // if not zero point, shorten
-		l->pt1->x=x;
-
-		y=(l->pt1->y>ymin0)?l->pt1->y-ymin0:0;  // setting p0 as 0 point
-		y=(y>(num_pixels*2))?(y-(num_pixels*2)):0; // if not zero point, shorten
-		l->pt1->y=y;
-
-		x=(l->pt2->x>xmin0)?l->pt2->x-xmin0:0;  // setting p0 as 0 point
-		x=(x>(num_pixels*2))?(x-(num_pixels*2)):0; // if not zero point, shorten
-		l->pt2->x=x;
-
-		y=(l->pt2->y>ymin0)?l->pt2->y-ymin0:0;  // setting p0 as 0 point
-		y=(y>(num_pixels*2))?(y-(num_pixels*2)):0; // if not zero point, shorten
-		l->pt2->y=y;
-
-		if(points_equal(l->pt1,l->pt2)) {
-			free(ret);
+		y=(orig->vertex[i].y>orig->y1)?orig->vertex[i].y-orig->y1:0;
+		y=(y>(num_pixels*2))?(y-(num_pixels*2)):0;
+		v[i].x=x+num_pixels+orig->x1; // shift right
+		v[i].y=y+num_pixels+orig->y1; // shift up
+	}
+	for(int i = 0; i < n; i++) {
+		if((v[i].x==v[(i+1)%n].x)&&(v[i].y==v[(i+1)%n].y)) { // an edge shrunk away
+			free(v);
 			return NULL;
-		} else {
-			// shift right
-			l->pt1->x+=num_pixels+xmin0;
-			l->pt2->x+=num_pixels+xmin0;
-			// shift up
-			l->pt1->y+=num_pixels+ymin0;
-			l->pt2->y+=num_pixels+ymin0;
 		}
 	}
 
+	ret = new_bbox();
+	set_bbox_vertices(ret, v, n);
+	free(v);
 	return ret;
 }
 
@@ -227,8 +249,11 @@ BBOX clone_bbox(BBOX orig)
 {
 	if(!orig) return NULL;
 	BBOX r = new_bbox();
-	r->edges = clone_line_list(orig->edges);
-	r->num_edges = orig->num_edges;
+	r->x1_exception = orig->x1_exception;
+	r->x2_exception = orig->x2_exception;
+	r->y1_exception = orig->y1_exception;
+	r->y2_exception = orig->y2_exception;
+	set_bbox_vertices(r, orig->vertex, orig->num_vertices);
 	return r;
 }
 
@@ -254,245 +279,393 @@ BOOL gpoints_equal(GRIDP p1, GRIDP p2)
 	return FALSE;
 }
 
-BOOL lines_equal(BBOX_LINE l1, BBOX_LINE l2)
+BOOL check_grid_point_area(BBOX bbox, GRIDP gpnt, BOOL with_edge, int edge_distance)
 {
-	if(!l1) return FALSE;
-	if(!l2) return FALSE;
-	if(points_equal(l1->pt1,l2->pt1)&&points_equal(l1->pt2,l2->pt2)) return TRUE;
-	if(points_equal(l1->pt1,l2->pt2)&&points_equal(l1->pt2,l2->pt1)) return TRUE;
-	return FALSE;
+	return check_xy_area(bbox, gpnt.x, gpnt.y, with_edge, edge_distance);
 }
 
-BOOL edge_contains_line(BBOX_LINE list, BBOX_LINE line)
+/*--------------------------------------------------------------*/
+/* Rasterized bbox membership.					*/
+/*								*/
+/* A point is inside a bbox if there is a horizontal edge below	*/
+/* and one above it, and a vertical edge to its left and one to	*/
+/* its right, each spanning the point and each at least		*/
+/* edge_distance away (or touching, if with_edge is set).  The	*/
+/* edge_distance is waived on sides clipped to the die area.	*/
+/* For the two combinations the router uses, the test is	*/
+/* evaluated once per row for the whole trunk extent and kept	*/
+/* as a bitmap on the bbox, so the router's per-position checks	*/
+/* neither walk the edges nor allocate.  Other combinations	*/
+/* test the edges directly.					*/
+/*								*/
+/* The bitmaps and the area further down are only built and	*/
+/* freed by set_bbox_vertices() and free_bbox(), never by a	*/
+/* check.  A bbox is only changed by the thread that owns it:	*/
+/* the router thread for its own temporary bboxes, and for net	*/
+/* bboxes the main thread, or the dispatcher under poolMutex	*/
+/* for a net not yet handed out, while no other thread looks	*/
+/* at it.  poolMutex then publishes the bbox to the router	*/
+/* thread the net is handed to.  The checks therefore only	*/
+/* read, and take no lock.					*/
+/*--------------------------------------------------------------*/
+
+void invalidate_bbox_raster(BBOX bbox)
 {
-	if(!list) return FALSE;
-	if(!line) return FALSE;
-	for(BBOX_LINE l=list;l;l=l->next) if(lines_equal(line,l)) return TRUE;
-	return FALSE;
+	BBOX_RASTER r;
+	if(!bbox) return;
+	bump_bbox_generation();
+	while((r = bbox->raster) != NULL) {
+		bbox->raster = r->next;
+		free(r->bits);
+		free(r);
+	}
+	if(bbox->area) {
+		free(bbox->area->rects);
+		free(bbox->area);
+		bbox->area = NULL;
+	}
 }
 
-BBOX_LINE add_line_to_edge(BBOX_LINE list, BBOX_LINE l)
+static BBOX_RASTER compile_bbox_raster(BBOX bbox, BOOL with_edge, int edge_distance)
 {
-	if(!l) return list;
-	if(edge_contains_line(list,l))
-		return list;
+	BBOX_RASTER r;
+	BBOX_EDGE *e;
+	u_char *below, *above;
+	int xmin, xmax, ymin, ymax;
+	int lxmin, lxmax;
+	int i, x, y, lo, hi, d;
 
-	BBOX_LINE line = clone_line(l); // cloning line
-	line->next = list;
-	return line;
+	// trunk extent, clipped to the die
+	xmin = MAX(bbox->x1, 0);
+	ymin = MAX(bbox->y1, 0);
+	xmax = MIN(bbox->x2, NumChannelsX[0]);
+	ymax = MIN(bbox->y2, NumChannelsY[0]);
+
+	r = malloc(sizeof(struct bbox_raster_));
+	if(!r) {
+		printf("%s: memory leak. dying!\n",__FUNCTION__);
+		exit(0);
+	}
+	r->next = NULL;
+	r->with_edge = with_edge;
+	r->edge_distance = edge_distance;
+	r->x0 = xmin;
+	r->y0 = ymin;
+	r->width = ((bbox->num_vertices == 0) || (xmax < xmin)) ? 0 : xmax - xmin + 1;
+	r->height = ((bbox->num_vertices == 0) || (ymax < ymin)) ? 0 : ymax - ymin + 1;
+	r->rowbytes = (r->width + 7) >> 3;
+	r->bits = NULL;
+	if((r->width == 0) || (r->height == 0)) return r;
+
+	r->bits = calloc(r->rowbytes * r->height, sizeof(u_char));
+	below = malloc(r->width);
+	above = malloc(r->width);
+	if(!r->bits || !below || !above) {
+		printf("%s: memory leak. dying!\n",__FUNCTION__);
+		exit(0);
+	}
+
+	for(y = ymin; y <= ymax; y++) {
+		lo = xmax + 1;
+		hi = xmin - 1;
+		memset(below, 0, r->width);
+		memset(above, 0, r->width);
+		for(i = 0; i < bbox->num_hedges; i++) {
+			e = &bbox->hedge[i];
+			lxmin = (e->lo < xmin) ? xmin : e->lo;
+			lxmax = (e->hi > xmax) ? xmax : e->hi;
+			if(lxmin > lxmax) continue;
+			d = (with_edge || bbox->y1_exception) ? 0 : edge_distance;
+			if(with_edge ? (y >= e->c) : (y > e->c + d))
+				memset(below + lxmin - xmin, 1, lxmax - lxmin + 1);
+			d = (with_edge || bbox->y2_exception) ? 0 : edge_distance;
+			if(with_edge ? (y <= e->c) : (y < e->c - d))
+				memset(above + lxmin - xmin, 1, lxmax - lxmin + 1);
+		}
+		for(i = 0; i < bbox->num_vedges; i++) {
+			e = &bbox->vedge[i];
+			if((y < e->lo) || (y > e->hi)) continue;
+			d = (with_edge || bbox->x1_exception) ? 0 : edge_distance;
+			x = with_edge ? e->c : e->c + d + 1; // first x right of line
+			if(x < lo) lo = x;
+			d = (with_edge || bbox->x2_exception) ? 0 : edge_distance;
+			x = with_edge ? e->c : e->c - d - 1; // last x left of line
+			if(x > hi) hi = x;
+		}
+		if(lo < xmin) lo = xmin;
+		if(hi > xmax) hi = xmax;
+		for(x = lo; x <= hi; x++)
+			if(below[x - xmin] && above[x - xmin])
+				r->bits[(y - ymin) * r->rowbytes + ((x - xmin) >> 3)] |= 1 << ((x - xmin) & 7);
+	}
+
+	free(below);
+	free(above);
+	return r;
+}
+
+// the membership rule of the raster, for one position
+static BOOL test_bbox_xy(BBOX bbox, int x, int y, BOOL with_edge, int edge_distance)
+{
+	BBOX_EDGE *e;
+	BOOL below = FALSE, above = FALSE, left = FALSE, right = FALSE;
+	int i, d;
+
+	if((x < MAX(bbox->x1, 0)) || (x > MIN(bbox->x2, NumChannelsX[0]))) return FALSE;
+	if((y < MAX(bbox->y1, 0)) || (y > MIN(bbox->y2, NumChannelsY[0]))) return FALSE;
+
+	for(i = 0; i < bbox->num_hedges; i++) {
+		e = &bbox->hedge[i];
+		if((x < e->lo) || (x > e->hi)) continue;
+		d = (with_edge || bbox->y1_exception) ? 0 : edge_distance;
+		if(with_edge ? (y >= e->c) : (y > e->c + d)) below = TRUE;
+		d = (with_edge || bbox->y2_exception) ? 0 : edge_distance;
+		if(with_edge ? (y <= e->c) : (y < e->c - d)) above = TRUE;
+	}
+	if(!below || !above) return FALSE;
+
+	for(i = 0; i < bbox->num_vedges; i++) {
+		e = &bbox->vedge[i];
+		if((y < e->lo) || (y > e->hi)) continue;
+		d = (with_edge || bbox->x1_exception) ? 0 : edge_distance;
+		if((with_edge ? e->c : e->c + d + 1) <= x) left = TRUE;
+		d = (with_edge || bbox->x2_exception) ? 0 : edge_distance;
+		if((with_edge ? e->c : e->c - d - 1) >= x) right = TRUE;
+	}
+	return left && right;
 }
 
-BBOX add_line_to_bbox(BBOX bbox, BBOX_LINE ol)
+// check whether grid position (x,y) is within borders
+BOOL check_xy_area(BBOX bbox, int x, int y, BOOL with_edge, int edge_distance)
 {
-	if(!ol) return bbox;
-	BBOX b = (bbox)?bbox:new_bbox();
-	b->num_edges++; // incrementing line count
-	b->edges=add_line_to_edge(b->edges, ol);
-	return b;
+	BBOX_RASTER r;
+	if(!bbox) return FALSE;
+	if(bbox->num_vertices<4) return FALSE;
+
+	if(with_edge) edge_distance = 0; // not used by the edge test
+	for(r = bbox->raster; r; r = r->next)
+		if((r->with_edge == with_edge) && (r->edge_distance == edge_distance)) break;
+	if(!r) return test_bbox_xy(bbox, x, y, with_edge, edge_distance);
+
+	x -= r->x0;
+	y -= r->y0;
+	if((x < 0) || (x >= r->width) || (y < 0) || (y >= r->height)) return FALSE;
+	return (r->bits[y * r->rowbytes + (x >> 3)] >> (x & 7)) & 1;
 }
 
-BOOL check_point_to_line(int mode, BBOX_LINE line, POINT pnt, BOOL with_edge, int edge_distance)
+// check whether pnt of point is within borders
+BOOL check_point_area(BBOX bbox, POINT pnt, BOOL with_edge, int edge_distance)
 {
-	if(!line) return FALSE;
 	if(!pnt) return FALSE;
-	if(!(line->pt1)) return FALSE;
-	if(!(line->pt2)) return FALSE;
-	int xmin, xmax;
-	int ymin, ymax;
-	int x,y;
-
-	if(mode&CHECK_POINT_HORIZONTAL) {
-		if(line->pt1->y!=line->pt2->y) return FALSE; // not a horizontal line!
-	} else if(mode&CHECK_POINT_VERTICAL) {
-		if(line->pt1->x!=line->pt2->x) return FALSE; // not a vertical line!
-	}
+	return check_xy_area(bbox, pnt->x, pnt->y, with_edge, edge_distance);
+}
 
-	xmin=(line->pt1->x<line->pt2->x)?line->pt1->x:line->pt2->x;
-	xmax=(line->pt1->x>line->pt2->x)?line->pt1->x:line->pt2->x;
-	ymin=(line->pt1->y<line->pt2->y)?line->pt1->y:line->pt2->y;
-	ymax=(line->pt1->y>line->pt2->y)?line->pt1->y:line->pt2->y;
-
-	switch(mode) {
-		case CHECK_POINT_ABOVE_HLINE:
-			y=(with_edge)?ymin:ymin+edge_distance;
-			if(with_edge) { if(pnt->y<y) return FALSE; } // point is under hline y
-			else if(pnt->y<=y) return FALSE; // point is under hline y or equal
-			break;
-		case CHECK_POINT_UNDER_HLINE:
-			y=(with_edge)?ymin:ymin-edge_distance;
-			if(with_edge) { if(pnt->y>y) return FALSE; } // point is over hline y
-			else if(pnt->y>=y) return FALSE; // point is over hline y or equal
-			break;
-		case CHECK_POINT_LEFT_VLINE:
-			x=(with_edge)?xmin:xmin-edge_distance;
-			if(with_edge) { if(pnt->x>x) return FALSE; } // point is right of line
-			else if(pnt->x>=x) return FALSE; // point is left of line or equal
-			break;
-		case CHECK_POINT_RIGHT_VLINE:
-			x=(with_edge)?xmin:xmin+edge_distance;
-			if(with_edge) { if(pnt->x<x) return FALSE; } // point is left of line
-			else if(pnt->x<=x) return FALSE; // point is left of line or equal
-			break;
-	}
+/*--------------------------------------------------------------*/
+/* Bbox area as rectangles.					*/
+/*								*/
+/* The membership rule of the raster, with edges included, is	*/
+/* a conjunction of four conditions, one per direction, and	*/
+/* each of them only changes at the y coordinates of the edge	*/
+/* end points.  Between two such coordinates the area is	*/
+/* therefore the same set of x intervals on every row, so the	*/
+/* area splits into one row at each coordinate and one band	*/
+/* between each pair of them, and each of those into a few	*/
+/* rectangles, ordered by rows.  The collision test then finds	*/
+/* the rectangles a line or point of the other bbox may hit by	*/
+/* bisection, instead of visiting every grid position on the	*/
+/* line.							*/
+/*--------------------------------------------------------------*/
 
-	if(mode&CHECK_POINT_HORIZONTAL) {
-		if((pnt->x>=xmin)&&(pnt->x<=xmax)) return TRUE;
-	} else if(mode&CHECK_POINT_VERTICAL) {
-		if((pnt->y>=ymin)&&(pnt->y<=ymax)) return TRUE;
-	}
+static int compare_area_lines(const void *a, const void *b)
+{
+	const BBOX_EDGE *la = a, *lb = b;
+	return (la->lo < lb->lo) ? -1 : (la->lo > lb->lo) ? 1 : 0;
+}
 
-	return FALSE;
+static int compare_ints(const void *a, const void *b)
+{
+	int ia = *(const int *)a, ib = *(const int *)b;
+	return (ia < ib) ? -1 : (ia > ib) ? 1 : 0;
 }
 
-// check whether a line goes through another area
-BOOL check_line_area(BBOX bbox, BBOX_LINE line, BOOL with_edge)
+static void add_area_rect(BBOX_AREA a, int *max, int x1, int y1, int x2, int y2)
 {
-	BOOL ret = FALSE;
-	int xmin, xmax, ymin, ymax;
-	POINT vpnt = create_point(0,0,0);
-	if(line->pt1->x==line->pt2->x) {
-		ymin=(line->pt1->y<line->pt2->y)?line->pt1->y:line->pt2->y;
-		ymax=(line->pt1->y>line->pt2->y)?line->pt1->y:line->pt2->y;
-		vpnt->x=line->pt1->x;
-		for(vpnt->y=ymin;vpnt->y<ymax;vpnt->y++) if(check_point_area(bbox,vpnt,with_edge,0)) ret=TRUE;
-	}
-	if(line->pt1->y==line->pt2->y) {
-		xmin=(line->pt1->x<line->pt2->x)?line->pt1->x:line->pt2->x;
-		xmax=(line->pt1->x>line->pt2->x)?line->pt1->x:line->pt2->x;
-		vpnt->y=line->pt1->y;
-		for(vpnt->x=xmin;vpnt->x<xmax;vpnt->x++) if(check_point_area(bbox,vpnt,with_edge,0)) ret=TRUE;
+	if(a->num_rects == *max) {
+		*max = (*max == 0) ? 8 : (*max << 1);
+		a->rects = realloc(a->rects, *max * sizeof(BBOX_RECT));
+		if(!a->rects) {
+			printf("%s: memory leak. dying!\n",__FUNCTION__);
+			exit(0);
+		}
 	}
-	free(vpnt);
-	return ret;
+	a->rects[a->num_rects].x1 = x1;
+	a->rects[a->num_rects].y1 = y1;
+	a->rects[a->num_rects].x2 = x2;
+	a->rects[a->num_rects].y2 = y2;
+	a->num_rects++;
 }
 
-BOOL check_grid_point_area(BBOX bbox, GRIDP gpnt, BOOL with_edge, int edge_distance)
+/* Merge the spans of the lines in hl[] (sorted by x) on rows	*/
+/* ymin to ymax into disjoint spans, and return their number.	*/
+static int merge_area_spans(BBOX_EDGE *hl, int nh, int ymin, int ymax, BBOX_EDGE *span)
 {
-	if(!bbox) return FALSE;
-	if(bbox->num_edges<4) return FALSE;
-	BOOL ret;
-	POINT pnt = create_point(gpnt.x,gpnt.y,gpnt.lay);
-	ret=check_point_area(bbox, pnt, with_edge, edge_distance);
-	free(pnt);
-	return ret;
+	int n = 0;
+	for(int i = 0; i < nh; i++) {
+		if((hl[i].c < ymin) || (hl[i].c > ymax)) continue;
+		if((n > 0) && (hl[i].lo <= span[n - 1].hi + 1)) {
+			if(hl[i].hi > span[n - 1].hi) span[n - 1].hi = hl[i].hi;
+		} else
+			span[n++] = hl[i];
+	}
+	return n;
 }
 
-int count_line_list(BBOX_LINE list)
+/* Add the rectangles of rows y1 to y2, on which the same lines apply */
+static void add_area_band(BBOX_AREA a, int *max, BBOX_EDGE *hl, int nh,
+		BBOX_EDGE *vl, int nv, BBOX_EDGE *below, BBOX_EDGE *above,
+		int y1, int y2)
 {
-	int ret=0;
-	if(!list) return ret;
-	for(BBOX_LINE l=list;l;l=l->next) {
-		ret++;
+	int i, j, nb, na, lo, hi;
+	int xmin = 0, xmax = 0;
+	BOOL found = FALSE;
+
+	if(y1 < 0) y1 = 0;
+	if(y2 > NumChannelsY[0]) y2 = NumChannelsY[0];
+	if(y1 > y2) return;
+
+	// x range between the outermost vertical lines spanning the band
+	for(i = 0; i < nv; i++) {
+		if((vl[i].lo > y1) || (vl[i].hi < y2)) continue;
+		if(!found || (vl[i].c < xmin)) xmin = vl[i].c;
+		if(!found || (vl[i].c > xmax)) xmax = vl[i].c;
+		found = TRUE;
+	}
+	if(!found) return;
+
+	// Each overlap of a span of lines below the band with a span
+	// of lines above it is a rectangle.
+	nb = merge_area_spans(hl, nh, INT_MIN, y1, below);
+	na = merge_area_spans(hl, nh, y2, INT_MAX, above);
+	for(i = j = 0; (i < nb) && (j < na);) {
+		lo = MAX(MAX(below[i].lo, above[j].lo), xmin);
+		hi = MIN(MIN(below[i].hi, above[j].hi), xmax);
+		if(lo <= hi) add_area_rect(a, max, lo, y1, hi, y2);
+		if(below[i].hi < above[j].hi) i++;
+		else j++;
 	}
-	return ret;
 }
 
-BOOL is_closed_shape(BBOX box)
+static BBOX_AREA compile_bbox_area(BBOX bbox)
 {
-	BOOL ret = FALSE;
-	if(!box) return FALSE;
-	if(!box->edges) return FALSE;
-	if(box->num_edges<4) return FALSE;
-
-	BBOX_LINE obj = clone_line_list(box->edges);
-	BBOX_LINE edge = NULL;
-
-	POINT pt = clone_point(obj->pt1);
-	for(BBOX_LINE l2=obj;l2;l2=l2->next) {
-		for(BBOX_LINE l=obj;l;l=l->next) {
-			if(edge_contains_line(edge,l)) continue;
-			if(points_equal(pt,l->pt1)) {
-				free(pt);
-				pt=clone_point(l->pt2);
-				edge=add_line_to_edge(edge,l);
-				break;
-			}
-			if(points_equal(pt,l->pt2)) {
-				free(pt);
-				pt=clone_point(l->pt1);
-				edge=add_line_to_edge(edge,l);
-				break;
-			}
-		}
+	BBOX_AREA a;
+	BBOX_EDGE *hl, *vl, *below, *above;
+	int *ys;
+	int nh = 0, nv = bbox->num_vedges, ny = 0, max = 0;
+	int i, k, n = bbox->num_vertices;
+
+	a = malloc(sizeof(struct bbox_area_));
+	if(!a) {
+		printf("%s: memory leak. dying!\n",__FUNCTION__);
+		exit(0);
+	}
+	a->num_rects = 0;
+	a->rects = NULL;
+	if(n < 4) return a;
+
+	hl = malloc(n * sizeof(BBOX_EDGE));
+	below = malloc(n * sizeof(BBOX_EDGE));
+	above = malloc(n * sizeof(BBOX_EDGE));
+	ys = malloc(2 * n * sizeof(int));
+	if(!hl || !below || !above || !ys) {
+		printf("%s: memory leak. dying!\n",__FUNCTION__);
+		exit(0);
 	}
 
-	if(count_line_list(edge)==count_line_list(obj)) ret = TRUE;
+	// horizontal edges clipped to the die, sorted by x
+	for(i = 0; i < bbox->num_hedges; i++) {
+		hl[nh] = bbox->hedge[i];
+		hl[nh].lo = MAX(hl[nh].lo, 0);
+		hl[nh].hi = MIN(hl[nh].hi, NumChannelsX[0]);
+		if(hl[nh].lo <= hl[nh].hi) nh++;
+		ys[ny++] = bbox->hedge[i].c;
+	}
+	vl = bbox->vedge;
+	for(i = 0; i < nv; i++) {
+		ys[ny++] = vl[i].lo;
+		ys[ny++] = vl[i].hi;
+	}
+	qsort(hl, nh, sizeof(BBOX_EDGE), compare_area_lines);
+	qsort(ys, ny, sizeof(int), compare_ints);
+
+	for(k = 0; k < ny; k++) {
+		if((k > 0) && (ys[k] == ys[k - 1])) continue;
+		add_area_band(a, &max, hl, nh, vl, nv, below, above, ys[k], ys[k]);
+		for(i = k + 1; (i < ny) && (ys[i] == ys[k]); i++);
+		if(i < ny)
+			add_area_band(a, &max, hl, nh, vl, nv, below, above,
+					ys[k] + 1, ys[i] - 1);
+	}
 
-	free(pt);
-	free_line_list(edge);
-	free_line_list(obj);
+	free(hl);
+	free(below);
+	free(above);
+	free(ys);
+	return a;
+}
 
-	return ret;
+// build the membership tests of a bbox from its edges
+static void compile_bbox(BBOX bbox)
+{
+	BBOX_RASTER r;
+
+	r = compile_bbox_raster(bbox, FALSE, WIRE_ROOM);
+	r->next = compile_bbox_raster(bbox, TRUE, 0);
+	bbox->raster = r;
+	bbox->area = compile_bbox_area(bbox);
 }
 
-// check whether pnt of point is within borders
-BOOL check_point_area(BBOX bbox, POINT pnt, BOOL with_edge, int edge_distance)
+/* Check whether any grid position of rows y1 to y2 and columns	*/
+/* x1 to x2 lies in area "a".  The rectangles are ordered by	*/
+/* rows, so the first one that may be hit is found by bisection.	*/
+static BOOL range_in_area(BBOX_AREA a, int x1, int y1, int x2, int y2)
 {
-	if(!bbox) return FALSE;
-	if(!bbox->edges) return FALSE;
-	if(bbox->num_edges<4) return FALSE;
-	if(!pnt) return FALSE;
-	int xmin, xmax, ymin, ymax;
-	BBOX_LINE hlines = NULL, vlines = NULL;
-
-	// first check die area
-	if((pnt->x<0)||(pnt->x>NumChannelsX[0])||(pnt->y<0)||(pnt->y>NumChannelsY[0])) return FALSE; // outside die
-
-	// is not a closed shape then false
-	//if(!is_closed_shape(bbox)) return FALSE;
-
-	// then  check trunk box
-	POINT pt1 = get_left_lower_trunk_point(bbox);
-	POINT pt2 = get_right_upper_trunk_point(bbox);
-	if(!pt1) return FALSE;
-	if(!pt2) return FALSE;
-	xmin=pt1->x;
-	xmax=pt2->x;
-	ymin=pt1->y;
-	ymax=pt2->y;
-	free(pt1);
-	free(pt2);
-	if((pnt->x<xmin)||(pnt->x>xmax)||(pnt->y<ymin)||(pnt->y>ymax)) return FALSE; // outside trunk
-
-	// now check structure
-	hlines = get_horizontal_lines(bbox->edges);
-	vlines = get_vertical_lines(bbox->edges);
-	for(BBOX_LINE hll = hlines;hll;hll=hll->next) { // horizontal lower line hll
-		//if(bbox->y1_exception) printf("%s lower die area violated, adapting\n",__FUNCTION__);
-		if(check_point_to_line(CHECK_POINT_ABOVE_HLINE,hll,pnt,with_edge,bbox->y1_exception?0:edge_distance)) {
-			for(BBOX_LINE vrl = vlines;vrl;vrl=vrl->next) { // vertical right line vrl
-				//if(bbox->x2_exception) printf("%s right die area violated, adapting\n",__FUNCTION__);
-				if(check_point_to_line(CHECK_POINT_LEFT_VLINE,vrl,pnt,with_edge,bbox->x2_exception?0:edge_distance)) {
-					for(BBOX_LINE hul = hlines;hul;hul=hul->next) { // horizontal upper line hul
-						//if(bbox->y2_exception) printf("%s upper die area violated, adapting\n",__FUNCTION__);
-						if(check_point_to_line(CHECK_POINT_UNDER_HLINE,hul,pnt,with_edge,bbox->y2_exception?0:edge_distance)) {
-							for(BBOX_LINE vll = vlines;vll;vll=vll->next) { // vertical left line vll
-								//if(bbox->x1_exception) printf("%s left die area violated, adapting\n",__FUNCTION__);
-								if(check_point_to_line(CHECK_POINT_RIGHT_VLINE,vll,pnt,with_edge,bbox->x1_exception?0:edge_distance)) {
-									free_line_list(hlines);
-									free_line_list(vlines);
-									return TRUE;
-								}
-							}
-						}
-					}
-				}
-			}
-		}
+	BBOX_RECT *r;
+	int lo = 0, hi = a->num_rects, mid;
+
+	while(lo < hi) {
+		mid = (lo + hi) >> 1;
+		if(a->rects[mid].y2 < y1) lo = mid + 1;
+		else hi = mid;
+	}
+	for(; (lo < a->num_rects) && (a->rects[lo].y1 <= y2); lo++) {
+		r = &a->rects[lo];
+		if((r->x1 <= x2) && (r->x2 >= x1)) return TRUE;
 	}
-	free_line_list(hlines);
-	free_line_list(vlines);
 	return FALSE;
 }
 
-// check whether b2 is totally within b1
-BOOL partial_bbox_overlap(BBOX b1, BBOX b2)
+/* Check whether all vertices of "b" lie in area "a" */
+static BOOL bbox_points_in_area(BBOX b, BBOX_AREA a)
 {
-	if(!b1) return FALSE;
-	if(!b2) return FALSE;
-	BOOL ret=FALSE;
-	for(BBOX_LINE l=b2->edges;l;l=l->next) if(check_line_area(b1,l,TRUE)) ret=TRUE;
-	return ret;
+	for(int i=0;i<b->num_vertices;i++)
+		if(!range_in_area(a,b->vertex[i].x,b->vertex[i].y,b->vertex[i].x,b->vertex[i].y)) return FALSE;
+	return TRUE;
+}
+
+/* Check whether any edge of "b" passes through area "a".  The	*/
+/* end of each edge is left to the edge it starts.		*/
+static BOOL bbox_lines_in_area(BBOX b, BBOX_AREA a)
+{
+	BBOX_EDGE *e;
+	for(int i=0;i<b->num_vedges;i++) {
+		e=&b->vedge[i];
+		if(range_in_area(a,e->c,e->lo,e->c,e->hi-1)) return TRUE;
+	}
+	for(int i=0;i<b->num_hedges;i++) {
+		e=&b->hedge[i];
+		if(range_in_area(a,e->lo,e->c,e->hi-1,e->c)) return TRUE;
+	}
+	return FALSE;
 }
 
 // check whether b2 is totally within b1
@@ -500,40 +673,117 @@ BOOL box2_inside_box1(BBOX b1, BBOX b2)
 {
 	if(!b1) return FALSE;
 	if(!b2) return FALSE;
-	POINT p1, p2;
-	BOOL ret=TRUE;
-	for(BBOX_LINE l=b2->edges;l;l=l->next) {
-		p1=l->pt1;
-		p2=l->pt2;
-		if(!check_point_area(b1,p1,TRUE,0)) ret=FALSE;
-		if(!check_point_area(b1,p2,TRUE,0)) ret=FALSE;
-	}
-	return ret;
+	for(int i=0;i<b2->num_vertices;i++)
+		if(!check_xy_area(b1,b2->vertex[i].x,b2->vertex[i].y,TRUE,0)) return FALSE;
+	return TRUE;
 }
 
+// two bboxes collide if either lies inside the other, or if an edge
+// of either passes through the other.  an empty bbox lies inside
+// everything.
 BOOL check_single_bbox_collision(BBOX box1, BBOX box2)
 {
+	BBOX_AREA a1, a2;
 	if(!box1) return TRUE;
 	if(!box2) return TRUE;
 	if(box1==box2) return TRUE;
-	BOOL ret=FALSE;
-	if(box2_inside_box1(box1,box2)) ret=TRUE;
-	if(box2_inside_box1(box2,box1)) ret=TRUE;
-	if(partial_bbox_overlap(box1,box2)) ret=TRUE;
-	if(partial_bbox_overlap(box2,box1)) ret=TRUE;
-	return ret;
+	if(box1->num_vertices==0) return TRUE;
+	if(box2->num_vertices==0) return TRUE;
+	a1=box1->area;
+	a2=box2->area;
+	if(bbox_lines_in_area(box2,a1)) return TRUE;
+	if(bbox_lines_in_area(box1,a2)) return TRUE;
+	if(bbox_points_in_area(box2,a1)) return TRUE;
+	if(bbox_points_in_area(box1,a2)) return TRUE;
+	return FALSE;
+}
+
+/*--------------------------------------------------------------*/
+/* Bbox collision candidates.					*/
+/*								*/
+/* Two bin indexes (bbindex.c) narrow the collision checks	*/
+/* below to the nets whose bbox extent overlaps that of the	*/
+/* query net.  "inFlight" holds the nets in CurNet[], keyed by	*/
+/* router thread, and is kept up to date by set_current_net().	*/
+/* "allNets" holds Nlnets[], keyed by net order, and is rebuilt	*/
+/* whenever a bbox, the net order or the net list has changed	*/
+/* since it was last built (see BboxGeneration).  The loops	*/
+/* visit the candidate keys in ascending order, so they find	*/
+/* the same nets in the same order as a scan of all keys.	*/
+/*--------------------------------------------------------------*/
+
+static u_int BboxGeneration = 0;
+
+TCL_DECLARE_MUTEX(bboxGenerationMutex)
+
+/* Note a change of a bbox, the net order or the net list */
+void bump_bbox_generation()
+{
+	Tcl_MutexLock(&bboxGenerationMutex);
+	BboxGeneration++;
+	Tcl_MutexUnlock(&bboxGenerationMutex);
+}
+
+static u_int get_bbox_generation()
+{
+	u_int g;
+	Tcl_MutexLock(&bboxGenerationMutex);
+	g = BboxGeneration;
+	Tcl_MutexUnlock(&bboxGenerationMutex);
+	return g;
+}
+
+static BBINDEX inFlight = NULL;
+static BBINDEX allNets = NULL;
+static u_int allNetsGeneration;
+static NET *allNetsList = NULL;
+static int allNetsCount = 0;
+
+/* Empty CurNet[] of "numthreads" threads.  Callers hold poolMutex */
+void clear_current_nets(int numthreads)
+{
+	for(int i=0; i<numthreads; i++) CurNet[i]=NULL;
+	if(!inFlight) inFlight=bbindex_new();
+	else bbindex_clear(inFlight);
+}
+
+/* Set the net in flight of thread "thnum".  Callers hold poolMutex */
+void set_current_net(int thnum, NET net)
+{
+	if(CurNet[thnum]) bbindex_remove(inFlight, CurNet[thnum]);
+	CurNet[thnum]=net;
+	if(net) bbindex_insert(inFlight, net, thnum);
+}
+
+static int *query_all_nets(NET net, int *count)
+{
+	u_int generation=get_bbox_generation();
+	if(!allNets||(allNetsGeneration!=generation)||
+			(allNetsList!=Nlnets)||(allNetsCount!=Numnets)) {
+		if(!allNets) allNets=bbindex_new();
+		else bbindex_clear(allNets);
+		for(int i=0; i<Numnets; i++)
+			if(Nlnets[i]) bbindex_insert(allNets, Nlnets[i], i);
+		allNetsGeneration=generation;
+		allNetsList=Nlnets;
+		allNetsCount=Numnets;
+	}
+	return bbindex_query(allNets, net, count);
 }
 
 NETLIST get_bbox_collisions(NET net, BOOL thread)
 {
 	NETLIST ret = NULL;
 	NET n;
+	int *cand, count;
 	if(!net) return NULL;
 	if(!net->bbox) return NULL;
-	if(net->bbox->num_edges<4) return NULL;
+	if(net->bbox->num_vertices<4) return NULL;
 	if(thread==FOR_THREAD) {
-		for(int i=0; i<MAX_NUM_THREADS; i++) {
-			n = CurNet[i];
+		if(!inFlight) return NULL;
+		cand = bbindex_query(inFlight, net, &count);
+		for(int i=0; i<count; i++) {
+			n = CurNet[cand[i]];
 			if(n) {
 				if(n!=net) {
 					if(check_single_bbox_collision(net->bbox,n->bbox)) {
@@ -544,8 +794,9 @@ NETLIST get_bbox_collisions(NET net, BOOL thread)
 		}
 	}
 	if(thread==NOT_FOR_THREAD) {
-		for(int i=0; i<Numnets; i++) {
-			n = getnettoroute(i);
+		cand = query_all_nets(net, &count);
+		for(int i=0; i<count; i++) {
+			n = getnettoroute(cand[i]);
 			if(n) {
 				if((n!=net)&&!is_gndnet(n)&&!is_vddnet(n)&&!is_clknet(n)) {
 					if(check_single_bbox_collision(net->bbox,n->bbox)) {
@@ -562,10 +813,13 @@ BOOL check_bbox_collisions(NET net, BOOL thread)
 {
 	NET n;
 	BOOL ret = FALSE;
+	int *cand, count;
 	if(!net) return TRUE;
 	if(thread==FOR_THREAD) {
-		for(int i=0; i<MAX_NUM_THREADS; i++) {
-			n = CurNet[i];
+		if(!inFlight) return FALSE;
+		cand = bbindex_query(inFlight, net, &count);
+		for(int i=0; i<count; i++) {
+			n = CurNet[cand[i]];
 			if(n) {
 				if(n!=net) {
 					if(check_single_bbox_collision(net->bbox,n->bbox)) {
@@ -576,8 +830,9 @@ BOOL check_bbox_collisions(NET net, BOOL thread)
 		}
 	}
 	if(thread==NOT_FOR_THREAD) {
-		for(int i=0; i<Numnets; i++) {
-			n = getnettoroute(i);
+		cand = query_all_nets(net, &count);
+		for(int i=0; i<count; i++) {
+			n = getnettoroute(cand[i]);
 			if(n) {
 				if((n!=net)&&!is_gndnet(n)&&!is_vddnet(n)&&!is_clknet(n)&&!n->routed) {
 					if(check_single_bbox_collision(net->bbox,n->bbox)) {
@@ -593,367 +848,238 @@ BOOL check_bbox_collisions(NET net, BOOL thread)
 void free_bbox(BBOX t)
 {
 	if(!t) return;
-	free_line_list(t->edges);
-	t->edges = NULL;
-	free(t);
-}
-
-void free_line(BBOX_LINE t)
-{
-	if(!t) return;
-	if(!t->pt1) return;
-	if(!t->pt2) return;
-	free(t->pt1);
-	free(t->pt2);
+	invalidate_bbox_raster(t);
+	free(t->vertex);
+	free(t->hedge);
+	free(t->vedge);
 	free(t);
 }
 
-BBOX_LINE delete_line_from_edge(BBOX_LINE vbox, BBOX_LINE l)
-{
-	if(!vbox) return NULL;
-	if(!l) return vbox;
-	if(edge_contains_line(vbox,l)) {
-		BBOX_LINE i = vbox;
-		BBOX_LINE last = NULL;
-		while(!lines_equal(i,l)) {
-			last=i;
-			i=i->next;
-		}
-		if(last) last->next=i->next;
-		else vbox=i->next;
-		free(i);
-	}
-	return vbox;
-}
-
 // checks whether all taps are inside vbox
 // return FALSE if not and otherwise TRUE
 BOOL check_bbox_consistency(NET net, BBOX vbox)
 {
 	if(!net) return FALSE;
 	if(!vbox) return FALSE;
-	if(!vbox->edges) return FALSE;
-	if(!is_closed_shape(vbox)) return FALSE;
+	if(vbox->num_vertices<4) return FALSE;
 
-	POINT vpnt;
 	DPOINT dtap;
-	BOOL ok;
 
-	vpnt = create_point(0,0,0);
 	for(NODE tn = net->netnodes; tn; tn=tn->next) {
 		dtap = (tn->taps == NULL) ? tn->extend : tn->taps;
 		if (dtap == NULL) continue;
-		vpnt->x=dtap->gridx;
-		vpnt->y=dtap->gridy;
-		ok=check_point_area(vbox, vpnt,FALSE,TAP_ROOM);
-		if(!ok) {
-			free(vpnt);
-			return FALSE;
-		}
+		if(!check_xy_area(vbox, dtap->gridx, dtap->gridy, FALSE, TAP_ROOM)) return FALSE;
 	}
-	free(vpnt);
 
 	return TRUE;
 }
 
-void free_line_list(BBOX_LINE t)
-{
-	if(!t) return;
-	BBOX_LINE curr, head=t;
-	while ((curr = head) != NULL) {
-		head = head->next;
-		free_line(curr);
-	}
-}
-
-BBOX_LINE get_vertical_lines(BBOX_LINE box)
-{
-	if(!box) return NULL;
-	BBOX_LINE ret = NULL;
-	for(BBOX_LINE l=box;l;l=l->next)
-		if((l->pt1->x==l->pt2->x)&&(l->pt1->y!=l->pt2->y))
-			ret=add_line_to_edge(ret,l);
-	return ret;
-}
-
-BBOX_LINE get_horizontal_lines(BBOX_LINE box)
+BOOL point_on_edge(BBOX box, POINT pnt)
 {
-	if(!box) return NULL;
-	BBOX_LINE ret = NULL;
-	for(BBOX_LINE l=box;l;l=l->next)
-		if((l->pt1->x!=l->pt2->x)&&(l->pt1->y==l->pt2->y))
-			ret=add_line_to_edge(ret,l);
-	return ret;
-}
-
-POINT get_line_intersection(BBOX_LINE a, BBOX_LINE b)
-{
-	if(!a) return NULL;
-	if(!a->pt1) return NULL;
-	if(!a->pt2) return NULL;
-	if(!b) return NULL;
-	if(!b->pt1) return NULL;
-	if(!b->pt2) return NULL;
-	int axmin, axmax;
-	int aymin, aymax;
-	int bxmin, bxmax;
-	int bymin, bymax;
-	int ax, ay;
-	int bx, by;
-	int ax1=a->pt1->x, ax2=a->pt2->x, ay1=a->pt1->y, ay2=a->pt2->y;
-	int bx1=b->pt1->x, bx2=b->pt2->x, by1=b->pt1->y, by2=b->pt2->y;
-	if((ax1==ax2)&&(bx1==bx2)) { // parallel
-		return NULL;
-	} else if((ay1==ay2)&&(by1==by2)) { // parallel
-		return NULL;
-	} else if((ax1==ax2)&&(by1==by2)) { // line a is vertical, line b is horizontal
-		aymin = (ay1<ay2)?ay1:ay2;
-		aymax = (ay1>ay2)?ay1:ay2;
-		bxmin = (bx1<bx2)?bx1:bx2;
-		bxmax = (bx1>bx2)?bx1:bx2;
-		ax=ax1;
-		by=by1;
-		if((aymin<=by)&&(aymax>=by)) // line a is vertical here
-			if((bxmin<=ax)&&(bxmax>=ax))  // line b must be horizontal here
-				return create_point(ax,by,0);
-	} else if((ay1==ay2)&&(bx1==bx2)) { // line a is horizontal, line b is vertical
-		axmin = (ax1<ax2)?ax1:ax2;
-		axmax = (ax1>ax2)?ax1:ax2;
-		bymin = (by1<by2)?by1:by2;
-		bymax = (by1>by2)?by1:by2;
-		ay=ay1;
-		bx=bx1;
-		if((axmin<=bx)&&(axmax>=bx)) // line a is horizontal here
-			if((bymin<=ay)&&(bymax>=ay))  // line b must be vertical here
-				return create_point(bx,ay,0);
+	BBOX_EDGE *e;
+	if(!box) return FALSE;
+	if(!pnt) return FALSE;
+	for(int i=0;i<box->num_hedges;i++) {
+		e=&box->hedge[i];
+		if((pnt->y==e->c)&&(pnt->x>=e->lo)&&(pnt->x<=e->hi)) return TRUE;
 	}
-	return NULL;
-}
-
-BOOL lines_are_intersecting(BBOX_LINE a, BBOX_LINE b)
-{
-	if(!a) return FALSE;
-	if(!b) return FALSE;
-	BOOL ret = FALSE;
-	POINT p = get_line_intersection(a,b);
-	if(p) {
-		ret=TRUE;
-		free(p);
+	for(int i=0;i<box->num_vedges;i++) {
+		e=&box->vedge[i];
+		if((pnt->x==e->c)&&(pnt->y>=e->lo)&&(pnt->y<=e->hi)) return TRUE;
 	}
-	return ret;
-}
-
-BOOL point_on_hline(BBOX_LINE l, POINT pnt)
-{
-	if(!l) return FALSE;
-	if(!pnt) return FALSE;
-	BOOL ret = FALSE;
-	int xmin, xmax, y;
-	xmin=(l->pt1->x<l->pt2->x)?l->pt1->x:l->pt2->x;
-	xmax=(l->pt1->x>l->pt2->x)?l->pt1->x:l->pt2->x;
-	y=l->pt2->y;
-	if((pnt->y==y)&&(pnt->x>=xmin)&&(pnt->x<=xmax)) ret = TRUE;
-	return ret;
+	return FALSE;
 }
 
-BOOL point_on_vline(BBOX_LINE l, POINT pnt)
-{
-	if(!l) return FALSE;
-	if(!pnt) return FALSE;
-	BOOL ret = FALSE;
-	int ymin, ymax, x;
-	ymin=(l->pt1->y<l->pt2->y)?l->pt1->y:l->pt2->y;
-	ymax=(l->pt1->y>l->pt2->y)?l->pt1->y:l->pt2->y;
-	x=l->pt2->x;
-	if((pnt->x==x)&&(pnt->y>=ymin)&&(pnt->y<=ymax)) ret = TRUE;
-	return ret;
-}
+/*--------------------------------------------------------------*/
+/* Cutting one bbox out of another.				*/
+/*								*/
+/* The x and y coordinates of the vertices of both bboxes cut	*/
+/* the plane into a coarse grid of cells, each of which lies	*/
+/* either wholly inside or wholly outside of each bbox.  The	*/
+/* cells inside "box" and outside "cut" make up the result,	*/
+/* whose outline is traced counter-clockwise along the cell	*/
+/* sides.  The outline of the result runs along the edges of	*/
+/* "cut" where it has been cut, so the two bboxes still touch.	*/
+/*--------------------------------------------------------------*/
 
-BOOL point_on_edge(BBOX box, POINT pnt)
-{
-	BOOL ret = FALSE;
-	BBOX_LINE hlines = get_horizontal_lines(box->edges);
-	BBOX_LINE vlines = get_vertical_lines(box->edges);
-	for(BBOX_LINE l=hlines;l;l=l->next) if(point_on_hline(l, pnt)) ret = TRUE;
-	for(BBOX_LINE l=vlines;l;l=l->next) if(point_on_vline(l, pnt)) ret = TRUE;
-	free_line_list(hlines);
-	free_line_list(vlines);
-	return ret;
-}
+enum { CUT_NONE = 0, CUT_EAST, CUT_NORTH, CUT_WEST, CUT_SOUTH };
 
-BBOX_LINE get_intersecting_lines(BBOX box1, BBOX box2)
+static int unique_ints(int *v, int n)
 {
-	if(!box1) return NULL;
-	if(!box2) return NULL;
-	BBOX_LINE ret = NULL;
-	for(BBOX_LINE la=box1->edges; la; la=la->next)
-		for(BBOX_LINE lb=box2->edges; lb; lb=lb->next)
-			if(lines_are_intersecting(la,lb))
-				ret = add_line_to_edge(ret, la);
-	return ret;
+	int k = 0;
+	qsort(v, n, sizeof(int), compare_ints);
+	for(int i = 0; i < n; i++)
+		if((k == 0) || (v[i] != v[k - 1])) v[k++] = v[i];
+	return k;
 }
 
-BOOL lines_are_parallel(BBOX_LINE a, BBOX_LINE b)
+/* Check whether the point at half the coordinates x2,y2 lies in	*/
+/* the interior of "b".  The point must not lie on an edge.	*/
+static BOOL bbox_contains_half(BBOX b, int x2, int y2)
 {
-	if(!a) return FALSE;
-	if(!b) return FALSE;
-	if(!a->pt1) return FALSE;
-	if(!a->pt2) return FALSE;
-	if(!b->pt1) return FALSE;
-	if(!b->pt2) return FALSE;
-	if((a->pt1->x==a->pt2->x)&&(b->pt1->x==b->pt2->x)) return TRUE;
-	if((a->pt1->y==a->pt2->y)&&(b->pt1->y==b->pt2->y)) return TRUE;
-	return FALSE;
+	BBOX_EDGE *e;
+	BOOL in = FALSE;
+	for(int i = 0; i < b->num_vedges; i++) {
+		e = &b->vedge[i];
+		if((2 * e->c > x2) && (2 * e->lo < y2) && (2 * e->hi > y2)) in = !in;
+	}
+	return in;
 }
 
-BBOX_LINE get_cutout_edge(BBOX box1, BBOX box2)
+/* Replace "box" by the part of it outside of "cut".  Fails,	*/
+/* leaving "box" as it was, if nothing is left or the rest is	*/
+/* not a single polygon without holes.				*/
+static BOOL cut_bbox(BBOX box, BBOX cut)
 {
-	if(!box1) return NULL;
-	if(!box2) return NULL;
-	BBOX_LINE ret = NULL; // return value
-	BBOX_LINE tl = NULL; // temporary line
-	BBOX_LINE vtl = NULL; // vertical temporary line
-	POINT i = NULL; // intersect point
-	
-	for(BBOX_LINE line=box2->edges; line; line=line->next) {
-		if(point_on_edge(box1,line->pt1)&&point_on_edge(box1,line->pt2)) { // whole line on the edge
-			continue;
-		} else if(point_on_edge(box1,line->pt1)) { // point on the edge
-			continue;
-		} else if(point_on_edge(box1,line->pt2)) { // point on the edge
-			continue;
-		} else if(check_point_area(box1,line->pt1,FALSE,0)&&check_point_area(box1,line->pt2,FALSE,0)) { // whole line within our box (without edges)
-			tl = clone_line(line);
-			ret = add_line_to_edge(ret,tl);
-			free_line(tl);
-		} else if(check_point_area(box1,line->pt1,FALSE,0)) {
-			for(vtl=box1->edges;vtl;vtl=vtl->next) {
-				if(lines_are_parallel(vtl,line)) continue;
-				i=get_line_intersection(line,vtl);
-				if(i) {
-					tl = new_line();
-					tl->pt1 = clone_point(line->pt1);
-					tl->pt2 = clone_point(i);
-					ret=add_line_to_edge(ret,tl);
-					free_line(tl);
-					tl = new_line();
-					tl->pt1 = clone_point(check_point_area(box2,vtl->pt1,TRUE,0)?vtl->pt2:vtl->pt1);
-					tl->pt2 = clone_point(i);
-					ret=add_line_to_edge(ret,tl);
-					free_line(tl);
-					free(i);
-				}
-			}
-		} else if(check_point_area(box1,line->pt2,FALSE,0)) {
-			for(vtl=box1->edges;vtl;vtl=vtl->next) {
-				if(lines_are_parallel(vtl,line)) continue;
-				i=get_line_intersection(line,vtl);
-				if(i) {
-					tl = new_line();
-					tl->pt1 = clone_point(line->pt2);
-					tl->pt2 = clone_point(i);
-					ret=add_line_to_edge(ret,tl);
-					free_line(tl);
-					tl = new_line();
-					tl->pt1 = clone_point(check_point_area(box2,vtl->pt1,TRUE,0)?vtl->pt2:vtl->pt1);
-					tl->pt2 = clone_point(i);
-					ret=add_line_to_edge(ret,tl);
-					free_line(tl);
-					free(i);
-				}
-			}
-		}
+	int *xs, *ys, nx, ny, cx, cy, i, j, p, start, total, steps;
+	u_char *in, *out;
+	BBOX_VERTEX *v;
+	BOOL ok = FALSE;
+
+	nx = ny = box->num_vertices + cut->num_vertices;
+	xs = malloc(nx * sizeof(int));
+	ys = malloc(ny * sizeof(int));
+	if(!xs || !ys) {
+		printf("%s: memory leak. dying!\n",__FUNCTION__);
+		exit(0);
 	}
-	return ret;
+	for(i = 0; i < box->num_vertices; i++) {
+		xs[i] = box->vertex[i].x;
+		ys[i] = box->vertex[i].y;
+	}
+	for(j = 0; j < cut->num_vertices; j++, i++) {
+		xs[i] = cut->vertex[j].x;
+		ys[i] = cut->vertex[j].y;
+	}
+	nx = unique_ints(xs, nx);
+	ny = unique_ints(ys, ny);
+	cx = nx - 1;
+	cy = ny - 1;
+
+	// cells of the result, and the outgoing side at each corner
+	in = calloc(cx * cy + 1, sizeof(u_char));
+	out = calloc(nx * ny, sizeof(u_char));
+	v = malloc((nx * ny + 1) * sizeof(BBOX_VERTEX));
+	if(!in || !out || !v) {
+		printf("%s: memory leak. dying!\n",__FUNCTION__);
+		exit(0);
+	}
+	for(j = 0; j < cy; j++)
+		for(i = 0; i < cx; i++)
+			in[j * cx + i] = bbox_contains_half(box, xs[i] + xs[i + 1], ys[j] + ys[j + 1])
+				&& !bbox_contains_half(cut, xs[i] + xs[i + 1], ys[j] + ys[j + 1]);
+
+#define CELL_IN(i, j) (((i) >= 0) && ((i) < cx) && ((j) >= 0) && ((j) < cy) && in[(j) * cx + (i)])
+#define SET_OUT(i, j, d) { if(out[(j) * nx + (i)]) goto done; out[(j) * nx + (i)] = d; total++; }
+
+	total = 0;
+	start = -1;
+	for(j = 0; j < cy; j++)
+		for(i = 0; i < cx; i++) {
+			if(!CELL_IN(i, j)) continue;
+			if(!CELL_IN(i, j - 1)) SET_OUT(i, j, CUT_EAST);
+			if(!CELL_IN(i + 1, j)) SET_OUT(i + 1, j, CUT_NORTH);
+			if(!CELL_IN(i, j + 1)) SET_OUT(i + 1, j + 1, CUT_WEST);
+			if(!CELL_IN(i - 1, j)) SET_OUT(i, j + 1, CUT_SOUTH);
+			if(start < 0) start = j * nx + i;
+		}
+	if(start < 0) goto done;
+
+	// follow the outline from the lower left corner of the first cell
+	p = start;
+	steps = 0;
+	do {
+		i = p % nx;
+		j = p / nx;
+		v[steps].x = xs[i];
+		v[steps].y = ys[j];
+		switch(out[p]) {
+			case CUT_EAST: i++; break;
+			case CUT_NORTH: j++; break;
+			case CUT_WEST: i--; break;
+			case CUT_SOUTH: j--; break;
+			default: goto done;
+		}
+		p = j * nx + i;
+		steps++;
+	} while((p != start) && (steps < total));
+	if((p != start) || (steps != total)) goto done;
+
+	set_bbox_vertices(box, v, steps);
+	ok = (box->num_vertices >= 4);
+
+#undef CELL_IN
+#undef SET_OUT
+
+done:
+	free(xs);
+	free(ys);
+	free(in);
+	free(out);
+	free(v);
+	return ok;
 }
 
 void fit_all_bboxes(NETLIST list)
 {
 	NET net;
+	BBOX_VERTEX *v;
+	int n, xmax, ymax;
+
+	xmax = NumChannelsX[0];
+	ymax = NumChannelsY[0];
+	for(int lay=1;lay<Num_layers;lay++) {
+		if(NumChannelsX[lay]<xmax) xmax=NumChannelsX[lay];
+		if(NumChannelsY[lay]<ymax) ymax=NumChannelsY[lay];
+	}
 	for(NETLIST li=list;li;li=li->next) {
 		net=li->net;
-		if(net) if(net->bbox) if(net->bbox->edges) { 
-			for(BBOX_LINE l=net->bbox->edges;l;l=l->next) {
-				for(int lay=0;lay<Num_layers;lay++) {
-					if(l->pt1) {
-						if(l->pt1->x>NumChannelsX[lay]) {
-							l->pt1->x=NumChannelsX[lay];
-							net->bbox->x2_exception=TRUE;
-						}
-						if(l->pt1->y>NumChannelsY[lay]) {
-							l->pt1->y=NumChannelsY[lay];
-							net->bbox->y2_exception=TRUE;
-						}
-					}
-					if(l->pt2) {
-						if(l->pt2->x>NumChannelsX[lay]) {
-							l->pt2->x=NumChannelsX[lay];
-							net->bbox->x2_exception=TRUE;
-						}
-						if(l->pt2->y>NumChannelsY[lay]) {
-							l->pt2->y=NumChannelsY[lay];
-							net->bbox->y2_exception=TRUE;
-						}
-					}
-				}
-				if(l->pt1) {
-					if(l->pt1->x<0) {
-						l->pt1->x=0;
-						net->bbox->x1_exception=TRUE;
-					}
-					if(l->pt1->y<0) {
-						l->pt1->y=0;
-						net->bbox->y1_exception=TRUE;
-					}
-				}
-				if(l->pt2) {
-					if(l->pt2->x<0) {
-						l->pt2->x=0;
-						net->bbox->x1_exception=TRUE;
-					}
-					if(l->pt2->y<0) {
-						l->pt2->y=0;
-						net->bbox->y1_exception=TRUE;
-					}
-				}
+		if(!net) continue;
+		if(!net->bbox) continue;
+		if(net->bbox->num_vertices==0) continue;
+		n=net->bbox->num_vertices;
+		v=malloc(n*sizeof(BBOX_VERTEX));
+		if(!v) {
+			printf("%s: memory leak. dying!\n",__FUNCTION__);
+			exit(0);
+		}
+		memcpy(v,net->bbox->vertex,n*sizeof(BBOX_VERTEX));
+		for(int i=0;i<n;i++) {
+			if(v[i].x>xmax) {
+				v[i].x=xmax;
+				net->bbox->x2_exception=TRUE;
+			}
+			if(v[i].y>ymax) {
+				v[i].y=ymax;
+				net->bbox->y2_exception=TRUE;
+			}
+			if(v[i].x<0) {
+				v[i].x=0;
+				net->bbox->x1_exception=TRUE;
+			}
+			if(v[i].y<0) {
+				v[i].y=0;
+				net->bbox->y1_exception=TRUE;
 			}
 		}
+		set_bbox_vertices(net->bbox,v,n);
+		free(v);
 	}
 }
 
-BBOX delete_line_from_bbox(BBOX bbox, BBOX_LINE l)
-{
-	if(!l) return bbox;
-	if(!bbox) return bbox;
-	if(!bbox->edges) return bbox;
-	if(edge_contains_line(bbox->edges,l)) {
-		bbox->edges=delete_line_from_edge(bbox->edges,l);
-		bbox->num_edges--;
-	}
-	return bbox;
-}
-
 BOOL fit_competing_net_bboxes(NET n1, NET n2)
 {
 	if(!n1) return FALSE;
 	if(!n2) return FALSE;
 	if(!n1->bbox) return FALSE;
 	if(!n2->bbox) return FALSE;
-	if(n1->bbox->num_edges<4) return FALSE;
-	if(n2->bbox->num_edges<4) return FALSE;
+	if(n1->bbox->num_vertices<4) return FALSE;
+	if(n2->bbox->num_vertices<4) return FALSE;
 	if(box2_inside_box1(n1->bbox,n2->bbox)) return FALSE; // don't cut out inside
 
 	BBOX bbox_temp = clone_bbox(n1->bbox); // copy of bbox1
-	BBOX_LINE edge1 = get_intersecting_lines(bbox_temp,n2->bbox);
-	BBOX_LINE edge2 = get_cutout_edge(bbox_temp,n2->bbox);
-
-	for(BBOX_LINE l=edge1;l;l=l->next) bbox_temp=delete_line_from_bbox(bbox_temp, l);
-	for(BBOX_LINE l=edge2;l;l=l->next) bbox_temp=add_line_to_bbox(bbox_temp, l);
-
-	free_line_list(edge1);
-	free_line_list(edge2);
 
-	if(check_bbox_consistency(n1, bbox_temp)) { // check whether all taps are still within the box
+	if(cut_bbox(bbox_temp,n2->bbox) && check_bbox_consistency(n1, bbox_temp)) { // check whether all taps are still within the box
 		free_bbox(n1->bbox);
 		n1->bbox=bbox_temp;
 		return TRUE;
@@ -1017,19 +1143,7 @@ void define_route_tree(NET net)
 
     // This is called after create_bounding_box(), so bounds have
     // been calculated.
-    POINT p1, p2;
-    if(net->bbox->num_edges>3) {
-    p1 = get_left_lower_trunk_point(net->bbox);
-    p2 = get_right_upper_trunk_point(net->bbox);
-
-    xmin = p1->x;
-    xmax = p2->x;
-    ymin = p1->y;
-    ymax = p2->y;
-
-    free(p1);
-    free(p2);
-    } else {
+    if(!get_bbox_extent(net->bbox, &xmin, &ymin, &xmax, &ymax)) {
     xmin = -MAXRT;
     xmax = MAXRT;
     ymin = -MAXRT;
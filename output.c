@@ -362,12 +362,7 @@ void print_net(NET net) {
     int i, first;
     
     int xmin, ymin, xmax, ymax;
-    POINT p1 = get_left_lower_trunk_point(net->bbox);
-    POINT p2 = get_right_upper_trunk_point(net->bbox);
-    xmin = p1->x;
-    ymin = p1->y;
-    xmax = p2->x;
-    ymax = p2->y;
+    get_bbox_extent(net->bbox, &xmin, &ymin, &xmax, &ymax);
 
     Fprintf(stdout, "Net %d: %s", net->netnum, net->netname);
     for (node = net->netnodes; node != NULL; node = node->next) {
@@ -659,7 +654,7 @@ static void cleanup_net(NET net)
 			   // avoid notch DRC errors.
 
 			   SEG newseg;
-			   newseg = (SEG)malloc(sizeof(struct seg_));
+			   newseg = allocSEG();
 			   rt->segments = newseg;
 			   newseg->next = segf;
 			   newseg->layer = lf;
@@ -688,7 +683,7 @@ static void cleanup_net(NET net)
 			   // avoid notch DRC errors.
 
 			   SEG newseg;
-			   newseg = (SEG)malloc(sizeof(struct seg_));
+			   newseg = allocSEG();
 			   rt->segments = newseg;
 			   newseg->next = segf;
 			   newseg->layer = lf;
@@ -723,7 +718,7 @@ static void cleanup_net(NET net)
 			   // avoid notch DRC errors.
 
 			   SEG newseg;
-			   newseg = (SEG)malloc(sizeof(struct seg_));
+			   newseg = allocSEG();
 			   segl->next = newseg;
 			   newseg->next = NULL;
 			   newseg->layer = ll;
@@ -753,7 +748,7 @@ static void cleanup_net(NET net)
 			   // avoid notch DRC errors.
 
 			   SEG newseg;
-			   newseg = (SEG)malloc(sizeof(struct seg_));
+			   newseg = allocSEG();
 			   segl->next = newseg;
 			   newseg->next = NULL;
 			   newseg->layer = ll;
@@ -1,7 +1,7 @@
 /*--------------------------------------------------------------*/
 /* point.c --							*/
 /*								*/
-/* Memory mapped point allocation				*/
+/* Memory mapped point, segment and route allocation		*/
 /*--------------------------------------------------------------*/
 /* Written by Tim Edwards, April 2017, based on code from Magic	*/
 /*--------------------------------------------------------------*/
@@ -10,86 +10,217 @@
 #include <unistd.h>
 #include <stdlib.h>
 
+#include <tcl.h>
+
 #include "qrouter.h"
 #include "point.h"
 
 #ifdef HAVE_SYS_MMAN_H
 
-POINT POINTStoreFreeList = NULL;
-POINT POINTStoreFreeList_end = NULL;
+/* The memory mapped allocation scheme:  records of one type are	*/
+/* carved in sequence out of mmap'd blocks, and freed records are	*/
+/* kept on a free list for reuse.  Every thread has its own blocks	*/
+/* and free lists, so the router threads never contend for them.	*/
+/* A record may be freed by a different thread than the one that	*/
+/* allocated it;  it then simply joins the other thread's list.	*/
+/* The first word of a free record links it to the next one.	*/
+
+typedef struct store_ {
+    void *freelist;
+    void *freelist_end;
+    char *current;
+    char *end;
+} STORE;
+
+enum store_type { STORE_POINT = 0, STORE_SEG, STORE_ROUTE, STORE_TYPES };
+
+static const size_t store_size[STORE_TYPES] = {
+    sizeof(struct point_), sizeof(struct seg_), sizeof(struct route_)
+};
+
+typedef struct {
+    STORE store[STORE_TYPES];
+    int ready;
+} ThreadSpecificData;
 
-/* The memory mapped POINT Allocation scheme */
+static __thread ThreadSpecificData threadData;	// stores of this thread
 
-static void *_block_begin = NULL;
-static void *_current_ptr = NULL;
-static void *_block_end = NULL;
+/* Stores handed back by threads that have finished, waiting to be	*/
+/* picked up by the next thread that starts allocating.		*/
 
-/* MMAP the point store */
-static signed char
-mmapPOINTStore()
+static STORE sharedStore[STORE_TYPES];
+TCL_DECLARE_MUTEX(sharedStoreMutex)
+
+/* MMAP a new block for the store */
+static void
+mmapStore(STORE *st)
 {
     int prot = PROT_READ | PROT_WRITE;
     int flags = MAP_ANON | MAP_PRIVATE;
-    u_long map_len = POINT_STORE_BLOCK_SIZE; 	
+    u_long map_len = POINT_STORE_BLOCK_SIZE;
+    void *block;
 
-    _block_begin = mmap(NULL, map_len, prot, flags, -1, 0);
-    if (_block_begin == MAP_FAILED)
+    block = mmap(NULL, map_len, prot, flags, -1, 0);
+    if (block == MAP_FAILED)
     {
-	fprintf(stderr, "mmapPOINTStore: Unable to mmap ANON SEGMENT\n");
+	fprintf(stderr, "mmapStore: Unable to mmap ANON SEGMENT\n");
 	exit(1);
     }
-    _block_end = (void *) ((unsigned long) _block_begin + map_len);
-    _current_ptr = _block_begin;
-    return 0;
+    st->current = (char *)block;
+    st->end = (char *)block + map_len;
 }
 
-POINT
-allocPOINT()
+/* Append the free list of "src" to that of "dst" */
+static void
+mergeFreeList(STORE *dst, STORE *src)
 {
-    POINT _return_point = NULL;
+    if (src->freelist == NULL) return;
+    if (dst->freelist == NULL)
+	dst->freelist = src->freelist;
+    else
+	*(void **)dst->freelist_end = src->freelist;
+    dst->freelist_end = src->freelist_end;
+    src->freelist = src->freelist_end = NULL;
+}
 
-    if (!_block_begin && !_block_end) mmapPOINTStore();
+/* Return the stores of the calling thread, adopting any stores	*/
+/* left behind by finished threads on first use.		*/
+static ThreadSpecificData *
+threadStore()
+{
+    ThreadSpecificData *tsdPtr;
+    int i;
 
-    /* Check if we can get the point from the 
-     * Free list
-     */
+    tsdPtr = &threadData;
+    if (tsdPtr->ready) return tsdPtr;
 
-    if (POINTStoreFreeList) {
-	_return_point = POINTStoreFreeList;
-	POINTStoreFreeList = (POINT)POINTStoreFreeList->next;
-	return _return_point;
+    Tcl_MutexLock(&sharedStoreMutex);
+    for (i = 0; i < STORE_TYPES; i++) {
+	tsdPtr->store[i] = sharedStore[i];
+	sharedStore[i].freelist = sharedStore[i].freelist_end = NULL;
+	sharedStore[i].current = sharedStore[i].end = NULL;
+    }
+    Tcl_MutexUnlock(&sharedStoreMutex);
+    tsdPtr->ready = 1;
+    return tsdPtr;
+}
+
+static void *
+allocRecord(int type)
+{
+    STORE *st = &threadStore()->store[type];
+    size_t size = store_size[type];
+    void *rec;
+
+    /* Check if we can get the record from the free list */
+
+    if (st->freelist) {
+	rec = st->freelist;
+	st->freelist = *(void **)rec;
+	if (st->freelist == NULL) st->freelist_end = NULL;
+	return rec;
     }
 
     /* Get it from the mmap */
 
-    if (((unsigned long)_current_ptr + sizeof(struct point_)) >
-		(unsigned long)_block_end)
-	 mmapPOINTStore();
+    if ((st->current == NULL) || (st->current + size > st->end))
+	mmapStore(st);
 
-    _current_ptr  = (void *)((unsigned long)_current_ptr
-		+ sizeof(struct point_));
-	
-    if ((unsigned long)_current_ptr > (unsigned long) _block_end) {
-	fprintf(stderr,
-		"allocPOINT(): internal assertion failure.");
-	exit(1);
+    rec = (void *)st->current;
+    st->current += size;
+    return rec;
+}
+
+static void
+freeRecord(int type, void *rec)
+{
+    STORE *st = &threadStore()->store[type];
+
+    *(void **)rec = NULL;
+    if (st->freelist == NULL)
+	st->freelist = rec;
+    else
+	*(void **)st->freelist_end = rec;
+    st->freelist_end = rec;
+}
+
+/*--------------------------------------------------------------*/
+/* releasePOINTStore --						*/
+/*								*/
+/* Hand the stores of the calling thread over to the shared	*/
+/* pool, so that the next router thread can reuse them.  Must	*/
+/* be called by router threads before they exit.		*/
+/*--------------------------------------------------------------*/
+
+void
+releasePOINTStore()
+{
+    ThreadSpecificData *tsdPtr;
+    STORE *st, *sh;
+    int i;
+
+    tsdPtr = &threadData;
+    if (!tsdPtr->ready) return;
+
+    Tcl_MutexLock(&sharedStoreMutex);
+    for (i = 0; i < STORE_TYPES; i++) {
+	st = &tsdPtr->store[i];
+	sh = &sharedStore[i];
+
+	/* Keep the unused part of the block, either as the block	*/
+	/* of the shared store or as records on its free list.	*/
+
+	if ((sh->current == NULL) || (sh->current == sh->end)) {
+	    sh->current = st->current;
+	    sh->end = st->end;
+	}
+	else if (st->current != NULL) {
+	    while (st->current + store_size[i] <= st->end) {
+		freeRecord(i, (void *)st->current);
+		st->current += store_size[i];
+	    }
+	}
+	mergeFreeList(sh, st);
+	st->current = st->end = NULL;
     }
-    return (POINT)((unsigned long)_current_ptr - sizeof(struct point_));
+    tsdPtr->ready = 0;
+    Tcl_MutexUnlock(&sharedStoreMutex);
+}
+
+POINT
+allocPOINT()
+{
+    return (POINT)allocRecord(STORE_POINT);
 }
 
 void
 freePOINT(POINT gp)
 {
-    if (!POINTStoreFreeList_end || !POINTStoreFreeList) {
-	POINTStoreFreeList_end = gp;
-	gp->next = (POINT)NULL;
-	POINTStoreFreeList = POINTStoreFreeList_end;
-    }
-    else {
-	POINTStoreFreeList_end->next = gp;
-	POINTStoreFreeList_end = gp;
-	POINTStoreFreeList_end->next = (POINT)NULL;
-    }
+    freeRecord(STORE_POINT, (void *)gp);
+}
+
+SEG
+allocSEG()
+{
+    return (SEG)allocRecord(STORE_SEG);
+}
+
+void
+freeSEG(SEG seg)
+{
+    freeRecord(STORE_SEG, (void *)seg);
+}
+
+ROUTE
+allocROUTE()
+{
+    return (ROUTE)allocRecord(STORE_ROUTE);
+}
+
+void
+freeROUTE(ROUTE rt)
+{
+    freeRecord(STORE_ROUTE, (void *)rt);
 }
 
 #else
@@ -109,5 +240,33 @@ freePOINT(POINT gp)
     free((char *)gp);
 }
 
-#endif /* !HAVE_SYS_MMAN_H */
+SEG
+allocSEG()
+{
+    return (SEG)malloc(sizeof(struct seg_));
+}
+
+void
+freeSEG(SEG seg)
+{
+    free((char *)seg);
+}
+
+ROUTE
+allocROUTE()
+{
+    return (ROUTE)malloc(sizeof(struct route_));
+}
 
+void
+freeROUTE(ROUTE rt)
+{
+    free((char *)rt);
+}
+
+void
+releasePOINTStore()
+{
+}
+
+#endif /* !HAVE_SYS_MMAN_H */
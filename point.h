@@ -13,10 +13,16 @@
 /* Page size is 4KB so we mmap a segment equal to 64 pages */
 #define POINT_STORE_BLOCK_SIZE (4 * 1024 * 64)
 
-extern POINT PointStoreFreeList;
-extern POINT PointStoreFreeList_end;
-
 #endif /* HAVE_SYS_MMAN_H */
 
+/* POINT, SEG and ROUTE records are allocated from per-thread	*/
+/* stores.  Records from any of these may be passed to the	*/
+/* matching free routine, but never to free().			*/
+
 extern POINT allocPOINT();
 extern void freePOINT(POINT gp);
+extern SEG allocSEG();
+extern void freeSEG(SEG seg);
+extern ROUTE allocROUTE();
+extern void freeROUTE(ROUTE rt);
+extern void releasePOINTStore();
@@ -0,0 +1,458 @@
+/*--------------------------------------------------------------*/
+/* pqueue.c --							*/
+/*								*/
+/* Bucketed priority queue for the maze router search front.	*/
+/*								*/
+/* route_segs() used to keep pending positions on six linked	*/
+/* stacks ordered by search direction, which caused positions	*/
+/* to be evaluated many times over as cheaper paths to them	*/
+/* were discovered.  Positions are now held in a flat array of	*/
+/* entries and chained into buckets indexed by route cost.	*/
+/* Since every step cost is positive, popping the lowest	*/
+/* bucket first means that a position is final the first time	*/
+/* it is processed.  A position whose cost is lowered while it	*/
+/* is queued is simply queued again;  the stale entry is	*/
+/* discarded when it is popped.					*/
+/*								*/
+/* Each router thread owns one queue, which is reused for all	*/
+/* nets routed by that thread.					*/
+/*								*/
+/* In A* mode ("route search astar" in the configuration	*/
+/* file, or "search astar" from Tcl) the bucket of an entry is	*/
+/* its cost plus a lower bound on the cost remaining to reach	*/
+/* the nearest target, so that the search is drawn toward the	*/
+/* targets rather than spreading evenly around the source.	*/
+/*--------------------------------------------------------------*/
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "qrouter.h"
+#include "qconfig.h"
+#include "pqueue.h"
+
+static __thread struct pqueue_ ThreadQueue;	// queue of this thread
+
+/*--------------------------------------------------------------*/
+/* pq_thread_queue --						*/
+/*								*/
+/* Return the queue belonging to the calling thread, creating	*/
+/* it on first use.						*/
+/*--------------------------------------------------------------*/
+
+PQUEUE
+pq_thread_queue(void)
+{
+    PQUEUE pq;
+    int i;
+
+    pq = &ThreadQueue;
+    if (pq->bucket != NULL) return pq;
+
+    pq->maxentries = PQ_INIT_ENTRIES;
+    pq->entries = (PQENTRY *)malloc(pq->maxentries * sizeof(PQENTRY));
+    pq->numbuckets = PQ_INIT_BUCKETS;
+    pq->bucket = (int *)malloc(pq->numbuckets * sizeof(int));
+    if ((pq->entries == NULL) || (pq->bucket == NULL)) {
+	printf("%s: memory leak. dying!\n",__FUNCTION__);
+	exit(0);
+    }
+    pq->allocs += 2;
+    for (i = 0; i < pq->numbuckets; i++) pq->bucket[i] = PQ_NONE;
+    pq->numentries = 0;
+    pq->freelist = PQ_NONE;
+    pq->deferred = PQ_NONE;
+    pq->minbucket = pq->numbuckets;
+    pq->maxbucket = -1;
+    pq->count = 0;
+    return pq;
+}
+
+/*--------------------------------------------------------------*/
+/* pq_release --						*/
+/*								*/
+/* Free the queue of the calling thread.  Must be called by	*/
+/* router threads before they exit.				*/
+/*--------------------------------------------------------------*/
+
+void
+pq_release(void)
+{
+    PQUEUE pq;
+
+    pq = &ThreadQueue;
+    if (pq->bucket == NULL) return;
+
+    free(pq->entries);
+    free(pq->bucket);
+    if (pq->goals != NULL) free(pq->goals);
+    pq->entries = NULL;
+    pq->bucket = NULL;
+    pq->goals = NULL;
+    pq->maxentries = 0;
+    pq->numbuckets = 0;
+    pq->maxgoals = 0;
+    pq->numgoals = 0;
+}
+
+/*--------------------------------------------------------------*/
+/* Add grid position (x, y, lay) to the current target area,	*/
+/* starting a new area if "newgoal" is TRUE.			*/
+/*--------------------------------------------------------------*/
+
+static void
+pq_add_goal(PQUEUE pq, int x, int y, int lay, u_char newgoal)
+{
+    PQGOAL *pg;
+
+    if (newgoal) {
+	if (pq->numgoals == pq->maxgoals) {
+	    pq->maxgoals = (pq->maxgoals == 0) ? 8 : (pq->maxgoals << 1);
+	    pq->goals = (PQGOAL *)realloc(pq->goals,
+			pq->maxgoals * sizeof(PQGOAL));
+	    if (pq->goals == NULL) {
+		printf("%s: memory leak. dying!\n",__FUNCTION__);
+		exit(0);
+	    }
+	    pq->allocs++;
+	}
+	pg = &pq->goals[pq->numgoals++];
+	pg->x1 = pg->x2 = x;
+	pg->y1 = pg->y2 = y;
+	pg->l1 = pg->l2 = lay;
+	return;
+    }
+
+    pg = &pq->goals[pq->numgoals - 1];
+    if (x < pg->x1) pg->x1 = x;
+    if (x > pg->x2) pg->x2 = x;
+    if (y < pg->y1) pg->y1 = y;
+    if (y > pg->y2) pg->y2 = y;
+    if (lay < pg->l1) pg->l1 = lay;
+    if (lay > pg->l2) pg->l2 = lay;
+}
+
+/*--------------------------------------------------------------*/
+/* pq_set_goals --						*/
+/*								*/
+/* Collect the positions of "net" currently marked PR_TARGET	*/
+/* in Obs2 into target areas for the A* lower bound:  one area	*/
+/* per node, and one per segment of any route attached to a	*/
+/* target node.  If A* search is not enabled, clear the target	*/
+/* areas so that entries are queued by cost alone.		*/
+/*								*/
+/* Must be called whenever the set of targets changes.		*/
+/*--------------------------------------------------------------*/
+
+void
+pq_set_goals(PQUEUE pq, NET net)
+{
+    NODE node;
+    DPOINT ntap;
+    ROUTE rt;
+    SEG seg;
+    PQGOAL *pg;
+    u_char newgoal;
+    int i, lay, cost;
+
+    pq->numgoals = 0;
+    if ((AStarSearch == FALSE) || (net == NULL)) return;
+
+    for (node = net->netnodes; node; node = node->next) {
+	newgoal = TRUE;
+	for (ntap = node->taps; ntap; ntap = ntap->next) {
+	    if (OBS2VAL(ntap->gridx, ntap->gridy, ntap->layer).flags
+			& PR_TARGET) {
+		pq_add_goal(pq, ntap->gridx, ntap->gridy, ntap->layer, newgoal);
+		newgoal = FALSE;
+	    }
+	}
+	for (ntap = node->extend; ntap; ntap = ntap->next) {
+	    if (OBS2VAL(ntap->gridx, ntap->gridy, ntap->layer).flags
+			& PR_TARGET) {
+		pq_add_goal(pq, ntap->gridx, ntap->gridy, ntap->layer, newgoal);
+		newgoal = FALSE;
+	    }
+	}
+    }
+
+    for (rt = net->routes; rt; rt = rt->next) {
+	for (seg = rt->segments; seg; seg = seg->next) {
+	    if (!(OBS2VAL(seg->x1, seg->y1, seg->layer).flags & PR_TARGET))
+		continue;
+	    lay = (seg->segtype & ST_VIA) ? seg->layer + 1 : seg->layer;
+	    pq_add_goal(pq, seg->x1, seg->y1, seg->layer, TRUE);
+	    pq_add_goal(pq, seg->x2, seg->y2, lay, FALSE);
+	}
+    }
+
+    // Too many areas make the bound expensive to compute;  fall
+    // back to the single area enclosing all of them.
+
+    if (pq->numgoals > PQ_MAX_GOALS) {
+	pg = &pq->goals[0];
+	for (i = 1; i < pq->numgoals; i++) {
+	    if (pq->goals[i].x1 < pg->x1) pg->x1 = pq->goals[i].x1;
+	    if (pq->goals[i].x2 > pg->x2) pg->x2 = pq->goals[i].x2;
+	    if (pq->goals[i].y1 < pg->y1) pg->y1 = pq->goals[i].y1;
+	    if (pq->goals[i].y2 > pg->y2) pg->y2 = pq->goals[i].y2;
+	    if (pq->goals[i].l1 < pg->l1) pg->l1 = pq->goals[i].l1;
+	    if (pq->goals[i].l2 > pg->l2) pg->l2 = pq->goals[i].l2;
+	}
+	pq->numgoals = 1;
+    }
+
+    // The cheapest step in each direction over all layers.  A
+    // step along the preferred direction of a layer costs SegCost,
+    // and against it costs JogCost (see eval_pt()).
+
+    pq->stepx = pq->stepy = MAXRT;
+    for (lay = 0; lay < Num_layers; lay++) {
+	cost = (Vert[lay]) ? JogCost : SegCost;
+	if (cost < pq->stepx) pq->stepx = cost;
+	cost = (Vert[lay]) ? SegCost : JogCost;
+	if (cost < pq->stepy) pq->stepy = cost;
+    }
+}
+
+/*--------------------------------------------------------------*/
+/* pq_bound --							*/
+/*								*/
+/* Return a lower bound on the cost of a route from grid	*/
+/* position (x, y, lay) to the nearest target area.  The bound	*/
+/* is the Manhattan distance weighted by the least step cost	*/
+/* in each direction, plus ViaCost for each layer change.	*/
+/* Since no step of eval_pt() costs less than this, the bound	*/
+/* never overestimates and the first target reached is still	*/
+/* the cheapest one.						*/
+/*--------------------------------------------------------------*/
+
+u_int
+pq_bound(PQUEUE pq, int x, int y, int lay)
+{
+    PQGOAL *pg;
+    u_int bound, best;
+    int i, dx, dy, dl;
+
+    best = MAXRT;
+    for (i = 0; i < pq->numgoals; i++) {
+	pg = &pq->goals[i];
+	dx = (x < pg->x1) ? pg->x1 - x : ((x > pg->x2) ? x - pg->x2 : 0);
+	dy = (y < pg->y1) ? pg->y1 - y : ((y > pg->y2) ? y - pg->y2 : 0);
+	dl = (lay < pg->l1) ? pg->l1 - lay : ((lay > pg->l2) ? lay - pg->l2 : 0);
+	bound = dx * pq->stepx + dy * pq->stepy + dl * ViaCost;
+	if (bound < best) best = bound;
+    }
+    return best;
+}
+
+/*--------------------------------------------------------------*/
+/* Get an unused entry, growing the entry array if necessary	*/
+/*--------------------------------------------------------------*/
+
+static int
+pq_new_entry(PQUEUE pq)
+{
+    int e;
+
+    if (pq->freelist != PQ_NONE) {
+	e = pq->freelist;
+	pq->freelist = pq->entries[e].next;
+	return e;
+    }
+    if (pq->numentries == pq->maxentries) {
+	pq->maxentries <<= 1;
+	pq->entries = (PQENTRY *)realloc(pq->entries,
+			pq->maxentries * sizeof(PQENTRY));
+	if (pq->entries == NULL) {
+	    printf("%s: memory leak. dying!\n",__FUNCTION__);
+	    exit(0);
+	}
+	pq->allocs++;
+    }
+    return pq->numentries++;
+}
+
+/*--------------------------------------------------------------*/
+/* Link entry "e" into the bucket for its cost			*/
+/*--------------------------------------------------------------*/
+
+static void
+pq_link(PQUEUE pq, int e)
+{
+    u_int cost = pq->entries[e].key;
+    int i, oldsize;
+
+    if (cost >= (u_int)pq->numbuckets) {
+	oldsize = pq->numbuckets;
+	while (cost >= (u_int)pq->numbuckets) pq->numbuckets <<= 1;
+	pq->bucket = (int *)realloc(pq->bucket, pq->numbuckets * sizeof(int));
+	if (pq->bucket == NULL) {
+	    printf("%s: memory leak. dying!\n",__FUNCTION__);
+	    exit(0);
+	}
+	pq->allocs++;
+	for (i = oldsize; i < pq->numbuckets; i++) pq->bucket[i] = PQ_NONE;
+    }
+
+    pq->entries[e].next = pq->bucket[cost];
+    pq->bucket[cost] = e;
+    if ((int)cost < pq->minbucket) pq->minbucket = (int)cost;
+    if ((int)cost > pq->maxbucket) pq->maxbucket = (int)cost;
+    pq->count++;
+}
+
+/*--------------------------------------------------------------*/
+/* Get a new entry for grid position (x, y, lay) at route cost	*/
+/* "cost", with its queue key.					*/
+/*--------------------------------------------------------------*/
+
+static int
+pq_fill_entry(PQUEUE pq, int x, int y, int lay, u_int cost)
+{
+    PQENTRY *pe;
+    int e;
+
+    e = pq_new_entry(pq);
+    pe = &pq->entries[e];
+    pe->x = x;
+    pe->y = y;
+    pe->lay = lay;
+    pe->cost = cost;
+    pe->key = cost;
+    if (pq->numgoals > 0) pe->key += pq_bound(pq, x, y, lay);
+    return e;
+}
+
+/*--------------------------------------------------------------*/
+/* pq_push --							*/
+/*								*/
+/* Queue grid position (x, y, lay) at route cost "cost".	*/
+/* Within a bucket, the last position queued is the first to	*/
+/* be popped.							*/
+/*--------------------------------------------------------------*/
+
+void
+pq_push(PQUEUE pq, int x, int y, int lay, u_int cost)
+{
+    pq_link(pq, pq_fill_entry(pq, x, y, lay, cost));
+}
+
+/*--------------------------------------------------------------*/
+/* pq_pop --							*/
+/*								*/
+/* Remove the lowest-cost entry from the queue and copy it	*/
+/* into "gp".  If "key" is non-NULL, it receives the queue key	*/
+/* of the entry, which in A* mode includes the lower bound to	*/
+/* the targets.  Return 1 on success, 0 if the queue is empty.	*/
+/*--------------------------------------------------------------*/
+
+int
+pq_pop(PQUEUE pq, GRIDP *gp, u_int *key)
+{
+    PQENTRY *pe;
+    int e;
+
+    if (pq->count == 0) return 0;
+
+    while (pq->bucket[pq->minbucket] == PQ_NONE) pq->minbucket++;
+
+    e = pq->bucket[pq->minbucket];
+    pe = &pq->entries[e];
+    pq->bucket[pq->minbucket] = pe->next;
+    pq->count--;
+
+    gp->x = pe->x;
+    gp->y = pe->y;
+    gp->lay = pe->lay;
+    gp->cost = pe->cost;
+    if (key != NULL) *key = pe->key;
+
+    pe->next = pq->freelist;
+    pq->freelist = e;
+    return 1;
+}
+
+/*--------------------------------------------------------------*/
+/* pq_defer --							*/
+/*								*/
+/* Hold a popped position aside until pq_restore() is called,	*/
+/* such as for a position outside of the current route mask.	*/
+/*--------------------------------------------------------------*/
+
+void
+pq_defer(PQUEUE pq, GRIDP *gp)
+{
+    int e;
+
+    e = pq_fill_entry(pq, gp->x, gp->y, gp->lay, gp->cost);
+    pq->entries[e].next = pq->deferred;
+    pq->deferred = e;
+}
+
+/*--------------------------------------------------------------*/
+/* pq_restore --						*/
+/*								*/
+/* Return all deferred positions to the queue.  Returns the	*/
+/* number of positions restored.				*/
+/*--------------------------------------------------------------*/
+
+int
+pq_restore(PQUEUE pq)
+{
+    int e, count = 0;
+
+    while (pq->deferred != PQ_NONE) {
+	e = pq->deferred;
+	pq->deferred = pq->entries[e].next;
+	pq_link(pq, e);
+	count++;
+    }
+    return count;
+}
+
+/*--------------------------------------------------------------*/
+/* pq_empty --							*/
+/*								*/
+/* Return 1 if nothing is queued or deferred.			*/
+/*--------------------------------------------------------------*/
+
+int
+pq_empty(PQUEUE pq)
+{
+    return ((pq->count == 0) && (pq->deferred == PQ_NONE)) ? 1 : 0;
+}
+
+/*--------------------------------------------------------------*/
+/* pq_clear --							*/
+/*								*/
+/* Empty the queue, clearing the Obs2 PR_ON_STACK flag of each	*/
+/* position that was still pending.  The storage is kept for	*/
+/* the next route.						*/
+/*--------------------------------------------------------------*/
+
+void
+pq_clear(PQUEUE pq)
+{
+    PQENTRY *pe;
+    int b, e;
+
+    pq_restore(pq);
+
+    for (b = pq->minbucket; b <= pq->maxbucket; b++) {
+	for (e = pq->bucket[b]; e != PQ_NONE; e = pe->next) {
+	    pe = &pq->entries[e];
+	    OBS2VAL(pe->x, pe->y, pe->lay).flags &= ~PR_ON_STACK;
+	}
+	pq->bucket[b] = PQ_NONE;
+    }
+
+    pq->numentries = 0;
+    pq->freelist = PQ_NONE;
+    pq->minbucket = pq->numbuckets;
+    pq->maxbucket = -1;
+    pq->count = 0;
+    pq->numgoals = 0;
+}
+
+/* end of pqueue.c */
@@ -0,0 +1,38 @@
+/*--------------------------------------------------------------*/
+/* pqueue.h --							*/
+/*								*/
+/* Bucketed priority queue for the maze router search front	*/
+/* (header file)						*/
+/*--------------------------------------------------------------*/
+
+#ifndef PQUEUE_H
+
+/* Initial allocation sizes;  both arrays grow on demand */
+#define PQ_INIT_ENTRIES		4096
+#define PQ_INIT_BUCKETS		1024
+
+#define PQ_NONE			-1
+
+/* Beyond this many target areas, an A* search uses the single	*/
+/* area enclosing all of them.					*/
+#define PQ_MAX_GOALS		32
+
+/* Queue key of a grid position:  source positions are not	*/
+/* marked with PR_COST and are always queued at cost zero.	*/
+#define PQ_KEY(Pr) (((Pr)->flags & PR_COST) ? (Pr)->prdata.cost : 0)
+
+PQUEUE pq_thread_queue(void);
+void   pq_release(void);
+void   pq_set_goals(PQUEUE pq, NET net);
+u_int  pq_bound(PQUEUE pq, int x, int y, int lay);
+void   pq_push(PQUEUE pq, int x, int y, int lay, u_int cost);
+int    pq_pop(PQUEUE pq, GRIDP *gp, u_int *key);
+void   pq_defer(PQUEUE pq, GRIDP *gp);
+int    pq_restore(PQUEUE pq);
+int    pq_empty(PQUEUE pq);
+void   pq_clear(PQUEUE pq);
+
+#define PQUEUE_H
+#endif
+
+/* end of pqueue.h */
@@ -22,6 +22,8 @@
 #include "qrouter.h"
 #include "qconfig.h"
 #include "lef.h"
+#include "hash.h"
+#include "snapshot.h"
 
 int    CurrentPin = 0;
 int    Firstcall = TRUE;
@@ -58,6 +60,7 @@ int     BlockCost = 25;            // Cost of a crossover when node has
 int	OffsetCost = 50;	   // Cost per micron of a node offset
 int 	ConflictCost = 50;	   // Cost of shorting another route
 				   // during the rip-up and reroute stage
+u_char	AStarSearch = FALSE;	   // Direct the route search toward targets
 
 char    *ViaX[MAX_LAYERS];
 char    *ViaY[MAX_LAYERS];
@@ -158,6 +161,7 @@ int read_config(FILE *fconfig, int is_info)
 	DontRoute = (STRING)NULL;
 	CriticalNet = (STRING)NULL;
         GateInfo = (GATE)NULL;
+	LefHashCells();
 	Nlgates = (GATE)NULL;
 	UserObs = (DSEG)NULL;
 
@@ -173,7 +177,8 @@ int read_config(FILE *fconfig, int is_info)
     lines = 0;
 
     while (!feof(fconfig)) {
-	fgets(line, MAX_LINE_LEN, fconfig);
+	if (fgets(line, MAX_LINE_LEN, fconfig) != NULL)
+	    snapshot_input(SNAP_CONFIG, line, strlen(line));
 	lines++;
 	lineptr = line;
 	while (isspace(*lineptr)) lineptr++;
@@ -305,46 +310,56 @@ int read_config(FILE *fconfig, int is_info)
 	    OK = 1; BlockCost = iarg;
 	}
 
+	// "route search astar" directs the route search toward the
+	// targets;  "route search maze" (the default) expands evenly
+	// around the source.
+
+	if ((i = sscanf(lineptr, "route search %s", sarg)) == 1) {
+	    if (!strcmp(sarg, "astar") || !strcmp(sarg, "a*")) {
+		OK = 1; AStarSearch = TRUE;
+	    }
+	    else if (!strcmp(sarg, "maze")) {
+		OK = 1; AStarSearch = FALSE;
+	    }
+	}
+
 	if ((i = sscanf(lineptr, "do not route node %s\n", sarg)) == 1) {
 	    OK = 1; 
 	    dnr = (STRING)malloc(sizeof(struct string_));
 	    dnr->name = strdup(sarg);
+	    dnr->next = NULL;
 	    if (DontRoute != NULL) {
 	       for (strl = DontRoute; strl->next; strl = strl->next);
 	       strl->next = dnr;
 	    }
-	    else {
-	       dnr->next = NULL;
+	    else
 	       DontRoute = dnr;
-	    }
 	}
 	
 	if ((i = sscanf(lineptr, "route priority %s\n", sarg)) == 1) {
 	    OK = 1; 
 	    cn = (STRING)malloc(sizeof(struct string_));
 	    cn->name = strdup(sarg);
+	    cn->next = NULL;
 	    if (CriticalNet != NULL) {
 	       for (strl = CriticalNet; strl->next; strl = strl->next);
 	       strl->next = cn;
 	    }
-	    else {
-	       cn->next = NULL;
+	    else
 	       CriticalNet = cn;
-	    }
 	}
 	
 	if ((i = sscanf(lineptr, "critical net %s\n", sarg)) == 1) {
 	    OK = 1; 
 	    cn = (STRING)malloc(sizeof(struct string_));
 	    cn->name = strdup(sarg);
+	    cn->next = NULL;
 	    if (CriticalNet != NULL) {
 	       for (strl = CriticalNet; strl->next; strl = strl->next);
 	       strl->next = cn;
 	    }
-	    else {
-	       cn->next = NULL;
+	    else
 	       CriticalNet = cn;
-	    }
 	}
 
 	// Search for "no stack".  This allows variants like "no stacked
@@ -431,6 +446,7 @@ int read_config(FILE *fconfig, int is_info)
 	    gateinfo->node[0] = NULL;
  
 	    GateInfo = gateinfo;
+	    LefHashCell(gateinfo);
 	}
 	
         if ((i = sscanf(lineptr, "endgate %s\n", sarg)) == 1) {
@@ -444,7 +460,7 @@ int read_config(FILE *fconfig, int is_info)
 
 	if ((i = sscanf(lineptr, "pin %s %lf %lf\n", sarg, &darg, &darg2)) == 3) {
 	    OK = 1; 
-	    gateinfo->node[CurrentPin] = strdup(sarg);
+	    gateinfo->node[CurrentPin] = StrIntern(&CellNames, sarg);
 
 	    // These style gates have only one tap per gate;  LEF file reader
 	    // allows multiple taps per gate node.
@@ -483,7 +499,7 @@ int read_config(FILE *fconfig, int is_info)
 				break;
 			lenstrT++;
 		}
-		vddnet=malloc(lenstrT);
+		vddnet=malloc(lenstrT + 1);
 		strncpy(vddnet,vddname,lenstrT);
 		vddnet[lenstrT]=0;
 		printf("vddnet %s\n",vddnet);
@@ -498,7 +514,7 @@ int read_config(FILE *fconfig, int is_info)
 				break;
 			lenstrT++;
 		}
-		gndnet=malloc(lenstrT);
+		gndnet=malloc(lenstrT + 1);
 		strncpy(gndnet,gndname,lenstrT);
 		gndnet[lenstrT]=0;
 		printf("gndnet %s\n",gndnet);
@@ -513,7 +529,7 @@ int read_config(FILE *fconfig, int is_info)
 				break;
 			lenstrT++;
 		}
-		clknet=malloc(lenstrT);
+		clknet=malloc(lenstrT + 1);
 		strncpy(clknet,clkname,lenstrT);
 		clknet[lenstrT]=0;
 		printf("clknet %s\n",clknet);
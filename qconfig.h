@@ -37,6 +37,7 @@ extern int     XverCost;
 extern int     BlockCost;
 extern int     OffsetCost;
 extern int     ConflictCost;
+extern u_char  AStarSearch;
 
 extern char    *ViaX[MAX_LAYERS];
 extern char    *ViaY[MAX_LAYERS];
@@ -22,6 +22,8 @@
 #include "qrouter.h"
 #include "qconfig.h"
 #include "point.h"
+#include "pqueue.h"
+#include "window.h"
 #include "node.h"
 #include "maze.h"
 #include "mask.h"
@@ -29,12 +31,20 @@
 #include "lef.h"
 #include "def.h"
 #include "graphics.h"
+#include "schedule.h"
+#include "congest.h"
+#include "hash.h"
+#include "snapshot.h"
 
 int  TotalRoutes = 0;
+u_long TotalExpanded = 0;	// Grid positions expanded by route_segs()
+u_long TotalSearchAllocs = 0;	// Heap allocations made by search queues
 TCL_DECLARE_MUTEX(TotalRoutesMutex)
 
 NET     *Nlnets;	// list of nets in the design
-NET	CurNet[MAX_NUM_THREADS];		// current net to route, used by 2nd stage
+static HASHTABLE NetTable = {HASH_STRING};	// Nlnets by name
+static HASHTABLE NetNumTable = {HASH_INT};	// Nlnets by net number
+NET	*CurNet = NULL;		// current net of each router thread
 STRING  DontRoute;      // a list of nets not to route (e.g., power)
 STRING  CriticalNet;    // list of critical nets to route first
 GATE    GateInfo;       // standard cell macro information
@@ -43,7 +53,7 @@ GATE    Nlgates;	// gate instance information
 NETLIST FailedNets;	// list of nets that failed to route
 
 u_int    *Obs[MAX_LAYERS];      // net obstructions in layer
-PROUTE   *Obs2[MAX_LAYERS];     // used for pt->pt routes on layer
+__thread u_int Obs2Epoch = 0;	// epoch of this thread's current route setup
 float    *Obsinfo[MAX_LAYERS];  // temporary array used for detailed obstruction info
 NODEINFO *Nodeinfo[MAX_LAYERS]; // nodes and stub information is here. . .
 DSEG      UserObs;		// user-defined obstruction layers
@@ -61,6 +71,7 @@ int    Pinlayers = 0;
 u_int  minEffort = 0;	// Minimum effort applied from command line.
 u_char Verbose = 3;	// Default verbose level
 u_char forceRoutable = FALSE;
+u_char Deterministic = FALSE;	// Same routes for any number of threads
 u_char maskMode = MASK_AUTO;
 u_char mapType = MAP_OBSTRUCT | DRAW_ROUTES;
 u_char ripLimit = 10;	// Fail net rather than rip up more than
@@ -106,6 +117,20 @@ BOOL is_failed_net(NET net)
 	return FALSE;
 }
 
+TCL_DECLARE_MUTEX(FailedNetsMutex)
+
+/* Add a net to FailedNets from any router thread.  Returns	*/
+/* TRUE if the net was on the list already.			*/
+static BOOL fail_net(NET net)
+{
+	BOOL ret;
+	Tcl_MutexLock(&FailedNetsMutex);
+	ret=is_failed_net(net);
+	if(!ret) FailedNets=postpone_net(FailedNets,net);
+	Tcl_MutexUnlock(&FailedNetsMutex);
+	return ret;
+}
+
 void free_postponed(NETLIST postponed) {
 	if(!postponed) return;
 	NETLIST lp = NULL;
@@ -295,6 +320,7 @@ runqrouter(int argc, char *argv[])
    char *dotptr;
    char *Filename = NULL;
    u_char readconfig = FALSE;
+   int numthreads = 0;
     
    Scales.iscale = 1;
    Scales.mscale = 100;
@@ -321,6 +347,8 @@ runqrouter(int argc, char *argv[])
 	    case 'g':
 	    case 'r':
 	    case 't':
+	    case 'j':
+	    case 'S':
 	       argsep = *(argv[i] + 2);
 	       if (argsep == '\0') {
 		  i++;
@@ -367,6 +395,17 @@ runqrouter(int argc, char *argv[])
 	    case 't':
 	       clknet = strdup(optarg);
 	       break;
+	    case 'j':
+	       if ((sscanf(optarg, "%d", &numthreads) != 1) || (numthreads <= 0)) {
+		   Fprintf(stderr, "Bad number of threads \"%s\", "
+			"positive integer expected.\n", optarg);
+		   numthreads = 0;
+	       }
+	       break;
+	    case 'S':
+	       if (SnapshotFile != NULL) free(SnapshotFile);
+	       SnapshotFile = strdup(optarg);
+	       break;
 	    case 'r':
 	       if (sscanf(optarg, "%d", &Scales.iscale) != 1) {
 		   Fprintf(stderr, "Bad resolution scalefactor \"%s\", "
@@ -381,6 +420,9 @@ runqrouter(int argc, char *argv[])
 	    case 'f':
 	       forceRoutable = TRUE;
 	       break;
+	    case 'D':
+	       Deterministic = TRUE;
+	       break;
 	    case 'k':
 	       Fprintf(stdout, "Option \"k\" deprecated.  Use \"effort\""
 			" in stage2 or stage3 command or -e option\n");
@@ -405,6 +447,10 @@ runqrouter(int argc, char *argv[])
       }
    }
 
+   // Keep a thread count set earlier by the "threads" command unless
+   // -j was given.
+   if ((numthreads > 0) || (NumThreads == 0)) set_num_threads(numthreads);
+
    if (infofile != NULL) {
       infoFILEptr = fopen(infofile, "w" );
       free(infofile);
@@ -552,16 +598,11 @@ static void reinitialize()
 	Nodeinfo[i] = NULL;
     }
     for (i = 0; i < Num_layers; i++) {
-	free(Obs2[i]);
 	free(Obs[i]);
-
-	Obs2[i] = NULL;
 	Obs[i] = NULL;
     }
-    if (RMask != NULL) {
-	free(RMask);
-	RMask = NULL;
-    }
+    occupancy_clear();
+    window_release();
 
     // Free the netlist of failed nets (if there is one)
 
@@ -586,9 +627,9 @@ static void reinitialize()
 	    while (rt->segments) {
 		seg = rt->segments;
 		rt->segments = rt->segments->next;
-		free(seg);
+		freeSEG(seg);
 	    }
-	    free(rt);
+	    freeROUTE(rt);
 	}
 	while (net->netnodes) {
 	    node = net->netnodes;
@@ -608,12 +649,15 @@ static void reinitialize()
 	    // but copied from net record
 	    free(node);
 	}
-	free (net->netname);
+	free (net->guide);
 	free (net);
     }
     free(Nlnets);
     Nlnets = NULL;
     Numnets = 0;
+    HashKill(&NetTable);
+    HashKill(&NetNumTable);
+    bump_bbox_generation();
 
     // Free all gates information
 
@@ -635,10 +679,12 @@ static void reinitialize()
 	    // but copied from cell record in GateInfo
 	    // Likewise for gate->noderec[i]
 	}
-
-	free(gate->gatename);
     }
     Nlgates = NULL;
+
+    // Net and gate names live in the design string table
+
+    StrKill(&DesignNames);
 }
 
 /*--------------------------------------------------------------*/
@@ -676,8 +722,6 @@ static int post_def_setup()
    set_num_channels();		// If not called from DefRead()
    allocate_obs_array();	// If not called from DefRead()
 
-   initMask();
-
    for (i = 0; i < Num_layers; i++) {
 
       Obsinfo[i] = (float *)calloc(NumChannelsX[i] * NumChannelsY[i],
@@ -706,15 +750,26 @@ static int post_def_setup()
 
    expand_tap_geometry();
    clip_gate_taps();
-   create_obstructions_from_gates();
-   create_obstructions_inside_nodes();
-   create_obstructions_outside_nodes();
-   tap_to_tap_interactions();
-   create_obstructions_from_variable_pitch();
-   adjust_stub_lengths();
-   find_route_blocks();
-   count_reachable_taps();
-   count_pinlayers();
+
+   // The rest depends only on the inputs, so it may be read back from
+   // a snapshot saved by an earlier run.
+
+   if ((SnapshotFile == NULL) || (load_snapshot(SnapshotFile) != 0)) {
+      if (SnapshotFile != NULL) snapshot_record(TRUE);
+      create_obstructions_from_gates();
+      create_obstructions_inside_nodes();
+      create_obstructions_outside_nodes();
+      tap_to_tap_interactions();
+      create_obstructions_from_variable_pitch();
+      adjust_stub_lengths();
+      find_route_blocks();
+      count_reachable_taps();
+      count_pinlayers();
+      if (SnapshotFile != NULL) {
+	 snapshot_record(FALSE);
+	 save_snapshot(SnapshotFile);
+      }
+   }
    
    // If any nets are pre-routed, place those routes.
 
@@ -723,20 +778,11 @@ static int post_def_setup()
       writeback_all_routes(net);
    }
 
-   // Remove the Obsinfo array, which is no longer needed, and allocate
-   // the Obs2 array for costing information
+   // Remove the Obsinfo array, which is no longer needed.  Costing
+   // information is kept in the search window of each router thread.
 
    for (i = 0; i < Num_layers; i++) free(Obsinfo[i]);
 
-   for (i = 0; i < Num_layers; i++) {
-      Obs2[i] = (PROUTE *)calloc(NumChannelsX[i] * NumChannelsY[i],
-			sizeof(PROUTE));
-      if (!Obs2[i]) {
-         fprintf( stderr, "Out of memory 9.\n");
-         exit(9);
-      }
-   }
-
    // Fill in needblock bit fields, which are used by commit_proute
    // when route layers are too large for the grid size, and grid points
    // around a route need to be marked as blocked whenever something is
@@ -868,21 +914,97 @@ typedef struct {
 	NET net;
 } qThreadData;
 
-Tcl_ThreadId threadIDs[MAX_NUM_THREADS];
-qThreadData *thread_params_list[MAX_NUM_THREADS];
+int NumThreads = 0;			// set by set_num_threads()
+Tcl_ThreadId *threadIDs = NULL;
+qThreadData **thread_params_list = NULL;
 int numThreadsRunningG = 0;
 
+/*--------------------------------------------------------------*/
+/* set_num_threads --						*/
+/*								*/
+/* Set the number of router threads used by stage 1 and size	*/
+/* the per-thread arrays to match.  A value of zero or less	*/
+/* selects the number of processors online.  Must not be	*/
+/* called while nets are being routed.				*/
+/*--------------------------------------------------------------*/
+
+void set_num_threads(int numthreads)
+{
+	if(numthreads<=0) numthreads=(int)sysconf(_SC_NPROCESSORS_ONLN);
+	if(numthreads<=0) numthreads=1;
+
+	CurNet=realloc(CurNet,numthreads*sizeof(NET));
+	threadIDs=realloc(threadIDs,numthreads*sizeof(Tcl_ThreadId));
+	thread_params_list=realloc(thread_params_list,numthreads*sizeof(qThreadData *));
+	if(!CurNet||!threadIDs||!thread_params_list) {
+		printf("%s: memory leak. dying!\n",__FUNCTION__);
+		exit(0);
+	}
+	for(int c=0;c<numthreads;c++) thread_params_list[c]=NULL;
+	clear_current_nets(numthreads);
+	NumThreads=numthreads;
+}
+
 TCL_DECLARE_MUTEX(dofirststage_threadMutex)
-void dofirststage_thread(ClientData parm)
+
+/*--------------------------------------------------------------*/
+/* Stage 1 and stage 3 router thread pool.			*/
+/*								*/
+/* The worker threads are started once for each list of nets,	*/
+/* and each one routes the nets handed to it until the list is	*/
+/* done.  The main thread plans the list up front		*/
+/* (schedule.c), finding which nets collide and ordering them	*/
+/* in waves of nets that can run together.  Whenever a worker	*/
+/* is idle, it hands it the first pending net in plan order	*/
+/* that does not collide with any net in flight, so that a	*/
+/* long net only holds back the nets that collide with it.	*/
+/* Only when every pending net collides does it try to fit the	*/
+/* bbox of one around the nets in flight.  Net selection stays	*/
+/* on the main thread because resolving bbox collisions prints	*/
+/* through Tcl.							*/
+/*								*/
+/* In stage 3, nets are ripped up before they are routed again	*/
+/* and collide by the area of their windows and current routes	*/
+/* rather than by bbox.  bboxes are never refit there.		*/
+/*								*/
+/* In deterministic mode a net is instead held back until all	*/
+/* nets in conflict with it that come before it in the list	*/
+/* are finished, and bboxes are never refit.  Every net then	*/
+/* routes exactly as it would on a single thread, whatever the	*/
+/* number of workers.  The nets failing in the pass are put	*/
+/* back on FailedNets in the order a single thread would have	*/
+/* left them.							*/
+/*								*/
+/* The pool state, CurNet[] and the "net" field of each		*/
+/* worker's qThreadData are protected by poolMutex.  CurNet[]	*/
+/* is only changed through set_current_net(), which keeps the	*/
+/* index of nets in flight up to date.  poolCond is notified	*/
+/* whenever a net is handed out or finished.			*/
+/*--------------------------------------------------------------*/
+
+typedef struct {
+	NETPLAN plan;		// nets of the list, in dispatch order
+	u_char *started;	// net handed to a worker, by plan position
+	int *blocked;		// colliding nets in flight, by plan position
+	int *slot;		// plan position of each worker's net, or -1
+	int first;		// no pending nets before this plan position
+	int pending;		// nets not yet handed to a worker
+	int finished;		// nets finished by the workers
+	BOOL shutdown;		// no more nets, workers should exit
+	BOOL ordered;		// nets wait for earlier nets only
+	BOOL cleanup;		// stage 3:  rip up each net first
+} qPool;
+
+static qPool pool;
+TCL_DECLARE_MUTEX(poolMutex)
+static Tcl_Condition poolCond = NULL;
+
+static void route_pool_net(NET net, int *remaining, u_char graphdebug)
 {
-	NET net;
-	qThreadData *thread_params = (qThreadData*)parm;
 	int result=0;
-	int *remaining = thread_params->remaining;
-	u_char graphdebug = thread_params->graphdebug;
-	net = thread_params->net;
 	net->locked = TRUE;
-	if ((net != NULL) && (net->netnodes != NULL)) {
+	if (net->netnodes != NULL) {
+		if (pool.cleanup) ripup_net_locked(net, FALSE);
 		result = doroute(net, (u_char)0, graphdebug);
 		if (result == 0) {
 			Tcl_MutexLock(&dofirststage_threadMutex);
@@ -898,7 +1020,7 @@ void dofirststage_thread(ClientData parm)
 			}
 		}
 	} else {
-		if (net && (Verbose > 0)) {
+		if (Verbose > 0) {
 			FprintfT(stdout, "%s: Nothing to do for net %s\n",__FUNCTION__, net->netname);
 		}
 		Tcl_MutexLock(&dofirststage_threadMutex);
@@ -906,6 +1028,35 @@ void dofirststage_thread(ClientData parm)
 		Tcl_MutexUnlock(&dofirststage_threadMutex);
 	}
 	net->locked = FALSE;
+}
+
+void dofirststage_thread(ClientData parm)
+{
+	NET net;
+	qThreadData *thread_params = (qThreadData*)parm;
+
+	Tcl_MutexLock(&poolMutex);
+	while(1) {
+		while(!thread_params->net && !pool.shutdown)
+			Tcl_ConditionWait(&poolCond, &poolMutex, NULL);
+		net = thread_params->net;
+		if(!net) break;
+		Tcl_MutexUnlock(&poolMutex);
+
+		route_pool_net(net, thread_params->remaining, thread_params->graphdebug);
+
+		Tcl_MutexLock(&poolMutex);
+		net->active = FALSE;
+		thread_params->net = NULL;
+		set_current_net(thread_params->thnum, NULL);
+		pool.finished++;
+		Tcl_ConditionNotify(&poolCond);
+	}
+	Tcl_MutexUnlock(&poolMutex);
+
+	pq_release();
+	window_release();
+	releasePOINTStore();
 	return TCL_THREAD_CREATE_RETURN;
 }
 
@@ -936,99 +1087,222 @@ void hide_all_nets()
 	}
 }
 
-void route_essential_nets(NETLIST l, int *remaining, u_char graphdebug)
+/* Find the plan position of the next net to hand out, or -1.	*/
+/* Called with poolMutex held.					*/
+static int pool_next_net()
+{
+	NETPLAN plan=pool.plan;
+	NET net;
+	int i;
+
+	while((pool.first<plan->numnets)&&pool.started[pool.first]) pool.first++;
+	for(i=pool.first;i<plan->numnets;i++)
+		if(!pool.started[i]&&(pool.blocked[i]==0)) return i;
+	if(pool.ordered||pool.cleanup) return -1;
+
+	for(i=pool.first;i<plan->numnets;i++) {
+		if(pool.started[i]) continue;
+		net=plan->net[i];
+		if(check_bbox_collisions(net,FOR_THREAD)) {
+			Fprintf(stdout,"%s: Box of %s overlaps. Trying to find alternative shape\n", __FUNCTION__,  net->netname);
+			if(resolve_bbox_collisions(net,FOR_THREAD)) {
+				Fprintf(stdout,"%s: Found alternative shape for %s. Friendship is magic!\n", __FUNCTION__,  net->netname);
+			} else {
+				FprintfT(stdout,"%s: Box of %s still overlaps. Post-Pony-ing\n", __FUNCTION__, net->netname);
+				continue;
+			}
+		}
+		return i;
+	}
+	return -1;
+}
+
+/* Mark the net at plan position "i" as in flight, or no longer	*/
+/* in flight, for the nets colliding with it.  In deterministic	*/
+/* mode, the net is pending until finished and only holds back	*/
+/* the nets after it in the list.				*/
+static void pool_block(int i, int delta)
+{
+	NETPLAN plan=pool.plan;
+	int j;
+	for(int k=plan->adjstart[i];k<plan->adjstart[i+1];k++) {
+		j=plan->adj[k];
+		if(pool.ordered&&(plan->rank[j]<plan->rank[i])) continue;
+		pool.blocked[j]+=delta;
+	}
+}
+
+typedef struct {
+	NET net;
+	int rank;
+} qNetRank;
+
+static int compare_net_ranks(const void *a, const void *b)
+{
+	NET p=((qNetRank *)a)->net, q=((qNetRank *)b)->net;
+	return (p<q)?-1:((p>q)?1:0);
+}
+
+/* Put the nets that failed since FailedNets was "before" back	*/
+/* in the order a single worker would have failed them, that is	*/
+/* the reverse of the list.					*/
+static void pool_order_failed(NETLIST before)
+{
+	NETPLAN plan=pool.plan;
+	qNetRank *byptr, key, *found;
+	NET *byrank;
+	NETLIST nl;
+	int k;
+
+	byptr=malloc(plan->numnets*sizeof(qNetRank));
+	byrank=calloc(plan->numnets,sizeof(NET));
+	if(!byptr||!byrank) {
+		printf("%s: memory leak. dying!\n",__FUNCTION__);
+		exit(0);
+	}
+	for(k=0;k<plan->numnets;k++) {
+		byptr[k].net=plan->net[k];
+		byptr[k].rank=plan->rank[k];
+	}
+	qsort(byptr,plan->numnets,sizeof(qNetRank),compare_net_ranks);
+	for(nl=FailedNets;nl!=before;nl=nl->next) {
+		key.net=nl->net;
+		found=bsearch(&key,byptr,plan->numnets,sizeof(qNetRank),compare_net_ranks);
+		if(found) byrank[found->rank]=nl->net;
+	}
+	k=plan->numnets;
+	for(nl=FailedNets;nl!=before;nl=nl->next) {
+		key.net=nl->net;
+		if(!bsearch(&key,byptr,plan->numnets,sizeof(qNetRank),compare_net_ranks)) continue;
+		while(!byrank[--k]);
+		nl->net=byrank[k];
+	}
+	free(byptr);
+	free(byrank);
+}
+
+/*--------------------------------------------------------------*/
+/* Route all nets of list "l" with a pool of "numthreads"	*/
+/* workers, ripping up each net first if "cleanup" is set.	*/
+/* The layout is redrawn each time a net is finished.		*/
+/*--------------------------------------------------------------*/
+
+static void route_with_pool(NETLIST l, int numthreads, int *remaining, u_char graphdebug, BOOL cleanup)
 {
 	qThreadData *thread_params;
 	Tcl_ThreadId idPtr;
-	int thret;
 	NET net;
-	numThreadsRunningG=1;
-	for(NETLIST pn=l;pn;pn=pn->next) {
-		net=pn->net;
-		if(check_bbox_collisions(net,FOR_THREAD)) continue;
-		CurNet[0]=net;
+	NETLIST before=FailedNets;
+	int thret, busy, finished, i;
+
+	if(!l) return;
+	if(numthreads>count_postponed_nets(l)) numthreads=count_postponed_nets(l);
+
+	pool.plan=plan_net_waves(l,numthreads,cleanup);
+	if((numthreads>1)&&(Verbose>0)) print_net_plan(pool.plan,numthreads);
+	pool.started=calloc(pool.plan->numnets,sizeof(u_char));
+	pool.blocked=calloc(pool.plan->numnets,sizeof(int));
+	pool.slot=malloc(numthreads*sizeof(int));
+	if(!pool.started||!pool.blocked||!pool.slot) {
+		printf("%s: memory leak. dying!\n",__FUNCTION__);
+		exit(0);
+	}
+	for(int c=0;c<numthreads;c++) pool.slot[c]=-1;
+	pool.first=0;
+	pool.pending=pool.plan->numnets;
+	pool.finished=0;
+	pool.shutdown=FALSE;
+	pool.ordered=Deterministic;
+	pool.cleanup=cleanup;
+	if(pool.ordered)
+		for(i=0;i<pool.plan->numnets;i++) pool_block(i,1);
+	if(NumThreads==0) set_num_threads(0);
+	for(int c=0;c<NumThreads;c++) thread_params_list[c]=NULL;
+	clear_current_nets(NumThreads);
+	numThreadsRunningG=0;
+	for(int c=0;c<numthreads;c++) {
 		thread_params=get_thread_data();
-		thread_params->net = CurNet[0]; // Global, used by 2nd stage
+		thread_params->net=NULL;
 		thread_params->remaining=remaining;
 		thread_params->graphdebug=graphdebug;
-		thread_params->thnum=0;
-		thread_params_list[0]=thread_params;
-		net->active=TRUE;
-		draw_layout();
-		thret = Tcl_CreateThread(&idPtr,  &dofirststage_thread, thread_params_list[0], TCL_THREAD_STACK_DEFAULT, TCL_THREAD_JOINABLE);
-		if( thret == TCL_OK) {
-			threadIDs[0]=idPtr;
-			Fprintf(stdout,"routing net %s\n",thread_params_list[0]->net->netname);
+		thread_params->thnum=c;
+		thread_params_list[c]=thread_params;
+		thret = Tcl_CreateThread(&idPtr,  &dofirststage_thread, thread_params, TCL_THREAD_STACK_DEFAULT, TCL_THREAD_JOINABLE);
+		if(thret == TCL_OK) {
+			threadIDs[c]=idPtr;
+			numThreadsRunningG++;
 		} else {
 			exit(0);
 		}
-		Tcl_JoinThread(threadIDs[0], NULL );
-		if(thread_params_list[0]) free(thread_params_list[0]);
-		thread_params_list[0]=NULL;
-		CurNet[0]=NULL;		
 	}
-}
 
-void route_postponed_nets(NETLIST l, int *remaining, u_char graphdebug)
-{
-	qThreadData *thread_params;
-	Tcl_ThreadId idPtr;
-	int threadnum;
-	int thret;
-	NET net;
-	char *netname;
-	while(count_postponed_nets(l)) {
-		threadnum=0;
-		for(int c=0;c<MAX_NUM_THREADS;c++) {
-			thread_params_list[c]=NULL;
-			CurNet[c]=NULL;
-		}
-		for(NETLIST pn=l;pn;pn=pn->next) {
-			net=pn->net;
-			if(check_bbox_collisions(net,FOR_THREAD)) {
-				Fprintf(stdout,"%s: Box of %s overlaps. Trying to find alternative shape\n", __FUNCTION__,  net->netname);
-				if(resolve_bbox_collisions(net,FOR_THREAD)) {
-					Fprintf(stdout,"%s: Found alternative shape for %s. Friendship is magic!\n", __FUNCTION__,  net->netname);
-				} else {
-					FprintfT(stdout,"%s: Box of %s still overlaps. Post-Pony-ing\n", __FUNCTION__, net->netname);
-					continue;
-				}
+	Tcl_MutexLock(&poolMutex);
+	while(1) {
+		// Release the nets the workers have finished
+		for(int c=0;c<numthreads;c++) {
+			if((pool.slot[c]>=0)&&!thread_params_list[c]->net) {
+				pool_block(pool.slot[c],-1);
+				pool.slot[c]=-1;
 			}
-			CurNet[threadnum]=net;
-			thread_params=get_thread_data();
-			thread_params->net = CurNet[threadnum]; // Global, used by 2nd stage
-			thread_params->remaining=remaining;
-			thread_params->graphdebug=graphdebug;
-			thread_params->thnum=threadnum;
-			thread_params_list[threadnum]=thread_params;
-			threadnum++;
-			if(threadnum==MAX_NUM_THREADS) break;
 		}
-		numThreadsRunningG=0;
-		hide_all_nets();
-		for(int c=0;c<threadnum;c++) thread_params_list[c]->net->active=TRUE;
-		draw_layout();
-		for(int c=0;c<threadnum;c++) {
-			netname = thread_params_list[c]->net->netname;
-			thret = Tcl_CreateThread(&idPtr,  &dofirststage_thread, thread_params_list[c], TCL_THREAD_STACK_DEFAULT, TCL_THREAD_JOINABLE);
-			if(thret == TCL_OK) {
-				threadIDs[c]=idPtr;
-				if(graphdebug) FprintfT(stdout, "%s: routing net %s\n", __FUNCTION__, netname);
-				else FprintfT(stdout, "%s: routing net %s\n", __FUNCTION__, netname);
-				numThreadsRunningG++;
-			} else {
-				exit(0);
+
+		// Hand a net to every idle worker, as far as possible
+		busy=0;
+		for(int c=0;c<numthreads;c++) {
+			thread_params=thread_params_list[c];
+			if(!thread_params->net && (pool.pending>0) && ((i=pool_next_net())>=0)) {
+				net=pool.plan->net[i];
+				pool.started[i]=TRUE;
+				pool.pending--;
+				pool.slot[c]=i;
+				if(!pool.ordered) pool_block(i,1);
+				set_current_net(c,net);
+				net->active=TRUE;
+				thread_params->net=net;
+				FprintfT(stdout, "%s: routing net %s\n", __FUNCTION__, net->netname);
+				Tcl_ConditionNotify(&poolCond);
 			}
+			if(thread_params->net) busy++;
 		}
-		for(int c=0;c<threadnum;c++) {
-			Tcl_JoinThread( threadIDs[c], NULL );
-			if(CurNet[c]) l=delete_postponed(l,CurNet[c]);
-			if(thread_params_list[c]) free(thread_params_list[c]);
-			thread_params_list[c]=NULL;
-			CurNet[c]=NULL;
-		}
+		if(busy==0) break;
+		finished=pool.finished;
+		Tcl_MutexUnlock(&poolMutex);
 		draw_layout();
+		Tcl_MutexLock(&poolMutex);
+
+		// Wait for a worker to finish its net
+		while(pool.finished==finished)
+			Tcl_ConditionWait(&poolCond, &poolMutex, NULL);
 	}
+	pool.shutdown=TRUE;
+	Tcl_ConditionNotify(&poolCond);
+	Tcl_MutexUnlock(&poolMutex);
+
+	for(int c=0;c<numthreads;c++) {
+		Tcl_JoinThread( threadIDs[c], NULL );
+		free(thread_params_list[c]);
+		thread_params_list[c]=NULL;
+	}
+	Tcl_ConditionFinalize(&poolCond);
+	numThreadsRunningG=0;
+
+	if(pool.ordered) pool_order_failed(before);
+	free_net_plan(pool.plan);
+	free(pool.started);
+	free(pool.blocked);
+	free(pool.slot);
+	pool.plan=NULL;
+}
+
+void route_essential_nets(NETLIST l, int *remaining, u_char graphdebug)
+{
+	// The nets are routed one after another, by a single worker.
+	route_with_pool(l, 1, remaining, graphdebug, FALSE);
+}
+
+void route_postponed_nets(NETLIST l, int *remaining, u_char graphdebug)
+{
+	route_with_pool(l, NumThreads, remaining, graphdebug, FALSE);
 }
 
 int dofirststage(u_char graphdebug, int debug_netnum)
@@ -1055,6 +1329,11 @@ int dofirststage(u_char graphdebug, int debug_netnum)
    hide_all_nets();
    postponed=get_net_queue(postponed, debug_netnum);
    route_postponed_nets(postponed,&remaining,graphdebug);
+   while (postponed) {
+      nl = postponed->next;
+      free(postponed);
+      postponed = nl;
+   }
    hide_all_nets();
    draw_layout();
    route_essential_nets(clknets,&remaining,graphdebug);
@@ -1069,6 +1348,9 @@ int dofirststage(u_char graphdebug, int debug_netnum)
       Fprintf(stdout, "\n----------------------------------------------\n");
       Fprintf(stdout, "Progress: ");
       Fprintf(stdout, "Stage 1 total routes completed: %d\n", TotalRoutes);
+      if (Verbose > 1)
+	 Fprintf(stdout, "Grid positions expanded: %lu (%lu allocations)\n",
+		TotalExpanded, TotalSearchAllocs);
    }
    if (FailedNets == (NETLIST)NULL)
       Fprintf(stdout, "No failed routes!\n");
@@ -1253,6 +1535,26 @@ NET getnettoroute(int order)
 
 } /* getnettoroute() */
 
+/*--------------------------------------------------------------*/
+/* hash_net - enter a net just added to Nlnets into the	*/
+/*	tables used by getnetbyname() and getnetbynum()		*/
+/*								*/
+/*   ARGS: 	net (its name and number must be set)		*/
+/*   RETURNS: 	nothing						*/
+/*   SIDE EFFECTS: the first net of a given name or number	*/
+/*	stays in the tables, as a search of Nlnets would find	*/
+/*	it.							*/
+/*--------------------------------------------------------------*/
+
+void hash_net(NET net)
+{
+   if (HashFind(&NetTable, net->netname) == NULL)
+      HashAdd(&NetTable, net->netname, (void *)net);
+   if (HashIntFind(&NetNumTable, net->netnum) == NULL)
+      HashIntAdd(&NetNumTable, net->netnum, (void *)net);
+
+} /* hash_net() */
+
 /*--------------------------------------------------------------*/
 /* getnetbyname - get a net by name			*/
 /*										*/
@@ -1264,18 +1566,99 @@ NET getnettoroute(int order)
 
 NET getnetbyname(char *name)
 {
-	NET net;
 	if(!name) return NULL;
-	for (int i = 0; i < Numnets; i++) {
-		net=Nlnets[i];
-		if(net) {
-			if(!strcmp(name,net->netname)) {
-				return net;
-			}
-		}
+	return (NET)HashFind(&NetTable, name);
+} /* getnetbyname() */
+
+/*--------------------------------------------------------------*/
+/* getnetbynum - get a net by net number			*/
+/*								*/
+/*   ARGS: 	netnum						*/
+/*   RETURNS: 	the net, or NULL if there is none		*/
+/*   SIDE EFFECTS: none						*/
+/*--------------------------------------------------------------*/
+
+NET getnetbynum(int netnum)
+{
+   return (NET)HashIntFind(&NetNumTable, netnum);
+
+} /* getnetbynum() */
+
+/*--------------------------------------------------------------*/
+/* Areas of Obs[] and Nodeinfo[] changed by rip-up since the	*/
+/* last call to rip_area_clear(), as x1, y1, x2, y2 in grid	*/
+/* units.  The second stage uses them to find routes made in	*/
+/* parallel against an Obs[] that has changed since.		*/
+/*--------------------------------------------------------------*/
+
+static int *ripArea = NULL;
+static int numRipAreas = 0;
+static int maxRipAreas = 0;
+
+static void rip_area_clear(void)
+{
+    numRipAreas = 0;
+}
+
+/* Record the positions changed when ripping up net "net":  its	*/
+/* routes and node taps, and the positions next to them.	*/
+
+static void rip_area_add(NET net)
+{
+    ROUTE rt;
+    SEG seg;
+    NODE node;
+    DPOINT ntap;
+    int x1, y1, x2, y2, *r;
+
+    x1 = y1 = MAXRT;
+    x2 = y2 = -1;
+    for (rt = net->routes; rt; rt = rt->next) {
+	for (seg = rt->segments; seg; seg = seg->next) {
+	    x1 = MIN(x1, MIN(seg->x1, seg->x2));
+	    x2 = MAX(x2, MAX(seg->x1, seg->x2));
+	    y1 = MIN(y1, MIN(seg->y1, seg->y2));
+	    y2 = MAX(y2, MAX(seg->y1, seg->y2));
 	}
-	return NULL;
-} /* getnettoroute() */
+    }
+    for (node = net->netnodes; node; node = node->next) {
+	for (ntap = node->taps; ntap; ntap = ntap->next) {
+	    x1 = MIN(x1, ntap->gridx);
+	    x2 = MAX(x2, ntap->gridx);
+	    y1 = MIN(y1, ntap->gridy);
+	    y2 = MAX(y2, ntap->gridy);
+	}
+    }
+    if (x2 < x1) return;
+
+    if (numRipAreas == maxRipAreas) {
+	maxRipAreas = (maxRipAreas == 0) ? 16 : (maxRipAreas << 1);
+	ripArea = (int *)realloc(ripArea, 4 * maxRipAreas * sizeof(int));
+	if (ripArea == NULL) {
+	    printf("%s: memory leak. dying!\n",__FUNCTION__);
+	    exit(0);
+	}
+    }
+    r = ripArea + 4 * numRipAreas++;
+    r[0] = x1 - 1;
+    r[1] = y1 - 1;
+    r[2] = x2 + 1;
+    r[3] = y2 + 1;
+}
+
+/* Return TRUE if any recorded area overlaps x1, y1 to x2, y2 */
+
+static BOOL rip_area_overlaps(int x1, int y1, int x2, int y2)
+{
+    int i, *r;
+
+    for (i = 0; i < numRipAreas; i++) {
+	r = ripArea + 4 * i;
+	if ((r[0] <= x2) && (x1 <= r[2]) && (r[1] <= y2) && (y1 <= r[3]))
+	    return TRUE;
+    }
+    return FALSE;
+}
 
 /*--------------------------------------------------------------*/
 /* Find all routes that collide with net "net", remove them	*/
@@ -1316,6 +1699,7 @@ static int ripup_colliding(NET net, u_char onlybreak)
 	nl2 = nl->next;
 	if (Verbose > 0)
             Fprintf(stdout, "Ripping up blocking net %s\n", nl->net->netname);
+	rip_area_add(nl->net);
 	if (ripup_net(nl->net, TRUE, onlybreak) == TRUE) { 
 	    for (fn = FailedNets; fn && fn->next != NULL; fn = fn->next);
 	    if (fn)
@@ -1339,6 +1723,48 @@ static int ripup_colliding(NET net, u_char onlybreak)
      return ripped;
 }
 
+/*--------------------------------------------------------------*/
+/* Route net "net" allowing collisions with other nets.  If	*/
+/* that fails while the net has a "noripup" list, the list is	*/
+/* set aside in "setaside" and the net is tried once more	*/
+/* without it.  Nothing outside of the net itself and the	*/
+/* search window of the calling thread is changed, so this may	*/
+/* be called from several threads at once for nets with	*/
+/* disjoint windows.						*/
+/*--------------------------------------------------------------*/
+
+static int route_with_collisions(NET net, u_char graphdebug, NETLIST *setaside)
+{
+    int result;
+
+    *setaside = NULL;
+    result = doroute(net, TRUE, graphdebug);
+    if (result != 0) {
+	if (net->noripup != NULL) {
+	    if ((net->flags & NET_PENDING) == 0) {
+		// Clear this net's "noripup" list and try again.
+
+		*setaside = net->noripup;
+		net->noripup = NULL;
+		result = doroute(net, TRUE, graphdebug);
+		net->flags |= NET_PENDING;	// Next time we abandon it.
+	    }
+	}
+    }
+    return result;
+}
+
+static void free_netlist(NETLIST nl)
+{
+    NETLIST nl2;
+
+    while (nl) {
+	nl2 = nl->next;
+	free(nl);
+	nl = nl2;
+    }
+}
+
 /*--------------------------------------------------------------*/
 /* Do a second-stage route (rip-up and re-route) of a single	*/
 /* net "net".							*/
@@ -1347,7 +1773,7 @@ static int ripup_colliding(NET net, u_char onlybreak)
 int route_net_ripup(NET net, u_char graphdebug, u_char onlybreak)
 {
     int result;
-    NETLIST nl, nl2;
+    NETLIST nl, nl2, setaside;
 
     // Find the net in the Failed list and remove it.
     if (FailedNets) {
@@ -1367,28 +1793,185 @@ int route_net_ripup(NET net, u_char graphdebug, u_char onlybreak)
 	}
     }
 
-    result = doroute(net, TRUE, graphdebug);
-    if (result != 0) {
-	if (net->noripup != NULL) {
-	    if ((net->flags & NET_PENDING) == 0) {
-		// Clear this net's "noripup" list and try again.
-
-		while (net->noripup) {
-		    nl = net->noripup->next;
-		    free(net->noripup);
-		    net->noripup = nl;
-		}
-		result = doroute(net, TRUE, graphdebug);
-		net->flags |= NET_PENDING;	// Next time we abandon it.
-	    }
-	}
-    }
+    result = route_with_collisions(net, graphdebug, &setaside);
+    free_netlist(setaside);
     if (result != 0)
 	result = ripup_colliding(net, onlybreak);
 
     return result;
 }
 
+/*--------------------------------------------------------------*/
+/* Second stage nets routed in parallel.  Nets are taken from	*/
+/* near the front of FailedNets as long as their search	*/
+/* windows do not overlap, and each one is routed with		*/
+/* collisions by its own thread against Obs[] as it is.	*/
+/* Routing with collisions only reads Obs[] inside the window,	*/
+/* so the routes do not depend on each other.  They are then	*/
+/* committed one at a time, in order, on the main thread,	*/
+/* which is where nets are ripped up.  A rip-up may change	*/
+/* Obs[] far from the net being committed, so a net whose	*/
+/* window overlaps any area ripped up since the batch was	*/
+/* routed has its routes thrown away and is put back at the	*/
+/* front of FailedNets to be routed again.  The first net of a	*/
+/* batch is never put back.					*/
+/*--------------------------------------------------------------*/
+
+typedef struct {
+	NET net;
+	ROUTE last;		// last route of the net before this pass
+	NETLIST setaside;	// "noripup" list set aside while routing
+	NETLIST failed;		// entries added to FailedNets while routing
+	u_char flags;		// net flags before this pass
+	u_char requeue;		// net must be routed again
+	int result;		// result of route_with_collisions()
+	int failcount;		// failing nets when the net was taken
+	int x1, y1, x2, y2;	// search window, grown by one
+	Tcl_ThreadId id;
+} qSpecNet;
+
+void dosecondstage_thread(ClientData parm)
+{
+	qSpecNet *spec = (qSpecNet*)parm;
+
+	spec->result = route_with_collisions(spec->net, (u_char)0, &spec->setaside);
+
+	pq_release();
+	window_release();
+	releasePOINTStore();
+	return TCL_THREAD_CREATE_RETURN;
+}
+
+/* Take up to "maxnets" nets with disjoint windows from the	*/
+/* front of "list" into "spec".  Returns the number taken.	*/
+
+static int take_ripup_batch(NETLIST *list, qSpecNet *spec, int maxnets, int failcount)
+{
+	NETLIST nl, *prev;
+	NET net;
+	int n=0, k, scan, x1, y1, x2, y2;
+	BOOL clash;
+
+	prev=list;
+	for(scan=0;(nl=*prev)&&(n<maxnets)&&(scan<maxnets*RIPUP_LOOKAHEAD);scan++) {
+		net=nl->net;
+		window_bounds(net,&x1,&y1,&x2,&y2);
+		x1--; y1--; x2++; y2++;
+		clash=FALSE;
+		for(k=0;(k<n)&&!clash;k++)
+			if((spec[k].net==net)||((spec[k].x1<=x2)&&(x1<=spec[k].x2)&&
+					(spec[k].y1<=y2)&&(y1<=spec[k].y2)))
+				clash=TRUE;
+		if(clash) {
+			prev=&nl->next;
+			continue;
+		}
+		*prev=nl->next;
+		free(nl);
+
+		// Keep track of which routes existed before the call to doroute().
+		for (spec[n].last = net->routes; spec[n].last && spec[n].last->next;
+				spec[n].last = spec[n].last->next);
+		spec[n].net=net;
+		spec[n].setaside=NULL;
+		spec[n].failed=NULL;
+		spec[n].flags=net->flags;
+		spec[n].requeue=FALSE;
+		spec[n].result=0;
+		spec[n].failcount=failcount-n;
+		spec[n].x1=x1;
+		spec[n].y1=y1;
+		spec[n].x2=x2;
+		spec[n].y2=y2;
+		n++;
+	}
+	return n;
+}
+
+/* Remove routing information for all routes of "net" after "rt" */
+/* that have not been copied back into Obs[].			*/
+
+static void free_new_routes(NET net, ROUTE rt)
+{
+	ROUTE rt2;
+	SEG seg;
+
+	if (rt == NULL) {
+		rt = net->routes;
+		net->routes = NULL;		// remove defunct pointer
+	}
+	else {
+		rt2 = rt->next;
+		rt->next = NULL;
+		rt = rt2;
+	}
+	while (rt != NULL) {
+		rt2 = rt->next;
+		while (rt->segments) {
+			seg = rt->segments->next;
+			freeSEG(rt->segments);
+			rt->segments = seg;
+		}
+		freeROUTE(rt);
+		rt = rt2;
+	}
+}
+
+/* Route the nets of a batch, in parallel if more than one */
+
+static void route_ripup_batch(qSpecNet *spec, int n, u_char graphdebug)
+{
+	NETLIST before, nl;
+	int i, thret;
+
+	for(i=0;i<n;i++) {
+		if (Verbose > 2)
+			Fprintf(stdout, "Routing net %s with collisions\n", spec[i].net->netname);
+	}
+	Flush(stdout);
+
+	if(n==1) {
+		spec[0].result = route_with_collisions(spec[0].net, graphdebug, &spec[0].setaside);
+		return;
+	}
+
+	before=FailedNets;
+	for(i=0;i<n;i++) {
+		thret = Tcl_CreateThread(&spec[i].id, &dosecondstage_thread, &spec[i], TCL_THREAD_STACK_DEFAULT, TCL_THREAD_JOINABLE);
+		if(thret != TCL_OK) exit(0);
+	}
+	for(i=0;i<n;i++) Tcl_JoinThread(spec[i].id, NULL);
+
+	// Hold back the nets the routes added to FailedNets, so that
+	// each can be put back when its net is committed.
+	while(FailedNets!=before) {
+		nl=FailedNets;
+		FailedNets=nl->next;
+		for(i=0;(i<n)&&(spec[i].net!=nl->net);i++);
+		if(i==n) {
+			nl->next=NULL;
+			free(nl);
+			continue;
+		}
+		nl->next=spec[i].failed;
+		spec[i].failed=nl;
+	}
+}
+
+/* Undo the route of a batch net, to be routed again later */
+
+static void undo_ripup_route(qSpecNet *spec)
+{
+	NET net=spec->net;
+
+	free_new_routes(net, spec->last);
+	if (spec->setaside) net->noripup = spec->setaside;
+	spec->setaside = NULL;
+	net->flags = spec->flags;
+	free_netlist(spec->failed);
+	spec->failed = NULL;
+}
+
 /*--------------------------------------------------------------*/
 /* dosecondstage() ---						*/
 /*								*/
@@ -1404,59 +1987,25 @@ int route_net_ripup(NET net, u_char graphdebug, u_char onlybreak)
 /* 5) Route the original failing net.				*/
 /* 6) Continue until all failed nets have been processed.	*/
 /*								*/
+/* Step 1 is done for several nets at a time when there is	*/
+/* more than one router thread, unless single-stepping,	*/
+/* debugging graphics, or in deterministic mode.		*/
+/*								*/
 /* Return value:  The number of failing nets			*/
 /*--------------------------------------------------------------*/
 
-TCL_DECLARE_MUTEX(dosecondstage_threadMutex)
-void dosecondstage_thread(ClientData parm)
-{
-	NET net;
-	qThreadData *thread_params = (qThreadData*)parm;
-	int result=0;
-	int *remaining = thread_params->remaining;
-	u_char graphdebug = thread_params->graphdebug;
-	net = thread_params->net;
-	net->locked = TRUE;
-	if ((net != NULL) && (net->netnodes != NULL)) {
-		result = doroute(net, (u_char)0, graphdebug);
-		if (result == 0) {
-			Tcl_MutexLock(&dosecondstage_threadMutex);
-			(*remaining)--;
-			Tcl_MutexUnlock(&dosecondstage_threadMutex);
-			if (Verbose > 0) {
-				FprintfT(stdout, "%s: Finished routing net %s\n",__FUNCTION__, net->netname);
-			}
-			FprintfT(stdout, "%s: Nets remaining: %d\n",__FUNCTION__, (*remaining));
-		} else {
-			if (Verbose > 0) {
-				FprintfT(stdout, "%s: Failed to route net %s\n",__FUNCTION__, net->netname);
-			}
-		}
-	} else {
-		if (net && (Verbose > 0)) {
-			FprintfT(stdout, "%s: Nothing to do for net %s\n",__FUNCTION__, net->netname);
-		}
-		Tcl_MutexLock(&dosecondstage_threadMutex);
-		(*remaining)--;
-		Tcl_MutexUnlock(&dosecondstage_threadMutex);
-	}
-	net->locked = FALSE;
-	return TCL_THREAD_CREATE_RETURN;
-}
-
 int
 dosecondstage(u_char graphdebug, u_char singlestep, u_char onlybreak, u_int effort)
 {
-   int failcount, result, i;
+   int failcount, result, i, n, maxnets, committed;
    NET net;
    NETLIST nl, nl2;
    NETLIST Abandoned;	// Abandoned routes---not even trying any more.
-   ROUTE rt, rt2;
-   SEG seg;
+   qSpecNet *spec;
+   BOOL stop;
 
    u_int loceffort = (effort > minEffort) ? effort : minEffort;
 
-   fillMask(net, (u_char)0);
    Abandoned = NULL;
    for (i = 0; i < 3; i++) progress[i] = 0;
    
@@ -1473,6 +2022,15 @@ dosecondstage(u_char graphdebug, u_char singlestep, u_char onlybreak, u_int effo
        net->flags &= ~NET_PENDING;
    }
 
+   if (NumThreads == 0) set_num_threads(0);
+   maxnets = (singlestep || graphdebug || Deterministic) ? 1 : NumThreads;
+   spec = (qSpecNet *)malloc(maxnets * sizeof(qSpecNet));
+   if (spec == NULL) {
+      printf("%s: memory leak. dying!\n",__FUNCTION__);
+      exit(0);
+   }
+   stop = FALSE;
+
    while (FailedNets != NULL) {
 
       // Diagnostic:  how are we doing?
@@ -1481,120 +2039,115 @@ dosecondstage(u_char graphdebug, u_char singlestep, u_char onlybreak, u_int effo
       if (Verbose > 1) Fprintf(stdout, "%s: Nets remaining: %d\n", __FUNCTION__, failcount);
       if (Verbose > 1) Fprintf(stdout, "------------------------------\n");
 
-      net = FailedNets->net;
-
-      // Remove this net from the fail list
-      nl2 = FailedNets;
-      FailedNets = FailedNets->next;
-      free(nl2);
-
-      // Keep track of which routes existed before the call to doroute().
-      for (rt = net->routes; rt && rt->next; rt = rt->next);
-
-      if (Verbose > 2)
-	 Fprintf(stdout, "Routing net %s with collisions\n", net->netname);
-      Flush(stdout);
-
-      result = doroute(net, TRUE, graphdebug);
+      // Remove the nets from the fail list and route them
+      n = take_ripup_batch(&FailedNets, spec, maxnets, failcount);
+      route_ripup_batch(spec, n, graphdebug);
 
-      if (result != 0) {
-	 if (net->noripup != NULL) {
-	    if ((net->flags & NET_PENDING) == 0) {
-	       // Clear this net's "noripup" list and try again.
+      rip_area_clear();
+      committed = 0;
+      for (i = 0; i < n; i++) {
+	 net = spec[i].net;
 
-	       while (net->noripup) {
-	          nl = net->noripup->next;
-	          free(net->noripup);
-	          net->noripup = nl;
-	       }
-	       result = doroute(net, TRUE, graphdebug);
-	       net->flags |= NET_PENDING;	// Next time we abandon it.
-	    }
+	 if (stop || rip_area_overlaps(spec[i].x1, spec[i].y1,
+			spec[i].x2, spec[i].y2)) {
+	    undo_ripup_route(&spec[i]);
+	    spec[i].requeue = TRUE;
+	    continue;
 	 }
-      }
+	 free_netlist(spec[i].setaside);
+	 spec[i].setaside = NULL;
+	 while ((nl = spec[i].failed) != NULL) {
+	    spec[i].failed = nl->next;
+	    nl->next = FailedNets;
+	    FailedNets = nl;
+	 }
+	 result = spec[i].result;
 
-      if (result == 0) {
+         if (result == 0) {
 
-         // Find nets that collide with "net" and remove them, adding them
-         // to the end of the FailedNets list.
+            // Find nets that collide with "net" and remove them, adding them
+            // to the end of the FailedNets list.
 
-	 // If the number of nets to be ripped up exceeds "ripLimit",
-	 // then treat this as a route failure, and don't rip up any of
-	 // the colliding nets.
+	    // If the number of nets to be ripped up exceeds "ripLimit",
+	    // then treat this as a route failure, and don't rip up any of
+	    // the colliding nets.
 
-	 result = ripup_colliding(net, onlybreak);
-	 if (result > 0) result = 0;
-      }
+	    result = ripup_colliding(net, onlybreak);
+	    if (result > 0) result = 0;
+         }
 
-      if (result != 0) {
+         if (result != 0) {
 
-	 // Complete failure to route, even allowing collisions.
-	 // Abandon routing this net.
+	    // Complete failure to route, even allowing collisions.
+	    // Abandon routing this net.
 
-	 if (Verbose > 0)
-	    Fprintf(stdout, "Failure on net %s:  Abandoning for now.\n",
+	    if (Verbose > 0)
+	       Fprintf(stdout, "Failure on net %s:  Abandoning for now.\n",
 			net->netname);
 
-	 // Add the net to the "abandoned" list
-	 Abandoned = postpone_net(Abandoned,net);
+	    // Add the net to the "abandoned" list
+	    Abandoned = postpone_net(Abandoned,net);
 
-	 while (FailedNets && (FailedNets->net == net)) {
-	    nl = FailedNets->next;
-	    free(FailedNets);
-	    FailedNets = nl;
-	 }
+	    while (FailedNets && (FailedNets->net == net)) {
+	       nl = FailedNets->next;
+	       free(FailedNets);
+	       FailedNets = nl;
+	    }
 
-	 // Remove routing information for all new routes that have
-	 // not been copied back into Obs[].
-	 if (rt == NULL) {
-	    rt = net->routes;
-	    net->routes = NULL;		// remove defunct pointer
-	 }
-	 else {
-	    rt2 = rt->next;
-	    rt->next = NULL;
-	    rt = rt2;
-	 }
-	 while (rt != NULL) {
-	    rt2 = rt->next;
-            while (rt->segments) {
-              seg = rt->segments->next;
-              free(rt->segments);
-              rt->segments = seg;
-            }
-	    free(rt);
-	    rt = rt2;
-	 }
+	    // Remove routing information for all new routes that have
+	    // not been copied back into Obs[].
+	    free_new_routes(net, spec[i].last);
 
-	 // Remove both routing information and remove the route from
-	 // Obs[] for all parts of the net that were previously routed
+	    // Remove both routing information and remove the route from
+	    // Obs[] for all parts of the net that were previously routed
 
-	 ripup_net(net, TRUE, FALSE);	// Remove routing information from net
-	 continue;
-      }
-
-      // Write back the original route to the grid array
-      writeback_all_routes(net);
-
-      // Evaluate progress by counting the total number of remaining
-      // routes in the last (effort) cycles.  progress[2]->progress[1]
-      // is a progression from oldest to newest number of remaining
-      // routes.  Calculate the slope of this line and declare an end
-      // to this 2nd stage route if the slope falls to zero.
+	    rip_area_add(net);
+	    ripup_net(net, TRUE, FALSE);	// Remove routing information from net
+	    continue;
+         }
 
-      progress[1] += failcount;
-      progress[0]++;
-      if (progress[0] > loceffort) {
-	 if ((progress[2] > 0) && (progress[2] < progress[1])) {
-	    Fprintf(stderr, "\nNo progress at level of effort %d;"
+         // Write back the original route to the grid array
+         writeback_all_routes(net);
+	 committed++;
+
+         // Evaluate progress by counting the total number of remaining
+         // routes in the last (effort) cycles.  progress[2]->progress[1]
+         // is a progression from oldest to newest number of remaining
+         // routes.  Calculate the slope of this line and declare an end
+         // to this 2nd stage route if the slope falls to zero.
+
+         progress[1] += spec[i].failcount;
+         progress[0]++;
+         if (progress[0] > loceffort) {
+	    if ((progress[2] > 0) && (progress[2] < progress[1])) {
+	       Fprintf(stderr, "\nNo progress at level of effort %d;"
 			" ending 2nd stage.\n", loceffort);
-	    break;
+	       stop = TRUE;
+	    }
+	    progress[2] = progress[1];
+	    progress[1] = progress[0] = 0;
+         }
+      }
+
+      // Nets that must be routed again go back to the front, in order
+      for (i = n - 1; i >= 0; i--) {
+	 if (!spec[i].requeue) continue;
+	 nl = (NETLIST)malloc(sizeof(struct netlist_));
+	 if (nl == NULL) {
+	    printf("%s: memory leak. dying!\n",__FUNCTION__);
+	    exit(0);
 	 }
-	 progress[2] = progress[1];
-	 progress[1] = progress[0] = 0;
+	 nl->net = spec[i].net;
+	 nl->next = FailedNets;
+	 FailedNets = nl;
+      }
+      if (stop) break;
+      if (singlestep && committed && (FailedNets != NULL)) {
+	 free(spec);
+	 return countlist(FailedNets);
       }
-      if (singlestep && (FailedNets != NULL)) return countlist(FailedNets);
    }
+   free(spec);
 
    // If the list of abandoned nets is non-null, attach it to the
    // end of the failed nets list.
@@ -1632,19 +2185,278 @@ dosecondstage(u_char graphdebug, u_char singlestep, u_char onlybreak, u_int effo
    return failcount;
 }
 
+/*--------------------------------------------------------------*/
+/* Append net "net" to the list of nets taking part in		*/
+/* negotiation, whose end is at "*tail".			*/
+/*--------------------------------------------------------------*/
+
+static void negotiate_append(NET net, NETLIST **tail)
+{
+   NETLIST nl;
+
+   nl = (NETLIST)malloc(sizeof(struct netlist_));
+   if (nl == NULL) {
+      printf("%s: memory leak. dying!\n",__FUNCTION__);
+      exit(0);
+   }
+   nl->net = net;
+   nl->next = NULL;
+   **tail = nl;
+   *tail = &nl->next;
+
+   net->flags |= NET_NEGOTIATE;
+   net->flags &= ~NET_PENDING;
+   free_netlist(net->noripup);
+   net->noripup = NULL;
+}
+
+/* Free a list returned by find_colliding(), clearing the	*/
+/* rip-up flags it left on the routes of the nets in it.	*/
+
+static void free_colliding(NETLIST nl)
+{
+   NETLIST nl2;
+   ROUTE rt;
+
+   while (nl) {
+      for (rt = nl->net->routes; rt; rt = rt->next)
+	 rt->flags &= ~RT_RIP;
+      nl2 = nl->next;
+      free(nl);
+      nl = nl2;
+   }
+}
+
+/*--------------------------------------------------------------*/
+/* donegotiate() ---						*/
+/*								*/
+/* Second stage by negotiated congestion, instead of rip-up	*/
+/* and reroute.							*/
+/* Method:							*/
+/* 1) Remove the failing nets from Obs[].  While negotiating,	*/
+/*    their routes are only counted in the usage of each grid	*/
+/*    position (see congest.c), and other nets crossing them	*/
+/*    pay a cost for sharing instead of ripping them up.	*/
+/* 2) Route each of these nets with collisions.  Nets in Obs[]	*/
+/*    that the route crosses are removed from Obs[] in the	*/
+/*    same way and join the negotiation.			*/
+/* 3) Raise the cost of sharing, and of positions that have	*/
+/*    been overused, and route again the nets that failed or	*/
+/*    still share positions with others.			*/
+/* 4) Continue until no position is overused, or for at most	*/
+/*    NEGOTIATE_PASSES passes.  Nets failing when nothing is	*/
+/*    overused are not routed again.				*/
+/* 5) Write the routes back to Obs[], in order.  Nets that	*/
+/*    failed, or that still collide, are put on FailedNets	*/
+/*    for the rip-up and reroute stage.				*/
+/*								*/
+/* Each pass routes several nets at a time when there is more	*/
+/* than one router thread, unless debugging graphics or in	*/
+/* deterministic mode.						*/
+/*								*/
+/* Return value:  The number of failing nets			*/
+/*--------------------------------------------------------------*/
+
+int
+donegotiate(u_char graphdebug)
+{
+   int failcount, overused, pass, i, n, maxnets;
+   NET net;
+   NETLIST nl, nlist, redo, kept, collide;
+   NETLIST *tail, *rtail;
+   qSpecNet *spec;
+
+   // Take the failing nets out of Obs[] and off the FailedNets list.
+
+   nlist = NULL;
+   tail = &nlist;
+   kept = NULL;
+   while (FailedNets != NULL) {
+      nl = FailedNets;
+      FailedNets = nl->next;
+      net = nl->net;
+      free(nl);
+      if (net->flags & NET_NEGOTIATE) continue;
+      if (lift_net(net) == FALSE) {
+	 kept = postpone_net(kept, net);
+	 continue;
+      }
+      free_new_routes(net, NULL);
+      negotiate_append(net, &tail);
+   }
+
+   congest_init();
+   Negotiating = TRUE;
+   HistoryFactor = MAX(ConflictCost / 10, 1);
+   PresentFactor = HistoryFactor;
+
+   if (NumThreads == 0) set_num_threads(0);
+   maxnets = (graphdebug || Deterministic) ? 1 : NumThreads;
+   spec = (qSpecNet *)malloc(maxnets * sizeof(qSpecNet));
+   if (spec == NULL) {
+      printf("%s: memory leak. dying!\n",__FUNCTION__);
+      exit(0);
+   }
+
+   for (pass = 1; pass <= NEGOTIATE_PASSES; pass++) {
+
+      // Route again every net that failed or shares positions with
+      // another net.  On the first pass, that is all of them.
+
+      redo = NULL;
+      rtail = &redo;
+      for (nl = nlist; nl; nl = nl->next) {
+	 net = nl->net;
+	 if ((net->routes != NULL) && (congest_overuse(net) == 0)) continue;
+	 *rtail = (NETLIST)malloc(sizeof(struct netlist_));
+	 if (*rtail == NULL) {
+	    printf("%s: memory leak. dying!\n",__FUNCTION__);
+	    exit(0);
+	 }
+	 (*rtail)->net = net;
+	 (*rtail)->next = NULL;
+	 rtail = &(*rtail)->next;
+      }
+      if (redo == NULL) break;
+
+      if (Verbose > 1) Fprintf(stdout, "------------------------------\n");
+      if (Verbose > 1) Fprintf(stdout, "%s: Pass %d, nets to route: %d\n",
+		__FUNCTION__, pass, countlist(redo));
+      if (Verbose > 1) Fprintf(stdout, "------------------------------\n");
+
+      while (redo != NULL) {
+	 n = take_ripup_batch(&redo, spec, maxnets, 0);
+	 for (i = 0; i < n; i++) {
+	    net = spec[i].net;
+	    if (net->routes != NULL) {
+	       congest_add_net(net, -1);
+	       free_new_routes(net, NULL);
+	    }
+	    spec[i].last = NULL;
+	 }
+	 route_ripup_batch(spec, n, graphdebug);
+
+	 // Nets are only put back on FailedNets at the end
+	 free_netlist(FailedNets);
+	 FailedNets = NULL;
+
+	 for (i = 0; i < n; i++) {
+	    net = spec[i].net;
+	    free_netlist(spec[i].failed);
+	    free_netlist(spec[i].setaside);
+	    if (spec[i].result != 0) {
+	       free_new_routes(net, NULL);
+	       continue;
+	    }
+
+	    // Nets in Obs[] crossed by the route join the negotiation
+	    collide = find_colliding(net, NULL);
+	    for (nl = collide; nl; nl = nl->next) {
+	       if (nl->net->flags & NET_NEGOTIATE) continue;
+	       if (lift_net(nl->net) == FALSE) continue;
+	       if (Verbose > 0)
+		  Fprintf(stdout, "Negotiating with net %s\n", nl->net->netname);
+	       negotiate_append(nl->net, &tail);
+	       congest_add_net(nl->net, 1);
+	    }
+	    free_colliding(collide);
+	    congest_add_net(net, 1);
+	 }
+      }
+
+      overused = congest_update_history();
+      if (Verbose > 0)
+	 Fprintf(stdout, "Negotiation pass %d: %d positions overused\n",
+		pass, overused);
+
+      // Nets still failing with nothing left to share are failing
+      // on account of hard obstructions;  routing again won't help.
+      if (overused == 0) break;
+      PresentFactor = MIN(PresentFactor * 2, 2 * ConflictCost);
+   }
+   free(spec);
+   Negotiating = FALSE;
+
+   // Write the routes back in order.  A net that shares a position
+   // with one written back before it collides with it in Obs[].
+
+   while (nlist != NULL) {
+      nl = nlist;
+      nlist = nl->next;
+      net = nl->net;
+      net->flags &= ~NET_NEGOTIATE;
+      if (net->routes != NULL) {
+	 collide = find_colliding(net, NULL);
+	 if (collide == NULL) {
+	    writeback_all_routes(net);
+	    free(nl);
+	    continue;
+	 }
+	 free_colliding(collide);
+	 free_new_routes(net, NULL);
+      }
+      if (Verbose > 0)
+	 Fprintf(stdout, "Failure on net %s:  Leaving for rip-up.\n",
+		net->netname);
+      nl->next = FailedNets;
+      FailedNets = nl;
+   }
+   congest_free();
+
+   // Keep the failing nets in their original order
+   nl = NULL;
+   while (FailedNets != NULL) {
+      nlist = FailedNets;
+      FailedNets = nlist->next;
+      nlist->next = nl;
+      nl = nlist;
+   }
+   FailedNets = nl;
+   while (kept != NULL) {
+      nl = kept;
+      kept = nl->next;
+      nl->next = FailedNets;
+      FailedNets = nl;
+   }
+
+   if (Verbose > 0) {
+      Flush(stdout);
+      Fprintf(stdout, "\n----------------------------------------------\n");
+      Fprintf(stdout, "Progress: ");
+      Fprintf(stdout, "Stage 2 total routes completed: %d\n", TotalRoutes);
+   }
+   if (FailedNets == (NETLIST)NULL) {
+      failcount = 0;
+      Fprintf(stdout, "No failed routes!\n");
+   }
+   else {
+      failcount = countlist(FailedNets);
+      Fprintf(stdout, "Failed net routes: %d\n", failcount);
+   }
+   if (Verbose > 0)
+      Fprintf(stdout, "----------------------------------------------\n");
+
+   return failcount;
+}
+
 /*--------------------------------------------------------------*/
 /* 3rd stage routing (cleanup).  Rip up each net in turn and	*/
 /* reroute it.  With all of the crossover costs gone, routes	*/
 /* should be much better than the 1st stage.  Any route that	*/
 /* existed before it got ripped up should by definition be	*/
 /* routable.							*/
+/*								*/
+/* The nets are handed to the router thread pool (effort + 1)	*/
+/* at a time, which is how often progress is checked.  Each	*/
+/* net is rerouted inside its bbox, and nets whose windows and	*/
+/* current routes do not overlap are rerouted in parallel.	*/
 /*--------------------------------------------------------------*/
 
 int dothirdstage(u_char graphdebug, int debug_netnum, u_int effort)
 {
-   int i, failcount, remaining, result, maskSave;
+   int i, n, failcount, remaining, maskSave;
    NET net;
-   NETLIST nl;
+   NETLIST nl, chunk, tail;
    u_int loceffort = (effort > minEffort) ? effort : minEffort;
 
    // Clear the lists of failed routes
@@ -1661,35 +2473,40 @@ int dothirdstage(u_char graphdebug, int debug_netnum, u_int effort)
 
    for (i = 0; i < 3; i++) progress[i] = 0;
    remaining = Numnets;
+   if (NumThreads == 0) set_num_threads(0);
+
+   // set mask mode to BBOX, if auto
+   maskSave = maskMode;
+   if (maskMode == MASK_AUTO) maskMode = MASK_BBOX;
  
-   for (i = (debug_netnum >= 0) ? debug_netnum : 0; i < Numnets; i++) {
-
-      net = getnettoroute(i);
-      if ((net != NULL) && (net->netnodes != NULL)) {
-	 setBboxCurrent(net);
-	 ripup_net(net, FALSE, FALSE);
-	 // set mask mode to BBOX, if auto
-	 maskSave = maskMode;
-	 if (maskMode == MASK_AUTO) maskMode = MASK_BBOX;
-	 result = doroute(net, FALSE, graphdebug);
-	 maskMode = maskSave;
-	 if (result == 0) {
+   i = (debug_netnum >= 0) ? debug_netnum : 0;
+   while (i < Numnets) {
+
+      // Take the next (effort + 1) nets in order, or the one net
+      // being debugged.
+
+      chunk = tail = NULL;
+      for (n = 0; i < Numnets; ) {
+	 net = getnettoroute(i++);
+	 n++;
+	 if (net == NULL)
 	    remaining--;
-	    if (Verbose > 0)
-	       Fprintf(stdout, "Finished routing net %s\n", net->netname);
-	    Fprintf(stdout, "%s: Nets remaining: %d\n", __FUNCTION__, remaining);
-	 }
 	 else {
-	    if (Verbose > 0)
-	       Fprintf(stdout, "%s: Failed to route net %s\n", __FUNCTION__, net->netname);
-	 }
-      }
-      else {
-	 if (net && (Verbose > 0)) {
-	    Fprintf(stdout, "%s: Nothing to do for net %s\n", __FUNCTION__, net->netname);
+	    nl = (NETLIST)malloc(sizeof(struct netlist_));
+	    if (nl == NULL) {
+	       printf("%s: memory leak. dying!\n",__FUNCTION__);
+	       exit(0);
+	    }
+	    nl->net = net;
+	    nl->next = NULL;
+	    if (tail) tail->next = nl;
+	    else chunk = nl;
+	    tail = nl;
 	 }
-	 remaining--;
+	 if ((debug_netnum >= 0) || ((u_int)n > loceffort)) break;
       }
+      route_with_pool(chunk, NumThreads, &remaining, graphdebug, TRUE);
+      free_netlist(chunk);
       if (debug_netnum >= 0) break;
 
       /* Progress analysis (see 2nd stage).  Normally, the 3rd	 */
@@ -1697,8 +2514,9 @@ int dothirdstage(u_char graphdebug, int debug_netnum, u_int effort)
       /* routed.  However, there is no guarantee of this, so it	 */
       /* is necessary to anticipate convergence issues.		 */
 
-      progress[1] += failcount;
-      progress[0]++;
+      failcount = countlist(FailedNets);
+      progress[1] += failcount * n;
+      progress[0] += n;
       if (progress[0] > loceffort) {
 	 if ((progress[2] > 0) && (progress[2] < progress[1])) {
 	    Fprintf(stderr, "\nNo progress at level of effort %d;"
@@ -1709,6 +2527,7 @@ int dothirdstage(u_char graphdebug, int debug_netnum, u_int effort)
 	 progress[1] = progress[0] = 0;
       }
    }
+   maskMode = maskSave;
    failcount = countlist(FailedNets);
    if (debug_netnum >= 0) return failcount;
 
@@ -1731,25 +2550,14 @@ int dothirdstage(u_char graphdebug, int debug_netnum, u_int effort)
 }
 
 /*--------------------------------------------------------------*/
-/* Free memory of an iroute glist and clear the Obs2		*/
-/* PR_ON_STACK flag for each location in the list.		*/
+/* Empty the iroute queue and clear the Obs2 PR_ON_STACK	*/
+/* flag for each location in the queue.				*/
 /*--------------------------------------------------------------*/
 
 void
 free_glist(struct routeinfo_ *iroute)
 {
-   POINT gpoint;
-   PROUTE *Pr;
-   int i; 
-   for (i = 0; i < 6; i++) {
-      while (iroute->glist[i]) {
-         gpoint = iroute->glist[i];
-         iroute->glist[i] = iroute->glist[i]->next;
-         Pr = &OBS2VAL(gpoint->x, gpoint->y, gpoint->layer);
-         Pr->flags &= ~PR_ON_STACK;
-         freePOINT(gpoint);
-      }
-   }
+   pq_clear(iroute->pq);
 }
 
 /*--------------------------------------------------------------*/
@@ -1766,7 +2574,7 @@ free_glist(struct routeinfo_ *iroute)
 int doroute(NET net, u_char stage, u_char graphdebug)
 {
   ROUTE rt1, lrt;
-  int result, lastlayer, unroutable, i;
+  int result, lastlayer, unroutable, failed;
   struct routeinfo_ iroute;
 
   if (!net) {
@@ -1777,8 +2585,7 @@ int doroute(NET net, u_char stage, u_char graphdebug)
   // Fill out route information record
   iroute.net = net;
   iroute.rt = NULL;
-  for (i = 0; i < 6; i++)
-     iroute.glist[i] = NULL;
+  iroute.pq = pq_thread_queue();
   iroute.nsrc = NULL;
   iroute.nsrctap = NULL;
   iroute.maxcost = MAXRT;
@@ -1786,8 +2593,11 @@ int doroute(NET net, u_char stage, u_char graphdebug)
   iroute.pwrbus_src = 0;
 
   lastlayer = -1;
+  failed = 0;
+  net->expanded = 0;
 
-  /* Set up Obs2[] matrix for first route */
+  /* Open the search window and set it up for the first route */
+  window_open(net);
   result = route_setup(net, &iroute, stage);
   unroutable = result - 1;
 
@@ -1795,9 +2605,7 @@ int doroute(NET net, u_char stage, u_char graphdebug)
   while (net && (result > 0)) {
      if (graphdebug) highlight_source(net);
      if (graphdebug) highlight_dest(net);
-     if (graphdebug)
-	for (i = 0; i < 6; i++)
-	    highlight_starts(iroute.glist[i]);
+     if (graphdebug) highlight_starts(iroute.pq);
 
      rt1 = createemptyroute();
      rt1->netnum = net->netnum;
@@ -1813,9 +2621,9 @@ int doroute(NET net, u_char stage, u_char graphdebug)
      if (result < 0) {		// Route failure.
 	// If we failed this on the last round, then stop
 	// working on this net and move on to the next.
-	if(is_failed_net(net))  break;
-	FailedNets = 	postpone_net(FailedNets,net);
-	free(rt1);
+	failed = 1;
+	if(fail_net(net))  break;
+	freeROUTE(rt1);
      } else {
         Tcl_MutexLock(&TotalRoutesMutex);
         TotalRoutes++;
@@ -1841,9 +2649,15 @@ int doroute(NET net, u_char stage, u_char graphdebug)
 
   /* Finished routing (or error occurred) */
   free_glist(&iroute);
+  window_close();
+
+  /* A route that failed leaves the net incomplete, even if the	*/
+  /* remaining routes succeeded.  Report it, or else stage 2 pops	*/
+  /* the net off FailedNets and puts it right back, forever.		*/
+  if ((result == 0) && failed) result = -1;
 
   /* Route failure due to no taps or similar error---Log it */
-  if ((result < 0) || (unroutable > 0)) FailedNets = postpone_net(FailedNets,net);
+  if ((result < 0) || (unroutable > 0)) fail_net(net);
   return result;
   
 } /* doroute() */
@@ -1868,6 +2682,34 @@ void unable_to_route(char *netname, NODE node, unsigned char forced)
 	FprintfT(stderr, "unable to route!\n");
 }
 
+/*--------------------------------------------------------------*/
+/* clear_net_nodelocs --					*/
+/*								*/
+/* Remove nodes of a net from Nodeinfo.nodeloc so that they	*/
+/* will not be used for crossover costing of future routes.	*/
+/* Only the routable area of the net's bbox is searched.	*/
+/*--------------------------------------------------------------*/
+
+static void clear_net_nodelocs(NET net)
+{
+  int x, y, lay;
+  NODEINFO nodeptr;
+  NODE node;
+  int x1, y1, x2, y2;
+
+  if (!net || !get_bbox_extent(net->bbox, &x1, &y1, &x2, &y2)) return;
+  for (lay = 0; lay < Num_layers; lay++) {
+     if (!Nodeinfo[lay]) continue;
+     for (x = x1; x < x2; x++)
+	for (y = y1; y < y2; y++)
+	   if (check_xy_area(net->bbox, x, y, FALSE, WIRE_ROOM))
+	      if ((nodeptr = NODEIPTR(x, y, lay)))
+		 if ((node = nodeptr->nodeloc))
+		    if (node->netnum == net->netnum)
+		       nodeptr->nodeloc = (NODE)NULL;
+  }
+}
+
 /*--------------------------------------------------------------*/
 /* next_route_setup --						*/
 /*								*/
@@ -1875,7 +2717,6 @@ void unable_to_route(char *netname, NODE node, unsigned char forced)
 int next_route_setup(NET net, struct routeinfo_ *iroute, u_char stage)
 {
   ROUTE rt;
-  NODE node;
   int  i, j;
   int  rval, result;
 
@@ -1892,7 +2733,7 @@ int next_route_setup(NET net, struct routeinfo_ *iroute, u_char stage)
 	else {
 	    result = set_powerbus_to_net(iroute->nsrc->netnum);
 	    clear_target_node(iroute->nsrc);
-	    rval = set_node_to_net(iroute->nsrc, PR_SOURCE, &iroute->glist[0],
+	    rval = set_node_to_net(iroute->nsrc, PR_SOURCE, iroute->pq,
 			iroute->bbox, stage);
 	    if (rval == -2) {
 		if (forceRoutable) {
@@ -1913,7 +2754,7 @@ int next_route_setup(NET net, struct routeinfo_ *iroute, u_char stage)
 
      // Set positions on last route to PR_SOURCE
      if (rt) {
-	result = set_route_to_net(iroute->net, rt, PR_SOURCE, &iroute->glist[0], stage);
+	result = set_route_to_net(iroute->net, rt, PR_SOURCE, iroute->pq, stage);
         if (result == -2) {
 	   unable_to_route(iroute->net->netname, NULL, 0);
            return -1;
@@ -1930,22 +2771,7 @@ int next_route_setup(NET net, struct routeinfo_ *iroute, u_char stage)
      // Remove nodes of the net from Nodeinfo.nodeloc so that they will not be
      // used for crossover costing of future routes.
 
-  POINT pt1 = get_left_lower_trunk_point(net->bbox);
-  POINT pt2 = get_right_upper_trunk_point(net->bbox);
-  POINT vpnt = create_point(0,0,0);
-  NODEINFO nodeptr;
-  for (vpnt->layer = 0; vpnt->layer < Num_layers; vpnt->layer++)
-	for(vpnt->x=pt1->x;vpnt->x<pt2->x;vpnt->x++)
-		for(vpnt->y=pt1->y;vpnt->y<pt2->y;vpnt->y++)
-			if(check_point_area(net->bbox,vpnt,FALSE,WIRE_ROOM))
-				if(Nodeinfo[vpnt->layer])
-					if((nodeptr = NODEIPTR(vpnt->x, vpnt->y, vpnt->layer)))
-						if((node = nodeptr->nodeloc)&&(iroute->net))
-							if(node->netnum == iroute->net->netnum)
-								nodeptr->nodeloc = (NODE)NULL;
-  free(vpnt);
-  free(pt1);
-  free(pt2);
+     clear_net_nodelocs(iroute->net);
 
      free_glist(iroute);
      return 0;
@@ -1959,7 +2785,7 @@ int next_route_setup(NET net, struct routeinfo_ *iroute, u_char stage)
      // Make sure this doesn't happen my clearing the "processed"
      // flag from all such target nodes, and placing the positions
      // on the stack for processing again.
-     clear_non_source_targets(iroute->net, &iroute->glist[0]);
+     clear_non_source_targets(iroute->net, iroute->pq);
   }
 
   int num_taps;
@@ -1980,48 +2806,24 @@ int next_route_setup(NET net, struct routeinfo_ *iroute, u_char stage)
 /*								*/
 /*--------------------------------------------------------------*/
 
+TCL_DECLARE_MUTEX(Obs2EpochMutex)
+static u_int LastObs2Epoch = 0;
+
 int route_setup(NET net, struct routeinfo_ *iroute, u_char stage)
 {
-  int  xmin, xmax, ymin, ymax;
-  u_int netnum, dir;
+  u_int dir;
   int  result, rval, unroutable;
   NODE node;
   NODEINFO lnode;
-  PROUTE *Pr;
   iroute->bbox = iroute->net->bbox;
 
-  // Make Obs2[][] a copy of Obs[][].  Convert pin obstructions to
-  // terminal positions for the net being routed.
-  POINT pt1 = get_left_lower_trunk_point(net->bbox);
-  POINT pt2 = get_right_upper_trunk_point(net->bbox);
-  xmin = pt1->x;
-  xmax = pt2->x;
-  ymin = pt1->y;
-  ymax = pt2->y;
-  free(pt1);
-  free(pt2);
-  POINT vpnt = create_point(0,0,0);
-  for (vpnt->layer = 0; vpnt->layer < Num_layers; vpnt->layer++) {
-	for(vpnt->x=xmin;vpnt->x<xmax;vpnt->x++) {
-		for(vpnt->y=ymin;vpnt->y<ymax;vpnt->y++) {
-			if(check_point_area(net->bbox,vpnt,FALSE,WIRE_ROOM)) {
-				netnum = OBSVAL(vpnt->x, vpnt->y, vpnt->layer) & (~BLOCKED_MASK);
-				Pr = &OBS2VAL(vpnt->x, vpnt->y, vpnt->layer);
-				if (netnum != 0) {
-					Pr->flags = 0;		// Clear all flags
-					if (netnum == DRC_BLOCKAGE)
-						Pr->prdata.net = netnum;
-					else
-						Pr->prdata.net = netnum & NETNUM_MASK;
-				} else {
-					Pr->flags = PR_COST;		// This location is routable
-					Pr->prdata.cost = MAXRT;
-				}
-			}
-		}
-	}
-  }
-  free(vpnt);
+  // Make the search window a copy of Obs[][] by starting a new epoch;
+  // records are copied by window_obs2() as the search reaches them.  Pin
+  // obstructions are then converted to terminal positions for the net
+  // being routed.
+  Tcl_MutexLock(&Obs2EpochMutex);
+  Obs2Epoch = ++LastObs2Epoch;
+  Tcl_MutexUnlock(&Obs2EpochMutex);
 
   if (iroute->net->netnum == VDD_NET || iroute->net->netnum == GND_NET) {
      // The normal method of selecting source and target is not amenable
@@ -2053,7 +2855,7 @@ int route_setup(NET net, struct routeinfo_ *iroute, u_char stage)
   if (result) {
      while(1) {
         if (iroute->nsrc == NULL) break;
-        rval = set_node_to_net(iroute->nsrc, PR_SOURCE, iroute->glist, iroute->bbox, stage);
+        rval = set_node_to_net(iroute->nsrc, PR_SOURCE, iroute->pq, iroute->bbox, stage);
 	if (rval == -2) {
 	   iroute->nsrc = iroute->nsrc->next;
 	   if (iroute->nsrc == NULL) break;
@@ -2069,10 +2871,10 @@ int route_setup(NET net, struct routeinfo_ *iroute, u_char stage)
      if (iroute->do_pwrbus == FALSE) {
 
         // Set associated routes to PR_SOURCE
-        rval = set_routes_to_net(iroute->nsrc, iroute->net, PR_SOURCE, iroute->glist, stage);
+        rval = set_routes_to_net(iroute->nsrc, iroute->net, PR_SOURCE, iroute->pq, stage);
 
 	// Set node to PR_SOURCE
-	rval = set_node_to_net(iroute->nsrc, PR_SOURCE, &iroute->glist[0], iroute->bbox, stage);
+	rval = set_node_to_net(iroute->nsrc, PR_SOURCE, iroute->pq, iroute->bbox, stage);
 
         if (rval == -2) {
 	   unable_to_route(iroute->net->netname, NULL, 0);
@@ -2109,7 +2911,7 @@ int route_setup(NET net, struct routeinfo_ *iroute, u_char stage)
      else {	/* Do this for power bus connections */
 
         while(1) {
-           rval = set_node_to_net(iroute->nsrc, PR_SOURCE, &iroute->glist[0], iroute->bbox, stage);
+           rval = set_node_to_net(iroute->nsrc, PR_SOURCE, iroute->pq, iroute->bbox, stage);
 	   if (rval == -2) {
 	      iroute->nsrc = iroute->nsrc->next;
 	      if (iroute->nsrc == NULL) break;
@@ -2135,22 +2937,7 @@ int route_setup(NET net, struct routeinfo_ *iroute, u_char stage)
   if (!result) {
      // Remove nodes of the net from Nodeinfo.nodeloc so that they will not be
      // used for crossover costing of future routes.
-	POINT pt1 = get_left_lower_trunk_point(net->bbox);
-	POINT pt2 = get_right_upper_trunk_point(net->bbox);
-	POINT vpnt = create_point(0,0,0);
-	NODEINFO nodeptr;
-	for (vpnt->layer = 0; vpnt->layer < Num_layers; vpnt->layer++)
-		for(vpnt->x=pt1->x;vpnt->x<pt2->x;vpnt->x++)
-			for(vpnt->y=pt1->y;vpnt->y<pt2->y;vpnt->y++)
-				if(check_point_area(net->bbox,vpnt,FALSE,WIRE_ROOM))
-					if(Nodeinfo[vpnt->layer])
-						if((nodeptr = NODEIPTR(vpnt->x, vpnt->y, vpnt->layer)))
-							if((iroute->nsrc = nodeptr->nodeloc))
-								if(iroute->nsrc->netnum == iroute->net->netnum)
-									nodeptr->nodeloc = (NODE)NULL;
-	free(vpnt);
-	free(pt1);
-	free(pt2);
+     clear_net_nodelocs(iroute->net);
 
      free_glist(iroute);
      return 0;
@@ -2158,7 +2945,9 @@ int route_setup(NET net, struct routeinfo_ *iroute, u_char stage)
 
   // Generate a search area mask representing the "likely best route".
   if ((iroute->do_pwrbus == FALSE) && (maskMode == MASK_AUTO)) {
-     if (stage == 0)
+     if (net->guide != NULL)
+	createGuideMask(net, (u_char)Numpasses);
+     else if (stage == 0)
 	createMask(net, MASK_SMALL, (u_char)Numpasses);
      else
 	createMask(net, MASK_LARGE, (u_char)Numpasses);
@@ -2178,20 +2967,15 @@ int route_setup(NET net, struct routeinfo_ *iroute, u_char stage)
   // algorithm.  If the initial max cost is so low that no route can
   // be found, it will be doubled on each pass.
 
-  POINT p1, p2;
+  int x1, y1, x2, y2;
   if (iroute->do_pwrbus)
      iroute->maxcost = 20;	// Maybe make this SegCost * row height?
   else {
-     p1 = get_left_lower_trunk_point(iroute->bbox);
-     p2 = get_right_upper_trunk_point(iroute->bbox);
-     iroute->maxcost = 1 + 2 * MAX((p2->x - p1->x), (p2->y - p1->y)) * SegCost + (int)stage * ConflictCost;
+     get_bbox_extent(iroute->bbox, &x1, &y1, &x2, &y2);
+     iroute->maxcost = 1 + 2 * MAX((x2 - x1), (y2 - y1)) * SegCost + (int)stage * ConflictCost;
      iroute->maxcost /= (iroute->nsrc->numnodes - 1);
-     free(p1);
-     free(p2);
   }
 
-  netnum = iroute->net->netnum;
-
   iroute->nsrctap = iroute->nsrc->taps;
   if (iroute->nsrctap == NULL) iroute->nsrctap = iroute->nsrc->extend;
   if (iroute->nsrctap == NULL) {
@@ -2230,12 +3014,14 @@ int route_setup(NET net, struct routeinfo_ *iroute, u_char stage)
 
 int route_segs(struct routeinfo_ *iroute, u_char stage, u_char graphdebug)
 {
-  POINT gpoint, gunproc;
   NET net = iroute->net;
   int  i, o;
   int  pass, maskpass;
   u_int forbid;
   GRIDP best, curpt;
+  u_int key;
+  u_long expanded = 0;
+  u_long allocs;
   int rval;
   u_char first = TRUE;
   u_char check_order[6];
@@ -2248,8 +3034,14 @@ int route_segs(struct routeinfo_ *iroute, u_char stage, u_char graphdebug)
   best.x = 0;
   best.y = 0;
   best.lay = 0;
-  gunproc = (POINT)NULL;
   maskpass = 0;
+
+  // Only the growth of the queue is counted, not the route
+  // committed below.
+  allocs = iroute->pq->allocs;
+
+  // Targets may have changed since the last search (A* only)
+  pq_set_goals(iroute->pq, (iroute->do_pwrbus) ? NULL : net);
   
   for (pass = 0; pass < Numpasses; pass++) {
 
@@ -2263,37 +3055,25 @@ int route_segs(struct routeinfo_ *iroute, u_char stage, u_char graphdebug)
        FprintfT(stdout, " (maxcost is %d)\n", iroute->maxcost);
     }
 
-    while (TRUE) {
-      // Check priority stack and move down if 1st priorty is empty
-      while (iroute->glist[0] == NULL) {
-	 for (i = 0; i < 5; i++)
-	    iroute->glist[i] = iroute->glist[i + 1];
-	 iroute->glist[5] = NULL;
-	 if ((iroute->glist[0] == NULL) && (iroute->glist[1] == NULL) &&
-		(iroute->glist[2] == NULL) && (iroute->glist[3] == NULL) &&
-		(iroute->glist[4] == NULL))
-	    break;
-      }
-      gpoint = iroute->glist[0];
-      if (gpoint == NULL) break;
-
-      iroute->glist[0] = gpoint->next;
+    // Positions come off the queue in order of increasing cost (in
+    // A* mode, cost plus the lower bound of the cost to the targets)
+    while (pq_pop(iroute->pq, &curpt, &key)) {
 
-      curpt.x = gpoint->x;
-      curpt.y = gpoint->y;
-      curpt.lay = gpoint->layer;
-	
       Pr = &OBS2VAL(curpt.x, curpt.y, curpt.lay);
 
       // ignore grid positions that have already been processed
       if (Pr->flags & PR_PROCESSED) {
 	 Pr->flags &= ~PR_ON_STACK;
-	 freePOINT(gpoint);
 	 continue;
       }
+
+      // ignore entries superceded by a lower cost to the same position
+      if ((Pr->flags & PR_COST) && (curpt.cost > Pr->prdata.cost))
+	 continue;
+
       //if (graphdebug) highlight_source(net);
       //if (graphdebug) highlight_dest(net);
-      //if (graphdebug) highlight_starts(iroute.glist);
+      //if (graphdebug) highlight_starts(iroute->pq);
       //if (graphdebug) highlight(curpt.x, curpt.y);
 
       if (Pr->flags & PR_COST)
@@ -2332,7 +3112,10 @@ int route_segs(struct routeinfo_ *iroute, u_char stage, u_char graphdebug)
          // Don't continue processing from the target
 	 Pr->flags |= PR_PROCESSED;
 	 Pr->flags &= ~PR_ON_STACK;
-	 freePOINT(gpoint);
+
+	 // Everything left on the queue costs at least as much as
+	 // this target, so the search is complete.
+	 if (best.cost <= iroute->maxcost) break;
 	 continue;
       }
 
@@ -2340,27 +3123,27 @@ int route_segs(struct routeinfo_ *iroute, u_char stage, u_char graphdebug)
 
 	 // Severely limit the search space by not processing anything that
 	 // is not under the current route mask, which identifies a narrow
-	 // "best route" solution.
+	 // "best route" solution.  Set the point aside for the next pass.
 
 	 if (RMASK(curpt.x, curpt.y) > (u_char)maskpass) {
-	    gpoint->next = gunproc;
-	    gunproc = gpoint;
+	    pq_defer(iroute->pq, &curpt);
 	    continue;
 	 }
 
-         // Quick check:  Limit maximum cost to limit search space
-         // Move the point onto the "unprocessed" stack and we'll pick up
-         // from this point on the next pass, if needed.
+         // Quick check:  Limit maximum cost to limit search space.
+         // All remaining points cost at least this much, so put the
+         // point back and pick up from here on the next pass, if needed.
+         // In A* mode, no route through this point can cost less than
+         // the key, so the key is used for the check.
 
-         if (curpt.cost > iroute->maxcost) {
+         if (key > iroute->maxcost) {
 	    max_reached = TRUE;
-	    gpoint->next = gunproc;
-	    gunproc = gpoint;
-	    continue;
+	    pq_push(iroute->pq, curpt.x, curpt.y, curpt.lay, curpt.cost);
+	    break;
 	 }
       }
       Pr->flags &= ~PR_ON_STACK;
-      free(gpoint);
+      expanded++;
 
       // check east/west/north/south, and bottom to top
 
@@ -2389,10 +3172,11 @@ int route_segs(struct routeinfo_ *iroute, u_char stage, u_char graphdebug)
 	 check_order[5] = WEST  | ((forbid & BLOCKED_W) ? conflict : 0);
       }
 
-      // Check order is from 0 (1st priority) to 5 (last priority).  However, this
-      // is a stack system, so the last one placed on the stack is the first to be
-      // pulled and processed.  Therefore we evaluate and drop positions to check
-      // on the stack in reverse order (5 to 0).
+      // Check order is from 0 (1st priority) to 5 (last priority).  The
+      // queue is ordered by cost, but positions of equal cost are pulled
+      // last-in, first-out.  Therefore we evaluate and drop positions on
+      // the queue in reverse order (5 to 0) to break ties in favor of
+      // the preferred direction.
 
       for (i = 5; i >= 0; i--) {
 	 predecessor = 0;
@@ -2401,64 +3185,44 @@ int route_segs(struct routeinfo_ *iroute, u_char stage, u_char graphdebug)
 	       predecessor = PR_CONFLICT;
 	    case EAST:
 	       predecessor |= PR_PRED_W;
-	       if ((gpoint = eval_pt(net,&curpt, predecessor, stage))) {
-         	     gpoint->next = iroute->glist[i];
-         	     iroute->glist[i] = gpoint;
-	       }
+	       eval_pt(net, &curpt, predecessor, stage, iroute->pq);
 	       break;
 
 	    case WEST | PR_CONFLICT:
 	       predecessor = PR_CONFLICT;
 	    case WEST:
 	       predecessor |= PR_PRED_E;
-	       if ((gpoint = eval_pt(net,&curpt, predecessor, stage))) {
-         	     gpoint->next = iroute->glist[i];
-         	     iroute->glist[i] = gpoint;
-	       }
+	       eval_pt(net, &curpt, predecessor, stage, iroute->pq);
 	       break;
          
 	    case SOUTH | PR_CONFLICT:
 	       predecessor = PR_CONFLICT;
 	    case SOUTH:
 	       predecessor |= PR_PRED_N;
-	       if ((gpoint = eval_pt(net,&curpt, predecessor, stage))) {
-         	     gpoint->next = iroute->glist[i];
-         	     iroute->glist[i] = gpoint;
-	       }
+	       eval_pt(net, &curpt, predecessor, stage, iroute->pq);
 	       break;
 
 	    case NORTH | PR_CONFLICT:
 	       predecessor = PR_CONFLICT;
 	    case NORTH:
 	       predecessor |= PR_PRED_S;
-	       if ((gpoint = eval_pt(net,&curpt, predecessor, stage))) {
-         	     gpoint->next = iroute->glist[i];
-         	     iroute->glist[i] = gpoint;
-	       }
+	       eval_pt(net, &curpt, predecessor, stage, iroute->pq);
 	       break;
       
 	    case DOWN | PR_CONFLICT:
 	       predecessor = PR_CONFLICT;
 	    case DOWN:
 	       predecessor |= PR_PRED_U;
-	       if (curpt.lay > 0) {
-			if ((gpoint = eval_pt(net,&curpt, predecessor, stage))) {
-				gpoint->next = iroute->glist[i];
-				iroute->glist[i] = gpoint;
-			}
-	       }
+	       if (curpt.lay > 0)
+		  eval_pt(net, &curpt, predecessor, stage, iroute->pq);
 	       break;
          
 	    case UP | PR_CONFLICT:
 	       predecessor = PR_CONFLICT;
 	    case UP:
 	       predecessor |= PR_PRED_D;
-	       if (curpt.lay < (Num_layers - 1)) {
-			if ((gpoint = eval_pt(net,&curpt, predecessor, stage))) {
-				gpoint->next = iroute->glist[i];
-				iroute->glist[i] = gpoint;
-			}
-	       }
+	       if (curpt.lay < (Num_layers - 1))
+		  eval_pt(net, &curpt, predecessor, stage, iroute->pq);
 	       break;
             }
          }
@@ -2466,9 +3230,7 @@ int route_segs(struct routeinfo_ *iroute, u_char stage, u_char graphdebug)
       // Mark this node as processed
       Pr->flags |= PR_PROCESSED;
 
-    } // while stack is not empty
-
-    free_glist(iroute);
+    } // while queue is not empty
 
     // If we found a route, save it and return
 
@@ -2504,12 +3266,11 @@ int route_segs(struct routeinfo_ *iroute, u_char stage, u_char graphdebug)
     else
        maskpass++;			// Increase the mask size
 
-    if (gunproc == NULL) break;		// route failure not due to limiting
+    if (pq_empty(iroute->pq)) break;	// route failure not due to limiting
 					// search to maxcost or to masking
 
-    // Regenerate the stack of unprocessed nodes
-    iroute->glist[0] = gunproc;
-    gunproc = NULL;
+    // Return the masked positions to the queue
+    pq_restore(iroute->pq);
   } // pass
   
   if (!first && (Verbose > 2)) {
@@ -2525,9 +3286,19 @@ int route_segs(struct routeinfo_ *iroute, u_char stage, u_char graphdebug)
 
 done:
 
+  allocs = iroute->pq->allocs - allocs;
+  if (Verbose > 2)
+     FprintfT(stdout, "%s: Expanded %lu positions, %lu allocations\n",
+		__FUNCTION__, expanded, allocs);
+  net->expanded += expanded;
+  Tcl_MutexLock(&TotalRoutesMutex);
+  TotalExpanded += expanded;
+  TotalSearchAllocs += allocs;
+  Tcl_MutexUnlock(&TotalRoutesMutex);
+
   FprintfT(stdout, "%s: Exiting with code %d\n", __FUNCTION__, rval);
-  // Regenerate the stack of unprocessed nodes
-  if (gunproc != NULL) iroute->glist[0] = gunproc;
+  // Return the masked positions to the queue
+  pq_restore(iroute->pq);
   return rval;
   
 } /* route_segs() */
@@ -2536,19 +3307,16 @@ done:
 /* createemptyroute - begin a ROUTE structure			*/
 /*								*/
 /*   ARGS: a nodes						*/
-/*   RETURNS: ROUTE calloc'd and ready to begin			*/
+/*   RETURNS: ROUTE allocated and ready to begin		*/
 /*   SIDE EFFECTS: 						*/
 /*   AUTHOR and DATE: steve beccue      Fri Aug 8		*/
 /*--------------------------------------------------------------*/
 
-TCL_DECLARE_MUTEX(createemptyrouteMutex)
 ROUTE createemptyroute(void)
 {
    ROUTE rt;
 
-   Tcl_MutexLock(&createemptyrouteMutex);
-   rt = (ROUTE)calloc(1, sizeof(struct route_));
-   Tcl_MutexUnlock(&createemptyrouteMutex);
+   rt = allocROUTE();
    rt->netnum = 0;
    rt->segments = (SEG)NULL;
    rt->flags = (u_char)0;
@@ -2589,6 +3357,9 @@ void helpmessage(void)
 	Fprintf(stdout, "\t-r <value>\t\t\tForce output resolution scale.\n");
 	Fprintf(stdout, "\t-f       \t\t\tForce all pins to be routable.\n");
 	Fprintf(stdout, "\t-e <level>\t\t\tLevel of effort to keep trying.\n");
+	Fprintf(stdout, "\t-j <number>\t\t\tNumber of router threads (default all processors).\n");
+	Fprintf(stdout, "\t-D       \t\t\tSame routes for any number of threads.\n");
+	Fprintf(stdout, "\t-S <file>\t\t\tSave or reuse design setup in snapshot file.\n");
 	Fprintf(stdout, "\n");
     }
 #ifdef TCL_QROUTER
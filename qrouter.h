@@ -15,9 +15,12 @@
 #include <stdint.h>
 #include <X11/Xlibint.h> // needed for type BOOL
 
-#define THREADS 6
-#define TCL_THREADS THREADS
-#define MAX_NUM_THREADS THREADS
+// Tcl's mutex and condition calls are no-ops unless TCL_THREADS is
+// defined before <tcl.h> is included, so it is also set by the Makefile.
+#ifndef TCL_THREADS
+#define TCL_THREADS 1
+#endif
+extern int NumThreads;		// number of stage 1 router threads
 extern int numThreadsRunningG;
 
 #define DEBUG_DELAY 100
@@ -121,6 +124,7 @@ struct proute_ {        // partial route
       u_int cost;	// cost of route coming from predecessor
       u_int net;	// net number at route point
    } prdata;
+   u_int epoch;		// route setup that last copied this point from Obs
 };
 
 // Bit values for "flags" in PROUTE
@@ -207,6 +211,69 @@ struct dpoint_ {
    int gridx, gridy;
 };
 
+/* PQUEUE is the search front of the maze router.  Entries are	*/
+/* kept in a flat array and chained by index into buckets that	*/
+/* are indexed by route cost, so that positions are expanded	*/
+/* in order of increasing cost (Dial's algorithm).		*/
+
+typedef struct pqentry_ PQENTRY;
+
+struct pqentry_ {
+   int x, y, lay;
+   u_int cost;
+   u_int key;		// Cost plus A* lower bound (bucket index)
+   int next;		// Index of next entry in the same bucket
+};
+
+/* A target area of an A* search, in grid coordinates */
+
+typedef struct pqgoal_ PQGOAL;
+
+struct pqgoal_ {
+   int x1, y1, x2, y2;
+   int l1, l2;
+};
+
+typedef struct pqueue_ *PQUEUE;
+
+struct pqueue_ {
+   PQENTRY *entries;	// Flat entry store
+   int numentries;	// Number of entries ever used
+   int maxentries;	// Allocated size of entries[]
+   int freelist;	// Chain of recycled entries
+   int *bucket;		// First entry of each cost, or PQ_NONE
+   int numbuckets;	// Allocated size of bucket[]
+   int minbucket;	// No bucket below this one is occupied
+   int maxbucket;	// No bucket above this one is occupied
+   int deferred;	// Chain of entries held for the next pass
+   int count;		// Number of entries in buckets
+   PQGOAL *goals;	// A* target areas
+   int numgoals;	// Number of target areas, 0 if not A*
+   int maxgoals;	// Allocated size of goals[]
+   int stepx, stepy;	// Least cost of one grid step in X and Y
+   u_long allocs;	// Heap allocations made by the queue
+};
+
+/* SWINDOW is the private search area of a router thread.  It	*/
+/* covers the trunk extent of the bounding box of the net being	*/
+/* routed, plus a halo of one grid position, and holds the	*/
+/* working copy of Obs[] (one plane per layer) and the route	*/
+/* mask for that area only.					*/
+
+typedef struct swindow_ *SWINDOW;
+
+struct swindow_ {
+   int x0, y0;		// Grid position of the lower left corner
+   int width, height;	// Extent in grid positions
+   int size;		// Positions per plane (width * height)
+   int maxsize;		// Allocated positions per plane
+   int maxlayers;	// Allocated number of planes
+   PROUTE *obs2;	// Working copy of Obs[], layer by layer
+   u_char *rmask;	// Route mask
+   PROUTE outside;	// Stand-in for positions outside the window
+   u_char outmask;	// Stand-in mask value outside the window
+};
+
 typedef struct route_ *ROUTE;
 typedef struct node_ *NODE;
 
@@ -298,21 +365,61 @@ struct gate_ {
 typedef struct net_ *NET;
 typedef struct netlist_ *NETLIST;
 
-typedef struct bbox_line_ *BBOX_LINE;
-struct bbox_line_ {
-	POINT pt1;
-	POINT pt2;
-	BBOX_LINE next;
+// Outline of a bbox as a rectilinear polygon.  The vertices run
+// counter-clockwise from the lowest of the leftmost ones, without
+// repeated or collinear vertices, so that horizontal and vertical
+// edges alternate.  The edges are kept split by direction, each
+// sorted by its coordinate c and spanning lo to hi.
+
+typedef struct bbox_vertex_ {
+	int x, y;
+} BBOX_VERTEX;
+
+typedef struct bbox_edge_ {
+	int c;
+	int lo, hi;
+} BBOX_EDGE;
+
+// Rasterized membership of a bbox for one (with_edge, edge_distance)
+// combination, one bit per grid position of the trunk extent.
+
+typedef struct bbox_raster_ *BBOX_RASTER;
+struct bbox_raster_ {
+	BBOX_RASTER next;
+	BOOL with_edge;
+	int edge_distance;
+	int x0, y0;		// grid position of bit 0 of row 0
+	int width, height;
+	int rowbytes;
+	u_char *bits;
+};
+
+// Area of a bbox as disjoint rectangles, ordered by rows, with the
+// same membership as the raster with edges included.
+
+typedef struct bbox_rect_ {
+	int x1, y1, x2, y2;
+} BBOX_RECT;
+
+typedef struct bbox_area_ *BBOX_AREA;
+struct bbox_area_ {
+	int num_rects;
+	BBOX_RECT *rects;
 };
 
 typedef struct bbox_ *BBOX;
 struct bbox_ {
-	BBOX_LINE edges;
-	int num_edges;
+	BBOX_VERTEX *vertex;
+	int num_vertices;
+	int x1, y1, x2, y2;	// extent of the vertices
+	BBOX_EDGE *hedge, *vedge;
+	int num_hedges, num_vedges;
 	BOOL x1_exception;
 	BOOL y1_exception;
 	BOOL x2_exception;
 	BOOL y2_exception;
+	BBOX_RASTER raster;	// compiled with the vertices, see node.c
+	BBOX_AREA area;		// likewise
 };
 
 struct net_ {
@@ -333,6 +440,9 @@ struct net_ {
    BOOL locked;
    BOOL active;
    BOOL routed;
+   u_long expanded;	// grid positions expanded by the last route
+   int *guide;		// GCells of the global route (see global.c),
+   int numguide;	// sorted, or NULL if not globally routed
    NET next;
    char *bbox_color;
 };
@@ -344,6 +454,7 @@ struct net_ {
 #define NET_IGNORED  		4	// net is ignored by router
 #define NET_STUB     		8	// Net has at least one stub
 #define NET_VERTICAL_TRUNK	16	// Trunk line is (preferred) vertical
+#define NET_NEGOTIATE		32	// Net is in negotiated congestion routing
 
 #define FOR_THREAD 1
 #define NOT_FOR_THREAD 2
@@ -361,7 +472,7 @@ struct netlist_ {
 struct routeinfo_ {
    NET net;
    ROUTE rt;
-   POINT glist[6];	/* Lists of points by priority 0 to 5 */
+   PQUEUE pq;		/* Positions pending evaluation, by cost */
    NODE nsrc;
    DPOINT nsrctap;
    int maxcost;
@@ -442,7 +553,7 @@ struct routeinfo_ {
 
 extern STRING  DontRoute;
 extern STRING  CriticalNet;
-extern NET     CurNet[MAX_NUM_THREADS];
+extern NET     *CurNet;		// net in flight, one per router thread
 extern NETLIST FailedNets;	// nets that have failed the first pass
 extern char    *DEFfilename;
 extern char    *delayfilename;
@@ -454,7 +565,6 @@ extern GATE   Nlgates;
 extern NET    *Nlnets;
 
 extern u_int  *Obs[MAX_LAYERS];		// obstructions by layer, y, x
-extern PROUTE *Obs2[MAX_LAYERS]; 	// working copy of Obs 
 extern float  *Obsinfo[MAX_LAYERS];	// temporary detailed obstruction info
 extern NODEINFO *Nodeinfo[MAX_LAYERS];	// stub route distances to pins and
 					// pointers to node structures.
@@ -462,9 +572,32 @@ extern NODEINFO *Nodeinfo[MAX_LAYERS];	// stub route distances to pins and
 #define NODEIPTR(x, y, l) (Nodeinfo[l][OGRID(x, y, l)])
 #define OBSINFO(x, y, l) (Obsinfo[l][OGRID(x, y, l)])
 #define OBSVAL(x, y, l)  (Obs[l][OGRID(x, y, l)])
-#define OBS2VAL(x, y, l) (Obs2[l][OGRID(x, y, l)])
 
-#define RMASK(x, y)      (RMask[OGRID(x, y, 0)])
+// The working copy of Obs[] and the route mask live in the search
+// window of the calling thread, which is open while a net is being
+// routed.  Records are copied from Obs[] lazily:  each route setup
+// starts a new epoch for the thread running it, and any record that
+// does not carry the thread's epoch is refreshed on first access.
+// Positions outside of the window read as a single stand-in record.
+//
+// Per-thread state is kept in __thread variables throughout.  The
+// macros below read SearchWin and Obs2Epoch on every grid access of
+// the search, which a lookup through Tcl_GetThreadData() would turn
+// into a function call each time.
+
+extern __thread u_int Obs2Epoch;
+extern __thread SWINDOW SearchWin;
+
+#define INWINDOW(x, y)	 (((u_int)((x) - SearchWin->x0) < (u_int)SearchWin->width) \
+		&& ((u_int)((y) - SearchWin->y0) < (u_int)SearchWin->height))
+#define WGRID(x, y)	 (((y) - SearchWin->y0) * SearchWin->width + ((x) - SearchWin->x0))
+#define WOBS2(x, y, l)	 (SearchWin->obs2[(l) * SearchWin->size + WGRID(x, y)])
+
+#define OBS2VAL(x, y, l) (*((INWINDOW(x, y) && (WOBS2(x, y, l).epoch == Obs2Epoch)) \
+		? &WOBS2(x, y, l) : window_obs2(x, y, l)))
+
+#define RMASK(x, y)      (*(INWINDOW(x, y) ? &SearchWin->rmask[WGRID(x, y)] \
+		: &SearchWin->outmask))
 #define CONGEST(x, y)	 (Congestion[OGRID(x, y, 0)])
 
 extern DSEG  UserObs;			// user-defined obstruction layers
@@ -475,7 +608,10 @@ extern int    Numnets;
 extern int    Pinlayers;		// Number of layers containing pin info.
 
 extern u_char Verbose;
+extern u_long TotalExpanded;
+extern u_long TotalSearchAllocs;
 extern u_char forceRoutable;
+extern u_char Deterministic;
 extern u_char maskMode;
 extern u_char mapType;
 extern u_char ripLimit;
@@ -513,7 +649,9 @@ ROUTE createemptyroute(void);
 void helpmessage(void);
 
 int    set_num_channels(void);
+void   set_num_threads(int numthreads);
 int    allocate_obs_array();
+PROUTE *window_obs2(int x, int y, int lay);
 int    countlist(NETLIST net);
 int    runqrouter(int argc, char *argv[]);
 
@@ -526,11 +664,14 @@ int    write_delays(char *filename);
 int    dofirststage(u_char graphdebug, int debug_netnum);
 int    dosecondstage(u_char graphdebug, u_char singlestep,
 		u_char onlybreak, u_int effort);
+int    donegotiate(u_char graphdebug);
 int    dothirdstage(u_char graphdebug, int debug_netnum, u_int effort);
 
 int    doroute(NET net, u_char stage, u_char graphdebug);
 NET    getnettoroute(int order);
 NET getnetbyname(char *name);
+NET    getnetbynum(int netnum);
+void   hash_net(NET net);
 int    route_net_ripup(NET net, u_char graphdebug, u_char onlybreak);
 
 NETLIST postpone_net(NETLIST postponed, NET net);
@@ -0,0 +1,441 @@
+/*--------------------------------------------------------------*/
+/* schedule.c --						*/
+/*								*/
+/* Planning of the parallel routing stages.			*/
+/*								*/
+/* Nets whose bboxes collide must not be routed at the same	*/
+/* time.  Rather than test each pending net against the nets	*/
+/* in flight every time a worker becomes idle, the conflicts	*/
+/* between all nets of a pass are found once, with a bin index	*/
+/* (bbindex.c) narrowing the exact collision tests down to	*/
+/* nets whose extents overlap.  The conflict graph is then	*/
+/* colored greedily, so that each net goes to the earliest	*/
+/* wave holding none of its conflicts.  Nets of one wave can	*/
+/* all run concurrently.					*/
+/*								*/
+/* The nets are colored longest first:  critical nets in list	*/
+/* order, then the rest by decreasing estimated work.  The	*/
+/* plan lists the nets wave by wave in that same order, so	*/
+/* that the long routes start first and the short ones fill in	*/
+/* around them, rather than a single large net being left to	*/
+/* run on its own at the end.  The stage 1 thread pool hands	*/
+/* out nets in plan order, skipping those in conflict with a	*/
+/* net in flight.						*/
+/*								*/
+/* In deterministic mode the result must not depend on which	*/
+/* nets happen to run at the same time, so two nets conflict	*/
+/* whenever one may write Obs[] where the other may read it:	*/
+/* a route is searched inside the window on its bbox and	*/
+/* written back there, plus the neighbors of its positions.	*/
+/* Each net then waits for the nets in conflict with it that	*/
+/* come before it in the list, so that every route sees Obs[]	*/
+/* exactly as it would when routing the list one net at a	*/
+/* time.  The wave of a net is the length of its longest chain	*/
+/* of such waits.						*/
+/*								*/
+/* The cleanup stage (stage 3) rips up each net before routing	*/
+/* it again, so there the area of a net also covers its	*/
+/* current routes, and nets conflict by area as in		*/
+/* deterministic mode.						*/
+/*--------------------------------------------------------------*/
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include <tcl.h>
+
+#include "qrouter.h"
+#include "qconfig.h"
+#include "node.h"
+#include "mask.h"
+#include "bbindex.h"
+#include "window.h"
+#include "schedule.h"
+
+typedef struct {
+    int index;			// Position in the list
+    int wave;
+    BOOL critical;
+    u_long work;
+} PLANITEM;
+
+/*--------------------------------------------------------------*/
+/* estimate_net_work --						*/
+/*								*/
+/* Predict the work of routing a net, in grid positions the	*/
+/* search would expand.  Each connection of a node to the rest	*/
+/* of the net searches the volume of the bbox on all layers.	*/
+/* Positions taken by other nets or obstructions force detours	*/
+/* and extra passes, so they count double.  The density of	*/
+/* those is sampled on a coarse grid over the bbox extent.  A	*/
+/* net without a bbox may be routed anywhere on the die.	*/
+/*--------------------------------------------------------------*/
+
+u_long
+estimate_net_work(NET net)
+{
+    int x, y, lay, x1, y1, x2, y2, dx, dy;
+    u_int val, samples, blocked;
+    double area;
+
+    if (!get_bbox_extent(net->bbox, &x1, &y1, &x2, &y2)) {
+	x1 = y1 = 0;
+	x2 = NumChannelsX[0] - 1;
+	y2 = NumChannelsY[0] - 1;
+	area = (double)NumChannelsX[0] * (double)NumChannelsY[0];
+    }
+    else {
+	area = (double)get_bbox_area(net);
+	if (area <= 0) area = (double)(x2 - x1 + 1) * (double)(y2 - y1 + 1);
+    }
+    x1 = MAX(x1, 0);
+    y1 = MAX(y1, 0);
+
+    samples = blocked = 0;
+    dx = MAX((x2 - x1) / WORK_SAMPLES, 1);
+    dy = MAX((y2 - y1) / WORK_SAMPLES, 1);
+    for (lay = 0; lay < Num_layers; lay++) {
+	if (Obs[lay] == NULL) continue;
+	for (x = x1; (x <= x2) && (x < NumChannelsX[lay]); x += dx)
+	    for (y = y1; (y <= y2) && (y < NumChannelsY[lay]); y += dy) {
+		val = OBSVAL(x, y, lay) & NETNUM_MASK;
+		if ((val != 0) && (val != (u_int)net->netnum)) blocked++;
+		samples++;
+	    }
+    }
+
+    area *= Num_layers;
+    if (samples > 0) area *= 1.0 + (double)blocked / (double)samples;
+    return (u_long)(area * MAX(net->numnodes - 1, 1));
+}
+
+/* Coloring order:  critical nets first, in list order, then by	*/
+/* decreasing work.						*/
+
+static int
+compare_work(const void *a, const void *b)
+{
+    const PLANITEM *p = (const PLANITEM *)a;
+    const PLANITEM *q = (const PLANITEM *)b;
+
+    if (p->critical != q->critical) return p->critical ? -1 : 1;
+    if (!p->critical && (p->work != q->work)) return (p->work > q->work) ? -1 : 1;
+    return (p->index < q->index) ? -1 : (p->index > q->index) ? 1 : 0;
+}
+
+/* Dispatch order:  by wave, then in coloring order */
+
+static int
+compare_items(const void *a, const void *b)
+{
+    const PLANITEM *p = (const PLANITEM *)a;
+    const PLANITEM *q = (const PLANITEM *)b;
+
+    if (p->wave != q->wave) return (p->wave < q->wave) ? -1 : 1;
+    return compare_work(a, b);
+}
+
+static void *
+plan_alloc(size_t size)
+{
+    void *ptr;
+
+    ptr = malloc((size == 0) ? 1 : size);
+    if (ptr == NULL) {
+	printf("%s: memory leak. dying!\n",__FUNCTION__);
+	exit(0);
+    }
+    return ptr;
+}
+
+/* Area of Obs[] that routing "net" may read or write, apart	*/
+/* from the neighbors of the positions written:  its search	*/
+/* window and, when "cleanup" is set, its current routes.	*/
+
+static void
+net_area(NET net, BOOL cleanup, int *x1, int *y1, int *x2, int *y2)
+{
+    int bx1, by1, bx2, by2;
+
+    window_bounds(net, x1, y1, x2, y2);
+    if (cleanup && getBboxCurrent(net, &bx1, &by1, &bx2, &by2)) {
+	*x1 = MIN(*x1, bx1);
+	*y1 = MIN(*y1, by1);
+	*x2 = MAX(*x2, bx2);
+	*y2 = MAX(*y2, by2);
+    }
+}
+
+/*--------------------------------------------------------------*/
+/* plan_net_waves --						*/
+/*								*/
+/* Plan the routing of the nets of list "l" by "numthreads"	*/
+/* workers, for the cleanup stage if "cleanup" is set.  With a	*/
+/* single worker nothing runs concurrently, so the conflicts	*/
+/* are not computed and the nets keep the order of the list.	*/
+/* The list itself is left alone.				*/
+/* Obs[] is read for the work estimates, so no nets may be	*/
+/* in flight.							*/
+/*--------------------------------------------------------------*/
+
+NETPLAN
+plan_net_waves(NETLIST l, int numthreads, BOOL cleanup)
+{
+    NETPLAN plan;
+    NETLIST nl;
+    NET *lnet;
+    BBINDEX idx;
+    PLANITEM *item, *order;
+    int *pairs, *cand, *ladj, *lstart, *mark, *pos, *fill, *area, *r, *q;
+    int i, j, k, w, n, count, numpairs, maxpairs;
+    int x1, y1, x2, y2, g;
+    BOOL byarea;
+    double hist, model;
+
+    n = 0;
+    for (nl = l; nl; nl = nl->next) n++;
+
+    plan = (NETPLAN)plan_alloc(sizeof(struct netplan_));
+    plan->numnets = n;
+    plan->net = (NET *)plan_alloc(n * sizeof(NET));
+    plan->wave = (int *)plan_alloc(n * sizeof(int));
+    plan->work = (u_long *)plan_alloc(n * sizeof(u_long));
+    plan->rank = (int *)plan_alloc(n * sizeof(int));
+    plan->adjstart = (int *)plan_alloc((n + 1) * sizeof(int));
+    plan->numwaves = 0;
+
+    lnet = (NET *)plan_alloc(n * sizeof(NET));
+    for (i = 0, nl = l; nl; nl = nl->next, i++) lnet[i] = nl->net;
+
+    /* Find all pairs of colliding nets */
+
+    numpairs = maxpairs = 0;
+    pairs = NULL;
+    area = NULL;
+    byarea = (Deterministic || cleanup) ? TRUE : FALSE;
+    if (numthreads > 1) {
+	idx = bbindex_new();
+	for (i = 0; i < n; i++) bbindex_insert(idx, lnet[i], i);
+
+	/* g is the furthest any area reaches past the extent	*/
+	/* that the index holds for its net.			*/
+
+	g = 0;
+	if (byarea) {
+	    area = (int *)plan_alloc(4 * n * sizeof(int));
+	    for (i = 0; i < n; i++) {
+		r = area + 4 * i;
+		net_area(lnet[i], cleanup, &r[0], &r[1], &r[2], &r[3]);
+		if (get_bbox_extent(lnet[i]->bbox, &x1, &y1, &x2, &y2)) {
+		    g = MAX(g, MAX(x1 - r[0], y1 - r[1]));
+		    g = MAX(g, MAX(r[2] - x2, r[3] - y2));
+		}
+	    }
+	}
+
+	for (i = 0; i < n; i++) {
+	    r = (byarea) ? area + 4 * i : NULL;
+	    if (byarea) {
+		/* Writes reach one position past each area, so	*/
+		/* areas conflict unless two positions apart.	*/
+		cand = bbindex_query_rect(idx, r[0] - g - 2, r[1] - g - 2,
+				r[2] + g + 2, r[3] + g + 2, &count);
+	    }
+	    else
+		cand = bbindex_query(idx, lnet[i], &count);
+	    for (k = 0; k < count; k++) {
+		j = cand[k];
+		if (j <= i) continue;
+		if (byarea) {
+		    q = area + 4 * j;
+		    if ((q[0] > r[2] + 2) || (r[0] - 2 > q[2]) ||
+				(q[1] > r[3] + 2) || (r[1] - 2 > q[3]))
+			continue;
+		}
+		else if (!check_single_bbox_collision(lnet[i]->bbox,
+				lnet[j]->bbox))
+		    continue;
+		if (numpairs == maxpairs) {
+		    maxpairs = (maxpairs == 0) ? 256 : (maxpairs << 1);
+		    pairs = (int *)realloc(pairs, 2 * maxpairs * sizeof(int));
+		    if (pairs == NULL) {
+			printf("%s: memory leak. dying!\n",__FUNCTION__);
+			exit(0);
+		    }
+		}
+		pairs[2 * numpairs] = i;
+		pairs[2 * numpairs + 1] = j;
+		numpairs++;
+	    }
+	}
+	bbindex_free(idx);
+	free(area);
+    }
+
+    /* Conflicts by list position */
+
+    lstart = (int *)calloc(n + 1, sizeof(int));
+    ladj = (int *)plan_alloc(2 * numpairs * sizeof(int));
+    fill = (int *)plan_alloc((n + 1) * sizeof(int));
+    if (lstart == NULL) {
+	printf("%s: memory leak. dying!\n",__FUNCTION__);
+	exit(0);
+    }
+    for (k = 0; k < numpairs; k++) {
+	lstart[pairs[2 * k] + 1]++;
+	lstart[pairs[2 * k + 1] + 1]++;
+    }
+    for (i = 0; i < n; i++) lstart[i + 1] += lstart[i];
+    for (i = 0; i <= n; i++) fill[i] = lstart[i];
+    for (k = 0; k < numpairs; k++) {
+	ladj[fill[pairs[2 * k]]++] = pairs[2 * k + 1];
+	ladj[fill[pairs[2 * k + 1]]++] = pairs[2 * k];
+    }
+
+    /* Estimate the work of each net.  Nets routed before report	*/
+    /* the positions their last route expanded;  the estimates	*/
+    /* of the others are scaled by how far off the model was	*/
+    /* for those.							*/
+
+    item = (PLANITEM *)plan_alloc(n * sizeof(PLANITEM));
+    hist = model = 0.0;
+    for (i = 0; i < n; i++) {
+	item[i].index = i;
+	item[i].wave = -1;
+	item[i].critical = (lnet[i]->flags & NET_CRITICAL) ? TRUE : FALSE;
+	item[i].work = estimate_net_work(lnet[i]);
+	if (lnet[i]->expanded > 0) {
+	    hist += (double)lnet[i]->expanded;
+	    model += (double)item[i].work;
+	}
+    }
+    for (i = 0; i < n; i++) {
+	if (lnet[i]->expanded > 0)
+	    item[i].work = lnet[i]->expanded;
+	else if (model > 0)
+	    item[i].work = (u_long)((double)item[i].work * hist / model);
+    }
+
+    /* With a single worker the nets keep the order of the list */
+
+    if (numthreads <= 1) {
+	for (i = 0; i < n; i++) item[i].wave = 0;
+	plan->numwaves = (n > 0) ? 1 : 0;
+    }
+    else if (Deterministic) {
+	/* Wave after the latest conflict earlier in the list */
+
+	for (i = 0; i < n; i++) {
+	    w = 0;
+	    for (j = lstart[i]; (j < lstart[i + 1]) && (ladj[j] < i); j++)
+		w = MAX(w, item[ladj[j]].wave + 1);
+	    item[i].wave = w;
+	    if (w >= plan->numwaves) plan->numwaves = w + 1;
+	}
+	qsort(item, n, sizeof(PLANITEM), compare_items);
+    }
+    else {
+	/* Greedy coloring, longest first.  mark[w] == i flags wave	*/
+	/* w as taken by a conflict of net i.				*/
+
+	order = (PLANITEM *)plan_alloc(n * sizeof(PLANITEM));
+	for (i = 0; i < n; i++) order[i] = item[i];
+	qsort(order, n, sizeof(PLANITEM), compare_work);
+	mark = (int *)plan_alloc((n + 1) * sizeof(int));
+	for (w = 0; w <= n; w++) mark[w] = -1;
+	for (k = 0; k < n; k++) {
+	    i = order[k].index;
+	    for (j = lstart[i]; j < lstart[i + 1]; j++)
+		if (item[ladj[j]].wave >= 0) mark[item[ladj[j]].wave] = i;
+	    for (w = 0; mark[w] == i; w++);
+	    item[i].wave = w;
+	    if (w >= plan->numwaves) plan->numwaves = w + 1;
+	}
+	free(order);
+	free(mark);
+	qsort(item, n, sizeof(PLANITEM), compare_items);
+    }
+
+    /* Lay out the plan in dispatch order */
+
+    pos = (int *)plan_alloc((n + 1) * sizeof(int));
+    for (i = 0; i < n; i++) {
+	pos[item[i].index] = i;
+	plan->net[i] = lnet[item[i].index];
+	plan->rank[i] = item[i].index;
+	plan->wave[i] = item[i].wave;
+	plan->work[i] = item[i].work;
+    }
+    plan->adj = (int *)plan_alloc(2 * numpairs * sizeof(int));
+    plan->adjstart[0] = 0;
+    for (i = 0; i < n; i++) {
+	j = item[i].index;
+	plan->adjstart[i + 1] = plan->adjstart[i] + lstart[j + 1] - lstart[j];
+	for (k = lstart[j]; k < lstart[j + 1]; k++)
+	    plan->adj[plan->adjstart[i] + k - lstart[j]] = pos[ladj[k]];
+    }
+
+    free(pairs);
+    free(lstart);
+    free(ladj);
+    free(fill);
+    free(item);
+    free(pos);
+    free(lnet);
+    return plan;
+}
+
+void
+free_net_plan(NETPLAN plan)
+{
+    if (plan == NULL) return;
+    free(plan->net);
+    free(plan->wave);
+    free(plan->work);
+    free(plan->rank);
+    free(plan->adjstart);
+    free(plan->adj);
+    free(plan);
+}
+
+/*--------------------------------------------------------------*/
+/* print_net_plan --						*/
+/*								*/
+/* Report the waves of a plan, and the share of the time the	*/
+/* "numthreads" workers could be kept busy if each wave took	*/
+/* as long as its longest net, or its total work spread evenly	*/
+/* over the workers, whichever is more.				*/
+/*--------------------------------------------------------------*/
+
+void
+print_net_plan(NETPLAN plan, int numthreads)
+{
+    int i, w, nets;
+    u_long total, span, wsum, wmax;
+
+    if (plan == NULL) return;
+    if (numthreads < 1) numthreads = 1;
+
+    total = span = 0;
+    for (i = 0, w = 0; w < plan->numwaves; w++) {
+	nets = 0;
+	wsum = wmax = 0;
+	for (; (i < plan->numnets) && (plan->wave[i] == w); i++) {
+	    nets++;
+	    wsum += plan->work[i];
+	    if (plan->work[i] > wmax) wmax = plan->work[i];
+	}
+	total += wsum;
+	span += MAX(wmax, (wsum + numthreads - 1) / numthreads);
+	if (Verbose > 1)
+	    Fprintf(stdout, "Wave %d: %d nets, estimated work %lu\n", w, nets, wsum);
+    }
+    Fprintf(stdout, "Planned %d nets in %d waves, %d conflicts", plan->numnets,
+		plan->numwaves, plan->adjstart[plan->numnets] / 2);
+    if (span > 0)
+	Fprintf(stdout, ", expected use of %d threads %.0f%%", numthreads,
+		100.0 * (double)total / ((double)span * numthreads));
+    Fprintf(stdout, "\n");
+}
+
+/* end of schedule.c */
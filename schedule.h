@@ -0,0 +1,44 @@
+/*--------------------------------------------------------------*/
+/* schedule.h --						*/
+/*								*/
+/* Planning of the parallel routing stages (header file)	*/
+/*--------------------------------------------------------------*/
+
+#ifndef SCHEDULE_H
+
+/* Obstructions are sampled on about this many positions	*/
+/* along each side of a bbox when estimating routing work.	*/
+#define WORK_SAMPLES		16
+
+/* The second stage looks this many nets per thread down the	*/
+/* FailedNets list for nets to route in parallel.		*/
+#define RIPUP_LOOKAHEAD		4
+
+typedef struct netplan_ *NETPLAN;
+
+/* A plan lists the nets of one routing pass in dispatch order.	*/
+/* Nets in the same wave do not collide and may all be routed	*/
+/* at the same time.  Conflicts are kept in compressed form:	*/
+/* the nets colliding with net i are net[adj[k]] for k from	*/
+/* adjstart[i] up to adjstart[i + 1].				*/
+
+struct netplan_ {
+    int numnets;
+    NET *net;			// Nets in dispatch order
+    int *wave;			// Wave of each net
+    u_long *work;		// Estimated work of each net
+    int *rank;			// Position of each net in the list
+    int *adjstart;		// numnets + 1 entries
+    int *adj;
+    int numwaves;
+};
+
+u_long  estimate_net_work(NET net);
+NETPLAN plan_net_waves(NETLIST l, int numthreads, BOOL cleanup);
+void    free_net_plan(NETPLAN plan);
+void    print_net_plan(NETPLAN plan, int numthreads);
+
+#define SCHEDULE_H
+#endif
+
+/* end of schedule.h */
@@ -0,0 +1,640 @@
+/*--------------------------------------------------------------*/
+/* snapshot.c --						*/
+/*								*/
+/* Binary snapshot of the design state set up after reading	*/
+/* the DEF file.						*/
+/*								*/
+/* After a DEF file is read, post_def_setup() works out the	*/
+/* obstructions, the node positions and the stub routes of the	*/
+/* whole grid.  For a fixed placement this gives the same	*/
+/* result on every run, and on large designs it takes a good	*/
+/* part of the run time.  When a snapshot file is given, the	*/
+/* result is saved to it, and later runs on the same inputs	*/
+/* map the file and copy the state back instead.		*/
+/*								*/
+/* A snapshot holds Obs[], every Nodeinfo record, the number	*/
+/* of reachable taps of each node and Pinlayers.  Records	*/
+/* point to nodes by their position in a walk of the netlist,	*/
+/* which is the same on every run that reads the same DEF	*/
+/* file.  The snapshot is keyed by a digest of the text of all	*/
+/* LEF, DEF and config files read, and of the layer and grid	*/
+/* parameters, which commands may change after the files have	*/
+/* been read.  A snapshot with a different key, version or	*/
+/* grid is ignored and overwritten.				*/
+/*								*/
+/* The snapshot also keeps the messages printed while the	*/
+/* state was set up, such as unconnected nodes and nodes	*/
+/* without taps, and a run that reads it prints them again as	*/
+/* the run that saved it printed them.  They are recorded by	*/
+/* tcl_vprintf(), so only a Tcl build keeps them.		*/
+/*								*/
+/* Snapshots are written in the byte order and layout of the	*/
+/* machine and are not meant to be moved between machines.	*/
+/*--------------------------------------------------------------*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/mman.h>
+
+#include "qrouter.h"
+#include "qconfig.h"
+#include "node.h"
+#include "lef.h"
+#include "snapshot.h"
+
+char *SnapshotFile = NULL;	// Snapshot file, or NULL if none
+
+/* Digests of the text of the inputs */
+static uint64_t SnapDigest[SNAP_INPUTS];
+
+/* Messages recorded while the state is set up.  Each is kept	*/
+/* as its stream ('o' or 'e') followed by its text and a null.	*/
+static char *SnapMessages = NULL;
+static int SnapMessagesLen = 0;
+static int SnapMessagesMax = 0;
+static u_char SnapRecording = FALSE;
+
+#define SNAP_SEED	0x6a09e667f3bcc908ULL
+#define SNAP_MUL1	0x87c37b91114253d5ULL
+#define SNAP_MUL2	0x4cf5ad432745937fULL
+#define SNAP_HOST	0x01020304
+
+typedef struct snaphead_ SNAPHEAD;
+
+struct snaphead_ {
+    char magic[8];
+    u_int version;
+    u_int host;			// SNAP_HOST, to catch byte order
+    uint64_t key;
+    int numlayers;
+    int numnets;
+    int numnodes;
+    int pinlayers;
+    int numchannelsx[MAX_LAYERS];
+    int numchannelsy[MAX_LAYERS];
+    int numinfo[MAX_LAYERS];	// Nodeinfo records on each layer
+    int msglen;			// Bytes of recorded messages
+};
+
+/* One Nodeinfo record.  The header is followed by Obs[] of	*/
+/* each layer, then the records of each layer, then numtaps	*/
+/* of each node, then the recorded messages.			*/
+
+typedef struct snapinfo_ SNAPINFO;
+
+struct snapinfo_ {
+    int index;			// Position in Nodeinfo[layer]
+    int nodesav;		// Node numbers, or -1 for none
+    int nodeloc;
+    int flags;
+    float stub;
+    float offset;
+};
+
+/* A node and its position in the netlist walk */
+
+typedef struct snapnode_ SNAPNODE;
+
+struct snapnode_ {
+    NODE node;
+    int num;
+};
+
+/*--------------------------------------------------------------*/
+/* Fold "len" bytes at "data" into the digest "h".		*/
+/*--------------------------------------------------------------*/
+
+static uint64_t
+snapshot_digest(uint64_t h, const void *data, size_t len)
+{
+    const u_char *p = (const u_char *)data;
+    uint64_t w;
+
+    h ^= (uint64_t)len * SNAP_MUL2;
+    while (len >= 8) {
+	memcpy(&w, p, 8);
+	h ^= w * SNAP_MUL1;
+	h = ((h << 31) | (h >> 33)) * SNAP_MUL2;
+	p += 8;
+	len -= 8;
+    }
+    while (len > 0) {
+	h ^= (uint64_t)*p++ * SNAP_MUL1;
+	h = ((h << 31) | (h >> 33)) * SNAP_MUL2;
+	len--;
+    }
+    return h;
+}
+
+/*--------------------------------------------------------------*/
+/* snapshot_input ---						*/
+/*								*/
+/* Add the text of an input file to the digest of its kind.	*/
+/* A DEF file replaces the digest of the DEF file read before,	*/
+/* since it replaces the design.  LEF and config files add to	*/
+/* what has been read so far.					*/
+/*--------------------------------------------------------------*/
+
+void
+snapshot_input(int kind, char *text, size_t len)
+{
+    if ((kind == SNAP_DEF) || (SnapDigest[kind] == 0))
+	SnapDigest[kind] = SNAP_SEED;
+    SnapDigest[kind] = snapshot_digest(SnapDigest[kind], text, len);
+}
+
+/*--------------------------------------------------------------*/
+/* snapshot_record ---						*/
+/*								*/
+/* Start (on = TRUE) or stop recording the messages printed,	*/
+/* for the snapshot to be saved next.  Starting drops what	*/
+/* was recorded before.						*/
+/*--------------------------------------------------------------*/
+
+void
+snapshot_record(u_char on)
+{
+    if (on) SnapMessagesLen = 0;
+    SnapRecording = on;
+}
+
+/*--------------------------------------------------------------*/
+/* snapshot_message ---						*/
+/*								*/
+/* Record the text of a message printed to stream "f", if	*/
+/* recording.  Called by tcl_vprintf() for every message.	*/
+/*--------------------------------------------------------------*/
+
+void
+snapshot_message(FILE *f, char *text)
+{
+    int len;
+
+    if (!SnapRecording) return;
+
+    len = strlen(text) + 2;
+    if (SnapMessagesLen + len > SnapMessagesMax) {
+	SnapMessagesMax = (SnapMessagesMax == 0) ? 4096 : SnapMessagesMax * 2;
+	if (SnapMessagesMax < SnapMessagesLen + len)
+	    SnapMessagesMax = SnapMessagesLen + len;
+	SnapMessages = (char *)realloc(SnapMessages, SnapMessagesMax);
+	if (SnapMessages == NULL) {
+	    printf("%s: memory leak. dying!\n", __FUNCTION__);
+	    exit(0);
+	}
+    }
+    SnapMessages[SnapMessagesLen] = (f == stderr) ? 'e' : 'o';
+    memcpy(SnapMessages + SnapMessagesLen + 1, text, len - 1);
+    SnapMessagesLen += len;
+}
+
+/*--------------------------------------------------------------*/
+/* Key of the current inputs:  the file digests, and the	*/
+/* parameters that post_def_setup() depends on.			*/
+/*--------------------------------------------------------------*/
+
+static uint64_t
+snapshot_key(void)
+{
+    uint64_t h = SNAP_SEED;
+    double lval[8];
+    DSEG ds;
+    int i;
+
+    h = snapshot_digest(h, SnapDigest, sizeof(SnapDigest));
+    h = snapshot_digest(h, &Num_layers, sizeof(int));
+    h = snapshot_digest(h, &Xlowerbound, sizeof(double));
+    h = snapshot_digest(h, &Ylowerbound, sizeof(double));
+    h = snapshot_digest(h, &forceRoutable, sizeof(u_char));
+
+    for (i = 0; i < Num_layers; i++) {
+	lval[0] = PitchX[i];
+	lval[1] = PitchY[i];
+	lval[2] = LefGetRouteWidth(i);
+	lval[3] = LefGetRouteSpacing(i);
+	lval[4] = LefGetViaWidth(i, i, 0);
+	lval[5] = LefGetViaWidth(i, i, 1);
+	lval[6] = (i > 0) ? LefGetViaWidth(i - 1, i, 0) : 0.0;
+	lval[7] = (i > 0) ? LefGetViaWidth(i - 1, i, 1) : 0.0;
+	h = snapshot_digest(h, lval, sizeof(lval));
+	h = snapshot_digest(h, &NumChannelsX[i], sizeof(int));
+	h = snapshot_digest(h, &NumChannelsY[i], sizeof(int));
+	h = snapshot_digest(h, &Vert[i], sizeof(int));
+    }
+
+    for (ds = UserObs; ds; ds = ds->next) {
+	lval[0] = ds->x1;
+	lval[1] = ds->y1;
+	lval[2] = ds->x2;
+	lval[3] = ds->y2;
+	h = snapshot_digest(h, lval, 4 * sizeof(double));
+	h = snapshot_digest(h, &ds->layer, sizeof(int));
+    }
+
+    if (vddnet) h = snapshot_digest(h, vddnet, strlen(vddnet) + 1);
+    if (gndnet) h = snapshot_digest(h, gndnet, strlen(gndnet) + 1);
+    if (clknet) h = snapshot_digest(h, clknet, strlen(clknet) + 1);
+
+    return h;
+}
+
+/*--------------------------------------------------------------*/
+/* Sort nodes by address, and by walk position among equals.	*/
+/*--------------------------------------------------------------*/
+
+static int
+compare_snapnodes(const void *a, const void *b)
+{
+    const SNAPNODE *na = (const SNAPNODE *)a;
+    const SNAPNODE *nb = (const SNAPNODE *)b;
+
+    if (na->node != nb->node)
+	return ((uintptr_t)na->node < (uintptr_t)nb->node) ? -1 : 1;
+    return na->num - nb->num;
+}
+
+/*--------------------------------------------------------------*/
+/* Number the nodes of the design:  the nodes of each net in	*/
+/* Nlnets order, then any other nodes of the gates, such as	*/
+/* the power and ground placeholders.  Returns the nodes in	*/
+/* number order, and in "sorted" the same nodes sorted by	*/
+/* address for snapshot_node_num().				*/
+/*--------------------------------------------------------------*/
+
+static NODE *
+snapshot_nodes(int *count, SNAPNODE **sorted)
+{
+    SNAPNODE *sn;
+    NODE *nodes, node;
+    GATE g;
+    int i, n, k, max;
+
+    max = 0;
+    for (i = 0; i < Numnets; i++)
+	for (node = Nlnets[i]->netnodes; node; node = node->next)
+	    max++;
+    for (g = Nlgates; g; g = g->next)
+	max += g->nodes;
+
+    sn = (SNAPNODE *)malloc((max + 1) * sizeof(SNAPNODE));
+    nodes = (NODE *)malloc((max + 1) * sizeof(NODE));
+    if ((sn == NULL) || (nodes == NULL)) {
+	printf("%s: memory leak. dying!\n", __FUNCTION__);
+	exit(0);
+    }
+
+    n = 0;
+    for (i = 0; i < Numnets; i++)
+	for (node = Nlnets[i]->netnodes; node; node = node->next) {
+	    sn[n].node = node;
+	    sn[n].num = n;
+	    n++;
+	}
+    for (g = Nlgates; g; g = g->next)
+	for (i = 0; i < g->nodes; i++) {
+	    if (g->noderec[i] == NULL) continue;
+	    sn[n].node = g->noderec[i];
+	    sn[n].num = n;
+	    n++;
+	}
+
+    /* Keep only the first visit of each node */
+
+    qsort(sn, n, sizeof(SNAPNODE), compare_snapnodes);
+    for (i = 0; i < n; i++) nodes[i] = NULL;
+    for (i = 0; i < n; i++)
+	if ((i == 0) || (sn[i].node != sn[i - 1].node))
+	    nodes[sn[i].num] = sn[i].node;
+
+    for (i = 0, k = 0; i < n; i++)
+	if (nodes[i] != NULL)
+	    nodes[k++] = nodes[i];
+
+    /* Renumber the sorted list to match */
+
+    for (i = 0; i < k; i++) {
+	sn[i].node = nodes[i];
+	sn[i].num = i;
+    }
+    qsort(sn, k, sizeof(SNAPNODE), compare_snapnodes);
+
+    *count = k;
+    if (sorted != NULL)
+	*sorted = sn;
+    else
+	free(sn);
+    return nodes;
+}
+
+/*--------------------------------------------------------------*/
+/* Number of "node" in the sorted list, -1 for no node, or -2	*/
+/* if the node is not in the list.				*/
+/*--------------------------------------------------------------*/
+
+static int
+snapshot_node_num(SNAPNODE *sorted, int count, NODE node)
+{
+    int lo, hi, mid;
+
+    if (node == NULL) return -1;
+
+    lo = 0;
+    hi = count - 1;
+    while (lo <= hi) {
+	mid = (lo + hi) / 2;
+	if (sorted[mid].node == node)
+	    return sorted[mid].num;
+	else if ((uintptr_t)sorted[mid].node < (uintptr_t)node)
+	    lo = mid + 1;
+	else
+	    hi = mid - 1;
+    }
+    return -2;
+}
+
+/*--------------------------------------------------------------*/
+/* Fill in the header for the current design.			*/
+/*--------------------------------------------------------------*/
+
+static void
+snapshot_header(SNAPHEAD *head, int numnodes)
+{
+    int i;
+
+    memset(head, 0, sizeof(SNAPHEAD));
+    memcpy(head->magic, SNAPSHOT_MAGIC, sizeof(head->magic));
+    head->version = SNAPSHOT_VERSION;
+    head->host = SNAP_HOST;
+    head->key = snapshot_key();
+    head->numlayers = Num_layers;
+    head->numnets = Numnets;
+    head->numnodes = numnodes;
+    for (i = 0; i < Num_layers; i++) {
+	head->numchannelsx[i] = NumChannelsX[i];
+	head->numchannelsy[i] = NumChannelsY[i];
+    }
+}
+
+/*--------------------------------------------------------------*/
+/* save_snapshot ---						*/
+/*								*/
+/* Write the design state left by post_def_setup() to the	*/
+/* file "filename".  The file is written under a temporary	*/
+/* name and renamed when complete, so that a run that is cut	*/
+/* short does not leave a partial snapshot behind.		*/
+/*								*/
+/* Returns 0 on success, 1 on failure.				*/
+/*--------------------------------------------------------------*/
+
+int
+save_snapshot(char *filename)
+{
+    SNAPHEAD head;
+    SNAPINFO *info;
+    SNAPNODE *sorted;
+    NODEINFO lnode;
+    NODE *nodes;
+    u_char *numtaps;
+    char *tmpname;
+    FILE *f;
+    int numnodes, l, j, n, size;
+    int result = 1;
+
+    nodes = snapshot_nodes(&numnodes, &sorted);
+    snapshot_header(&head, numnodes);
+    head.pinlayers = Pinlayers;
+    head.msglen = SnapMessagesLen;
+
+    tmpname = (char *)malloc(strlen(filename) + 5);
+    sprintf(tmpname, "%s.tmp", filename);
+    f = fopen(tmpname, "w");
+    if (f == NULL) {
+	Fprintf(stderr, "Cannot open snapshot file %s for writing.\n",
+		tmpname);
+	free(tmpname);
+	free(sorted);
+	free(nodes);
+	return 1;
+    }
+
+    /* count_pinlayers() has freed Nodeinfo[] above the pin layers */
+
+    for (l = 0; l < Pinlayers; l++) {
+	size = NumChannelsX[l] * NumChannelsY[l];
+	for (j = 0; j < size; j++)
+	    if (Nodeinfo[l][j] != NULL) head.numinfo[l]++;
+    }
+    if (fwrite(&head, sizeof(SNAPHEAD), 1, f) != 1) goto done;
+
+    for (l = 0; l < Num_layers; l++) {
+	size = NumChannelsX[l] * NumChannelsY[l];
+	if (fwrite(Obs[l], sizeof(u_int), size, f) != size) goto done;
+    }
+
+    for (l = 0; l < Pinlayers; l++) {
+	size = NumChannelsX[l] * NumChannelsY[l];
+	info = (SNAPINFO *)malloc((head.numinfo[l] + 1) * sizeof(SNAPINFO));
+	for (j = 0, n = 0; j < size; j++) {
+	    lnode = Nodeinfo[l][j];
+	    if (lnode == NULL) continue;
+	    info[n].index = j;
+	    info[n].nodesav = snapshot_node_num(sorted, numnodes, lnode->nodesav);
+	    info[n].nodeloc = snapshot_node_num(sorted, numnodes, lnode->nodeloc);
+	    info[n].flags = (int)lnode->flags;
+	    info[n].stub = lnode->stub;
+	    info[n].offset = lnode->offset;
+	    if ((info[n].nodesav < -1) || (info[n].nodeloc < -1)) {
+		Fprintf(stderr, "Node at grid position %d layer %d is not "
+			"in the netlist;  no snapshot written.\n", j, l);
+		free(info);
+		goto done;
+	    }
+	    n++;
+	}
+	j = fwrite(info, sizeof(SNAPINFO), n, f);
+	free(info);
+	if (j != n) goto done;
+    }
+
+    numtaps = (u_char *)malloc(numnodes + 1);
+    for (j = 0; j < numnodes; j++) numtaps[j] = nodes[j]->numtaps;
+    j = fwrite(numtaps, 1, numnodes, f);
+    free(numtaps);
+    if (j != numnodes) goto done;
+
+    if (fwrite(SnapMessages, 1, head.msglen, f) != head.msglen) goto done;
+
+    result = 0;
+
+done:
+    if (fclose(f) != 0) result = 1;
+    if ((result == 0) && (rename(tmpname, filename) != 0)) result = 1;
+    if (result != 0) {
+	Fprintf(stderr, "Error writing snapshot file %s.\n", filename);
+	unlink(tmpname);
+    }
+    else if (Verbose > 0)
+	Fprintf(stdout, "Saved design state to snapshot %s.\n", filename);
+
+    free(tmpname);
+    free(sorted);
+    free(nodes);
+    return result;
+}
+
+/*--------------------------------------------------------------*/
+/* load_snapshot ---						*/
+/*								*/
+/* Replace the work of post_def_setup() from the creation of	*/
+/* obstructions through count_pinlayers() by the state saved	*/
+/* in "filename".  Obs[] and Nodeinfo[] must be allocated, and	*/
+/* Nodeinfo[] must still be empty.				*/
+/*								*/
+/* Returns 0 if the state was loaded, or 1 if the file is	*/
+/* missing or does not match the current inputs, in which	*/
+/* case nothing has been changed.				*/
+/*--------------------------------------------------------------*/
+
+int
+load_snapshot(char *filename)
+{
+    SNAPHEAD head, *fhead;
+    SNAPINFO *info, *si;
+    NODEINFO lnode;
+    NODE *nodes;
+    struct stat st;
+    char *map, *p, *msg, *msgend;
+    u_char *numtaps;
+    size_t expect;
+    int fd, numnodes, l, j, size;
+    int result = 1;
+
+    fd = open(filename, O_RDONLY);
+    if (fd < 0) return 1;
+
+    if ((fstat(fd, &st) != 0) || (st.st_size < sizeof(SNAPHEAD))) {
+	close(fd);
+	return 1;
+    }
+    map = mmap(NULL, (size_t)st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (map == MAP_FAILED) return 1;
+
+    nodes = snapshot_nodes(&numnodes, NULL);
+    snapshot_header(&head, numnodes);
+    fhead = (SNAPHEAD *)map;
+
+    /* Check everything before changing anything */
+
+    if (memcmp(fhead->magic, head.magic, sizeof(head.magic)) ||
+		(fhead->version != head.version) ||
+		(fhead->host != head.host) ||
+		(fhead->key != head.key) ||
+		(fhead->numlayers != head.numlayers) ||
+		(fhead->numnets != head.numnets) ||
+		(fhead->numnodes != head.numnodes) ||
+		memcmp(fhead->numchannelsx, head.numchannelsx,
+			sizeof(head.numchannelsx)) ||
+		memcmp(fhead->numchannelsy, head.numchannelsy,
+			sizeof(head.numchannelsy)))
+	goto done;
+
+    if ((fhead->pinlayers < 0) || (fhead->pinlayers > Num_layers)) goto done;
+    if (fhead->msglen < 0) goto done;
+
+    expect = sizeof(SNAPHEAD) + numnodes + fhead->msglen;
+    for (l = 0; l < Num_layers; l++) {
+	if (fhead->numinfo[l] < 0) goto done;
+	if ((l >= fhead->pinlayers) && (fhead->numinfo[l] > 0)) goto done;
+	expect += (size_t)NumChannelsX[l] * NumChannelsY[l] * sizeof(u_int);
+	expect += (size_t)fhead->numinfo[l] * sizeof(SNAPINFO);
+    }
+    if (expect != (size_t)st.st_size) goto done;
+
+    p = map + sizeof(SNAPHEAD);
+    for (l = 0; l < Num_layers; l++)
+	p += (size_t)NumChannelsX[l] * NumChannelsY[l] * sizeof(u_int);
+    info = (SNAPINFO *)p;
+    for (l = 0; l < Num_layers; l++) {
+	size = NumChannelsX[l] * NumChannelsY[l];
+	for (j = 0; j < fhead->numinfo[l]; j++) {
+	    si = info++;
+	    if ((si->index < 0) || (si->index >= size) ||
+			(si->nodesav < -1) || (si->nodesav >= numnodes) ||
+			(si->nodeloc < -1) || (si->nodeloc >= numnodes))
+		goto done;
+	}
+    }
+
+    msg = (char *)info + numnodes;
+    msgend = msg + fhead->msglen;
+    for (p = msg; p < msgend; p += strlen(p) + 1) {
+	if ((*p != 'o') && (*p != 'e')) goto done;
+	p++;
+	if (memchr(p, '\0', msgend - p) == NULL) goto done;
+    }
+
+    /* Copy the state in */
+
+    p = map + sizeof(SNAPHEAD);
+    for (l = 0; l < Num_layers; l++) {
+	size = NumChannelsX[l] * NumChannelsY[l];
+	memcpy(Obs[l], p, size * sizeof(u_int));
+	p += (size_t)size * sizeof(u_int);
+    }
+
+    info = (SNAPINFO *)p;
+    for (l = 0; l < Num_layers; l++) {
+	for (j = 0; j < fhead->numinfo[l]; j++) {
+	    si = info++;
+	    lnode = (NODEINFO)calloc(1, sizeof(struct nodeinfo_));
+	    lnode->nodesav = (si->nodesav < 0) ? NULL : nodes[si->nodesav];
+	    lnode->nodeloc = (si->nodeloc < 0) ? NULL : nodes[si->nodeloc];
+	    lnode->flags = (u_char)si->flags;
+	    lnode->stub = si->stub;
+	    lnode->offset = si->offset;
+	    Nodeinfo[l][si->index] = lnode;
+	}
+    }
+
+    numtaps = (u_char *)info;
+    for (j = 0; j < numnodes; j++) nodes[j]->numtaps = numtaps[j];
+
+    /* As count_pinlayers() does, drop Nodeinfo[] above the pin layers */
+
+    Pinlayers = fhead->pinlayers;
+    for (l = Pinlayers; l < Num_layers; l++) {
+	free(Nodeinfo[l]);
+	Nodeinfo[l] = NULL;
+    }
+
+    /* Print the messages of the setup again */
+
+    for (p = msg; p < msgend; p += strlen(p) + 1) {
+	Fprintf((*p == 'e') ? stderr : stdout, "%s", p + 1);
+	p++;
+    }
+#ifndef TCL_QROUTER
+    Fprintf(stdout, "Messages of the setup are not kept by this build;  "
+		"not repeating them from snapshot %s.\n", filename);
+#endif
+
+    result = 0;
+    if (Verbose > 0)
+	Fprintf(stdout, "Read design state from snapshot %s.\n", filename);
+
+done:
+    if ((result != 0) && (Verbose > 0))
+	Fprintf(stdout, "Snapshot %s does not match the design;  "
+		"setting up from the netlist.\n", filename);
+    munmap(map, (size_t)st.st_size);
+    free(nodes);
+    return result;
+}
+
+/* end of snapshot.c */
@@ -0,0 +1,32 @@
+/*--------------------------------------------------------------*/
+/* snapshot.h --						*/
+/*								*/
+/* Binary snapshot of the design state set up after reading	*/
+/* the DEF file (header file)					*/
+/*--------------------------------------------------------------*/
+
+#ifndef SNAPSHOT_H
+
+/* Bump SNAPSHOT_VERSION whenever the file layout, or the	*/
+/* meaning of anything stored in it, changes.			*/
+#define SNAPSHOT_MAGIC		"QRSNAP\n"
+#define SNAPSHOT_VERSION	2
+
+/* Inputs whose text keys the snapshot */
+#define SNAP_LEF		0	/* All LEF files read		*/
+#define SNAP_DEF		1	/* The DEF file last read	*/
+#define SNAP_CONFIG		2	/* All config files read	*/
+#define SNAP_INPUTS		3
+
+extern char *SnapshotFile;
+
+void snapshot_input(int kind, char *text, size_t len);
+int  load_snapshot(char *filename);
+int  save_snapshot(char *filename);
+void snapshot_record(u_char on);
+void snapshot_message(FILE *f, char *text);
+
+#define SNAPSHOT_H
+#endif
+
+/* end of snapshot.h */
@@ -22,10 +22,13 @@
 #include "maze.h"
 #include "qconfig.h"
 #include "lef.h"
+#include "def.h"
+#include "snapshot.h"
 #include "graphics.h"
 #include "node.h"
 #include "output.h"
 #include "tkSimple.h"
+#include "global.h"
 
 /* Global variables */
 
@@ -51,6 +54,9 @@ static int qrouter_map(
 static int qrouter_start(
     ClientData clientData, Tcl_Interp *interp,
     int objc, Tcl_Obj *CONST objv[]);
+static int qrouter_globalroute(
+    ClientData clientData, Tcl_Interp *interp,
+    int objc, Tcl_Obj *CONST objv[]);
 static int qrouter_stage1(
     ClientData clientData, Tcl_Interp *interp,
     int objc, Tcl_Obj *CONST objv[]);
@@ -114,6 +120,18 @@ static int qrouter_layers(
 static int qrouter_passes(
     ClientData clientData, Tcl_Interp *interp,
     int objc, Tcl_Obj *CONST objv[]);
+static int qrouter_search(
+    ClientData clientData, Tcl_Interp *interp,
+    int objc, Tcl_Obj *CONST objv[]);
+static int qrouter_threads(
+    ClientData clientData, Tcl_Interp *interp,
+    int objc, Tcl_Obj *CONST objv[]);
+static int qrouter_deterministic(
+    ClientData clientData, Tcl_Interp *interp,
+    int objc, Tcl_Obj *CONST objv[]);
+static int qrouter_snapshot(
+    ClientData clientData, Tcl_Interp *interp,
+    int objc, Tcl_Obj *CONST objv[]);
 static int qrouter_vdd(
     ClientData clientData, Tcl_Interp *interp,
     int objc, Tcl_Obj *CONST objv[]);
@@ -143,6 +161,7 @@ static cmdstruct qrouter_commands[] =
 {
    {"tag", qrouter_tag},
    {"start", qrouter_start},
+   {"global_route", qrouter_globalroute},
    {"stage1", qrouter_stage1},
    {"stage2", qrouter_stage2},
    {"stage3", qrouter_stage3},
@@ -160,6 +179,10 @@ static cmdstruct qrouter_commands[] =
    {"congested", qrouter_congested},
    {"layers", qrouter_layers},
    {"passes", qrouter_passes},
+   {"search", qrouter_search},
+   {"threads", qrouter_threads},
+   {"deterministic", qrouter_deterministic},
+   {"snapshot", qrouter_snapshot},
    {"vdd", qrouter_vdd},
    {"gnd", qrouter_gnd},
    {"clk", qrouter_clk},
@@ -265,6 +288,9 @@ void tcl_vprintf(FILE *f, const char *fmt, va_list args_in)
     }
     else if (nchars == -1) nchars = 126;
 
+    /* Keep setup messages for a snapshot of the design state */
+    snapshot_message(f, outptr + 24);
+
     for (i = 24; *(outptr + i) != '\0'; i++) {
        if (*(outptr + i) == '\"' || *(outptr + i) == '[' ||
 	  	*(outptr + i) == ']' || *(outptr + i) == '\\' ||
@@ -758,15 +784,7 @@ NET LookupNet(char *netname)
 
 NET LookupNetNr(int number)
 {
-    NET net;
-    int i;
-
-    for (i = 0; i < Numnets; i++) {
-       net = Nlnets[i];
-       if (net->netnum == number)
-	  return net;
-    }
-    return NULL;
+    return getnetbynum(number);
 }
 
 /*------------------------------------------------------*/
@@ -785,6 +803,59 @@ GATE LookupGate(char *gatename)
     return NULL;
 }
 
+/*------------------------------------------------------*/
+/* Command "global_route"				*/
+/*							*/
+/* Route all nets over a coarse grid of GCells, ahead	*/
+/* of stage1.  The GCells crossed by the route of each	*/
+/* net then take the place of the estimated best route	*/
+/* as the search mask of the net, whenever the mask	*/
+/* mode is "auto".					*/
+/*							*/
+/* The interpreter result is set to the total overflow	*/
+/* of the GCell edges.					*/
+/*							*/
+/* Options:						*/
+/*							*/
+/*  global_route	Route all nets			*/
+/*  global_route clear	Drop the global routes		*/
+/*------------------------------------------------------*/
+
+static int
+qrouter_globalroute(ClientData clientData, Tcl_Interp *interp,
+               int objc, Tcl_Obj *CONST objv[])
+{
+    int idx, result, overflow;
+
+    static char *subCmds[] = {
+	"clear", NULL
+    };
+    enum SubIdx {
+	ClearIdx
+    };
+
+    if (objc == 1) {
+	overflow = global_route();
+	Tcl_SetObjResult(interp, Tcl_NewIntObj(overflow));
+    }
+    else if (objc == 2) {
+	if ((result = Tcl_GetIndexFromObj(interp, objv[1],
+			(CONST84 char **)subCmds, "option", 0, &idx))
+			!= TCL_OK)
+	    return result;
+	switch (idx) {
+	    case ClearIdx:
+		global_clear();
+		break;
+	}
+    }
+    else {
+	Tcl_WrongNumArgs(interp, 1, objv, "?clear?");
+	return TCL_ERROR;
+    }
+    return QrouterTagCallback(interp, objc, objv);
+}
+
 /*------------------------------------------------------*/
 /* Command "stage1"					*/
 /*							*/
@@ -923,10 +994,8 @@ qrouter_stage1(ClientData clientData, Tcl_Interp *interp,
 	failcount = dofirststage(dodebug, stepnet);
     else {
 	if ((net != NULL) && (net->netnodes != NULL)) {
-	    for(int thnum=0;thnum<MAX_NUM_THREADS;thnum++) {
-			result = doroute(net, (u_char)0, dodebug);
-			failcount += (result == 0) ? 0 : 1;
-	    }
+	    result = doroute(net, (u_char)0, dodebug);
+	    failcount += (result == 0) ? 0 : 1;
 
 	    /* Remove from FailedNets list if routing	*/
 	    /* was successful				*/
@@ -987,6 +1056,8 @@ qrouter_stage1(ClientData clientData, Tcl_Interp *interp,
 /*  stage2 force	Force a terminal to be routable	*/
 /*  stage2 break	Only rip up colliding segment	*/
 /*  stage2 effort <n>	Level of effort (default 100)	*/
+/*  stage2 negotiate	Negotiate congestion instead of	*/
+/*			ripping up colliding nets	*/
 /*------------------------------------------------------*/
 
 static int
@@ -997,17 +1068,18 @@ qrouter_stage2(ClientData clientData, Tcl_Interp *interp,
     u_char dodebug;
     u_char dostep;
     u_char onlybreak;
+    u_char negotiate;
     u_char saveForce, saveOverhead;
     int i, idx, idx2, val, result, failcount;
     NET net = NULL;
 
     static char *subCmds[] = {
 	"debug", "mask", "limit", "route", "force", "tries", "step",
-	"break", "effort", NULL
+	"break", "effort", "negotiate", NULL
     };
     enum SubIdx {
 	DebugIdx, MaskIdx, LimitIdx, RouteIdx, ForceIdx, TriesIdx, StepIdx,
-	BreakIdx, EffortIdx
+	BreakIdx, EffortIdx, NegotiateIdx
     };
    
     static char *maskSubCmds[] = {
@@ -1022,6 +1094,7 @@ qrouter_stage2(ClientData clientData, Tcl_Interp *interp,
     dodebug = FALSE;
     dostep = FALSE;
     onlybreak = FALSE;
+    negotiate = FALSE;
     maskMode = MASK_AUTO;	// Mask mode is auto unless specified
     // Save these global defaults in case they are locally changed
     saveForce = forceRoutable;
@@ -1048,6 +1121,10 @@ qrouter_stage2(ClientData clientData, Tcl_Interp *interp,
 		case BreakIdx:
 		    onlybreak = TRUE;
 		    break;
+
+		case NegotiateIdx:
+		    negotiate = TRUE;
+		    break;
 	
 		case ForceIdx:
 		    forceRoutable = TRUE;
@@ -1137,7 +1214,9 @@ qrouter_stage2(ClientData clientData, Tcl_Interp *interp,
 	}
     }
 
-    if (net == NULL)
+    if ((net == NULL) && negotiate)
+	failcount = donegotiate(dodebug);
+    else if (net == NULL)
 	failcount = dosecondstage(dodebug, dostep, onlybreak, effort);
     else
 	failcount = route_net_ripup(net, dodebug, onlybreak);
@@ -1303,10 +1382,8 @@ qrouter_stage3(ClientData clientData, Tcl_Interp *interp,
 	failcount = dothirdstage(dodebug, stepnet, effort);
     else {
 	if ((net != NULL) && (net->netnodes != NULL)) {
-	    for(int thnum=0;thnum<MAX_NUM_THREADS;thnum++) {
-			result = doroute(net, (u_char)0, dodebug);
-			failcount += (result == 0) ? 0 : 1;
-	    }
+	    result = doroute(net, (u_char)0, dodebug);
+	    failcount += (result == 0) ? 0 : 1;
 
 	    /* Remove from FailedNets list if routing	*/
 	    /* was successful				*/
@@ -1524,20 +1601,38 @@ qrouter_readlef(ClientData clientData, Tcl_Interp *interp,
 
 /*------------------------------------------------------*/
 /* Command "read_def"					*/
+/*							*/
+/* With "-parallel", the COMPONENTS and NETS sections	*/
+/* are parsed on the router threads.  The result is the	*/
+/* same as reading the file serially.			*/
+/*							*/
+/* Options:						*/
+/*							*/
+/*	read_def [-parallel] [<filename>]		*/
 /*------------------------------------------------------*/
 
 static int
 qrouter_readdef(ClientData clientData, Tcl_Interp *interp,
                 int objc, Tcl_Obj *CONST objv[])
 {
-    if ((DEFfilename == NULL) && (objc != 2)) {
+    int argc = 1;
+
+    if ((objc > 1) && !strcmp(Tcl_GetString(objv[1]), "-parallel"))
+	argc++;
+    if (objc > argc + 1) {
+	Tcl_WrongNumArgs(interp, 1, objv, "?-parallel? ?filename?");
+	return TCL_ERROR;
+    }
+    if ((DEFfilename == NULL) && (objc != argc + 1)) {
 	Tcl_SetResult(interp, "No DEF filename specified!", NULL);
 	return TCL_ERROR;
     }
-    if (objc == 2)
-	read_def(Tcl_GetString(objv[1]));
+    DefParallel = (argc > 1) ? TRUE : FALSE;
+    if (objc == argc + 1)
+	read_def(Tcl_GetString(objv[argc]));
     else
 	read_def(NULL);
+    DefParallel = FALSE;
 
     // Redisplay
     draw_layout();
@@ -2232,6 +2327,200 @@ qrouter_passes(ClientData clientData, Tcl_Interp *interp,
     return QrouterTagCallback(interp, objc, objv);
 }
 
+/*------------------------------------------------------*/
+/* Command "threads"					*/
+/*							*/
+/* Set the number of router threads used to route nets	*/
+/* in parallel in the first stage.  The default is the	*/
+/* number of processors online, or the value of the -j	*/
+/* option to "start".  A value of 0 restores the	*/
+/* default.  With no argument, return the number of	*/
+/* threads.						*/
+/*							*/
+/* Options:						*/
+/*							*/
+/*	threads [<number>]				*/
+/*------------------------------------------------------*/
+
+static int
+qrouter_threads(ClientData clientData, Tcl_Interp *interp,
+               int objc, Tcl_Obj *CONST objv[])
+{
+    int result, value;
+
+    if (objc == 1) {
+	if (NumThreads == 0) set_num_threads(0);
+	Tcl_SetObjResult(interp, Tcl_NewIntObj(NumThreads));
+    }
+    else if (objc == 2) {
+	result = Tcl_GetIntFromObj(interp, objv[1], &value);
+	if (result != TCL_OK) return result;
+	if (value < 0) {
+	    Tcl_SetResult(interp, "Number of threads out of range", NULL);
+	    return TCL_ERROR;
+	}
+	set_num_threads(value);
+    }
+    else {
+	Tcl_WrongNumArgs(interp, 1, objv, "option ?arg?");
+	return TCL_ERROR;
+    }
+    return QrouterTagCallback(interp, objc, objv);
+}
+
+/*------------------------------------------------------*/
+/* Command "deterministic"				*/
+/*							*/
+/* When on, the first stage routes every net exactly	*/
+/* as a single thread would, so that the result does	*/
+/* not depend on the number of threads or on their	*/
+/* timing.  Nets then wait for all earlier nets near	*/
+/* them to finish, which leaves less room to route in	*/
+/* parallel.  The default is off, or on with the -D	*/
+/* option to "start".  With no argument, return the	*/
+/* current setting.					*/
+/*							*/
+/* Options:						*/
+/*							*/
+/*	deterministic [on|off]				*/
+/*------------------------------------------------------*/
+
+static int
+qrouter_deterministic(ClientData clientData, Tcl_Interp *interp,
+               int objc, Tcl_Obj *CONST objv[])
+{
+    int result, value;
+
+    if (objc == 1) {
+	Tcl_SetObjResult(interp, Tcl_NewBooleanObj(Deterministic));
+    }
+    else if (objc == 2) {
+	result = Tcl_GetBooleanFromObj(interp, objv[1], &value);
+	if (result != TCL_OK) return result;
+	Deterministic = (value) ? TRUE : FALSE;
+    }
+    else {
+	Tcl_WrongNumArgs(interp, 1, objv, "?on|off?");
+	return TCL_ERROR;
+    }
+    return QrouterTagCallback(interp, objc, objv);
+}
+
+/*------------------------------------------------------*/
+/* Command "snapshot"					*/
+/*							*/
+/* Name a file in which to save the design state set	*/
+/* up after reading a DEF file.  When the file holds	*/
+/* the state of the same LEF, DEF and config inputs,	*/
+/* read_def loads it instead of working the state out	*/
+/* again;  otherwise read_def works it out and saves	*/
+/* it.  "none" stops using a snapshot file.  With no	*/
+/* argument, return the current file name, or "none".	*/
+/*							*/
+/* Options:						*/
+/*							*/
+/*	snapshot [<filename>|none]			*/
+/*------------------------------------------------------*/
+
+static int
+qrouter_snapshot(ClientData clientData, Tcl_Interp *interp,
+               int objc, Tcl_Obj *CONST objv[])
+{
+    char *fname;
+
+    if (objc == 1) {
+	Tcl_SetObjResult(interp, Tcl_NewStringObj((SnapshotFile) ?
+		SnapshotFile : "none", -1));
+    }
+    else if (objc == 2) {
+	fname = Tcl_GetString(objv[1]);
+	if (SnapshotFile != NULL) free(SnapshotFile);
+	if (!strcasecmp(fname, "none"))
+	    SnapshotFile = NULL;
+	else
+	    SnapshotFile = strdup(fname);
+    }
+    else {
+	Tcl_WrongNumArgs(interp, 1, objv, "?filename|none?");
+	return TCL_ERROR;
+    }
+    return QrouterTagCallback(interp, objc, objv);
+}
+
+/*------------------------------------------------------*/
+/* Command "search"					*/
+/*							*/
+/* Select the route search method.  "maze" expands the	*/
+/* search evenly around the source in order of cost.	*/
+/* "astar" adds a lower bound on the remaining cost to	*/
+/* the nearest target, which directs the search toward	*/
+/* the targets and expands fewer grid positions.	*/
+/* With no argument, return the search method.		*/
+/*							*/
+/* Options:						*/
+/*							*/
+/*	search [maze|astar]				*/
+/*	search expanded		Return the number of	*/
+/*				grid positions expanded	*/
+/*				by all searches so far.	*/
+/*	search allocations	Return the number of	*/
+/*				heap allocations made	*/
+/*				to grow the queues of	*/
+/*				all searches so far.	*/
+/*	search reset		Reset both counts.	*/
+/*------------------------------------------------------*/
+
+static int
+qrouter_search(ClientData clientData, Tcl_Interp *interp,
+               int objc, Tcl_Obj *CONST objv[])
+{
+    int result, idx;
+
+    static char *subCmds[] = {
+	"maze", "astar", "expanded", "allocations", "reset", NULL
+    };
+    enum SubIdx {
+	MazeIdx, AStarIdx, ExpandedIdx, AllocsIdx, ResetIdx
+    };
+
+    if (objc == 1) {
+	Tcl_SetObjResult(interp, Tcl_NewStringObj((AStarSearch) ?
+		"astar" : "maze", -1));
+    }
+    else if (objc == 2) {
+	if ((result = Tcl_GetIndexFromObj(interp, objv[1],
+			(CONST84 char **)subCmds, "option", 0, &idx))
+			!= TCL_OK)
+	    return result;
+
+	switch (idx) {
+	    case MazeIdx:
+		AStarSearch = FALSE;
+		break;
+	    case AStarIdx:
+		AStarSearch = TRUE;
+		break;
+	    case ExpandedIdx:
+		Tcl_SetObjResult(interp, Tcl_NewWideIntObj(
+			(Tcl_WideInt)TotalExpanded));
+		break;
+	    case AllocsIdx:
+		Tcl_SetObjResult(interp, Tcl_NewWideIntObj(
+			(Tcl_WideInt)TotalSearchAllocs));
+		break;
+	    case ResetIdx:
+		TotalExpanded = 0;
+		TotalSearchAllocs = 0;
+		break;
+	}
+    }
+    else {
+	Tcl_WrongNumArgs(interp, 1, objv, "option ?arg?");
+	return TCL_ERROR;
+    }
+    return QrouterTagCallback(interp, objc, objv);
+}
+
 /*------------------------------------------------------*/
 /* Command "vdd"					*/
 /*							*/
@@ -0,0 +1,188 @@
+/*--------------------------------------------------------------*/
+/* window.c --							*/
+/*								*/
+/* Per-thread search windows of the maze router.		*/
+/*								*/
+/* The router used to keep the working copy of Obs[] (Obs2[])	*/
+/* and the route mask (RMask[]) as arrays covering the whole	*/
+/* die, shared by all router threads.  Threads routing nets	*/
+/* with overlapping areas then wrote into each other's costs	*/
+/* and flags, and each route touched records spread over the	*/
+/* full die width.  Instead, each thread now opens a window on	*/
+/* the bounding box of the net it is routing, and keeps both	*/
+/* planes for that area only, packed row by row.  The search	*/
+/* never leaves the net bbox, so nothing outside the window is	*/
+/* needed;  such positions read as a stand-in record, and	*/
+/* writes to them are discarded.				*/
+/*								*/
+/* Routes found in the window are committed back to Obs[] by	*/
+/* commit_proute() and writeback_route(), which serialize	*/
+/* their updates of Obs[] (see maze.c).  Obs[] itself is only	*/
+/* ever read from inside a window.				*/
+/*								*/
+/* The window buffers are reused for all nets routed by a	*/
+/* thread, and only grow.					*/
+/*--------------------------------------------------------------*/
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "qrouter.h"
+#include "qconfig.h"
+#include "node.h"
+#include "window.h"
+
+__thread SWINDOW SearchWin = NULL;	// open window of this thread
+static __thread struct swindow_ ThreadWindow;	// window buffers of this thread
+
+/*--------------------------------------------------------------*/
+/* window_bounds --						*/
+/*								*/
+/* Find the area of the window on "net":  the trunk extent of	*/
+/* its bbox grown by WINDOW_HALO, clipped to the die.  A net	*/
+/* without a usable bbox gets a window on the whole die.	*/
+/*--------------------------------------------------------------*/
+
+void
+window_bounds(NET net, int *xmin, int *ymin, int *xmax, int *ymax)
+{
+    if (!get_bbox_extent(net->bbox, xmin, ymin, xmax, ymax)) {
+	*xmin = *ymin = 0;
+	*xmax = NumChannelsX[0] - 1;
+	*ymax = NumChannelsY[0] - 1;
+    }
+    *xmin = MAX(*xmin - WINDOW_HALO, 0);
+    *ymin = MAX(*ymin - WINDOW_HALO, 0);
+    *xmax = MIN(*xmax + WINDOW_HALO, NumChannelsX[0] - 1);
+    *ymax = MIN(*ymax + WINDOW_HALO, NumChannelsY[0] - 1);
+    if (*xmax < *xmin) *xmax = *xmin;
+    if (*ymax < *ymin) *ymax = *ymin;
+}
+
+/*--------------------------------------------------------------*/
+/* window_open --						*/
+/*								*/
+/* Open the search window of the calling thread on the bbox	*/
+/* of "net", and make it the target of OBS2VAL() and RMASK().	*/
+/* Records left over from earlier nets carry an old epoch and	*/
+/* are refreshed on first access.				*/
+/*--------------------------------------------------------------*/
+
+SWINDOW
+window_open(NET net)
+{
+    SWINDOW sw;
+    int xmin, xmax, ymin, ymax;
+
+    sw = &ThreadWindow;
+    window_bounds(net, &xmin, &ymin, &xmax, &ymax);
+
+    sw->x0 = xmin;
+    sw->y0 = ymin;
+    sw->width = xmax - xmin + 1;
+    sw->height = ymax - ymin + 1;
+    sw->size = sw->width * sw->height;
+
+    // Grow the planes if needed.  New records are zeroed, so that
+    // their epoch is never current.
+
+    if ((sw->size > sw->maxsize) || (Num_layers > sw->maxlayers)) {
+	free(sw->obs2);
+	free(sw->rmask);
+	sw->maxsize = MAX(sw->size, sw->maxsize);
+	sw->maxlayers = MAX(Num_layers, sw->maxlayers);
+	sw->obs2 = (PROUTE *)calloc(sw->maxsize * sw->maxlayers,
+			sizeof(PROUTE));
+	sw->rmask = (u_char *)calloc(sw->maxsize, sizeof(u_char));
+	if ((sw->obs2 == NULL) || (sw->rmask == NULL)) {
+	    printf("%s: memory leak. dying!\n",__FUNCTION__);
+	    exit(0);
+	}
+    }
+
+    SearchWin = sw;
+    return sw;
+}
+
+/*--------------------------------------------------------------*/
+/* window_close --						*/
+/*								*/
+/* Detach the search window from the calling thread.  The	*/
+/* buffers are kept for the next net.				*/
+/*--------------------------------------------------------------*/
+
+void
+window_close(void)
+{
+    SearchWin = NULL;
+}
+
+/*--------------------------------------------------------------*/
+/* window_release --						*/
+/*								*/
+/* Free the search window of the calling thread.  Must be	*/
+/* called by router threads before they exit.			*/
+/*--------------------------------------------------------------*/
+
+void
+window_release(void)
+{
+    SWINDOW sw;
+
+    sw = &ThreadWindow;
+    free(sw->obs2);
+    free(sw->rmask);
+    sw->obs2 = NULL;
+    sw->rmask = NULL;
+    sw->maxsize = 0;
+    sw->maxlayers = 0;
+    SearchWin = NULL;
+}
+
+/*--------------------------------------------------------------*/
+/* window_obs2 --						*/
+/*								*/
+/* Return the record for (x, y, lay) in the window of the	*/
+/* calling thread, after making it a fresh copy of Obs[] for	*/
+/* the current epoch.  Obstructed positions record the net	*/
+/* number of the obstruction, free positions are marked		*/
+/* routable at the maximum cost.  Positions outside of the	*/
+/* window are copied into the stand-in record, which is		*/
+/* refreshed on every access.					*/
+/*--------------------------------------------------------------*/
+
+PROUTE *
+window_obs2(int x, int y, int lay)
+{
+    PROUTE *Pr;
+    u_int netnum;
+
+    if (INWINDOW(x, y))
+	Pr = &WOBS2(x, y, lay);
+    else {
+	Pr = &SearchWin->outside;
+	if ((x < 0) || (x >= NumChannelsX[lay]) || (y < 0) ||
+		(y >= NumChannelsY[lay])) {
+	    Pr->flags = 0;
+	    Pr->prdata.net = NO_NET;
+	    Pr->epoch = Obs2Epoch;
+	    return Pr;
+	}
+    }
+
+    netnum = OBSVAL(x, y, lay) & (~BLOCKED_MASK);
+    if (netnum != 0) {
+	Pr->flags = 0;		// Clear all flags
+	if (netnum == DRC_BLOCKAGE)
+	    Pr->prdata.net = netnum;
+	else
+	    Pr->prdata.net = netnum & NETNUM_MASK;
+    } else {
+	Pr->flags = PR_COST;		// This location is routable
+	Pr->prdata.cost = MAXRT;
+    }
+    Pr->epoch = Obs2Epoch;
+    return Pr;
+}
+
+/* end of window.c */
@@ -0,0 +1,22 @@
+/*--------------------------------------------------------------*/
+/* window.h --							*/
+/*								*/
+/* Per-thread search windows of the maze router (header file)	*/
+/*--------------------------------------------------------------*/
+
+#ifndef WINDOW_H
+
+/* Grid positions around the trunk extent of the net bbox that	*/
+/* are also held in the window, so that the neighbors of any	*/
+/* position the search can reach are inside the window.		*/
+#define WINDOW_HALO		1
+
+void    window_bounds(NET net, int *xmin, int *ymin, int *xmax, int *ymax);
+SWINDOW window_open(NET net);
+void    window_close(void);
+void    window_release(void);
+
+#define WINDOW_H
+#endif
+
+/* end of window.h */